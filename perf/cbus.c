@@ -0,0 +1,137 @@
+/*
+ * Measure the throughput of many producer threads sending
+ * batches of messages over cbus to one consumer.
+ *
+ * Usage: cbus.perf [threads] [messages per thread] [batch size]
+ */
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memory.h"
+#include "clock.h"
+#include "fiber.h"
+#include "cbus.h"
+
+static int thread_count = 32;
+static int msg_count = 20000;
+static int batch_size = 64;
+
+struct producer {
+	struct cord cord;
+	char name[FIBER_NAME_MAX];
+	/* Messages sent to the consumer. */
+	struct cmsg *msgs;
+	/* Sent last to tell the consumer the producer is done. */
+	struct cmsg done;
+};
+
+/* Number of messages received by the consumer. */
+static int received;
+/* Number of producers which have not sent all messages yet. */
+static int active_count;
+
+static void
+msg_received_cb(struct cmsg *msg)
+{
+	(void)msg;
+	received++;
+}
+
+static void
+producer_done_cb(struct cmsg *msg)
+{
+	(void)msg;
+	active_count--;
+}
+
+static int
+producer_f(va_list ap)
+{
+	struct producer *p = va_arg(ap, struct producer *);
+	static const struct cmsg_hop route[] = {
+		{ msg_received_cb, NULL }
+	};
+	static const struct cmsg_hop done_route[] = {
+		{ producer_done_cb, NULL }
+	};
+	struct cpipe pipe;
+	cpipe_create(&pipe, "main");
+	/* The pipe is flushed whenever a batch is complete. */
+	cpipe_set_max_input(&pipe, batch_size);
+	for (int i = 0; i < msg_count; i++) {
+		cmsg_init(&p->msgs[i], route);
+		cpipe_push_input(&pipe, &p->msgs[i]);
+	}
+	cmsg_init(&p->done, done_route);
+	cpipe_push_input(&pipe, &p->done);
+	cpipe_destroy(&pipe);
+	return 0;
+}
+
+static int
+main_f(va_list ap)
+{
+	(void)ap;
+	struct cbus_endpoint endpoint;
+	cbus_endpoint_create(&endpoint, "main", fiber_schedule_cb, fiber());
+
+	struct producer *producers = calloc(thread_count, sizeof(*producers));
+	assert(producers != NULL);
+	double start = clock_monotonic();
+	for (int i = 0; i < thread_count; i++) {
+		struct producer *p = &producers[i];
+		snprintf(p->name, sizeof(p->name), "producer_%d", i);
+		p->msgs = calloc(msg_count, sizeof(*p->msgs));
+		assert(p->msgs != NULL);
+		active_count++;
+		if (cord_costart(&p->cord, p->name, producer_f, p) != 0)
+			unreachable();
+	}
+	while (active_count > 0) {
+		cbus_process(&endpoint);
+		if (active_count > 0)
+			fiber_yield();
+	}
+	double elapsed = clock_monotonic() - start;
+	assert(received == thread_count * msg_count);
+	printf("%d threads, batch %d: %d messages in %.3f sec, "
+	       "%.0f messages/sec\n", thread_count, batch_size, received,
+	       elapsed, received / elapsed);
+
+	for (int i = 0; i < thread_count; i++) {
+		if (cord_join(&producers[i].cord) != 0)
+			unreachable();
+		free(producers[i].msgs);
+	}
+	free(producers);
+	cbus_endpoint_destroy(&endpoint, cbus_process);
+	ev_break(loop(), EVBREAK_ALL);
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 1)
+		thread_count = atoi(argv[1]);
+	if (argc > 2)
+		msg_count = atoi(argv[2]);
+	if (argc > 3)
+		batch_size = atoi(argv[3]);
+
+	memory_init();
+	fiber_init(fiber_c_invoke);
+	cbus_init();
+
+	struct fiber *f = fiber_new("main", main_f);
+	assert(f != NULL);
+	fiber_wakeup(f);
+	ev_run(loop(), 0);
+
+	cbus_free();
+	fiber_free();
+	memory_free();
+	return 0;
+}
@@ -0,0 +1,54 @@
+#!/usr/bin/env tarantool
+--
+-- Compare the small file I/O throughput of io_uring and the eio
+-- thread pool, see box.cfg.file_io_uring.
+--
+-- Usage: tarantool fio_io_uring.lua [fibers] [operations]
+--
+local fio = require('fio')
+local fiber = require('fiber')
+local clock = require('clock')
+
+local n_fibers = tonumber(arg[1]) or 100
+local n_ops = tonumber(arg[2]) or 1000
+local block = string.rep('x', 4096)
+local dir = fio.tempdir()
+
+box.cfg{work_dir = dir, log = fio.pathjoin(dir, 'tarantool.log')}
+
+local function bench(io_uring)
+    box.cfg{file_io_uring = io_uring}
+    local done = 0
+    local start = clock.monotonic()
+    for i = 1, n_fibers do
+        fiber.create(function()
+            local path = fio.pathjoin(dir, tostring(i))
+            local fh = fio.open(path, {'O_RDWR', 'O_CREAT', 'O_TRUNC'},
+                                tonumber('644', 8))
+            for j = 1, n_ops do
+                local offset = (j % 16) * #block
+                assert(fh:pwrite(block, offset))
+                assert(fh:pread(#block, offset) == block)
+                if j % 100 == 0 then
+                    assert(fh:fdatasync())
+                end
+            end
+            fh:close()
+            fio.unlink(path)
+            done = done + 1
+        end)
+    end
+    while done < n_fibers do
+        fiber.sleep(0.01)
+    end
+    local elapsed = clock.monotonic() - start
+    print(string.format('%s: %d fibers, %d requests: %.3f s, %d RPS',
+                        io_uring and 'io_uring' or 'eio', n_fibers,
+                        2 * n_fibers * n_ops, elapsed,
+                        2 * n_fibers * n_ops / elapsed))
+end
+
+bench(false)
+bench(true)
+fio.rmtree(dir)
+os.exit(0)
@@ -0,0 +1,74 @@
+#!/usr/bin/env tarantool
+--
+-- Compare the request throughput of the io_uring and the epoll
+-- network backends, see box.cfg.iproto_io_uring. Each backend
+-- is measured in a separate server process.
+--
+-- Usage: tarantool iproto_io_uring.lua [connections] [fibers] [requests]
+--
+local fio = require('fio')
+local fiber = require('fiber')
+local clock = require('clock')
+local popen = require('popen')
+local net_box = require('net.box')
+
+if arg[1] == 'server' then
+    box.cfg{work_dir = arg[4], iproto_io_uring = arg[3] == 'true'}
+    box.schema.user.grant('guest', 'read,write,execute', 'universe')
+    box.schema.space.create('test')
+    box.space.test:create_index('pk')
+    box.cfg{listen = arg[2]}
+    return
+end
+
+local n_conns = tonumber(arg[1]) or 500
+local n_fibers = tonumber(arg[2]) or 2000
+local n_requests = tonumber(arg[3]) or 100
+
+local function bench(io_uring)
+    local dir = fio.tempdir()
+    local uri = fio.pathjoin(dir, 'iproto.sock')
+    local server = popen.shell(string.format('exec %s %s server %s %s %s',
+                                             arg[-1], arg[0], uri,
+                                             tostring(io_uring), dir))
+    local conn = net_box.connect(uri)
+    while not conn:is_connected() do
+        fiber.sleep(0.1)
+        conn = net_box.connect(uri)
+    end
+    local conns = {conn}
+    for i = 2, n_conns do
+        conns[i] = net_box.connect(uri)
+    end
+    local done = 0
+    local start = clock.monotonic()
+    for i = 1, n_fibers do
+        fiber.create(function()
+            local space = conns[i % n_conns + 1].space.test
+            for j = 1, n_requests do
+                space:replace({i * n_requests + j})
+                space:get({i * n_requests + j})
+            end
+            done = done + 1
+        end)
+    end
+    while done < n_fibers do
+        fiber.sleep(0.01)
+    end
+    local elapsed = clock.monotonic() - start
+    print(string.format('%s: %d connections, %d requests: %.3f s, %d RPS',
+                        io_uring and 'io_uring' or 'epoll', n_conns,
+                        2 * n_fibers * n_requests, elapsed,
+                        2 * n_fibers * n_requests / elapsed))
+    for i = 1, n_conns do
+        conns[i]:close()
+    end
+    server:kill()
+    server:wait()
+    server:close()
+    fio.rmtree(dir)
+end
+
+bench(false)
+bench(true)
+os.exit(0)
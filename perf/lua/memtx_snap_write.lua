@@ -0,0 +1,50 @@
+#!/usr/bin/env tarantool
+--
+-- Compare the checkpoint time with a different number of snapshot
+-- compression threads, see box.cfg.memtx_snap_write_threads.
+--
+-- Usage: tarantool memtx_snap_write.lua [tuples]
+--
+local fio = require('fio')
+local clock = require('clock')
+local digest = require('digest')
+
+local n_tuples = tonumber(arg[1]) or 2000000
+local dir = fio.tempdir()
+
+box.cfg{
+    work_dir = dir,
+    log = fio.pathjoin(dir, 'tarantool.log'),
+    memtx_memory = 2 * 1024 * 1024 * 1024,
+}
+
+local s = box.schema.space.create('test')
+s:create_index('pk')
+for i = 1, n_tuples, 10000 do
+    box.begin()
+    for j = i, math.min(i + 9999, n_tuples) do
+        s:insert{j, digest.base64_encode(digest.urandom(24)),
+                 string.rep('x', j % 200)}
+    end
+    box.commit()
+end
+
+local function bench(threads)
+    box.cfg{memtx_snap_write_threads = threads}
+    -- Make sure a new snapshot is created.
+    s:replace(s:get(1))
+    local start = clock.monotonic()
+    box.snapshot()
+    local elapsed = clock.monotonic() - start
+    local path = fio.pathjoin(box.cfg.memtx_dir,
+        string.format('%020d.snap', box.info.signature))
+    local size = fio.stat(path).size / 1024 / 1024
+    print(string.format('%d threads: %.1f MB, %.3f s, %.1f MB/s',
+                        threads, size, elapsed, size / elapsed))
+end
+
+for _, threads in ipairs({0, 1, 2, 4, 8}) do
+    bench(threads)
+end
+fio.rmtree(dir)
+os.exit(0)
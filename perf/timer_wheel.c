@@ -0,0 +1,99 @@
+/*
+ * Compare the cost of arming and cancelling a timeout in the
+ * fiber timer wheel and in the libev timer heap while there are
+ * lots of other timeouts pending.
+ *
+ * Usage: timer_wheel.perf [pending timers] [operations]
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memory.h"
+#include "fiber.h"
+#include "clock.h"
+#include "timer_wheel.h"
+
+static int background_count = 100000;
+static int op_count = 1000000;
+
+static void
+timer_cb(ev_loop *loop, ev_timer *watcher, int revents)
+{
+	(void)loop;
+	(void)watcher;
+	(void)revents;
+}
+
+static double
+bench_wheel(void)
+{
+	struct timer_wheel_entry *entries =
+		calloc(background_count, sizeof(*entries));
+	assert(entries != NULL);
+	struct timer_wheel wheel;
+	timer_wheel_create(&wheel, 0);
+	for (int i = 0; i < background_count; i++) {
+		timer_wheel_entry_create(&entries[i]);
+		timer_wheel_add(&wheel, &entries[i], 1 + rand() % 1000000);
+	}
+	struct timer_wheel_entry entry;
+	timer_wheel_entry_create(&entry);
+	double start = clock_monotonic();
+	for (int i = 0; i < op_count; i++) {
+		timer_wheel_add(&wheel, &entry, 1 + i % 1000000);
+		timer_wheel_del(&wheel, &entry);
+	}
+	double elapsed = clock_monotonic() - start;
+	free(entries);
+	return elapsed;
+}
+
+static double
+bench_ev_heap(void)
+{
+	struct ev_loop *loop = loop();
+	struct ev_timer *timers = calloc(background_count, sizeof(*timers));
+	assert(timers != NULL);
+	for (int i = 0; i < background_count; i++) {
+		ev_timer_init(&timers[i], timer_cb,
+			      1000 + (rand() % 1000000) / 1000.0, 0);
+		ev_timer_start(loop, &timers[i]);
+	}
+	struct ev_timer timer;
+	double start = clock_monotonic();
+	for (int i = 0; i < op_count; i++) {
+		ev_timer_init(&timer, timer_cb,
+			      1000 + (i % 1000000) / 1000.0, 0);
+		ev_timer_start(loop, &timer);
+		ev_timer_stop(loop, &timer);
+	}
+	double elapsed = clock_monotonic() - start;
+	for (int i = 0; i < background_count; i++)
+		ev_timer_stop(loop, &timers[i]);
+	free(timers);
+	return elapsed;
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 1)
+		background_count = atoi(argv[1]);
+	if (argc > 2)
+		op_count = atoi(argv[2]);
+
+	srand(1);
+	memory_init();
+	fiber_init(fiber_c_invoke);
+
+	double wheel_time = bench_wheel();
+	double heap_time = bench_ev_heap();
+	printf("arm+cancel with %d pending timers: wheel %.1f ns, "
+	       "ev heap %.1f ns\n", background_count,
+	       wheel_time * 1e9 / op_count, heap_time * 1e9 / op_count);
+
+	fiber_free();
+	memory_free();
+	return 0;
+}
@@ -52,6 +52,7 @@
 #include "engine.h"
 #include "memtx_engine.h"
 #include "memtx_space.h"
+#include "affinity.h"
 #include "sysview.h"
 #include "blackhole.h"
 #include "service_engine.h"
@@ -459,6 +460,11 @@ box_check_say(void)
 		tnt_raise(ClientError, ER_CFG, "log_nonblock",
 			  "the option is incompatible with file/stderr logger");
 	}
+	const char *log_overflow = cfg_gets("log_overflow");
+	if (say_overflow_by_name(log_overflow) == say_overflow_MAX) {
+		tnt_raise(ClientError, ER_CFG, "log_overflow",
+			  "expected 'block' or 'drop'");
+	}
 }
 
 static void
@@ -475,6 +481,18 @@ box_check_uri(const char *source, const char *option_name)
 	}
 }
 
+/**
+ * Check the listen URI. A shared memory URI "shm/:<path>" is
+ * checked as the URI of the unix socket it is set up over.
+ */
+static void
+box_check_listen(const char *source)
+{
+	if (source != NULL && iproto_uri_is_shm(source))
+		source = tt_sprintf("unix/%s", source + strlen("shm/"));
+	box_check_uri(source, "listen");
+}
+
 static const char *
 box_check_election_mode(void)
 {
@@ -765,6 +783,123 @@ box_check_readahead(int readahead)
 	}
 }
 
+static int
+box_check_iproto_threads(void)
+{
+	int threads = cfg_geti("iproto_threads");
+	if (threads <= 0 || threads > IPROTO_THREADS_MAX) {
+		diag_set(ClientError, ER_CFG, "iproto_threads",
+			 tt_sprintf("must be greater than or equal to 1 "
+				    "and less than or equal to %d",
+				    IPROTO_THREADS_MAX));
+		return -1;
+	}
+	return threads;
+}
+
+/** Return the name of the CPU affinity option of a thread class. */
+static const char *
+box_cpu_affinity_option(int cls)
+{
+	return tt_sprintf("cpu_affinity_%s", affinity_class_strs[cls]);
+}
+
+static int
+box_check_cpu_affinity(void)
+{
+	for (int cls = 0; cls < affinity_class_MAX; cls++) {
+		const char *option = box_cpu_affinity_option(cls);
+		const char *cpus = cfg_gets(option);
+		if (cpus != NULL && affinity_check(cpus) != 0) {
+			diag_set(ClientError, ER_CFG, option,
+				 diag_last_error(diag_get())->errmsg);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static enum tuple_arena_huge_pages
+box_check_memtx_huge_pages(void)
+{
+	const char *mode_name = cfg_gets("memtx_huge_pages");
+	assert(mode_name != NULL); /* checked in Lua */
+	int mode = strindex(tuple_arena_huge_pages_strs, mode_name,
+			    tuple_arena_huge_pages_MAX);
+	if (mode == tuple_arena_huge_pages_MAX)
+		tnt_raise(ClientError, ER_CFG, "memtx_huge_pages", mode_name);
+	return (enum tuple_arena_huge_pages)mode;
+}
+
+static int
+box_check_memtx_snap_read_threads(void)
+{
+	int threads = cfg_geti("memtx_snap_read_threads");
+	if (threads < 0 || threads > MEMTX_SNAP_READ_THREADS_MAX) {
+		diag_set(ClientError, ER_CFG, "memtx_snap_read_threads",
+			 tt_sprintf("must be greater than or equal to 0 "
+				    "and less than or equal to %d",
+				    MEMTX_SNAP_READ_THREADS_MAX));
+		return -1;
+	}
+	return threads;
+}
+
+static int
+box_check_memtx_snap_write_threads(void)
+{
+	int threads = cfg_geti("memtx_snap_write_threads");
+	if (threads < 0 || threads > MEMTX_SNAP_WRITE_THREADS_MAX) {
+		diag_set(ClientError, ER_CFG, "memtx_snap_write_threads",
+			 tt_sprintf("must be greater than or equal to 0 "
+				    "and less than or equal to %d",
+				    MEMTX_SNAP_WRITE_THREADS_MAX));
+		return -1;
+	}
+	return threads;
+}
+
+/**
+ * Check the NUMA node to bind the memtx arena to.
+ * @retval >= 0 The node number.
+ * @retval   -1 The node is not set.
+ * @retval   -2 Invalid node, diag is set.
+ */
+static int
+box_check_memtx_numa_node(void)
+{
+	if (cfg_gets("memtx_numa_node") == NULL)
+		return -1;
+	int node = cfg_geti("memtx_numa_node");
+	int count = numa_node_count();
+	if (node < 0 || node >= count) {
+		diag_set(ClientError, ER_CFG, "memtx_numa_node",
+			 count == 0 ? "NUMA is not supported" :
+			 tt_sprintf("must be greater than or equal to 0 "
+				    "and less than %d", count));
+		return -2;
+	}
+	return node;
+}
+
+/**
+ * Pin the main thread and set CPU sets for the thread classes,
+ * which are applied when the threads start.
+ */
+static void
+box_set_cpu_affinity(void)
+{
+	for (int cls = 0; cls < affinity_class_MAX; cls++) {
+		const char *cpus = cfg_gets(box_cpu_affinity_option(cls));
+		if (cpus == NULL)
+			continue;
+		if (affinity_set((enum affinity_class)cls, cpus) != 0)
+			diag_raise();
+		say_info("%s threads are pinned to CPUs %s",
+			 affinity_class_strs[cls], cpus);
+	}
+}
+
 static void
 box_check_checkpoint_count(int checkpoint_count)
 {
@@ -854,7 +989,7 @@ box_check_config(void)
 {
 	struct tt_uuid uuid;
 	box_check_say();
-	box_check_uri(cfg_gets("listen"), "listen");
+	box_check_listen(cfg_gets("listen"));
 	box_check_instance_uuid(&uuid);
 	box_check_replicaset_uuid(&uuid);
 	if (box_check_election_mode() == NULL)
@@ -872,12 +1007,23 @@ box_check_config(void)
 		diag_raise();
 	box_check_replication_sync_timeout();
 	box_check_readahead(cfg_geti("readahead"));
+	if (box_check_iproto_threads() < 0)
+		diag_raise();
 	box_check_checkpoint_count(cfg_geti("checkpoint_count"));
 	box_check_wal_max_size(cfg_geti64("wal_max_size"));
 	box_check_wal_mode(cfg_gets("wal_mode"));
 	if (box_check_memory_quota("memtx_memory") < 0)
 		diag_raise();
 	box_check_memtx_min_tuple_size(cfg_geti64("memtx_min_tuple_size"));
+	box_check_memtx_huge_pages();
+	if (box_check_memtx_numa_node() < -1)
+		diag_raise();
+	if (box_check_memtx_snap_read_threads() < 0)
+		diag_raise();
+	if (box_check_memtx_snap_write_threads() < 0)
+		diag_raise();
+	if (box_check_cpu_affinity() != 0)
+		diag_raise();
 	box_check_vinyl_options();
 	if (box_check_sql_cache_size(cfg_geti("sql_cache_size")) != 0)
 		diag_raise();
@@ -1311,7 +1457,7 @@ void
 box_listen(void)
 {
 	const char *uri = cfg_gets("listen");
-	box_check_uri(uri, "listen");
+	box_check_listen(uri);
 	iproto_listen(uri);
 }
 
@@ -1349,6 +1495,18 @@ box_set_snap_io_rate_limit(void)
 			cfg_getd("snap_io_rate_limit"));
 }
 
+void
+box_set_memtx_snap_write_threads(void)
+{
+	int threads = box_check_memtx_snap_write_threads();
+	if (threads < 0)
+		diag_raise();
+	struct memtx_engine *memtx;
+	memtx = (struct memtx_engine *)engine_by_name("memtx");
+	assert(memtx != NULL);
+	memtx_engine_set_snap_write_threads(memtx, threads);
+}
+
 void
 box_set_memtx_memory(void)
 {
@@ -1452,11 +1610,29 @@ box_set_net_msg_max(void)
 {
 	int new_iproto_msg_max = cfg_geti("net_msg_max");
 	iproto_set_msg_max(new_iproto_msg_max);
+	/* Every network thread has its own message limit. */
 	fiber_pool_set_max_size(&tx_fiber_pool,
-				new_iproto_msg_max *
+				new_iproto_msg_max * iproto_threads_count *
 				IPROTO_FIBER_POOL_SIZE_FACTOR);
 }
 
+void
+box_set_iproto_queue_delay_max(void)
+{
+	double delay = cfg_getd("iproto_queue_delay_max");
+	if (delay < 0) {
+		tnt_raise(ClientError, ER_CFG, "iproto_queue_delay_max",
+			  "the value must be greater than or equal to 0");
+	}
+	iproto_set_queue_delay_max(delay);
+}
+
+void
+box_set_iproto_adaptive(void)
+{
+	iproto_set_adaptive(cfg_geti("iproto_adaptive"));
+}
+
 int
 box_set_prepared_stmt_cache_size(void)
 {
@@ -1652,6 +1828,43 @@ box_select(uint32_t space_id, uint32_t index_id,
 	   int iterator, uint32_t offset, uint32_t limit,
 	   const char *key, const char *key_end,
 	   struct port *port)
+{
+	return box_select_position(space_id, index_id, iterator, offset,
+				   limit, key, key_end, NULL, NULL, NULL, NULL,
+				   port);
+}
+
+/**
+ * Check that the iteration over @a index can be resumed from
+ * a position. Multikey and functional indexes can have several
+ * entries per tuple, so a tuple does not define a position.
+ */
+static int
+box_check_position(struct index *index, enum iterator_type type)
+{
+	if (type > ITER_GT) {
+		diag_set(ClientError, ER_ILLEGAL_PARAMS,
+			 tt_sprintf("iterator position is not supported "
+				    "by %s iterator", iterator_type_strs[type]));
+		return -1;
+	}
+	if (index->def->key_def->is_multikey ||
+	    index->def->key_def->for_func_index) {
+		diag_set(ClientError, ER_ILLEGAL_PARAMS,
+			 tt_sprintf("iterator position is not supported "
+				    "by index '%s'", index->def->name));
+		return -1;
+	}
+	return 0;
+}
+
+int
+box_select_position(uint32_t space_id, uint32_t index_id,
+		    int iterator, uint32_t offset, uint32_t limit,
+		    const char *key, const char *key_end,
+		    const char *after, const char *after_end,
+		    const char **position, const char **position_end,
+		    struct port *port)
 {
 	(void)key_end;
 
@@ -1677,6 +1890,37 @@ box_select(uint32_t space_id, uint32_t index_id,
 	uint32_t part_count = key ? mp_decode_array(&key) : 0;
 	if (key_validate(index->def, type, key, part_count))
 		return -1;
+	if ((after != NULL || position != NULL) &&
+	    box_check_position(index, type) != 0)
+		return -1;
+	/*
+	 * A position is the key of the last selected tuple
+	 * extended to the unique comparison key of the index.
+	 * The scan is resumed strictly after it in the iteration
+	 * order. All tuples there satisfy the original search
+	 * condition, except for EQ and REQ, which stop at the
+	 * first mismatch.
+	 */
+	enum iterator_type scan_type = type;
+	const char *scan_key = key;
+	uint32_t scan_part_count = part_count;
+	if (after != NULL) {
+		const char *pos = after;
+		if (after == after_end || mp_typeof(*after) != MP_ARRAY ||
+		    mp_check(&pos, after_end) != 0 || pos != after_end) {
+			diag_set(ClientError, ER_ILLEGAL_PARAMS,
+				 "invalid iterator position");
+			return -1;
+		}
+		scan_key = after;
+		scan_part_count = mp_decode_array(&scan_key);
+		if (exact_key_validate(index->def->cmp_def, scan_key,
+				       scan_part_count) != 0)
+			return -1;
+		scan_type = iterator_direction(type) > 0 ? ITER_GT : ITER_LT;
+	}
+	bool is_eq = after != NULL && part_count > 0 &&
+		     (type == ITER_EQ || type == ITER_REQ);
 
 	ERROR_INJECT(ERRINJ_TESTING, {
 		diag_set(ClientError, ER_INJECTION, "ERRINJ_TESTING");
@@ -1688,8 +1932,8 @@ box_select(uint32_t space_id, uint32_t index_id,
 	if (txn_begin_ro_stmt(space, &txn, &svp) != 0)
 		return -1;
 
-	struct iterator *it = index_create_iterator(index, type,
-						    key, part_count);
+	struct iterator *it = index_create_iterator(index, scan_type,
+						    scan_key, scan_part_count);
 	if (it == NULL) {
 		txn_rollback_stmt(txn);
 		return -1;
@@ -1698,11 +1942,16 @@ box_select(uint32_t space_id, uint32_t index_id,
 	int rc = 0;
 	uint32_t found = 0;
 	struct tuple *tuple;
+	struct tuple *last = NULL;
 	port_c_create(port);
 	while (found < limit) {
 		rc = iterator_next(it, &tuple);
 		if (rc != 0 || tuple == NULL)
 			break;
+		if (is_eq && tuple_compare_with_key(tuple, HINT_NONE, key,
+						    part_count, HINT_NONE,
+						    index->def->key_def) != 0)
+			break;
 		if (offset > 0) {
 			offset--;
 			continue;
@@ -1711,6 +1960,22 @@ box_select(uint32_t space_id, uint32_t index_id,
 		if (rc != 0)
 			break;
 		found++;
+		last = tuple;
+	}
+	if (rc == 0 && position != NULL) {
+		*position = NULL;
+		*position_end = NULL;
+		/* The tuple is referenced by the port. */
+		if (last != NULL) {
+			uint32_t size;
+			*position = tuple_extract_key(last,
+						      index->def->cmp_def,
+						      MULTIKEY_NONE, &size);
+			if (*position == NULL)
+				rc = -1;
+			else
+				*position_end = *position + size;
+		}
 	}
 	iterator_delete(it);
 
@@ -2541,9 +2806,13 @@ engine_init()
 				    cfg_getd("memtx_memory"),
 				    cfg_geti("memtx_min_tuple_size"),
 				    cfg_geti("strip_core"),
-				    cfg_getd("slab_alloc_factor"));
+				    cfg_getd("slab_alloc_factor"),
+				    box_check_memtx_huge_pages(),
+				    box_check_memtx_numa_node());
 	engine_register((struct engine *)memtx);
 	box_set_memtx_max_tuple_size();
+	memtx_engine_set_snap_read_threads(memtx,
+			box_check_memtx_snap_read_threads());
 
 	struct sysview_engine *sysview = sysview_engine_new_xc();
 	engine_register((struct engine *)sysview);
@@ -2945,12 +3214,16 @@ box_cfg_xc(void)
 	rmean_box = rmean_new(iproto_type_strs, IPROTO_TYPE_STAT_MAX);
 	rmean_error = rmean_new(rmean_error_strings, RMEAN_ERROR_LAST);
 
+	box_set_cpu_affinity();
 	gc_init();
 	engine_init();
 	schema_init();
 	replication_init();
 	port_init();
-	iproto_init();
+	int iproto_threads = box_check_iproto_threads();
+	if (iproto_threads < 0)
+		diag_raise();
+	iproto_init(iproto_threads, cfg_getb("iproto_io_uring"));
 	sql_init();
 
 	int64_t wal_max_size = box_check_wal_max_size(cfg_geti64("wal_max_size"));
@@ -2970,6 +3243,8 @@ box_cfg_xc(void)
 	if (box_set_prepared_stmt_cache_size() != 0)
 		diag_raise();
 	box_set_net_msg_max();
+	box_set_iproto_queue_delay_max();
+	box_set_iproto_adaptive();
 	box_set_readahead();
 	box_set_too_long_threshold();
 	box_set_replication_timeout();
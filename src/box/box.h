@@ -234,6 +234,7 @@ void box_set_log_level(void);
 void box_set_log_format(void);
 void box_set_io_collect_interval(void);
 void box_set_snap_io_rate_limit(void);
+void box_set_memtx_snap_write_threads(void);
 void box_set_too_long_threshold(void);
 void box_set_readahead(void);
 void box_set_checkpoint_count(void);
@@ -258,6 +259,8 @@ void box_set_replication_sync_timeout(void);
 void box_set_replication_skip_conflict(void);
 void box_set_replication_anon(void);
 void box_set_net_msg_max(void);
+void box_set_iproto_queue_delay_max(void);
+void box_set_iproto_adaptive(void);
 int box_set_crash(void);
 
 int
@@ -278,6 +281,23 @@ box_select(uint32_t space_id, uint32_t index_id,
 	   const char *key, const char *key_end,
 	   struct port *port);
 
+/**
+ * Same as box_select(), but the scan is resumed after the
+ * position @a after if it is not NULL, and the position of the
+ * last selected tuple is returned in @a position if it is not
+ * NULL. The returned position is allocated on the fiber region
+ * and is NULL if nothing is selected. A position is an opaque
+ * MsgPack array, valid only for the index it is obtained from.
+ * Supported for EQ, REQ, ALL, LT, LE, GE and GT iterators.
+ */
+int
+box_select_position(uint32_t space_id, uint32_t index_id,
+		    int iterator, uint32_t offset, uint32_t limit,
+		    const char *key, const char *key_end,
+		    const char *after, const char *after_end,
+		    const char **position, const char **position_end,
+		    struct port *port);
+
 /** \cond public */
 
 /*
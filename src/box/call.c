@@ -148,8 +148,12 @@ box_process_call(struct call_request *request, struct port *port)
 	const char *name = request->name;
 	assert(name != NULL);
 	uint32_t name_len = mp_decode_strl(&name);
-	/* Transaction is not started. */
-	assert(!in_txn());
+	/*
+	 * A request of a stream may run inside the stream
+	 * transaction. The function must not leave a
+	 * transaction of its own.
+	 */
+	struct txn *txn = in_txn();
 
 	int rc;
 	struct port args;
@@ -164,8 +168,9 @@ box_process_call(struct call_request *request, struct port *port)
 	}
 	if (rc != 0)
 		return -1;
-	if (in_txn() != NULL) {
+	if (in_txn() != NULL && in_txn() != txn) {
 		diag_set(ClientError, ER_FUNCTION_TX_ACTIVE);
+		txn_rollback(in_txn());
 		port_destroy(port);
 		return -1;
 	}
@@ -184,10 +189,12 @@ box_process_eval(struct call_request *request, struct port *port)
 			    request->args_end - request->args);
 	const char *expr = request->expr;
 	uint32_t expr_len = mp_decode_strl(&expr);
+	struct txn *txn = in_txn();
 	if (box_lua_eval(expr, expr_len, &args, port) != 0)
 		return -1;
-	if (in_txn() != 0) {
+	if (in_txn() != NULL && in_txn() != txn) {
 		diag_set(ClientError, ER_FUNCTION_TX_ACTIVE);
+		txn_rollback(in_txn());
 		port_destroy(port);
 		return -1;
 	}
@@ -32,10 +32,15 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/socket.h>
 
 #include <msgpuck.h>
 #include <small/ibuf.h>
 #include <small/obuf.h>
+#include <zstd.h>
+#include <pmatomic.h>
 #include "third_party/base64.h"
 
 #include "version.h"
@@ -45,21 +50,28 @@
 #include "sio.h"
 #include "evio.h"
 #include "coio.h"
+#include "uring.h"
+#include "shm_chan.h"
 #include "scoped_guard.h"
 #include "memory.h"
 #include "random.h"
+#include "assoc.h"
 
 #include "bind.h"
 #include "port.h"
 #include "box.h"
 #include "call.h"
+#include "tuple.h"
 #include "tuple_convert.h"
 #include "session.h"
+#include "txn.h"
 #include "xrow.h"
 #include "schema.h" /* schema_version */
 #include "replication.h" /* instance_uuid */
 #include "iproto_constants.h"
 #include "rmean.h"
+#include "latency.h"
+#include "info/info.h"
 #include "execute.h"
 #include "errinj.h"
 #include "tt_static.h"
@@ -67,8 +79,74 @@
 enum {
 	IPROTO_SALT_SIZE = 32,
 	IPROTO_PACKET_SIZE_MAX = 2UL * 1024 * 1024 * 1024,
+	/**
+	 * Size of the io_uring submission queue of a network
+	 * thread. When the ring is full, the connection falls
+	 * back to plain non-blocking I/O for a while.
+	 */
+	IPROTO_URING_ENTRIES = 1024,
+	/**
+	 * SELECT result sets of at least this size are sent
+	 * right from the tuples rather than copied to the
+	 * output buffer, see struct iproto_zc.
+	 */
+	IPROTO_ZC_MIN_SIZE = 16384,
+	/**
+	 * Tuples smaller than this are copied to the output
+	 * buffer even if the reply is sent without copying:
+	 * copying them is cheaper than an extra iovec and a
+	 * tuple reference.
+	 */
+	IPROTO_ZC_TUPLE_MIN_SIZE = 1024,
+	/** Max number of iovecs passed to a single writev(). */
+	IPROTO_FLUSH_IOV_MAX = IOV_MAX,
+	/**
+	 * Deficit round-robin quantum: size of requests a
+	 * connection may send to tx thread in one turn while
+	 * other connections wait for their turn.
+	 */
+	IPROTO_DRR_QUANTUM = 4096,
+	/**
+	 * Output of a connection with compression enabled is
+	 * compressed only if at least this much is flushed at
+	 * once, smaller replies are sent as is.
+	 */
+	IPROTO_COMPRESS_MIN_SIZE = 1024,
+	/** zstd compression level of the output. */
+	IPROTO_COMPRESS_LEVEL = 1,
+	/**
+	 * Bounds of the readahead chosen by the adaptive
+	 * controller. Like the default readahead, they leave room
+	 * for slab metadata, see iproto_readahead.
+	 */
+	IPROTO_READAHEAD_MIN = 4096 - 64,
+	IPROTO_READAHEAD_MAX = 1024 * 1024 - 64,
 };
 
+/**
+ * Weight of a new sample in the moving average of the time
+ * requests wait for tx thread.
+ */
+static const double IPROTO_QUEUE_DELAY_WEIGHT = 0.05;
+
+/**
+ * Weight of a new sample in the moving averages of request
+ * size and pipelining depth of a connection, which the
+ * adaptive controller sizes the connection readahead from.
+ */
+static const double IPROTO_READAHEAD_WEIGHT = 0.125;
+
+/**
+ * The adaptive controller lowers the limit of requests in
+ * flight while they wait for tx thread longer than this on
+ * average, or longer than half of iproto_queue_delay_max,
+ * whichever is less.
+ */
+static const double IPROTO_QUEUE_DELAY_TARGET = 0.01;
+
+/** How often the adaptive controller revises the request limit. */
+static const double IPROTO_TUNE_PERIOD = 0.1;
+
 /**
  * A position in connection output buffer.
  * Since we use rotating buffers to recycle memory,
@@ -109,6 +187,147 @@ struct iproto_kharon {
 	struct iproto_wpos wpos;
 };
 
+/**
+ * Zero-copy part of a SELECT reply. Large tuples of large result
+ * sets are not copied to the connection output buffer: the data
+ * is sent by the iproto thread directly from the tuples, which
+ * are referenced until then. Each run of large tuples is spliced
+ * into the output stream at position svp of obuf, i.e. right
+ * after the reply header or a small tuple copied to the buffer.
+ *
+ * Created in tx thread, handed over to iproto thread in
+ * iproto_msg, and sent back to tx thread to unreference the
+ * tuples when the data is written to the socket, or in
+ * tx_process_destroy() if the connection is closed earlier.
+ */
+struct iproto_zc {
+	/** Message returning the tuples to tx thread. */
+	struct cmsg base;
+	/** Link in iproto_connection::zc_queue. */
+	struct rlist in_queue;
+	/** Position in the output stream to send the data at. */
+	struct obuf *obuf;
+	struct obuf_svp svp;
+	/** Index of the first iovec not sent yet. */
+	int iov_pos;
+	/** Number of sent bytes of iov[iov_pos]. */
+	size_t iov_offset;
+	/** Number of tuples. */
+	int count;
+	/** Referenced tuples, stored right after iov. */
+	struct tuple **tuples;
+	/** Data of the tuples. */
+	struct iovec iov[0];
+};
+
+/**
+ * Allocate zero-copy data for the run of large tuples of a
+ * result set starting at @a first. The tuples are added by
+ * the caller.
+ */
+static struct iproto_zc *
+iproto_zc_new(struct port_c_entry *first)
+{
+	int count = 0;
+	for (struct port_c_entry *pe = first; pe != NULL &&
+	     pe->tuple->bsize >= IPROTO_ZC_TUPLE_MIN_SIZE; pe = pe->next)
+		count++;
+	struct iproto_zc *zc = (struct iproto_zc *)
+		malloc(sizeof(*zc) + count * (sizeof(struct iovec) +
+					      sizeof(struct tuple *)));
+	if (zc == NULL)
+		return NULL;
+	zc->count = 0;
+	zc->iov_pos = 0;
+	zc->iov_offset = 0;
+	zc->tuples = (struct tuple **) (zc->iov + count);
+	return zc;
+}
+
+/** Unreference the tuples and free zero-copy data. */
+static void
+iproto_zc_delete(struct iproto_zc *zc)
+{
+	for (int i = 0; i < zc->count; i++)
+		tuple_unref(zc->tuples[i]);
+	free(zc);
+}
+
+/**
+ * Dump a SELECT result set to @a out without copying the tuples
+ * if it pays off, i.e. the result set consists of tuples only
+ * and its large tuples are large enough in total. Tuples smaller
+ * than IPROTO_ZC_TUPLE_MIN_SIZE are copied to @a out, and each
+ * run of large tuples between them makes zero-copy data added
+ * to @a zc_list. The tuples are referenced.
+ * @param port Result set.
+ * @param out Output buffer.
+ * @param[out] zc_list List of zero-copy data.
+ * @param[out] zc_size Size of the zero-copy data.
+ * @return Number of tuples in the result set, or -1 if it
+ *         should be copied to the output buffer, @a out and
+ *         @a zc_list are intact then. Never sets diag.
+ */
+static int
+iproto_zc_dump(struct port *base, struct obuf *out, struct rlist *zc_list,
+	       size_t *zc_size)
+{
+	if (base->vtab != &port_c_vtab)
+		return -1;
+	struct port_c *port = (struct port_c *) base;
+	size_t size = 0;
+	struct port_c_entry *pe;
+	for (pe = port->first; pe != NULL; pe = pe->next) {
+		if (pe->mp_size != 0)
+			return -1;
+		if (pe->tuple->bsize >= IPROTO_ZC_TUPLE_MIN_SIZE)
+			size += pe->tuple->bsize;
+	}
+	if (size < IPROTO_ZC_MIN_SIZE)
+		return -1;
+	struct obuf_svp svp = obuf_create_svp(out);
+	struct iproto_zc *zc = NULL, *tmp;
+	for (pe = port->first; pe != NULL; pe = pe->next) {
+		uint32_t bsize;
+		const char *data = tuple_data_range(pe->tuple, &bsize);
+		if (bsize < IPROTO_ZC_TUPLE_MIN_SIZE) {
+			if (obuf_dup(out, data, bsize) != bsize)
+				goto error;
+			zc = NULL;
+			continue;
+		}
+		if (zc == NULL) {
+			zc = iproto_zc_new(pe);
+			if (zc == NULL)
+				goto error;
+			/* The tuples are sent at the current position. */
+			zc->obuf = out;
+			zc->svp = obuf_create_svp(out);
+			rlist_add_tail_entry(zc_list, zc, in_queue);
+		}
+		zc->iov[zc->count].iov_base = (void *) data;
+		zc->iov[zc->count].iov_len = bsize;
+		zc->tuples[zc->count] = pe->tuple;
+		zc->count++;
+		tuple_ref(pe->tuple);
+	}
+	*zc_size = size;
+	return port->size;
+error:
+	rlist_foreach_entry_safe(zc, zc_list, in_queue, tmp)
+		iproto_zc_delete(zc);
+	rlist_create(zc_list);
+	obuf_rollback_to_svp(out, &svp);
+	return -1;
+}
+
+/** Release zero-copy data sent by the iproto thread. */
+static void
+tx_release_zc(struct cmsg *m)
+{
+	iproto_zc_delete(container_of(m, struct iproto_zc, base));
+}
+
 /**
  * Network readahead. A signed integer to avoid
  * automatic type coercion to an unsigned type.
@@ -126,9 +345,32 @@ struct iproto_kharon {
  */
 unsigned iproto_readahead = 16320;
 
-/* The maximal number of iproto messages in fly. */
+/**
+ * The maximal number of iproto messages in fly per network
+ * thread. Set by tx and read by the network threads, so it is
+ * accessed with pm_atomic_load() and pm_atomic_store().
+ */
 static int iproto_msg_max = IPROTO_MSG_MAX_MIN;
 
+/** Use io_uring for socket I/O if the kernel supports it. */
+static bool iproto_use_io_uring = false;
+
+/**
+ * Requests are rejected by the network threads without being
+ * executed while the average time they wait for tx thread
+ * exceeds this value. 0 disables the admission control.
+ */
+static double iproto_queue_delay_max = 0;
+
+/**
+ * If set, the network threads choose readahead of every
+ * connection and the limit of requests in flight themselves.
+ * iproto_readahead is then the initial readahead of a new
+ * connection, and iproto_msg_max is the upper bound of the
+ * limit.
+ */
+static bool iproto_adaptive = false;
+
 /**
  * Address the iproto listens for, stored in TX
  * thread. Is kept in TX to be shown in box.info.
@@ -150,26 +392,26 @@ iproto_bound_address(void)
  * How big is a buffer which needs to be shrunk before
  * it is put back into buffer cache.
  */
-static inline unsigned
-iproto_max_input_size(void)
+static inline size_t
+iproto_max_input_size(size_t readahead)
 {
-	return 18 * iproto_readahead;
+	return 18 * readahead;
 }
 
-void
-iproto_reset_input(struct ibuf *ibuf)
+static void
+iproto_reset_input(struct ibuf *ibuf, size_t readahead)
 {
 	/*
 	 * If we happen to have fully processed the input,
 	 * move the pos to the start of the input buffer.
 	 */
 	assert(ibuf_used(ibuf) == 0);
-	if (ibuf_capacity(ibuf) < iproto_max_input_size()) {
+	if (ibuf_capacity(ibuf) < iproto_max_input_size(readahead)) {
 		ibuf_reset(ibuf);
 	} else {
 		struct slab_cache *slabc = ibuf->slabc;
 		ibuf_destroy(ibuf);
-		ibuf_create(ibuf, slabc, iproto_readahead);
+		ibuf_create(ibuf, slabc, readahead);
 	}
 }
 
@@ -180,10 +422,40 @@ iproto_reset_input(struct ibuf *ibuf)
  * from all connections are queued into a single queue
  * and processed in FIFO order.
  */
+/**
+ * A stream is a sequence of requests of one connection with the
+ * same IPROTO_STREAM_ID. The requests of a stream are sent to tx
+ * thread one at a time, so they are executed in order, while
+ * different streams and requests without a stream are executed
+ * concurrently. A transaction begun in a stream is detached from
+ * the fiber when a request is done, and the next request of the
+ * stream continues it.
+ */
+struct iproto_stream {
+	/** Stream identifier chosen by the client. */
+	uint64_t id;
+	/** Connection the stream belongs to. */
+	struct iproto_connection *connection;
+	/** Request being processed by tx thread, if any. */
+	struct iproto_msg *current;
+	/** Requests waiting for the current one to finish. */
+	struct stailq pending;
+	/**
+	 * Active transaction of the stream. Is set by tx thread
+	 * before the current request is sent back, so iproto
+	 * thread may read it when the request is finished.
+	 */
+	struct txn *txn;
+};
+
 struct iproto_msg
 {
 	struct cmsg base;
 	struct iproto_connection *connection;
+	/** Stream of the request, NULL if it doesn't have one. */
+	struct iproto_stream *stream;
+	/** Link in iproto_stream::pending. */
+	struct stailq_entry in_stream;
 
 	/* --- Box msgs - actual requests for the transaction processor --- */
 	/* Request message code and sync. */
@@ -193,6 +465,8 @@ struct iproto_msg
 		struct request dml;
 		/** Box request, if this is a call or eval. */
 		struct call_request call;
+		/** Batch of DML requests. */
+		struct batch_request batch;
 		/** Authentication request. */
 		struct auth_request auth;
 		/* SQL request, if this is the EXECUTE/PREPARE request. */
@@ -232,10 +506,27 @@ struct iproto_msg
 	 * and the connection must be closed.
 	 */
 	bool close_connection;
+	/** Zero-copy parts of a SELECT reply, struct iproto_zc. */
+	struct rlist zc_list;
+	/** Time the request was read from the socket. */
+	double recv_time;
+	/**
+	 * Time the request waited in the queue before tx thread
+	 * started processing it. Set by tx thread.
+	 */
+	double queue_delay;
+	/**
+	 * Time tx thread spent processing the request, including
+	 * WAL writes. Set by tx thread.
+	 */
+	double tx_time;
+	/**
+	 * Time tx thread waited for WAL writes of the request.
+	 * Set by tx thread.
+	 */
+	double wal_time;
 };
 
-static struct mempool iproto_msg_pool;
-
 static struct iproto_msg *
 iproto_msg_new(struct iproto_connection *con);
 
@@ -243,45 +534,14 @@ iproto_msg_new(struct iproto_connection *con);
  * Resume stopped connections, if any.
  */
 static void
-iproto_resume(void);
+iproto_resume(struct iproto_thread *iproto_thread);
 
 static void
 iproto_msg_decode(struct iproto_msg *msg, const char **pos, const char *reqend,
 		  bool *stop_input);
 
 static inline void
-iproto_msg_delete(struct iproto_msg *msg)
-{
-	mempool_free(&iproto_msg_pool, msg);
-	iproto_resume();
-}
-
-/**
- * A single global queue for all requests in all connections. All
- * requests from all connections are processed concurrently.
- * Is also used as a queue for just established connections and to
- * execute disconnect triggers. A few notes about these triggers:
- * - they need to be run in a fiber
- * - unlike an ordinary request failure, on_connect trigger
- *   failure must lead to connection close.
- * - on_connect trigger must be processed before any other
- *   request on this connection.
- */
-static struct cpipe tx_pipe;
-static struct cpipe net_pipe;
-
-/**
- * Network thread.
- */
-static struct cord net_cord;
-
-/**
- * Slab cache used for allocating memory for output network buffers
- * in the tx thread.
- */
-static struct slab_cache net_slabc;
-
-struct rmean *rmean_net;
+iproto_msg_delete(struct iproto_msg *msg);
 
 enum rmean_net_name {
 	IPROTO_SENT,
@@ -298,17 +558,167 @@ const char *rmean_net_strings[IPROTO_LAST] = {
 	"REQUESTS",
 };
 
+/**
+ * Context of a single network thread. Connections are spread
+ * among the threads: each thread accepts clients from the same
+ * listening socket and serves them till the end of their life.
+ * Everything a connection uses in the net thread - message and
+ * connection pools, output buffers, pipes to and from tx - is
+ * owned by the thread the connection was accepted by.
+ */
+/** Stages of request processing with tracked latency. */
+enum iproto_latency_stage {
+	/** From reading a request to getting its reply. */
+	IPROTO_LATENCY_TOTAL,
+	/** Waiting in the queue for tx thread. */
+	IPROTO_LATENCY_QUEUE,
+	/** Execution in tx thread, not counting WAL writes. */
+	IPROTO_LATENCY_EXEC,
+	/** Waiting for WAL writes. */
+	IPROTO_LATENCY_WAL,
+	iproto_latency_stage_MAX,
+};
+
+static const char *iproto_latency_stage_strs[] = {
+	"total",
+	"queue",
+	"exec",
+	"wal",
+};
+
+static_assert(lengthof(iproto_latency_stage_strs) ==
+	      iproto_latency_stage_MAX, "iproto_latency_stage_strs");
+
+struct iproto_thread {
+	/** Thread ordinal number, starting from 0. */
+	uint32_t id;
+	/**
+	 * Network thread.
+	 */
+	struct cord net_cord;
+	/**
+	 * Slab cache used for allocating memory for output network
+	 * buffers in the tx thread.
+	 */
+	struct slab_cache net_slabc;
+	/**
+	 * A single queue for all requests in all connections of
+	 * the thread. All requests from all connections are
+	 * processed concurrently. Is also used as a queue for just
+	 * established connections and to execute disconnect
+	 * triggers. A few notes about these triggers:
+	 * - they need to be run in a fiber
+	 * - unlike an ordinary request failure, on_connect trigger
+	 *   failure must lead to connection close.
+	 * - on_connect trigger must be processed before any other
+	 *   request on this connection.
+	 */
+	struct cpipe tx_pipe;
+	struct cpipe net_pipe;
+	/** Pool of iproto_msg objects of this thread. */
+	struct mempool iproto_msg_pool;
+	/** Pool of iproto_connection objects of this thread. */
+	struct mempool iproto_connection_pool;
+	/** Pool of iproto_stream objects of this thread. */
+	struct mempool iproto_stream_pool;
+	/**
+	 * Connections waiting for their turn to send requests to
+	 * tx thread: stopped by net_msg_max limit or having used
+	 * up their deficit round-robin quantum. Served in FIFO
+	 * order.
+	 */
+	struct rlist stopped_connections;
+	/** Network statistics of the thread. */
+	struct rmean *rmean;
+	/**
+	 * Binary protocol listener. The first thread binds the
+	 * socket, the others are attached to it.
+	 */
+	struct evio_service binary;
+	/*
+	 * Message routes. They refer to the thread pipes, so
+	 * every thread has its own copy.
+	 */
+	struct cmsg_hop destroy_route[2];
+	struct cmsg_hop disconnect_route[2];
+	struct cmsg_hop push_route[2];
+	struct cmsg_hop misc_route[2];
+	struct cmsg_hop call_route[2];
+	struct cmsg_hop select_route[2];
+	struct cmsg_hop process1_route[2];
+	struct cmsg_hop sql_route[2];
+	struct cmsg_hop txn_route[2];
+	struct cmsg_hop batch_route[2];
+	struct cmsg_hop join_route[2];
+	struct cmsg_hop subscribe_route[2];
+	struct cmsg_hop error_route[2];
+	struct cmsg_hop connect_route[2];
+	const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX];
+	/**
+	 * Ring used for reading from and writing to the client
+	 * sockets when iproto_io_uring is on. Requests of all
+	 * connections of the thread are submitted in a single
+	 * system call per event loop iteration, and a read is
+	 * always kept in flight instead of waiting for socket
+	 * readiness.
+	 */
+	struct uring uring;
+	/** True if the ring is created and used. */
+	bool use_uring;
+	/**
+	 * True if the thread listens on a "shm/:" URI, so the
+	 * accepted connections use the shared memory transport.
+	 */
+	bool is_listen_shm;
+	/**
+	 * Compression context shared by all connections of the
+	 * thread which have compression enabled. Created on demand.
+	 */
+	ZSTD_CCtx *zctx;
+	/**
+	 * Moving average of the time requests of the thread wait
+	 * for tx thread, updated when a reply comes back. Used by
+	 * the admission control, see iproto_queue_delay_max.
+	 */
+	double queue_delay;
+	/**
+	 * Limit of requests in flight chosen by the adaptive
+	 * controller, see iproto_thread_msg_max().
+	 */
+	int msg_max;
+	/**
+	 * True if input of a connection was stopped by the
+	 * request limit since the controller revised it last.
+	 */
+	bool is_msg_max_hit;
+	/** Time the controller revised the request limit last. */
+	double tune_time;
+	/**
+	 * Sum of readahead of the thread connections. Read by tx
+	 * thread without locks for statistics.
+	 */
+	size_t readahead;
+	/**
+	 * Latency histograms of the requests served by the
+	 * thread, per request type and processing stage.
+	 * Collected when a reply comes back from tx thread.
+	 * Created only for types having a name, read and reset
+	 * by tx thread without locks for statistics.
+	 */
+	struct latency latency[IPROTO_TYPE_STAT_MAX][iproto_latency_stage_MAX];
+};
+
+/** Network threads, created in iproto_init(). */
+static struct iproto_thread *iproto_threads;
+/** Number of network threads. */
+int iproto_threads_count;
+
 static void
 tx_process_destroy(struct cmsg *m);
 
 static void
 net_finish_destroy(struct cmsg *m);
 
-static const struct cmsg_hop destroy_route[] = {
-	{ tx_process_destroy, &net_pipe },
-	{ net_finish_destroy, NULL },
-};
-
 /** Fire on_disconnect triggers in the tx thread. */
 static void
 tx_process_disconnect(struct cmsg *m);
@@ -317,11 +727,6 @@ tx_process_disconnect(struct cmsg *m);
 static void
 net_finish_disconnect(struct cmsg *m);
 
-static const struct cmsg_hop disconnect_route[] = {
-	{ tx_process_disconnect, &net_pipe },
-	{ net_finish_disconnect, NULL }
-};
-
 /**
  * Kharon is in the dead world (iproto). Schedule an event to
  * flush new obuf as reflected in the fresh wpos.
@@ -339,12 +744,6 @@ iproto_process_push(struct cmsg *m);
 static void
 tx_end_push(struct cmsg *m);
 
-static const struct cmsg_hop push_route[] = {
-	{ iproto_process_push, &tx_pipe },
-	{ tx_end_push, NULL }
-};
-
-
 /* }}} */
 
 /* {{{ iproto_connection - declaration and definition */
@@ -461,6 +860,20 @@ struct iproto_connection
 	int long_poll_count;
 	struct ev_io input;
 	struct ev_io output;
+	/**
+	 * True if the client is connected via a "shm/:" URI. The
+	 * data is exchanged over @a shm then, and @a input and
+	 * @a output watch its doorbells rather than the socket.
+	 */
+	bool is_shm;
+	/** Shared memory channel, used if @a is_shm is set. */
+	struct shm_chan shm;
+	/**
+	 * The socket the shared memory channel is set up over.
+	 * The client never writes to it, so it becomes readable
+	 * only when the client is gone.
+	 */
+	struct ev_io hup;
 	/** Logical session. */
 	struct session *session;
 	ev_loop *loop;
@@ -531,43 +944,234 @@ struct iproto_connection
 		 * return.
 		 */
 		bool is_push_pending;
+		/**
+		 * True if the output is compressed, so SELECT
+		 * replies are not sent in zero-copy mode.
+		 */
+		bool is_compressed;
 	} tx;
 	/** Authentication salt. */
 	char salt[IPROTO_SALT_SIZE];
+	/** Network thread serving the connection. */
+	struct iproto_thread *iproto_thread;
+	/**
+	 * io_uring requests of the connection, used only if the
+	 * thread has a ring. At most one read and one write can be
+	 * in flight. The read targets the end of p_ibuf, the write
+	 * sends send_iov, which spans the output from wpos to
+	 * send_end.
+	 */
+	struct uring_req recv_req;
+	struct uring_req send_req;
+	bool is_recv_pending;
+	bool is_send_pending;
+	struct obuf_svp send_end;
+	struct iovec send_iov[SMALL_OBUF_IOV_MAX + 1];
+	/**
+	 * Zero-copy replies not sent yet, ordered by their
+	 * position in the output. Used by the iproto thread only.
+	 */
+	struct rlist zc_queue;
+	/**
+	 * Deficit round-robin counter: size of requests the
+	 * connection may still send to tx thread in its current
+	 * turn. Only limits the connection while others are
+	 * waiting in stopped_connections, so a single busy client
+	 * is not throttled.
+	 */
+	size_t drr_deficit;
+	/**
+	 * True if the client asked for compression of the output
+	 * with IPROTO_COMPRESS request. See iproto_compress().
+	 */
+	bool is_compressed;
+	/**
+	 * True if the last plain write stopped in the middle of
+	 * a reply, so the output can not be compressed until the
+	 * reply is flushed completely.
+	 */
+	bool is_flush_partial;
+	/**
+	 * Compressed frame being sent and the position in the
+	 * output buffer where its source data ends. The write
+	 * position is moved there when the frame is written out.
+	 */
+	struct ibuf zbuf;
+	struct obuf_svp zbuf_end;
+	/**
+	 * Number of requests sent to tx thread and not finished
+	 * yet. Read by tx thread without locks for statistics.
+	 */
+	int inflight;
+	/**
+	 * Size of a new input buffer of the connection, see
+	 * iproto_connection_tune_readahead().
+	 */
+	size_t readahead;
+	/**
+	 * Moving averages of the size of requests and of the
+	 * number of requests read at once.
+	 */
+	double request_size_avg;
+	double batch_size_avg;
+	/**
+	 * Streams of the connection by id, created on demand.
+	 * A stream is deleted when it has no requests and no
+	 * active transaction.
+	 */
+	struct mh_i64ptr_t *streams;
 };
 
-static struct mempool iproto_connection_pool;
-static RLIST_HEAD(stopped_connections);
+/**
+ * Return the limit of requests in flight of the thread: the
+ * one chosen by the adaptive controller if it is on, and
+ * iproto_msg_max otherwise.
+ */
+static inline int
+iproto_thread_msg_max(struct iproto_thread *iproto_thread)
+{
+	int msg_max = pm_atomic_load(&iproto_msg_max);
+	if (!iproto_adaptive || iproto_thread->msg_max == 0 ||
+	    iproto_thread->msg_max > msg_max)
+		return msg_max;
+	return iproto_thread->msg_max;
+}
 
 /**
  * Return true if we have not enough spare messages
- * in the message pool.
+ * in the message pool of the thread.
  */
 static inline bool
-iproto_check_msg_max(void)
+iproto_check_msg_max(struct iproto_thread *iproto_thread)
 {
-	size_t request_count = mempool_count(&iproto_msg_pool);
-	return request_count > (size_t) iproto_msg_max;
+	size_t request_count = mempool_count(&iproto_thread->iproto_msg_pool);
+	return request_count >
+	       (size_t) iproto_thread_msg_max(iproto_thread);
+}
+
+/**
+ * Revise the limit of requests in flight of the thread. While
+ * requests wait for tx thread longer than the target, the
+ * limit is decreased multiplicatively, so the excess waits in
+ * the sockets rather than in the tx queue. While the latency
+ * is fine, but the limit stops input, it grows additively up to
+ * iproto_msg_max.
+ */
+static void
+iproto_thread_tune_msg_max(struct iproto_thread *iproto_thread)
+{
+	if (!iproto_adaptive)
+		return;
+	double now = ev_monotonic_now(loop());
+	if (now - iproto_thread->tune_time < IPROTO_TUNE_PERIOD)
+		return;
+	iproto_thread->tune_time = now;
+	double target = IPROTO_QUEUE_DELAY_TARGET;
+	if (iproto_queue_delay_max > 0)
+		target = MIN(target, iproto_queue_delay_max / 2);
+	int msg_max = iproto_thread_msg_max(iproto_thread);
+	if (iproto_thread->queue_delay > target) {
+		msg_max = MAX(msg_max * 3 / 4, (int) IPROTO_MSG_MAX_MIN);
+	} else if (iproto_thread->is_msg_max_hit) {
+		msg_max = MIN(msg_max + msg_max / 8 + 1,
+			      pm_atomic_load(&iproto_msg_max));
+	}
+	iproto_thread->msg_max = msg_max;
+	iproto_thread->is_msg_max_hit = false;
+}
+
+static inline void
+iproto_msg_delete(struct iproto_msg *msg)
+{
+	struct iproto_thread *iproto_thread = msg->connection->iproto_thread;
+	assert(msg->connection->inflight > 0);
+	msg->connection->inflight--;
+	mempool_free(&iproto_thread->iproto_msg_pool, msg);
+	iproto_resume(iproto_thread);
+}
+
+/** The client socket of the connection. */
+static inline int
+iproto_connection_fd(struct iproto_connection *con)
+{
+	return con->is_shm ? con->hup.fd : con->input.fd;
+}
+
+/**
+ * Read input of the connection, see sio_read() for the return
+ * value and error handling.
+ */
+static inline ssize_t
+iproto_connection_read(struct iproto_connection *con, void *buf,
+		       size_t count)
+{
+	if (!con->is_shm)
+		return sio_read(con->input.fd, buf, count);
+	ssize_t n = shm_chan_read(&con->shm, buf, count);
+	if (n < 0 && errno != EAGAIN) {
+		diag_set(SocketError, sio_socketname(con->hup.fd),
+			 "read(%zd)", count);
+	}
+	return n;
+}
+
+/**
+ * Write output of the connection, see sio_writev() for the
+ * return value and error handling.
+ */
+static inline ssize_t
+iproto_connection_writev(struct iproto_connection *con,
+			 const struct iovec *iov, int iovcnt)
+{
+	if (!con->is_shm)
+		return sio_writev(con->output.fd, iov, iovcnt);
+	ssize_t n = shm_chan_writev(&con->shm, iov, iovcnt);
+	if (n < 0 && errno != EAGAIN) {
+		diag_set(SocketError, sio_socketname(con->hup.fd),
+			 "writev(%d)", iovcnt);
+	}
+	return n;
+}
+
+/**
+ * Best effort at sending an error to the client before the
+ * connection is closed. A shared memory client just sees the
+ * connection closed, the error is logged anyway.
+ */
+static inline void
+iproto_connection_write_error(struct iproto_connection *con,
+			      const struct error *e)
+{
+	if (!con->is_shm)
+		iproto_write_error(con->input.fd, e, ::schema_version, 0);
 }
 
 static struct iproto_msg *
 iproto_msg_new(struct iproto_connection *con)
 {
-	struct iproto_msg *msg =
-		(struct iproto_msg *) mempool_alloc(&iproto_msg_pool);
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	struct iproto_msg *msg = (struct iproto_msg *)
+		mempool_alloc(&iproto_thread->iproto_msg_pool);
 	ERROR_INJECT(ERRINJ_TESTING, {
-		mempool_free(&iproto_msg_pool, msg);
+		mempool_free(&iproto_thread->iproto_msg_pool, msg);
 		msg = NULL;
 	});
 	if (msg == NULL) {
 		diag_set(OutOfMemory, sizeof(*msg), "mempool_alloc", "msg");
 		say_warn("can not allocate memory for a new message, "
-			 "connection %s", sio_socketname(con->input.fd));
+			 "connection %s",
+			 sio_socketname(iproto_connection_fd(con)));
 		return NULL;
 	}
 	msg->close_connection = false;
+	msg->stream = NULL;
+	rlist_create(&msg->zc_list);
+	msg->queue_delay = 0;
+	msg->tx_time = 0;
+	msg->wal_time = 0;
 	msg->connection = con;
-	rmean_collect(rmean_net, IPROTO_REQUESTS, 1);
+	con->inflight++;
+	rmean_collect(iproto_thread->rmean, IPROTO_REQUESTS, 1);
 	return msg;
 }
 
@@ -578,7 +1182,8 @@ iproto_msg_new(struct iproto_connection *con)
  * Note: a connection only becomes idle after iproto_connection_close(),
  * which closes the fd.  This is why here the check is for
  * evio_has_fd(), not ev_is_active()  (false if event is not
- * started).
+ * started). io_uring requests in flight refer to the
+ * connection buffers, so they keep it busy too.
  *
  * ibuf_size() provides an effective reference counter
  * on connection use in the tx request queue. Any request
@@ -590,6 +1195,7 @@ static inline bool
 iproto_connection_is_idle(struct iproto_connection *con)
 {
 	return con->long_poll_count == 0 &&
+	       !con->is_recv_pending && !con->is_send_pending &&
 	       ibuf_used(&con->ibuf[0]) == 0 &&
 	       ibuf_used(&con->ibuf[1]) == 0;
 }
@@ -604,7 +1210,7 @@ iproto_connection_stop_readahead_limit(struct iproto_connection *con)
 {
 	say_warn_ratelimited("stopping input on connection %s, "
 			     "readahead limit is reached",
-			     sio_socketname(con->input.fd));
+			     sio_socketname(iproto_connection_fd(con)));
 	assert(rlist_empty(&con->in_stop_list));
 	ev_io_stop(con->loop, &con->input);
 }
@@ -616,13 +1222,30 @@ iproto_connection_stop_msg_max_limit(struct iproto_connection *con)
 
 	say_warn_ratelimited("stopping input on connection %s, "
 			     "net_msg_max limit is reached",
-			     sio_socketname(con->input.fd));
+			     sio_socketname(iproto_connection_fd(con)));
+	con->iproto_thread->is_msg_max_hit = true;
 	ev_io_stop(con->loop, &con->input);
 	/*
 	 * Important to add to tail and fetch from head to ensure
 	 * strict lifo order (fairness) for stopped connections.
 	 */
-	rlist_add_tail(&stopped_connections, &con->in_stop_list);
+	rlist_add_tail(&con->iproto_thread->stopped_connections,
+		       &con->in_stop_list);
+}
+
+/**
+ * Stop input when the connection has used up its deficit
+ * round-robin quantum while other connections are waiting. It
+ * continues when its turn comes, with a new quantum.
+ */
+static inline void
+iproto_connection_stop_drr(struct iproto_connection *con)
+{
+	assert(rlist_empty(&con->in_stop_list));
+	con->drr_deficit += IPROTO_DRR_QUANTUM;
+	ev_io_stop(con->loop, &con->input);
+	rlist_add_tail(&con->iproto_thread->stopped_connections,
+		       &con->in_stop_list);
 }
 
 /**
@@ -651,7 +1274,7 @@ iproto_connection_try_to_start_destroy(struct iproto_connection *con)
 	 * other parts of the connection.
 	 */
 	con->state = IPROTO_CONNECTION_DESTROYED;
-	cpipe_push(&tx_pipe, &con->destroy_msg);
+	cpipe_push(&con->iproto_thread->tx_pipe, &con->destroy_msg);
 }
 
 /**
@@ -667,9 +1290,21 @@ iproto_connection_close(struct iproto_connection *con)
 		ev_io_stop(con->loop, &con->input);
 		ev_io_stop(con->loop, &con->output);
 
-		int fd = con->input.fd;
+		int fd = iproto_connection_fd(con);
+		if (con->is_shm) {
+			ev_io_stop(con->loop, &con->hup);
+			con->hup.fd = -1;
+			shm_chan_close(&con->shm);
+		}
 		/* Make evio_has_fd() happy */
 		con->input.fd = con->output.fd = -1;
+		/*
+		 * io_uring requests in flight hold a reference to
+		 * the socket, so close() alone would not finish
+		 * them. Shut it down to complete them promptly.
+		 */
+		if (con->is_recv_pending || con->is_send_pending)
+			shutdown(fd, SHUT_RDWR);
 		close(fd);
 		/*
 		 * Discard unparsed data, to recycle the
@@ -678,7 +1313,7 @@ iproto_connection_close(struct iproto_connection *con)
 		 * is done only once.
 		 */
 		con->p_ibuf->wpos -= con->parse_size;
-		cpipe_push(&tx_pipe, &con->disconnect_msg);
+		cpipe_push(&con->iproto_thread->tx_pipe, &con->disconnect_msg);
 		assert(con->state == IPROTO_CONNECTION_ALIVE);
 		con->state = IPROTO_CONNECTION_CLOSED;
 	} else if (con->state == IPROTO_CONNECTION_PENDING_DESTROY) {
@@ -762,9 +1397,9 @@ iproto_connection_input_buffer(struct iproto_connection *con)
 		return NULL;
 	}
 	/* Update buffer size if readahead has changed. */
-	if (new_ibuf->start_capacity != iproto_readahead) {
+	if (new_ibuf->start_capacity != con->readahead) {
 		ibuf_destroy(new_ibuf);
-		ibuf_create(new_ibuf, cord_slab_cache(), iproto_readahead);
+		ibuf_create(new_ibuf, cord_slab_cache(), con->readahead);
 	}
 
 	ibuf_reserve_xc(new_ibuf, to_read + con->parse_size);
@@ -783,7 +1418,7 @@ iproto_connection_input_buffer(struct iproto_connection *con)
 		 * them.
 		 */
 		if (ibuf_used(old_ibuf) == 0)
-			iproto_reset_input(old_ibuf);
+			iproto_reset_input(old_ibuf, con->readahead);
 	}
 	/*
 	 * Rotate buffers. Not strictly necessary, but
@@ -793,11 +1428,62 @@ iproto_connection_input_buffer(struct iproto_connection *con)
 	return new_ibuf;
 }
 
+/** Set readahead of the connection, accounting it in the thread. */
+static inline void
+iproto_connection_set_readahead(struct iproto_connection *con,
+				size_t readahead)
+{
+	con->iproto_thread->readahead += readahead - con->readahead;
+	con->readahead = readahead;
+}
+
+/**
+ * Account @a n_requests requests of @a size bytes in total read
+ * at once and choose readahead of the connection. A new input
+ * buffer should fit two typical batches of requests: one being
+ * processed and one being read. If the buffer fills up on every
+ * read, the batch grows with the buffer, so readahead doubles
+ * until the client's pipeline fits. Readahead is rounded up to
+ * a slab size, so it only changes when the load changes at
+ * least twice.
+ */
+static void
+iproto_connection_tune_readahead(struct iproto_connection *con,
+				 int n_requests, size_t size)
+{
+	if (!iproto_adaptive) {
+		iproto_connection_set_readahead(con, iproto_readahead);
+		return;
+	}
+	if (con->batch_size_avg == 0) {
+		/* The first sample. */
+		con->request_size_avg = (double) size / n_requests;
+		con->batch_size_avg = n_requests;
+	}
+	con->request_size_avg += IPROTO_READAHEAD_WEIGHT *
+		((double) size / n_requests - con->request_size_avg);
+	con->batch_size_avg += IPROTO_READAHEAD_WEIGHT *
+		(n_requests - con->batch_size_avg);
+	double target = 2 * con->request_size_avg * con->batch_size_avg;
+	size_t readahead_max = MAX((size_t) IPROTO_READAHEAD_MAX,
+				   (size_t) iproto_readahead);
+	size_t readahead = IPROTO_READAHEAD_MIN;
+	while (readahead < target && readahead < readahead_max)
+		readahead = 2 * readahead + 64;
+	iproto_connection_set_readahead(con, MIN(readahead, readahead_max));
+}
+
 /**
  * Enqueue all requests which were read up. If a request limit is
  * reached - stop the connection input even if not the whole batch
  * is enqueued. Else try to read more feeding read event to the
  * event loop.
+ *
+ * While other connections are waiting for their turn, the
+ * connection may enqueue only as many requests as fit into its
+ * deficit round-robin quantum, and then it is queued after
+ * them. So a client pipelining a lot of requests can not starve
+ * the others.
  * @param con Connection to enqueue in.
  * @param in Buffer to parse.
  *
@@ -808,13 +1494,15 @@ static inline int
 iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 {
 	assert(rlist_empty(&con->in_stop_list));
+	struct iproto_thread *iproto_thread = con->iproto_thread;
 	int n_requests = 0;
+	size_t n_bytes = 0;
 	bool stop_input = false;
 	const char *errmsg;
 	while (con->parse_size != 0 && !stop_input) {
-		if (iproto_check_msg_max()) {
+		if (iproto_check_msg_max(iproto_thread)) {
 			iproto_connection_stop_msg_max_limit(con);
-			cpipe_flush_input(&tx_pipe);
+			cpipe_flush_input(&iproto_thread->tx_pipe);
 			return 0;
 		}
 		const char *reqstart = in->wpos - con->parse_size;
@@ -823,7 +1511,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		if (mp_typeof(*pos) != MP_UINT) {
 			errmsg = "packet length";
 err_msgpack:
-			cpipe_flush_input(&tx_pipe);
+			cpipe_flush_input(&iproto_thread->tx_pipe);
 			diag_set(ClientError, ER_INVALID_MSGPACK,
 				 errmsg);
 			return -1;
@@ -840,6 +1528,14 @@ err_msgpack:
 		const char *reqend = pos + len;
 		if (reqend > in->wpos)
 			break;
+		bool is_contended =
+			!rlist_empty(&iproto_thread->stopped_connections);
+		if (is_contended &&
+		    con->drr_deficit < (size_t) (reqend - reqstart)) {
+			iproto_connection_stop_drr(con);
+			cpipe_flush_input(&iproto_thread->tx_pipe);
+			return 0;
+		}
 		struct iproto_msg *msg = iproto_msg_new(con);
 		if (msg == NULL) {
 			/*
@@ -849,6 +1545,8 @@ err_msgpack:
 			iproto_connection_stop_msg_max_limit(con);
 			return 0;
 		}
+		if (is_contended)
+			con->drr_deficit -= reqend - reqstart;
 		msg->p_ibuf = con->p_ibuf;
 		msg->wpos = con->wpos;
 
@@ -857,15 +1555,29 @@ err_msgpack:
 		iproto_msg_decode(msg, &pos, reqend, &stop_input);
 		/*
 		 * This can't throw, but should not be
-		 * done in case of exception.
+		 * done in case of exception. A request of a
+		 * stream waits for the previous request of the
+		 * stream to finish, see net_send_msg().
 		 */
-		cpipe_push_input(&tx_pipe, &msg->base);
+		if (msg->stream == NULL ||
+		    iproto_stream_enqueue(msg->stream, msg))
+			cpipe_push_input(&iproto_thread->tx_pipe, &msg->base);
 		n_requests++;
+		n_bytes += reqend - reqstart;
 		/* Request is parsed */
 		assert(reqend > reqstart);
 		assert(con->parse_size >= (size_t) (reqend - reqstart));
 		con->parse_size -= reqend - reqstart;
 	}
+	/*
+	 * Deficit is not accumulated by a connection without
+	 * pending requests. A partially read request is still
+	 * pending, so it doesn't get a fresh quantum.
+	 */
+	if (con->parse_size == 0)
+		con->drr_deficit = IPROTO_DRR_QUANTUM;
+	if (n_requests > 0)
+		iproto_connection_tune_readahead(con, n_requests, n_bytes);
 	if (stop_input) {
 		/**
 		 * Don't mess with the file descriptor
@@ -877,7 +1589,8 @@ err_msgpack:
 		 */
 		ev_io_stop(con->loop, &con->output);
 		ev_io_stop(con->loop, &con->input);
-	} else if (n_requests != 1 || con->parse_size != 0) {
+	} else if (n_requests != 1 || con->parse_size != 0 ||
+		   (iproto_thread->use_uring && !con->is_shm)) {
 		/*
 		 * Keep reading input, as long as the socket
 		 * supplies data, but don't waste CPU on an extra
@@ -894,10 +1607,13 @@ err_msgpack:
 		 * If there is unparsed data, or 0 queued
 		 * requests, keep reading input, if only to avoid
 		 * a deadlock on this connection.
+		 *
+		 * With io_uring a read in flight costs no system
+		 * call, so it is always re-armed.
 		 */
 		ev_feed_event(con->loop, &con->input, EV_READ);
 	}
-	cpipe_flush_input(&tx_pipe);
+	cpipe_flush_input(&iproto_thread->tx_pipe);
 	return 0;
 }
 
@@ -909,7 +1625,7 @@ err_msgpack:
 static void
 iproto_connection_resume(struct iproto_connection *con)
 {
-	assert(! iproto_check_msg_max());
+	assert(!iproto_check_msg_max(con->iproto_thread));
 	rlist_del(&con->in_stop_list);
 	/*
 	 * Enqueue_batch() stops the connection again, if the
@@ -917,7 +1633,7 @@ iproto_connection_resume(struct iproto_connection *con)
 	 */
 	if (iproto_enqueue_batch(con, con->p_ibuf) != 0) {
 		struct error *e = box_error_last();
-		iproto_write_error(con->input.fd, e, ::schema_version, 0);
+		iproto_connection_write_error(con, e);
 		error_log(e);
 		iproto_connection_close(con);
 	}
@@ -933,27 +1649,94 @@ iproto_connection_resume(struct iproto_connection *con)
  * necessary to use up the limit.
  */
 static void
-iproto_resume(void)
+iproto_resume(struct iproto_thread *iproto_thread)
 {
-	while (!iproto_check_msg_max() && !rlist_empty(&stopped_connections)) {
+	while (!iproto_check_msg_max(iproto_thread) &&
+	       !rlist_empty(&iproto_thread->stopped_connections)) {
 		/*
 		 * Shift from list head to ensure strict FIFO
 		 * (fairness) for resumed connections.
 		 */
 		struct iproto_connection *con =
-			rlist_first_entry(&stopped_connections,
+			rlist_first_entry(&iproto_thread->stopped_connections,
 					  struct iproto_connection,
 					  in_stop_list);
 		iproto_connection_resume(con);
 	}
 }
 
+/**
+ * Account data just read to the end of the input buffer @a in
+ * and enqueue all requests which are fully read up.
+ * @retval  0 Success.
+ * @retval -1 Invalid MessagePack error, diag is set.
+ */
+static int
+iproto_connection_on_read(struct iproto_connection *con, struct ibuf *in,
+			  size_t nrd)
+{
+	/* Count statistics */
+	rmean_collect(con->iproto_thread->rmean, IPROTO_RECEIVED, nrd);
+
+	/* Update the read position and connection state. */
+	in->wpos += nrd;
+	con->parse_size += nrd;
+	/* Enqueue all requests which are fully read up. */
+	return iproto_enqueue_batch(con, in);
+}
+
+/** Complete an io_uring read started in iproto_connection_on_input(). */
+static void
+iproto_connection_on_recv(struct uring_req *req, int res)
+{
+	struct iproto_connection *con =
+		(struct iproto_connection *) req->data;
+	assert(con->is_recv_pending);
+	con->is_recv_pending = false;
+	if (!evio_has_fd(&con->input)) {
+		/* The connection was closed while reading. */
+		if (iproto_connection_is_idle(con))
+			iproto_connection_close(con);
+		return;
+	}
+	int fd = con->input.fd;
+	if (res == -EAGAIN) {
+		/*
+		 * Old kernels do not wait for data on non-blocking
+		 * sockets. Wait for readiness and retry.
+		 */
+		ev_io_start(con->loop, &con->input);
+		return;
+	}
+	if (res < 0) {
+		errno = -res;
+		diag_set(SocketError, sio_socketname(fd), "recv");
+		diag_log();
+		iproto_connection_close(con);
+		return;
+	}
+	if (res == 0) {                 /* EOF */
+		iproto_connection_close(con);
+		return;
+	}
+	if (iproto_connection_on_read(con, con->p_ibuf, res) != 0) {
+		/* Best effort at sending the error message to the client. */
+		struct error *e = box_error_last();
+		iproto_write_error(fd, e, ::schema_version, 0);
+		error_log(e);
+		iproto_connection_close(con);
+	}
+}
+
 static void
 iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 			   int /* revents */)
 {
 	struct iproto_connection *con =
 		(struct iproto_connection *) watcher->data;
+	/* The read in flight will continue processing input. */
+	if (con->is_recv_pending)
+		return;
 	int fd = con->input.fd;
 	assert(fd >= 0);
 	assert(rlist_empty(&con->in_stop_list));
@@ -963,7 +1746,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	 * otherwise we might deplete the fiber pool in tx
 	 * thread and deadlock.
 	 */
-	if (iproto_check_msg_max()) {
+	if (iproto_check_msg_max(con->iproto_thread)) {
 		iproto_connection_stop_msg_max_limit(con);
 		return;
 	}
@@ -975,45 +1758,210 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 			iproto_connection_stop_readahead_limit(con);
 			return;
 		}
+		struct iproto_thread *iproto_thread = con->iproto_thread;
+		if (iproto_thread->use_uring && !con->is_shm &&
+		    uring_recv(&iproto_thread->uring, &con->recv_req, fd,
+			       in->wpos, ibuf_unused(in)) == 0) {
+			con->is_recv_pending = true;
+			/* Readiness is tracked by the ring now. */
+			ev_io_stop(loop, &con->input);
+			return;
+		}
 		/* Read input. */
-		int nrd = sio_read(fd, in->wpos, ibuf_unused(in));
+		ssize_t nrd = iproto_connection_read(con, in->wpos,
+						     ibuf_unused(in));
 		if (nrd < 0) {                  /* Socket is not ready. */
 			if (! sio_wouldblock(errno))
 				diag_raise();
-			ev_io_start(loop, &con->input);
+			/*
+			 * The client rings the doorbell only if we
+			 * announce that we are going to sleep, and
+			 * the data may arrive before we do.
+			 */
+			if (con->is_shm &&
+			    shm_chan_prepare_wait(&con->shm,
+						  SHM_CHAN_READ) != 0)
+				ev_feed_event(loop, &con->input, EV_READ);
+			else
+				ev_io_start(loop, &con->input);
 			return;
 		}
 		if (nrd == 0) {                 /* EOF */
 			iproto_connection_close(con);
 			return;
 		}
-		/* Count statistics */
-		rmean_collect(rmean_net, IPROTO_RECEIVED, nrd);
-
-		/* Update the read position and connection state. */
-		in->wpos += nrd;
-		con->parse_size += nrd;
-		/* Enqueue all requests which are fully read up. */
-		if (iproto_enqueue_batch(con, in) != 0)
+		if (iproto_connection_on_read(con, in, nrd) != 0)
 			diag_raise();
 	} catch (Exception *e) {
 		/* Best effort at sending the error message to the client. */
-		iproto_write_error(fd, e, ::schema_version, 0);
+		iproto_connection_write_error(con, e);
 		e->log();
 		iproto_connection_close(con);
 	}
 }
 
-/** writev() to the socket and handle the result. */
+/**
+ * Return the zero-copy reply data to be sent next if the output
+ * buffer is flushed up to its position, NULL otherwise.
+ */
+static inline struct iproto_zc *
+iproto_connection_zc_at_wpos(struct iproto_connection *con)
+{
+	if (rlist_empty(&con->zc_queue))
+		return NULL;
+	struct iproto_zc *zc = rlist_first_entry(&con->zc_queue,
+						 struct iproto_zc, in_queue);
+	if (zc->obuf != con->wpos.obuf || zc->svp.used != con->wpos.svp.used)
+		return NULL;
+	return zc;
+}
 
+/**
+ * Account @a nwr bytes of zero-copy data sent to the socket.
+ * When all the data is sent, return the tuples to tx thread.
+ */
+static void
+iproto_zc_advance(struct iproto_connection *con, struct iproto_zc *zc,
+		  size_t nwr)
+{
+	while (nwr > 0) {
+		size_t left = zc->iov[zc->iov_pos].iov_len - zc->iov_offset;
+		if (nwr < left) {
+			zc->iov_offset += nwr;
+			return;
+		}
+		nwr -= left;
+		zc->iov_pos++;
+		zc->iov_offset = 0;
+	}
+	if (zc->iov_pos < zc->count)
+		return;
+	rlist_del(&zc->in_queue);
+	static const struct cmsg_hop release_route[] = {
+		{ tx_release_zc, NULL },
+	};
+	cmsg_init(&zc->base, release_route);
+	cpipe_push(&con->iproto_thread->tx_pipe, &zc->base);
+}
+
+/**
+ * Compress @a size bytes of output in @a iov into a frame in the
+ * connection compression buffer. The frame is a valid iproto
+ * packet, which replaces the replies it is compressed from:
+ *
+ * 0xce <frame length: uint32> 0xce <uncompressed size: uint32>
+ * <zstd frame>
+ *
+ * A client tells it from a plain reply by MP_UINT32 in place of
+ * the header map.
+ * @retval  0 The frame is ready to be sent.
+ * @retval -1 The output must be sent as is.
+ */
 static int
-iproto_flush(struct iproto_connection *con)
+iproto_compress(struct iproto_connection *con, const struct iovec *iov,
+		int iovcnt, size_t size)
 {
-	int fd = con->output.fd;
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	if (size > UINT32_MAX)
+		return -1;
+	if (iproto_thread->zctx == NULL) {
+		ZSTD_CCtx *zctx = ZSTD_createCCtx();
+		if (zctx == NULL)
+			return -1;
+		if (ZSTD_isError(ZSTD_CCtx_setParameter(zctx,
+				ZSTD_c_compressionLevel,
+				IPROTO_COMPRESS_LEVEL))) {
+			ZSTD_freeCCtx(zctx);
+			return -1;
+		}
+		iproto_thread->zctx = zctx;
+	}
+	ZSTD_CCtx *zctx = iproto_thread->zctx;
+	/* Drop the state of a frame abandoned on error. */
+	ZSTD_CCtx_reset(zctx, ZSTD_reset_session_only);
+	/* The client checks the size stored in the frame. */
+	if (ZSTD_isError(ZSTD_CCtx_setPledgedSrcSize(zctx, size)))
+		return -1;
+	struct ibuf *zbuf = &con->zbuf;
+	assert(ibuf_used(zbuf) == 0);
+	if (ibuf_alloc(zbuf, IPROTO_COMPRESS_HEADER_SIZE) == NULL)
+		return -1;
+	/*
+	 * A frame that doesn't fit in the size of the output is
+	 * useless, so the output buffer is limited by it.
+	 */
+	if (ibuf_reserve(zbuf, size) == NULL)
+		goto error;
+	ZSTD_outBuffer out;
+	out.dst = zbuf->wpos;
+	out.size = size;
+	out.pos = 0;
+	for (int i = 0; i < iovcnt; i++) {
+		ZSTD_inBuffer in;
+		in.src = iov[i].iov_base;
+		in.size = iov[i].iov_len;
+		in.pos = 0;
+		ZSTD_EndDirective mode = i == iovcnt - 1 ?
+					 ZSTD_e_end : ZSTD_e_continue;
+		size_t rc;
+		do {
+			rc = ZSTD_compressStream2(zctx, &out, &in, mode);
+			if (ZSTD_isError(rc) || out.pos == out.size)
+				goto error;
+		} while (mode == ZSTD_e_end ? rc != 0 : in.pos < in.size);
+	}
+	zbuf->wpos += out.pos;
+	/* Send incompressible output as is. */
+	if (ibuf_used(zbuf) >= size)
+		goto error;
+	char *data;
+	data = zbuf->rpos;
+	*(data++) = 0xce; /* MP_UINT32 */
+	data = mp_store_u32(data, ibuf_used(zbuf) - 5);
+	*(data++) = 0xce; /* MP_UINT32 */
+	data = mp_store_u32(data, size);
+	return 0;
+error:
+	ibuf_reset(zbuf);
+	return -1;
+}
+
+/**
+ * Fill @a iov with the output awaiting to be flushed, starting
+ * at the write position. Zero-copy reply data is not mixed with
+ * the output buffer contents: when the write position reaches
+ * it, only the zero-copy data is returned.
+ * @param iovmax Capacity of @a iov, at least
+ *        SMALL_OBUF_IOV_MAX + 1 to fit the output buffer.
+ * @param[out] end Position the filled output ends at.
+ * @return Number of filled iovecs, 0 if there is nothing to
+ *         flush.
+ */
+static int
+iproto_flush_prepare(struct iproto_connection *con, struct iovec *iov,
+		     int iovmax, struct obuf_svp *end)
+{
+	assert(iovmax >= SMALL_OBUF_IOV_MAX + 1);
+	if (ibuf_used(&con->zbuf) != 0) {
+		/* Continue sending the compressed frame. */
+		*end = con->zbuf_end;
+		iov[0].iov_base = con->zbuf.rpos;
+		iov[0].iov_len = ibuf_used(&con->zbuf);
+		return 1;
+	}
+	struct iproto_zc *zc = iproto_connection_zc_at_wpos(con);
+	if (zc != NULL) {
+		*end = con->wpos.svp;
+		int iovcnt = MIN(zc->count - zc->iov_pos, iovmax);
+		memcpy(iov, zc->iov + zc->iov_pos, iovcnt * sizeof(*iov));
+		iov[0].iov_base = (char *) iov[0].iov_base + zc->iov_offset;
+		iov[0].iov_len -= zc->iov_offset;
+		return iovcnt;
+	}
 	struct obuf *obuf = con->wpos.obuf;
 	struct obuf_svp obuf_end = obuf_create_svp(obuf);
 	struct obuf_svp *begin = &con->wpos.svp;
-	struct obuf_svp *end = &con->wend.svp;
+	*end = con->wend.svp;
 	if (con->wend.obuf != obuf) {
 		/*
 		 * Flush the current buffer before
@@ -1023,15 +1971,21 @@ iproto_flush(struct iproto_connection *con)
 			obuf = con->wpos.obuf = con->wend.obuf;
 			obuf_svp_reset(begin);
 		} else {
-			end = &obuf_end;
+			*end = obuf_end;
 		}
 	}
+	/* Stop at the next zero-copy data. */
+	if (!rlist_empty(&con->zc_queue)) {
+		zc = rlist_first_entry(&con->zc_queue, struct iproto_zc,
+				       in_queue);
+		if (zc->obuf == obuf && zc->svp.used < end->used)
+			*end = zc->svp;
+	}
 	if (begin->used == end->used) {
 		/* Nothing to do. */
-		return 1;
+		return 0;
 	}
 	assert(begin->used < end->used);
-	struct iovec iov[SMALL_OBUF_IOV_MAX+1];
 	struct iovec *src = obuf->iov;
 	int iovcnt = end->pos - begin->pos + 1;
 	/*
@@ -1042,34 +1996,158 @@ iproto_flush(struct iproto_connection *con)
 	sio_add_to_iov(iov, -begin->iov_len);
 	/* *Overwrite* iov_len of the last pos as it may be garbage. */
 	iov[iovcnt-1].iov_len = end->iov_len - begin->iov_len * (iovcnt == 1);
+	/*
+	 * The output can be compressed only if it starts and
+	 * ends at reply boundaries. It is not so if a plain
+	 * write stopped in the middle of a reply, or a zero-copy
+	 * reply is split between the buffer and tuples.
+	 */
+	size_t size = end->used - begin->used;
+	if (con->is_compressed && !con->is_flush_partial &&
+	    rlist_empty(&con->zc_queue) && size >= IPROTO_COMPRESS_MIN_SIZE &&
+	    iproto_compress(con, iov, iovcnt, size) == 0) {
+		con->zbuf_end = *end;
+		iov[0].iov_base = con->zbuf.rpos;
+		iov[0].iov_len = ibuf_used(&con->zbuf);
+		return 1;
+	}
+	return iovcnt;
+}
 
-	ssize_t nwr = sio_writev(fd, iov, iovcnt);
+/**
+ * Advance the write position by @a nwr bytes written from @a iov
+ * prepared by iproto_flush_prepare().
+ * @retval  0 Everything up to @a end is written.
+ * @retval -1 The write was partial.
+ */
+static int
+iproto_flush_advance(struct iproto_connection *con, struct iovec *iov,
+		     const struct obuf_svp *end, size_t nwr)
+{
+	struct obuf_svp *begin = &con->wpos.svp;
+	/* Count statistics */
+	rmean_collect(con->iproto_thread->rmean, IPROTO_SENT, nwr);
+	if (ibuf_used(&con->zbuf) != 0) {
+		con->zbuf.rpos += nwr;
+		if (ibuf_used(&con->zbuf) != 0)
+			return -1;
+		/* Do not keep a large buffer for an idle connection. */
+		ibuf_reinit(&con->zbuf);
+		*begin = *end;
+		return 0;
+	}
+	struct iproto_zc *zc = iproto_connection_zc_at_wpos(con);
+	if (zc != NULL) {
+		/*
+		 * A short write is detected by the next writev(),
+		 * the data is sent in several chunks anyway.
+		 */
+		iproto_zc_advance(con, zc, nwr);
+		return 0;
+	}
+	if (begin->used + nwr == end->used) {
+		*begin = *end;
+		con->is_flush_partial = false;
+		return 0;
+	}
+	con->is_flush_partial = true;
+	size_t offset = 0;
+	int advance = 0;
+	advance = sio_move_iov(iov, nwr, &offset);
+	begin->used += nwr;             /* advance write position */
+	begin->iov_len = advance == 0 ? begin->iov_len + offset: offset;
+	begin->pos += advance;
+	assert(begin->pos <= end->pos);
+	return -1;
+}
 
-	if (nwr > 0) {
-		/* Count statistics */
-		rmean_collect(rmean_net, IPROTO_SENT, nwr);
-		if (begin->used + nwr == end->used) {
-			*begin = *end;
-			return 0;
+/**
+ * writev() to the socket and handle the result.
+ * @retval  1 Nothing to flush.
+ * @retval  0 The output is flushed, but new output may be there.
+ * @retval -1 The socket is not ready for writing.
+ * @retval  2 The write is submitted to io_uring and will be
+ *            completed by iproto_connection_on_send().
+ */
+static int
+iproto_flush(struct iproto_connection *con)
+{
+	int fd = con->output.fd;
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	if (iproto_thread->use_uring && !con->is_shm) {
+		int iovcnt = iproto_flush_prepare(con, con->send_iov,
+						  lengthof(con->send_iov),
+						  &con->send_end);
+		if (iovcnt == 0)
+			return 1;
+		if (uring_writev(&iproto_thread->uring, &con->send_req, fd,
+				 con->send_iov, iovcnt) == 0) {
+			con->is_send_pending = true;
+			return 2;
 		}
-		size_t offset = 0;
-		int advance = 0;
-		advance = sio_move_iov(iov, nwr, &offset);
-		begin->used += nwr;             /* advance write position */
-		begin->iov_len = advance == 0 ? begin->iov_len + offset: offset;
-		begin->pos += advance;
-		assert(begin->pos <= end->pos);
-	} else if (nwr < 0 && ! sio_wouldblock(errno)) {
-		diag_raise();
 	}
+	struct obuf_svp end;
+	struct iovec iov[IPROTO_FLUSH_IOV_MAX];
+	int iovcnt = iproto_flush_prepare(con, iov, lengthof(iov), &end);
+	if (iovcnt == 0)
+		return 1;
+
+	ssize_t nwr = iproto_connection_writev(con, iov, iovcnt);
+
+	if (nwr > 0)
+		return iproto_flush_advance(con, iov, &end, nwr);
+	else if (nwr < 0 && ! sio_wouldblock(errno))
+		diag_raise();
+	/* See iproto_connection_on_input(). */
+	if (con->is_shm &&
+	    shm_chan_prepare_wait(&con->shm, SHM_CHAN_WRITE) != 0)
+		return 0;
 	return -1;
 }
 
+/** Complete an io_uring write started in iproto_flush(). */
+static void
+iproto_connection_on_send(struct uring_req *req, int res)
+{
+	struct iproto_connection *con =
+		(struct iproto_connection *) req->data;
+	assert(con->is_send_pending);
+	con->is_send_pending = false;
+	if (!evio_has_fd(&con->output)) {
+		/* The connection was closed while writing. */
+		if (iproto_connection_is_idle(con))
+			iproto_connection_close(con);
+		return;
+	}
+	if (res == -EAGAIN) {
+		/* See iproto_connection_on_recv(). */
+		ev_io_start(con->loop, &con->output);
+		return;
+	}
+	if (res < 0) {
+		errno = -res;
+		diag_set(SocketError, sio_socketname(con->output.fd),
+			 "writev");
+		diag_log();
+		iproto_connection_close(con);
+		return;
+	}
+	if (iproto_flush_advance(con, con->send_iov, &con->send_end,
+				 res) == 0 &&
+	    !ev_is_active(&con->input) && rlist_empty(&con->in_stop_list))
+		ev_feed_event(con->loop, &con->input, EV_READ);
+	/* Flush the rest and the output appended meanwhile. */
+	ev_feed_event(con->loop, &con->output, EV_WRITE);
+}
+
 static void
 iproto_connection_on_output(ev_loop *loop, struct ev_io *watcher,
 			    int /* revents */)
 {
 	struct iproto_connection *con = (struct iproto_connection *) watcher->data;
+	/* The write in flight will continue flushing. */
+	if (con->is_send_pending)
+		return;
 
 	try {
 		int rc;
@@ -1092,22 +2170,39 @@ iproto_connection_on_output(ev_loop *loop, struct ev_io *watcher,
 }
 
 static struct iproto_connection *
-iproto_connection_new(int fd)
+iproto_connection_new(struct iproto_thread *iproto_thread, int fd)
 {
 	struct iproto_connection *con = (struct iproto_connection *)
-		mempool_alloc(&iproto_connection_pool);
+		mempool_alloc(&iproto_thread->iproto_connection_pool);
 	if (con == NULL) {
 		diag_set(OutOfMemory, sizeof(*con), "mempool_alloc", "con");
 		return NULL;
 	}
 	con->input.data = con->output.data = con;
+	con->iproto_thread = iproto_thread;
 	con->loop = loop();
 	ev_io_init(&con->input, iproto_connection_on_input, fd, EV_READ);
 	ev_io_init(&con->output, iproto_connection_on_output, fd, EV_WRITE);
+	con->is_shm = false;
+	uring_req_create(&con->recv_req, iproto_connection_on_recv, con);
+	uring_req_create(&con->send_req, iproto_connection_on_send, con);
+	con->is_recv_pending = false;
+	con->is_send_pending = false;
+	rlist_create(&con->zc_queue);
+	con->drr_deficit = IPROTO_DRR_QUANTUM;
+	con->inflight = 0;
+	con->readahead = iproto_readahead;
+	iproto_thread->readahead += con->readahead;
+	con->request_size_avg = 0;
+	con->batch_size_avg = 0;
+	con->streams = NULL;
+	con->is_compressed = false;
+	con->is_flush_partial = false;
+	ibuf_create(&con->zbuf, cord_slab_cache(), iproto_readahead);
 	ibuf_create(&con->ibuf[0], cord_slab_cache(), iproto_readahead);
 	ibuf_create(&con->ibuf[1], cord_slab_cache(), iproto_readahead);
-	obuf_create(&con->obuf[0], &net_slabc, iproto_readahead);
-	obuf_create(&con->obuf[1], &net_slabc, iproto_readahead);
+	obuf_create(&con->obuf[0], &iproto_thread->net_slabc, iproto_readahead);
+	obuf_create(&con->obuf[1], &iproto_thread->net_slabc, iproto_readahead);
 	con->p_ibuf = &con->ibuf[0];
 	con->tx.p_obuf = &con->obuf[0];
 	iproto_wpos_create(&con->wpos, con->tx.p_obuf);
@@ -1117,12 +2212,13 @@ iproto_connection_new(int fd)
 	con->session = NULL;
 	rlist_create(&con->in_stop_list);
 	/* It may be very awkward to allocate at close. */
-	cmsg_init(&con->destroy_msg, destroy_route);
-	cmsg_init(&con->disconnect_msg, disconnect_route);
+	cmsg_init(&con->destroy_msg, iproto_thread->destroy_route);
+	cmsg_init(&con->disconnect_msg, iproto_thread->disconnect_route);
 	con->state = IPROTO_CONNECTION_ALIVE;
 	con->tx.is_push_pending = false;
 	con->tx.is_push_sent = false;
-	rmean_collect(rmean_net, IPROTO_CONNECTIONS, 1);
+	con->tx.is_compressed = false;
+	rmean_collect(iproto_thread->rmean, IPROTO_CONNECTIONS, 1);
 	return con;
 }
 
@@ -1141,11 +2237,111 @@ iproto_connection_delete(struct iproto_connection *con)
 	 */
 	ibuf_destroy(&con->ibuf[0]);
 	ibuf_destroy(&con->ibuf[1]);
+	ibuf_destroy(&con->zbuf);
+	con->iproto_thread->readahead -= con->readahead;
 	assert(con->obuf[0].pos == 0 &&
 	       con->obuf[0].iov[0].iov_base == NULL);
 	assert(con->obuf[1].pos == 0 &&
 	       con->obuf[1].iov[0].iov_base == NULL);
-	mempool_free(&iproto_connection_pool, con);
+	if (con->streams != NULL) {
+		mh_int_t i;
+		mh_foreach(con->streams, i) {
+			mempool_free(&con->iproto_thread->iproto_stream_pool,
+				     mh_i64ptr_node(con->streams, i)->val);
+		}
+		mh_i64ptr_delete(con->streams);
+	}
+	mempool_free(&con->iproto_thread->iproto_connection_pool, con);
+}
+
+/**
+ * Find a stream of the connection by id or create a new one.
+ * Returns NULL on memory allocation error.
+ */
+static struct iproto_stream *
+iproto_stream_get(struct iproto_connection *con, uint64_t id)
+{
+	if (con->streams == NULL) {
+		con->streams = mh_i64ptr_new();
+		if (con->streams == NULL) {
+			diag_set(OutOfMemory, 0, "mh_i64ptr_new", "streams");
+			return NULL;
+		}
+	}
+	mh_int_t k = mh_i64ptr_find(con->streams, id, NULL);
+	if (k != mh_end(con->streams)) {
+		return (struct iproto_stream *)
+			mh_i64ptr_node(con->streams, k)->val;
+	}
+	struct mempool *pool = &con->iproto_thread->iproto_stream_pool;
+	struct iproto_stream *stream =
+		(struct iproto_stream *) mempool_alloc(pool);
+	if (stream == NULL) {
+		diag_set(OutOfMemory, sizeof(*stream), "mempool_alloc",
+			 "stream");
+		return NULL;
+	}
+	stream->id = id;
+	stream->connection = con;
+	stream->current = NULL;
+	stailq_create(&stream->pending);
+	stream->txn = NULL;
+	struct mh_i64ptr_node_t node = { id, stream };
+	if (mh_i64ptr_put(con->streams, &node, NULL, NULL) ==
+	    mh_end(con->streams)) {
+		mempool_free(pool, stream);
+		diag_set(OutOfMemory, 0, "mh_i64ptr_put", "stream");
+		return NULL;
+	}
+	return stream;
+}
+
+static void
+iproto_stream_delete(struct iproto_stream *stream)
+{
+	struct iproto_connection *con = stream->connection;
+	assert(stream->current == NULL && stream->txn == NULL);
+	assert(stailq_empty(&stream->pending));
+	mh_int_t k = mh_i64ptr_find(con->streams, stream->id, NULL);
+	assert(k != mh_end(con->streams));
+	mh_i64ptr_del(con->streams, k, NULL);
+	mempool_free(&con->iproto_thread->iproto_stream_pool, stream);
+}
+
+/**
+ * Add a request to its stream. Returns true if the request
+ * may be sent to tx thread right away, false if it has to
+ * wait for the previous request of the stream.
+ */
+static inline bool
+iproto_stream_enqueue(struct iproto_stream *stream, struct iproto_msg *msg)
+{
+	if (stream->current != NULL) {
+		stailq_add_tail_entry(&stream->pending, msg, in_stream);
+		return false;
+	}
+	stream->current = msg;
+	return true;
+}
+
+/**
+ * Called when the current request of the stream is finished:
+ * send the next request to tx thread, or delete the stream if
+ * it has nothing more to do.
+ */
+static void
+iproto_stream_advance(struct iproto_stream *stream)
+{
+	stream->current = NULL;
+	if (!stailq_empty(&stream->pending)) {
+		stream->current = stailq_shift_entry(&stream->pending,
+						     struct iproto_msg,
+						     in_stream);
+		cpipe_push(&stream->connection->iproto_thread->tx_pipe,
+			   &stream->current->base);
+	} else if (stream->txn == NULL) {
+		iproto_stream_delete(stream);
+	}
 }
 
 /* }}} iproto_connection */
@@ -1167,6 +2363,12 @@ tx_process_select(struct cmsg *msg);
 static void
 tx_process_sql(struct cmsg *msg);
 
+static void
+tx_process_txn(struct cmsg *msg);
+
+static void
+tx_process_batch(struct cmsg *msg);
+
 static void
 tx_reply_error(struct iproto_msg *msg);
 
@@ -1188,74 +2390,93 @@ net_end_join(struct cmsg *msg);
 static void
 net_end_subscribe(struct cmsg *msg);
 
-static const struct cmsg_hop misc_route[] = {
-	{ tx_process_misc, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop call_route[] = {
-	{ tx_process_call, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop select_route[] = {
-	{ tx_process_select, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop process1_route[] = {
-	{ tx_process1, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop sql_route[] = {
-	{ tx_process_sql, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX] = {
-	NULL,                                   /* IPROTO_OK */
-	select_route,                           /* IPROTO_SELECT */
-	process1_route,                         /* IPROTO_INSERT */
-	process1_route,                         /* IPROTO_REPLACE */
-	process1_route,                         /* IPROTO_UPDATE */
-	process1_route,                         /* IPROTO_DELETE */
-	call_route,                             /* IPROTO_CALL_16 */
-	misc_route,                             /* IPROTO_AUTH */
-	call_route,                             /* IPROTO_EVAL */
-	process1_route,                         /* IPROTO_UPSERT */
-	call_route,                             /* IPROTO_CALL */
-	sql_route,                              /* IPROTO_EXECUTE */
-	NULL,                                   /* IPROTO_NOP */
-	sql_route,                              /* IPROTO_PREPARE */
-};
-
-static const struct cmsg_hop join_route[] = {
-	{ tx_process_replication, &net_pipe },
-	{ net_end_join, NULL },
-};
-
-static const struct cmsg_hop subscribe_route[] = {
-	{ tx_process_replication, &net_pipe },
-	{ net_end_subscribe, NULL },
-};
+/**
+ * Return true if a request of type @a type must be rejected
+ * without execution, because requests wait for tx thread longer
+ * than iproto_queue_delay_max. Only the requests doing actual
+ * work are rejected, so that clients can still connect and ping.
+ */
+static inline bool
+iproto_is_overloaded(struct iproto_thread *iproto_thread, uint32_t type)
+{
+	if (iproto_queue_delay_max == 0 ||
+	    iproto_thread->queue_delay <= iproto_queue_delay_max)
+		return false;
+	switch (type) {
+	case IPROTO_SELECT:
+	case IPROTO_INSERT:
+	case IPROTO_REPLACE:
+	case IPROTO_UPDATE:
+	case IPROTO_DELETE:
+	case IPROTO_UPSERT:
+	case IPROTO_CALL_16:
+	case IPROTO_CALL:
+	case IPROTO_EVAL:
+	case IPROTO_EXECUTE:
+	case IPROTO_PREPARE:
+	case IPROTO_BATCH:
+		return true;
+	default:
+		return false;
+	}
+}
 
-static const struct cmsg_hop error_route[] = {
-	{ tx_reply_iproto_error, &net_pipe },
-	{ net_send_error, NULL },
-};
+/**
+ * Return true if a request of type @a type may belong to a
+ * stream. Replication, authentication and other requests
+ * changing the state of the connection may not.
+ */
+static inline bool
+iproto_type_is_stream_request(uint32_t type)
+{
+	switch (type) {
+	case IPROTO_SELECT:
+	case IPROTO_INSERT:
+	case IPROTO_REPLACE:
+	case IPROTO_UPDATE:
+	case IPROTO_DELETE:
+	case IPROTO_UPSERT:
+	case IPROTO_CALL_16:
+	case IPROTO_CALL:
+	case IPROTO_EVAL:
+	case IPROTO_EXECUTE:
+	case IPROTO_PREPARE:
+	case IPROTO_BEGIN:
+	case IPROTO_COMMIT:
+	case IPROTO_ROLLBACK:
+	case IPROTO_BATCH:
+	case IPROTO_PING:
+		return true;
+	default:
+		return false;
+	}
+}
 
 static void
 iproto_msg_decode(struct iproto_msg *msg, const char **pos, const char *reqend,
 		  bool *stop_input)
 {
 	uint8_t type;
+	struct iproto_thread *iproto_thread = msg->connection->iproto_thread;
 
+	msg->recv_time = ev_monotonic_now(msg->connection->loop);
 	if (xrow_header_decode(&msg->header, pos, reqend, true))
 		goto error;
 	assert(*pos == reqend);
 
 	type = msg->header.type;
+	if (iproto_is_overloaded(iproto_thread, type)) {
+		/*
+		 * Do not log the error, rejecting requests
+		 * must be cheap.
+		 */
+		diag_set(ClientError, ER_OVERLOAD, iproto_thread->queue_delay,
+			 iproto_queue_delay_max);
+		diag_create(&msg->diag);
+		diag_move(&fiber()->diag, &msg->diag);
+		cmsg_init(&msg->base, iproto_thread->error_route);
+		return;
+	}
 
 	/*
 	 * Parse request before putting it into the queue
@@ -1272,56 +2493,98 @@ iproto_msg_decode(struct iproto_msg *msg, const char **pos, const char *reqend,
 		if (xrow_decode_dml(&msg->header, &msg->dml,
 				    dml_request_key_map(type)))
 			goto error;
-		assert(type < sizeof(dml_route)/sizeof(*dml_route));
-		cmsg_init(&msg->base, dml_route[type]);
+		assert(type < sizeof(iproto_thread->dml_route) /
+			      sizeof(*iproto_thread->dml_route));
+		cmsg_init(&msg->base, iproto_thread->dml_route[type]);
 		break;
 	case IPROTO_CALL_16:
 	case IPROTO_CALL:
 	case IPROTO_EVAL:
 		if (xrow_decode_call(&msg->header, &msg->call))
 			goto error;
-		cmsg_init(&msg->base, call_route);
+		cmsg_init(&msg->base, iproto_thread->call_route);
 		break;
 	case IPROTO_EXECUTE:
 	case IPROTO_PREPARE:
 		if (xrow_decode_sql(&msg->header, &msg->sql) != 0)
 			goto error;
-		cmsg_init(&msg->base, sql_route);
+		cmsg_init(&msg->base, iproto_thread->sql_route);
+		break;
+	case IPROTO_BEGIN:
+	case IPROTO_COMMIT:
+	case IPROTO_ROLLBACK:
+		if (msg->header.stream_id == 0) {
+			diag_set(ClientError,
+				 ER_UNABLE_TO_PROCESS_OUT_OF_STREAM,
+				 iproto_type_name(type));
+			goto error;
+		}
+		cmsg_init(&msg->base, iproto_thread->txn_route);
+		break;
+	case IPROTO_BATCH:
+		if (xrow_decode_batch(&msg->header, &msg->batch) != 0)
+			goto error;
+		cmsg_init(&msg->base, iproto_thread->batch_route);
 		break;
 	case IPROTO_PING:
-		cmsg_init(&msg->base, misc_route);
+		cmsg_init(&msg->base, iproto_thread->misc_route);
 		break;
 	case IPROTO_JOIN:
 	case IPROTO_FETCH_SNAPSHOT:
 	case IPROTO_REGISTER:
-		cmsg_init(&msg->base, join_route);
-		*stop_input = true;
-		break;
 	case IPROTO_SUBSCRIBE:
-		cmsg_init(&msg->base, subscribe_route);
+		/* Replication works with the socket directly. */
+		if (msg->connection->is_shm) {
+			diag_set(ClientError, ER_UNSUPPORTED,
+				 "Shared memory transport", "replication");
+			goto error;
+		}
+		cmsg_init(&msg->base, type == IPROTO_SUBSCRIBE ?
+			  iproto_thread->subscribe_route :
+			  iproto_thread->join_route);
 		*stop_input = true;
 		break;
 	case IPROTO_VOTE_DEPRECATED:
 	case IPROTO_VOTE:
-		cmsg_init(&msg->base, misc_route);
+		cmsg_init(&msg->base, iproto_thread->misc_route);
+		break;
+	case IPROTO_COMPRESS:
+		/*
+		 * The client detects compressed frames by their
+		 * format, so the output may be compressed right
+		 * away, even before the reply is sent.
+		 */
+		msg->connection->is_compressed = true;
+		cmsg_init(&msg->base, iproto_thread->misc_route);
 		break;
 	case IPROTO_AUTH:
 		if (xrow_decode_auth(&msg->header, &msg->auth))
 			goto error;
-		cmsg_init(&msg->base, misc_route);
+		cmsg_init(&msg->base, iproto_thread->misc_route);
 		break;
 	default:
 		diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE,
 			 (uint32_t) type);
 		goto error;
 	}
+	if (msg->header.stream_id != 0) {
+		if (!iproto_type_is_stream_request(type)) {
+			diag_set(ClientError, ER_UNABLE_TO_PROCESS_IN_STREAM,
+				 iproto_type_name(type));
+			goto error;
+		}
+		msg->stream = iproto_stream_get(msg->connection,
+						msg->header.stream_id);
+		if (msg->stream == NULL)
+			goto error;
+	}
 	return;
 error:
 	/** Log and send the error. */
 	diag_log();
 	diag_create(&msg->diag);
 	diag_move(&fiber()->diag, &msg->diag);
-	cmsg_init(&msg->base, error_route);
+	cmsg_init(&msg->base, iproto_thread->error_route);
 }
 
 static void
@@ -1334,6 +2597,7 @@ tx_fiber_init(struct session *session, uint64_t sync)
 	 */
 	assert(rlist_empty(&f->on_stop));
 	f->storage.net.sync = sync;
+	f->storage.net.wal_time = 0;
 	/*
 	 * We do not cleanup fiber keys at the end of each request.
 	 * This does not lead to privilege escalation as long as
@@ -1380,10 +2644,35 @@ tx_process_destroy(struct cmsg *m)
 	struct iproto_connection *con =
 		container_of(m, struct iproto_connection, destroy_msg);
 	assert(con->state == IPROTO_CONNECTION_DESTROYED);
+	/*
+	 * Roll back transactions the client didn't finish. The
+	 * iproto thread doesn't touch the streams anymore.
+	 */
+	if (con->streams != NULL) {
+		mh_int_t i;
+		mh_foreach(con->streams, i) {
+			struct iproto_stream *stream = (struct iproto_stream *)
+				mh_i64ptr_node(con->streams, i)->val;
+			if (stream->txn == NULL)
+				continue;
+			txn_attach(stream->txn);
+			txn_rollback(stream->txn);
+			stream->txn = NULL;
+		}
+	}
 	if (con->session) {
 		session_destroy(con->session);
 		con->session = NULL; /* safety */
 	}
+	/*
+	 * Zero-copy replies which were not sent before the
+	 * connection was closed. The iproto thread doesn't touch
+	 * the queue anymore.
+	 */
+	struct iproto_zc *zc, *tmp;
+	rlist_foreach_entry_safe(zc, &con->zc_queue, in_queue, tmp)
+		iproto_zc_delete(zc);
+	rlist_create(&con->zc_queue);
 	/*
 	 * obuf is being destroyed in tx thread cause it is where
 	 * it was allocated.
@@ -1438,7 +2727,8 @@ tx_discard_input(struct iproto_msg *msg)
 		{ net_discard_input, NULL },
 	};
 	cmsg_init(&msg->discard_input, discard_input_route);
-	cpipe_push(&net_pipe, &msg->discard_input);
+	cpipe_push(&msg->connection->iproto_thread->net_pipe,
+		   &msg->discard_input);
 }
 
 /**
@@ -1484,11 +2774,46 @@ static inline struct iproto_msg *
 tx_accept_msg(struct cmsg *m)
 {
 	struct iproto_msg *msg = (struct iproto_msg *) m;
+	msg->queue_delay = ev_monotonic_time() - msg->recv_time;
 	tx_accept_wpos(msg->connection, &msg->wpos);
 	tx_fiber_init(msg->connection->session, msg->header.sync);
+	if (msg->stream != NULL && msg->stream->txn != NULL)
+		txn_attach(msg->stream->txn);
 	return msg;
 }
 
+/**
+ * Finish processing of a request in tx thread. The transaction
+ * of a stream request is detached from the fiber to be continued
+ * by the next request of the stream.
+ */
+static inline void
+tx_end_msg(struct iproto_msg *msg)
+{
+	if (msg->stream != NULL)
+		msg->stream->txn = txn_detach();
+	msg->tx_time = ev_monotonic_time() - msg->recv_time -
+		       msg->queue_delay;
+	msg->wal_time = fiber()->storage.net.wal_time;
+}
+
+/**
+ * Check that the client still waits for the reply, i.e. the
+ * request has not spent its timeout in the queue, and that the
+ * schema version of the request is up to date. Executing an
+ * expired request would only waste tx thread time under load.
+ */
+static inline int
+tx_check_msg(struct iproto_msg *msg)
+{
+	if (msg->header.timeout > 0 &&
+	    msg->queue_delay > msg->header.timeout) {
+		diag_set(ClientError, ER_TIMEOUT);
+		return -1;
+	}
+	return tx_check_schema(msg->header.schema_version);
+}
+
 /**
  * Write error message to the output buffer and advance
  * write position. Doesn't throw.
@@ -1500,6 +2825,7 @@ tx_reply_error(struct iproto_msg *msg)
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync, ::schema_version);
 	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg);
 }
 
 /**
@@ -1514,6 +2840,7 @@ tx_reply_iproto_error(struct cmsg *m)
 	iproto_reply_error(out, diag_last_error(&msg->diag),
 			   msg->header.sync, ::schema_version);
 	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg);
 }
 
 /** Inject a short delay on tx request processing for testing. */
@@ -1530,7 +2857,7 @@ static void
 tx_process1(struct cmsg *m)
 {
 	struct iproto_msg *msg = tx_accept_msg(m);
-	if (tx_check_schema(msg->header.schema_version))
+	if (tx_check_msg(msg) != 0)
 		goto error;
 
 	struct tuple *tuple;
@@ -1547,6 +2874,7 @@ tx_process1(struct cmsg *m)
 	iproto_reply_select(out, &svp, msg->header.sync, ::schema_version,
 			    tuple != 0);
 	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg);
 	return;
 error:
 	tx_reply_error(msg);
@@ -1562,13 +2890,17 @@ tx_process_select(struct cmsg *m)
 	int count;
 	int rc;
 	struct request *req = &msg->dml;
-	if (tx_check_schema(msg->header.schema_version))
+	if (tx_check_msg(msg) != 0)
 		goto error;
 
 	tx_inject_delay();
-	rc = box_select(req->space_id, req->index_id,
-			req->iterator, req->offset, req->limit,
-			req->key, req->key_end, &port);
+	const char *position, *position_end;
+	rc = box_select_position(req->space_id, req->index_id,
+				 req->iterator, req->offset, req->limit,
+				 req->key, req->key_end, req->after_position,
+				 req->after_position_end,
+				 req->fetch_position ? &position : NULL,
+				 &position_end, &port);
 	if (rc < 0)
 		goto error;
 
@@ -1577,6 +2909,22 @@ tx_process_select(struct cmsg *m)
 		port_destroy(&port);
 		goto error;
 	}
+	size_t zc_size;
+	/*
+	 * Compression needs the whole reply in the buffer, and
+	 * the position is sent after the tuples.
+	 */
+	count = -1;
+	if (!msg->connection->tx.is_compressed && !req->fetch_position)
+		count = iproto_zc_dump(&port, out, &msg->zc_list, &zc_size);
+	if (count >= 0) {
+		port_destroy(&port);
+		iproto_reply_select_ext(out, &svp, msg->header.sync,
+					::schema_version, count, zc_size);
+		iproto_wpos_create(&msg->wpos, out);
+		tx_end_msg(msg);
+		return;
+	}
 	/*
 	 * SELECT output format has not changed since Tarantool 1.6
 	 */
@@ -1587,9 +2935,20 @@ tx_process_select(struct cmsg *m)
 		obuf_rollback_to_svp(out, &svp);
 		goto error;
 	}
-	iproto_reply_select(out, &svp, msg->header.sync,
-			    ::schema_version, count);
+	if (req->fetch_position && position != NULL) {
+		if (iproto_reply_select_position(out, &svp, msg->header.sync,
+						 ::schema_version, count,
+						 position,
+						 position_end) != 0) {
+			obuf_rollback_to_svp(out, &svp);
+			goto error;
+		}
+	} else {
+		iproto_reply_select(out, &svp, msg->header.sync,
+				    ::schema_version, count);
+	}
 	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg);
 	return;
 error:
 	tx_reply_error(msg);
@@ -1610,7 +2969,7 @@ static void
 tx_process_call(struct cmsg *m)
 {
 	struct iproto_msg *msg = tx_accept_msg(m);
-	if (tx_check_schema(msg->header.schema_version))
+	if (tx_check_msg(msg) != 0)
 		goto error;
 
 	/*
@@ -1680,6 +3039,7 @@ tx_process_call(struct cmsg *m)
 	iproto_reply_select(out, &svp, msg->header.sync,
 			    ::schema_version, count);
 	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg);
 	return;
 error:
 	tx_reply_error(msg);
@@ -1691,7 +3051,7 @@ tx_process_misc(struct cmsg *m)
 	struct iproto_msg *msg = tx_accept_msg(m);
 	struct iproto_connection *con = msg->connection;
 	struct obuf *out = con->tx.p_obuf;
-	if (tx_check_schema(msg->header.schema_version))
+	if (tx_check_msg(msg) != 0)
 		goto error;
 
 	try {
@@ -1716,10 +3076,16 @@ tx_process_misc(struct cmsg *m)
 			iproto_reply_vote_xc(out, &ballot, msg->header.sync,
 					     ::schema_version);
 			break;
+		case IPROTO_COMPRESS:
+			con->tx.is_compressed = true;
+			iproto_reply_ok_xc(out, msg->header.sync,
+					   ::schema_version);
+			break;
 		default:
 			unreachable();
 		}
 		iproto_wpos_create(&msg->wpos, out);
+		tx_end_msg(msg);
 	} catch (Exception *e) {
 		tx_reply_error(msg);
 	}
@@ -1740,7 +3106,7 @@ tx_process_sql(struct cmsg *m)
 	uint32_t len;
 	bool is_unprepare = false;
 
-	if (tx_check_schema(msg->header.schema_version))
+	if (tx_check_msg(msg) != 0)
 		goto error;
 	assert(msg->header.type == IPROTO_EXECUTE ||
 	       msg->header.type == IPROTO_PREPARE);
@@ -1803,6 +3169,7 @@ tx_process_sql(struct cmsg *m)
 		if (iproto_reply_ok(out, msg->header.sync, schema_version) != 0)
 			goto error;
 		iproto_wpos_create(&msg->wpos, out);
+		tx_end_msg(msg);
 		return;
 	}
 	struct obuf_svp header_svp;
@@ -1819,7 +3186,141 @@ tx_process_sql(struct cmsg *m)
 	port_destroy(&port);
 	iproto_reply_sql(out, &header_svp, msg->header.sync, schema_version);
 	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg);
+	return;
+error:
+	tx_reply_error(msg);
+}
+
+static void
+tx_process_txn(struct cmsg *m)
+{
+	struct iproto_msg *msg = tx_accept_msg(m);
+	struct obuf *out;
+	if (tx_check_msg(msg) != 0)
+		goto error;
+
+	switch (msg->header.type) {
+	case IPROTO_BEGIN:
+		if (box_txn_begin() != 0)
+			goto error;
+		break;
+	case IPROTO_COMMIT:
+		if (box_txn_commit() != 0)
+			goto error;
+		break;
+	case IPROTO_ROLLBACK:
+		if (box_txn_rollback() != 0)
+			goto error;
+		break;
+	default:
+		unreachable();
+	}
+	rmean_collect(rmean_box, msg->header.type, 1);
+	out = msg->connection->tx.p_obuf;
+	if (iproto_reply_ok(out, msg->header.sync, ::schema_version) != 0)
+		goto error;
+	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg);
+	return;
+error:
+	tx_reply_error(msg);
+}
+
+/**
+ * Execute all DML requests of a batch in one transaction, so
+ * that they are written to WAL at once. If the request belongs
+ * to a stream with an open transaction, the batch joins it and
+ * on failure only the batch statements are rolled back. The
+ * reply has the same format as SELECT: one tuple per request,
+ * or nil if the request didn't return a tuple.
+ */
+static void
+tx_process_batch(struct cmsg *m)
+{
+	struct iproto_msg *msg = tx_accept_msg(m);
+	struct batch_request *batch = &msg->batch;
+	struct tuple **results = NULL;
+	uint32_t count = 0;
+	struct txn *txn = NULL;
+	box_txn_savepoint_t *svp = NULL;
+	struct obuf_svp obuf_svp;
+	struct obuf *out;
+	if (tx_check_msg(msg) != 0)
+		goto error;
+	tx_inject_delay();
+
+	int size;
+	results = region_alloc_array(&fiber()->gc, struct tuple *,
+				     batch->count, &size);
+	if (results == NULL && batch->count > 0) {
+		diag_set(OutOfMemory, size, "region_alloc_array", "results");
+		goto error;
+	}
+	if (in_txn() == NULL) {
+		if ((txn = txn_begin()) == NULL)
+			goto error;
+	} else if ((svp = box_txn_savepoint()) == NULL) {
+		goto error;
+	}
+	{
+		const char *pos = batch->ops;
+		for (; count < batch->count; count++) {
+			struct xrow_header row = msg->header;
+			struct request request;
+			struct tuple *tuple = NULL;
+			if (xrow_decode_batch_op(&pos, batch->ops_end, &row,
+						 &request) != 0 ||
+			    box_process1(&request, &tuple) != 0)
+				goto rollback;
+			if (tuple != NULL)
+				tuple_ref(tuple);
+			results[count] = tuple;
+		}
+	}
+	if (txn != NULL && txn_commit(txn) != 0)
+		goto cleanup;
+
+	rmean_collect(rmean_box, IPROTO_BATCH, 1);
+	out = msg->connection->tx.p_obuf;
+	if (iproto_prepare_select(out, &obuf_svp) != 0)
+		goto cleanup;
+	for (uint32_t i = 0; i < count; i++) {
+		if (results[i] != NULL) {
+			if (tuple_to_obuf(results[i], out) != 0)
+				goto discard;
+			continue;
+		}
+		char *nil = (char *)obuf_alloc(out, mp_sizeof_nil());
+		if (nil == NULL) {
+			diag_set(OutOfMemory, mp_sizeof_nil(), "obuf_alloc",
+				 "nil");
+			goto discard;
+		}
+		mp_encode_nil(nil);
+	}
+	iproto_reply_select(out, &obuf_svp, msg->header.sync,
+			    ::schema_version, count);
+	for (uint32_t i = 0; i < count; i++) {
+		if (results[i] != NULL)
+			tuple_unref(results[i]);
+	}
+	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg);
 	return;
+discard:
+	obuf_rollback_to_svp(out, &obuf_svp);
+	goto cleanup;
+rollback:
+	if (txn != NULL)
+		txn_rollback(txn);
+	else
+		box_txn_rollback_to_savepoint(svp);
+cleanup:
+	for (uint32_t i = 0; i < count; i++) {
+		if (results[i] != NULL)
+			tuple_unref(results[i]);
+	}
 error:
 	tx_reply_error(msg);
 }
@@ -1867,6 +3368,23 @@ tx_process_replication(struct cmsg *m)
 	}
 }
 
+/** Account processing time of a request in its histograms. */
+static void
+iproto_thread_collect_latency(struct iproto_thread *iproto_thread,
+			      struct iproto_msg *msg)
+{
+	uint32_t type = msg->header.type;
+	if (type >= IPROTO_TYPE_STAT_MAX || iproto_type_strs[type] == NULL)
+		return;
+	struct latency *latency = iproto_thread->latency[type];
+	latency_collect(&latency[IPROTO_LATENCY_TOTAL],
+			ev_monotonic_time() - msg->recv_time);
+	latency_collect(&latency[IPROTO_LATENCY_QUEUE], msg->queue_delay);
+	latency_collect(&latency[IPROTO_LATENCY_EXEC],
+			msg->tx_time - msg->wal_time);
+	latency_collect(&latency[IPROTO_LATENCY_WAL], msg->wal_time);
+}
+
 static void
 net_send_msg(struct cmsg *m)
 {
@@ -1882,6 +3400,15 @@ net_send_msg(struct cmsg *m)
 		con->long_poll_count--;
 	}
 	con->wend = msg->wpos;
+	rlist_splice_tail(&con->zc_queue, &msg->zc_list);
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	iproto_thread->queue_delay += IPROTO_QUEUE_DELAY_WEIGHT *
+		(msg->queue_delay - iproto_thread->queue_delay);
+	iproto_thread_collect_latency(iproto_thread, msg);
+	/* The limit takes effect in iproto_msg_delete(). */
+	iproto_thread_tune_msg_max(iproto_thread);
+	if (msg->stream != NULL)
+		iproto_stream_advance(msg->stream);
 
 	if (evio_has_fd(&con->output)) {
 		if (! ev_is_active(&con->output))
@@ -1983,12 +3510,13 @@ net_send_greeting(struct cmsg *m)
 	struct iproto_connection *con = msg->connection;
 	if (msg->close_connection) {
 		struct obuf *out = msg->wpos.obuf;
-		int64_t nwr = sio_writev(con->output.fd, out->iov,
-					 obuf_iovcnt(out));
+		int64_t nwr = iproto_connection_writev(con, out->iov,
+						       obuf_iovcnt(out));
 
 		if (nwr > 0) {
 			/* Count statistics. */
-			rmean_collect(rmean_net, IPROTO_SENT, nwr);
+			rmean_collect(con->iproto_thread->rmean, IPROTO_SENT,
+				      nwr);
 		} else if (nwr < 0 && ! sio_wouldblock(errno)) {
 			diag_log();
 		}
@@ -2009,26 +3537,63 @@ net_send_greeting(struct cmsg *m)
 	iproto_msg_delete(msg);
 }
 
-static const struct cmsg_hop connect_route[] = {
-	{ tx_process_connect, &net_pipe },
-	{ net_send_greeting, NULL },
-};
-
 /** }}} */
 
+/** The shared memory client has closed the socket or died. */
+static void
+iproto_connection_on_hup(ev_loop *loop, struct ev_io *watcher,
+			 int /* revents */)
+{
+	(void) loop;
+	struct iproto_connection *con =
+		(struct iproto_connection *) watcher->data;
+	iproto_connection_close(con);
+}
+
+/**
+ * Set up a shared memory channel over the accepted socket @a fd
+ * and make the connection use it.
+ */
+static int
+iproto_connection_accept_shm(struct iproto_connection *con, int fd)
+{
+	if (shm_chan_accept(&con->shm, fd, SHM_CHAN_RING_SIZE_DEFAULT) != 0) {
+		diag_set(SocketError, sio_socketname(fd), "shm_chan_accept");
+		return -1;
+	}
+	con->is_shm = true;
+	ev_io_set(&con->input, shm_chan_fd(&con->shm, SHM_CHAN_READ),
+		  EV_READ);
+	ev_io_set(&con->output, shm_chan_fd(&con->shm, SHM_CHAN_WRITE),
+		  EV_READ);
+	ev_io_init(&con->hup, iproto_connection_on_hup, fd, EV_READ);
+	con->hup.data = con;
+	ev_io_start(con->loop, &con->hup);
+	return 0;
+}
+
 /**
  * Create a connection and start input.
  */
 static int
-iproto_on_accept(struct evio_service * /* service */, int fd,
+iproto_on_accept(struct evio_service *service, int fd,
 		 struct sockaddr *addr, socklen_t addrlen)
 {
 	(void) addr;
 	(void) addrlen;
+	struct iproto_thread *iproto_thread =
+		(struct iproto_thread *) service->on_accept_param;
 	struct iproto_msg *msg;
-	struct iproto_connection *con = iproto_connection_new(fd);
+	struct iproto_connection *con =
+		iproto_connection_new(iproto_thread, fd);
 	if (con == NULL)
 		return -1;
+	if (iproto_thread->is_listen_shm &&
+	    iproto_connection_accept_shm(con, fd) != 0) {
+		iproto_thread->readahead -= con->readahead;
+		mempool_free(&iproto_thread->iproto_connection_pool, con);
+		return -1;
+	}
 	/*
 	 * Ignore msg allocation failure - the queue size is
 	 * fixed so there is a limited number of msgs in
@@ -2036,61 +3601,105 @@ iproto_on_accept(struct evio_service * /* service */, int fd,
 	 */
 	msg = iproto_msg_new(con);
 	if (msg == NULL) {
-		mempool_free(&iproto_connection_pool, con);
+		if (con->is_shm) {
+			ev_io_stop(con->loop, &con->hup);
+			shm_chan_close(&con->shm);
+		}
+		iproto_thread->readahead -= con->readahead;
+		mempool_free(&iproto_thread->iproto_connection_pool, con);
 		return -1;
 	}
-	cmsg_init(&msg->base, connect_route);
+	cmsg_init(&msg->base, iproto_thread->connect_route);
 	msg->p_ibuf = con->p_ibuf;
 	msg->wpos = con->wpos;
-	cpipe_push(&tx_pipe, &msg->base);
+	cpipe_push(&iproto_thread->tx_pipe, &msg->base);
 	return 0;
 }
 
-static struct evio_service binary; /* iproto binary listener */
-
 /**
  * The network io thread main function:
  * begin serving the message bus.
  */
 static int
-net_cord_f(va_list /* ap */)
+net_cord_f(va_list ap)
 {
-	mempool_create(&iproto_msg_pool, &cord()->slabc,
+	struct iproto_thread *iproto_thread =
+		va_arg(ap, struct iproto_thread *);
+
+	mempool_create(&iproto_thread->iproto_msg_pool, &cord()->slabc,
 		       sizeof(struct iproto_msg));
-	mempool_create(&iproto_connection_pool, &cord()->slabc,
+	mempool_create(&iproto_thread->iproto_connection_pool, &cord()->slabc,
 		       sizeof(struct iproto_connection));
+	mempool_create(&iproto_thread->iproto_stream_pool, &cord()->slabc,
+		       sizeof(struct iproto_stream));
 
-	evio_service_init(loop(), &binary, "binary",
-			  iproto_on_accept, NULL);
+	evio_service_init(loop(), &iproto_thread->binary, "binary",
+			  iproto_on_accept, iproto_thread);
 
+	if (iproto_use_io_uring) {
+		if (uring_create(&iproto_thread->uring, loop(),
+				 IPROTO_URING_ENTRIES) == 0) {
+			iproto_thread->use_uring = true;
+		} else {
+			diag_log();
+			say_warn("io_uring is not available, "
+				 "falling back to epoll");
+		}
+	}
 
 	/* Init statistics counter */
-	rmean_net = rmean_new(rmean_net_strings, IPROTO_LAST);
+	iproto_thread->rmean = rmean_new(rmean_net_strings, IPROTO_LAST);
 
-	if (rmean_net == NULL) {
+	if (iproto_thread->rmean == NULL) {
 		tnt_raise(OutOfMemory, sizeof(struct rmean),
 			  "rmean", "struct rmean");
 	}
+	for (uint32_t type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		if (iproto_type_strs[type] == NULL)
+			continue;
+		for (int i = 0; i < iproto_latency_stage_MAX; i++) {
+			if (latency_create(
+				&iproto_thread->latency[type][i]) != 0) {
+				tnt_raise(OutOfMemory, sizeof(struct latency),
+					  "latency_create", "struct latency");
+			}
+		}
+	}
 
 	struct cbus_endpoint endpoint;
-	/* Create "net" endpoint. */
-	cbus_endpoint_create(&endpoint, "net", fiber_schedule_cb, fiber());
+	/* Create "net%u" endpoint. */
+	cbus_endpoint_create(&endpoint, tt_sprintf("net%u", iproto_thread->id),
+			     fiber_schedule_cb, fiber());
 	/* Create a pipe to "tx" thread. */
-	cpipe_create(&tx_pipe, "tx");
-	cpipe_set_max_input(&tx_pipe, iproto_msg_max / 2);
+	cpipe_create(&iproto_thread->tx_pipe, "tx");
+	cpipe_set_max_input(&iproto_thread->tx_pipe,
+			    pm_atomic_load(&iproto_msg_max) / 2);
 	/* Process incomming messages. */
 	cbus_loop(&endpoint);
 
-	cpipe_destroy(&tx_pipe);
+	cpipe_destroy(&iproto_thread->tx_pipe);
 	/*
 	 * Nothing to do in the fiber so far, the service
 	 * will take care of creating events for incoming
 	 * connections.
 	 */
-	if (evio_service_is_active(&binary))
-		evio_service_stop(&binary);
+	if (evio_service_is_active(&iproto_thread->binary)) {
+		if (iproto_thread->id == 0)
+			evio_service_stop(&iproto_thread->binary);
+		else
+			evio_service_detach(&iproto_thread->binary);
+	}
 
-	rmean_delete(rmean_net);
+	if (iproto_thread->use_uring)
+		uring_destroy(&iproto_thread->uring);
+	ZSTD_freeCCtx(iproto_thread->zctx);
+	rmean_delete(iproto_thread->rmean);
+	for (uint32_t type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		if (iproto_type_strs[type] == NULL)
+			continue;
+		for (int i = 0; i < iproto_latency_stage_MAX; i++)
+			latency_destroy(&iproto_thread->latency[type][i]);
+	}
 	return 0;
 }
 
@@ -2099,7 +3708,7 @@ iproto_session_fd(struct session *session)
 {
 	struct iproto_connection *con =
 		(struct iproto_connection *) session->meta.connection;
-	return con->output.fd;
+	return con->is_shm ? con->hup.fd : con->output.fd;
 }
 
 int64_t
@@ -2132,11 +3741,11 @@ static void
 tx_begin_push(struct iproto_connection *con)
 {
 	assert(! con->tx.is_push_sent);
-	cmsg_init(&con->kharon.base, push_route);
+	cmsg_init(&con->kharon.base, con->iproto_thread->push_route);
 	iproto_wpos_create(&con->kharon.wpos, con->tx.p_obuf);
 	con->tx.is_push_pending = false;
 	con->tx.is_push_sent = true;
-	cpipe_push(&net_pipe, (struct cmsg *) &con->kharon);
+	cpipe_push(&con->iproto_thread->net_pipe, (struct cmsg *) &con->kharon);
 }
 
 static void
@@ -2184,18 +3793,100 @@ iproto_session_push(struct session *session, struct port *port)
 
 /** }}} */
 
-/** Initialize the iproto subsystem and start network io thread */
-void
-iproto_init(void)
+static inline void
+iproto_thread_init_routes(struct iproto_thread *iproto_thread)
 {
-	slab_cache_create(&net_slabc, &runtime);
+	struct cpipe *net_pipe = &iproto_thread->net_pipe;
+	struct cpipe *tx_pipe = &iproto_thread->tx_pipe;
+
+	iproto_thread->destroy_route[0] = { tx_process_destroy, net_pipe };
+	iproto_thread->destroy_route[1] = { net_finish_destroy, NULL };
+	iproto_thread->disconnect_route[0] =
+		{ tx_process_disconnect, net_pipe };
+	iproto_thread->disconnect_route[1] = { net_finish_disconnect, NULL };
+	iproto_thread->push_route[0] = { iproto_process_push, tx_pipe };
+	iproto_thread->push_route[1] = { tx_end_push, NULL };
+	iproto_thread->misc_route[0] = { tx_process_misc, net_pipe };
+	iproto_thread->misc_route[1] = { net_send_msg, NULL };
+	iproto_thread->call_route[0] = { tx_process_call, net_pipe };
+	iproto_thread->call_route[1] = { net_send_msg, NULL };
+	iproto_thread->select_route[0] = { tx_process_select, net_pipe };
+	iproto_thread->select_route[1] = { net_send_msg, NULL };
+	iproto_thread->process1_route[0] = { tx_process1, net_pipe };
+	iproto_thread->process1_route[1] = { net_send_msg, NULL };
+	iproto_thread->sql_route[0] = { tx_process_sql, net_pipe };
+	iproto_thread->sql_route[1] = { net_send_msg, NULL };
+	iproto_thread->txn_route[0] = { tx_process_txn, net_pipe };
+	iproto_thread->txn_route[1] = { net_send_msg, NULL };
+	iproto_thread->batch_route[0] = { tx_process_batch, net_pipe };
+	iproto_thread->batch_route[1] = { net_send_msg, NULL };
+	iproto_thread->join_route[0] = { tx_process_replication, net_pipe };
+	iproto_thread->join_route[1] = { net_end_join, NULL };
+	iproto_thread->subscribe_route[0] =
+		{ tx_process_replication, net_pipe };
+	iproto_thread->subscribe_route[1] = { net_end_subscribe, NULL };
+	iproto_thread->error_route[0] = { tx_reply_iproto_error, net_pipe };
+	iproto_thread->error_route[1] = { net_send_error, NULL };
+	iproto_thread->connect_route[0] = { tx_process_connect, net_pipe };
+	iproto_thread->connect_route[1] = { net_send_greeting, NULL };
+
+	const struct cmsg_hop **dml_route = iproto_thread->dml_route;
+	dml_route[IPROTO_OK] = NULL;
+	dml_route[IPROTO_SELECT] = iproto_thread->select_route;
+	dml_route[IPROTO_INSERT] = iproto_thread->process1_route;
+	dml_route[IPROTO_REPLACE] = iproto_thread->process1_route;
+	dml_route[IPROTO_UPDATE] = iproto_thread->process1_route;
+	dml_route[IPROTO_DELETE] = iproto_thread->process1_route;
+	dml_route[IPROTO_CALL_16] = iproto_thread->call_route;
+	dml_route[IPROTO_AUTH] = iproto_thread->misc_route;
+	dml_route[IPROTO_EVAL] = iproto_thread->call_route;
+	dml_route[IPROTO_UPSERT] = iproto_thread->process1_route;
+	dml_route[IPROTO_CALL] = iproto_thread->call_route;
+	dml_route[IPROTO_EXECUTE] = iproto_thread->sql_route;
+	dml_route[IPROTO_NOP] = NULL;
+	dml_route[IPROTO_PREPARE] = iproto_thread->sql_route;
+	dml_route[IPROTO_BEGIN] = iproto_thread->txn_route;
+	dml_route[IPROTO_COMMIT] = iproto_thread->txn_route;
+	dml_route[IPROTO_ROLLBACK] = iproto_thread->txn_route;
+	dml_route[IPROTO_BATCH] = iproto_thread->batch_route;
+}
+
+/** Start a network thread and create a pipe to it. */
+static void
+iproto_thread_init(struct iproto_thread *iproto_thread, uint32_t id)
+{
+	iproto_thread->id = id;
+	rlist_create(&iproto_thread->stopped_connections);
+	iproto_thread_init_routes(iproto_thread);
+	slab_cache_create(&iproto_thread->net_slabc, &runtime);
 
-	if (cord_costart(&net_cord, "iproto", net_cord_f, NULL))
+	if (cord_costart(&iproto_thread->net_cord, "iproto",
+			 net_cord_f, iproto_thread))
 		panic("failed to initialize iproto thread");
 
 	/* Create a pipe to "net" thread. */
-	cpipe_create(&net_pipe, "net");
-	cpipe_set_max_input(&net_pipe, iproto_msg_max / 2);
+	cpipe_create(&iproto_thread->net_pipe, tt_sprintf("net%u", id));
+	cpipe_set_max_input(&iproto_thread->net_pipe,
+			    pm_atomic_load(&iproto_msg_max) / 2);
+}
+
+/** Initialize the iproto subsystem and start network io threads */
+void
+iproto_init(int threads_count, bool use_io_uring)
+{
+	assert(threads_count > 0);
+	iproto_use_io_uring = use_io_uring;
+	iproto_threads = (struct iproto_thread *)
+		calloc(threads_count, sizeof(struct iproto_thread));
+	if (iproto_threads == NULL) {
+		tnt_raise(OutOfMemory, threads_count *
+			  sizeof(struct iproto_thread), "calloc",
+			  "struct iproto_thread");
+	}
+	iproto_threads_count = threads_count;
+	for (int i = 0; i < threads_count; i++)
+		iproto_thread_init(&iproto_threads[i], i);
+
 	struct session_vtab iproto_session_vtab = {
 		/* .push = */ iproto_session_push,
 		/* .fd = */ iproto_session_fd,
@@ -2224,15 +3915,23 @@ struct iproto_cfg_msg: public cbus_call_msg
 		struct {
 			/** New URI to bind to. */
 			const char *uri;
+			/** True if it is a shared memory URI. */
+			bool is_shm;
 			/** Result address. */
 			struct sockaddr_storage addr;
 			/** Address length. */
 			socklen_t addrlen;
 		};
 
-		/** New iproto max message count. */
-		int iproto_msg_max;
+		struct {
+			/** New iproto max message count. */
+			int iproto_msg_max;
+			/** Previous iproto max message count. */
+			int old_iproto_msg_max;
+		};
 	};
+	/** Thread the message is sent to. */
+	struct iproto_thread *iproto_thread;
 };
 
 static inline void
@@ -2242,30 +3941,61 @@ iproto_cfg_msg_create(struct iproto_cfg_msg *msg, enum iproto_cfg_op op)
 	msg->op = op;
 }
 
+/**
+ * Stop accepting connections in a network thread. Only the
+ * first thread owns the listening socket and closes it, the
+ * others are merely detached from it.
+ */
+static void
+iproto_thread_stop_listen(struct iproto_thread *iproto_thread)
+{
+	if (!evio_service_is_active(&iproto_thread->binary))
+		return;
+	if (iproto_thread->id == 0)
+		evio_service_stop(&iproto_thread->binary);
+	else
+		evio_service_detach(&iproto_thread->binary);
+}
+
 static int
 iproto_do_cfg_f(struct cbus_call_msg *m)
 {
 	struct iproto_cfg_msg *cfg_msg = (struct iproto_cfg_msg *) m;
-	int old;
+	struct iproto_thread *iproto_thread = cfg_msg->iproto_thread;
+	struct evio_service *binary = &iproto_thread->binary;
 	try {
 		switch (cfg_msg->op) {
 		case IPROTO_CFG_MSG_MAX:
-			cpipe_set_max_input(&tx_pipe,
+			cpipe_set_max_input(&iproto_thread->tx_pipe,
 					    cfg_msg->iproto_msg_max / 2);
-			old = iproto_msg_max;
-			iproto_msg_max = cfg_msg->iproto_msg_max;
-			if (old < iproto_msg_max)
-				iproto_resume();
+			/*
+			 * The limit is shared by all threads and
+			 * is already updated by tx. If it has grown,
+			 * resume the connections stopped by it.
+			 */
+			if (cfg_msg->old_iproto_msg_max <
+			    cfg_msg->iproto_msg_max)
+				iproto_resume(iproto_thread);
 			break;
 		case IPROTO_CFG_LISTEN:
-			if (evio_service_is_active(&binary))
-				evio_service_stop(&binary);
-			if (cfg_msg->uri != NULL &&
-			    (evio_service_bind(&binary, cfg_msg->uri) != 0 ||
-			     evio_service_listen(&binary) != 0))
+			iproto_thread_stop_listen(iproto_thread);
+			if (cfg_msg->uri == NULL)
+				break;
+			iproto_thread->is_listen_shm = cfg_msg->is_shm;
+			if (iproto_thread->id != 0) {
+				/*
+				 * The first thread has already bound
+				 * the socket, share it.
+				 */
+				evio_service_attach(binary,
+						    &iproto_threads[0].binary);
+				break;
+			}
+			if (evio_service_bind(binary, cfg_msg->uri) != 0 ||
+			    evio_service_listen(binary) != 0)
 				diag_raise();
-			cfg_msg->addrlen = binary.addr_len;
-			cfg_msg->addr = binary.addrstorage;
+			cfg_msg->addrlen = binary->addr_len;
+			cfg_msg->addr = binary->addrstorage;
 			break;
 		default:
 			unreachable();
@@ -2277,10 +4007,11 @@ iproto_do_cfg_f(struct cbus_call_msg *m)
 }
 
 static inline void
-iproto_do_cfg(struct iproto_cfg_msg *msg)
+iproto_do_cfg(struct iproto_thread *iproto_thread, struct iproto_cfg_msg *msg)
 {
-	if (cbus_call(&net_pipe, &tx_pipe, msg, iproto_do_cfg_f,
-		      NULL, TIMEOUT_INFINITY) != 0)
+	msg->iproto_thread = iproto_thread;
+	if (cbus_call(&iproto_thread->net_pipe, &iproto_thread->tx_pipe, msg,
+		      iproto_do_cfg_f, NULL, TIMEOUT_INFINITY) != 0)
 		diag_raise();
 }
 
@@ -2288,35 +4019,206 @@ void
 iproto_listen(const char *uri)
 {
 	struct iproto_cfg_msg cfg_msg;
+	/*
+	 * A shared memory channel is set up over a unix socket,
+	 * so listen on it.
+	 */
+	char *unix_uri = NULL;
+	bool is_shm = uri != NULL && iproto_uri_is_shm(uri);
+	if (is_shm) {
+		unix_uri = strdup(tt_sprintf("unix/%s",
+					     uri + strlen("shm/")));
+		if (unix_uri == NULL) {
+			tnt_raise(OutOfMemory, strlen(uri) + 2, "strdup",
+				  "unix_uri");
+		}
+		uri = unix_uri;
+	}
+	auto unix_uri_guard = make_scoped_guard([=] { free(unix_uri); });
+	/*
+	 * Detach the threads sharing the listening socket before
+	 * the first thread closes it.
+	 */
+	for (int i = iproto_threads_count - 1; i > 0; i--) {
+		iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_LISTEN);
+		iproto_do_cfg(&iproto_threads[i], &cfg_msg);
+	}
 	iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_LISTEN);
 	cfg_msg.uri = uri;
-	iproto_do_cfg(&cfg_msg);
+	cfg_msg.is_shm = is_shm;
+	iproto_do_cfg(&iproto_threads[0], &cfg_msg);
 	iproto_bound_address_storage = cfg_msg.addr;
 	iproto_bound_address_len = cfg_msg.addrlen;
+	if (uri == NULL)
+		return;
+	for (int i = 1; i < iproto_threads_count; i++) {
+		iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_LISTEN);
+		cfg_msg.uri = uri;
+		cfg_msg.is_shm = is_shm;
+		iproto_do_cfg(&iproto_threads[i], &cfg_msg);
+	}
 }
 
 size_t
 iproto_mem_used(void)
 {
-	return slab_cache_used(&net_cord.slabc) + slab_cache_used(&net_slabc);
+	size_t mem = 0;
+	for (int i = 0; i < iproto_threads_count; i++) {
+		mem += slab_cache_used(&iproto_threads[i].net_cord.slabc);
+		mem += slab_cache_used(&iproto_threads[i].net_slabc);
+	}
+	return mem;
+}
+
+size_t
+iproto_thread_connection_count(int thread_id)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	return mempool_count(&iproto_threads[thread_id].iproto_connection_pool);
 }
 
 size_t
 iproto_connection_count(void)
 {
-	return mempool_count(&iproto_connection_pool);
+	size_t count = 0;
+	for (int i = 0; i < iproto_threads_count; i++)
+		count += iproto_thread_connection_count(i);
+	return count;
+}
+
+size_t
+iproto_thread_request_count(int thread_id)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	return mempool_count(&iproto_threads[thread_id].iproto_msg_pool);
 }
 
 size_t
 iproto_request_count(void)
 {
-	return mempool_count(&iproto_msg_pool);
+	size_t count = 0;
+	for (int i = 0; i < iproto_threads_count; i++)
+		count += iproto_thread_request_count(i);
+	return count;
+}
+
+int
+iproto_session_queue_stat(struct session *session,
+			  struct iproto_queue_stat *stat)
+{
+	if (session->type != SESSION_TYPE_BINARY ||
+	    session->meta.connection == NULL)
+		return -1;
+	struct iproto_connection *con =
+		(struct iproto_connection *) session->meta.connection;
+	/* Dirty reads of the iproto thread state. */
+	stat->inflight = con->inflight;
+	stat->pending = con->parse_size;
+	stat->readahead = con->readahead;
+	return 0;
+}
+
+void
+iproto_thread_tune_stat(int thread_id, struct iproto_tune_stat *stat)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	struct iproto_thread *iproto_thread = &iproto_threads[thread_id];
+	/* Dirty reads of the iproto thread state. */
+	stat->msg_max = iproto_thread_msg_max(iproto_thread);
+	stat->readahead = iproto_thread->readahead;
+}
+
+void
+iproto_tune_stat(struct iproto_tune_stat *stat)
+{
+	memset(stat, 0, sizeof(*stat));
+	for (int i = 0; i < iproto_threads_count; i++) {
+		struct iproto_tune_stat thread_stat;
+		iproto_thread_tune_stat(i, &thread_stat);
+		stat->msg_max += thread_stat.msg_max;
+		stat->readahead += thread_stat.readahead;
+	}
+}
+
+int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx)
+{
+	for (size_t i = 0; i < IPROTO_LAST; i++) {
+		int64_t mean = 0;
+		int64_t total = 0;
+		for (int j = 0; j < iproto_threads_count; j++) {
+			mean += rmean_mean(iproto_threads[j].rmean, i);
+			total += rmean_total(iproto_threads[j].rmean, i);
+		}
+		int rc = cb(rmean_net_strings[i], mean, total, cb_ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
+}
+
+int
+iproto_thread_rmean_foreach(int thread_id, rmean_cb cb, void *cb_ctx)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	return rmean_foreach(iproto_threads[thread_id].rmean, cb, cb_ctx);
 }
 
 void
 iproto_reset_stat(void)
 {
-	rmean_cleanup(rmean_net);
+	for (int i = 0; i < iproto_threads_count; i++) {
+		struct iproto_thread *iproto_thread = &iproto_threads[i];
+		rmean_cleanup(iproto_thread->rmean);
+		for (uint32_t type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+			if (iproto_type_strs[type] == NULL)
+				continue;
+			for (int j = 0; j < iproto_latency_stage_MAX; j++)
+				latency_reset(&iproto_thread->latency[type][j]);
+		}
+	}
+}
+
+int
+iproto_latency_stat(struct info_handler *h)
+{
+	struct latency sum;
+	if (latency_create(&sum) != 0) {
+		diag_set(OutOfMemory, sizeof(struct latency),
+			 "latency_create", "struct latency");
+		return -1;
+	}
+	info_begin(h);
+	for (uint32_t type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		if (iproto_type_strs[type] == NULL)
+			continue;
+		size_t count = 0;
+		for (int i = 0; i < iproto_threads_count; i++) {
+			count += latency_count(&iproto_threads[i].
+					       latency[type][IPROTO_LATENCY_TOTAL]);
+		}
+		if (count == 0)
+			continue;
+		info_table_begin(h, iproto_type_strs[type]);
+		info_append_int(h, "count", count);
+		for (int stage = 0; stage < iproto_latency_stage_MAX; stage++) {
+			latency_reset(&sum);
+			for (int i = 0; i < iproto_threads_count; i++) {
+				latency_merge(&sum, &iproto_threads[i].
+					      latency[type][stage]);
+			}
+			info_table_begin(h, iproto_latency_stage_strs[stage]);
+			info_append_double(h, "p50", latency_get(&sum, 50));
+			info_append_double(h, "p90", latency_get(&sum, 90));
+			info_append_double(h, "p99", latency_get(&sum, 99));
+			info_append_double(h, "p999", latency_get(&sum, 99.9));
+			info_table_end(h);
+		}
+		info_table_end(h);
+	}
+	info_end(h);
+	latency_destroy(&sum);
+	return 0;
 }
 
 void
@@ -2328,22 +4230,52 @@ iproto_set_msg_max(int new_iproto_msg_max)
 				     IPROTO_MSG_MAX_MIN));
 	}
 	struct iproto_cfg_msg cfg_msg;
-	iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_MSG_MAX);
-	cfg_msg.iproto_msg_max = new_iproto_msg_max;
-	iproto_do_cfg(&cfg_msg);
-	cpipe_set_max_input(&net_pipe, new_iproto_msg_max / 2);
+	int old_iproto_msg_max = pm_atomic_load(&iproto_msg_max);
+	pm_atomic_store(&iproto_msg_max, new_iproto_msg_max);
+	for (int i = 0; i < iproto_threads_count; i++) {
+		iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_MSG_MAX);
+		cfg_msg.iproto_msg_max = new_iproto_msg_max;
+		cfg_msg.old_iproto_msg_max = old_iproto_msg_max;
+		iproto_do_cfg(&iproto_threads[i], &cfg_msg);
+		cpipe_set_max_input(&iproto_threads[i].net_pipe,
+				    new_iproto_msg_max / 2);
+	}
+}
+
+void
+iproto_set_queue_delay_max(double delay)
+{
+	/*
+	 * Read by the network threads without locks: a stale
+	 * value only delays the new limit for a few requests.
+	 */
+	iproto_queue_delay_max = delay;
+}
+
+void
+iproto_set_adaptive(bool is_adaptive)
+{
+	/*
+	 * Read by the network threads without locks. The new
+	 * readahead is applied to a connection when it reads
+	 * input next time.
+	 */
+	iproto_adaptive = is_adaptive;
 }
 
 void
 iproto_free(void)
 {
-	tt_pthread_cancel(net_cord.id);
-	tt_pthread_join(net_cord.id, NULL);
+	for (int i = 0; i < iproto_threads_count; i++) {
+		tt_pthread_cancel(iproto_threads[i].net_cord.id);
+		tt_pthread_join(iproto_threads[i].net_cord.id, NULL);
+	}
 	/*
 	* Close socket descriptor to prevent hot standby instance
 	* failing to bind in case it tries to bind before socket
 	* is closed by OS.
 	*/
-	if (evio_service_is_active(&binary))
-		close(binary.ev.fd);
+	if (iproto_threads_count > 0 &&
+	    evio_service_is_active(&iproto_threads[0].binary))
+		close(iproto_threads[0].binary.ev.fd);
 }
@@ -31,7 +31,11 @@
  * SUCH DAMAGE.
  */
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
+
+#include "rmean.h"
 
 #if defined(__cplusplus)
 extern "C" {
@@ -52,10 +56,15 @@ enum {
 	 * processing stops until some new fibers are freed up.
 	 */
 	IPROTO_FIBER_POOL_SIZE_FACTOR = 5,
+	/** The maximal number of network threads. */
+	IPROTO_THREADS_MAX = 1000,
 };
 
 extern unsigned iproto_readahead;
 
+/** Number of network threads, set on box.cfg() by iproto_init(). */
+extern int iproto_threads_count;
+
 /**
  * Return size of memory used for storing network buffers.
  */
@@ -68,18 +77,103 @@ iproto_mem_used(void);
 size_t
 iproto_connection_count(void);
 
+/**
+ * Return the number of active connections served by
+ * the network thread @a thread_id.
+ */
+size_t
+iproto_thread_connection_count(int thread_id);
+
 /**
  * Return the number of iproto requests in flight.
  */
 size_t
 iproto_request_count(void);
 
+/**
+ * Return the number of iproto requests in flight received
+ * by the network thread @a thread_id.
+ */
+size_t
+iproto_thread_request_count(int thread_id);
+
+/** Request queue of a binary protocol connection. */
+struct iproto_queue_stat {
+	/** Number of requests being processed by tx thread. */
+	int inflight;
+	/** Size of the input not sent to tx thread yet. */
+	size_t pending;
+	/** Size of a new input buffer of the connection. */
+	size_t readahead;
+};
+
+struct session;
+
+/**
+ * Get request queue statistics of the connection of @a session.
+ * The values are read from the network thread without locks,
+ * so they are approximate.
+ * @retval  0 Success.
+ * @retval -1 The session is not a binary protocol one.
+ */
+int
+iproto_session_queue_stat(struct session *session,
+			  struct iproto_queue_stat *stat);
+
+/**
+ * Limits chosen by the adaptive network controller, or the
+ * configured ones if it is off. See box.cfg.iproto_adaptive.
+ */
+struct iproto_tune_stat {
+	/** Limit of requests in flight. */
+	size_t msg_max;
+	/** Sum of readahead of the connections. */
+	size_t readahead;
+};
+
+/**
+ * Get the limits of all network threads summed up. The values
+ * are read without locks, so they are approximate.
+ */
+void
+iproto_tune_stat(struct iproto_tune_stat *stat);
+
+/** Get the limits of the network thread @a thread_id. */
+void
+iproto_thread_tune_stat(int thread_id, struct iproto_tune_stat *stat);
+
+/**
+ * Invoke @a cb for every network statistics counter summed
+ * up over all network threads.
+ */
+int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx);
+
+/**
+ * Invoke @a cb for every network statistics counter of the
+ * network thread @a thread_id.
+ */
+int
+iproto_thread_rmean_foreach(int thread_id, rmean_cb cb, void *cb_ctx);
+
 /**
  * Reset network statistics.
  */
 void
 iproto_reset_stat(void);
 
+struct info_handler;
+
+/**
+ * Dump latency percentiles of the requests served by all
+ * network threads, per request type and processing stage,
+ * to an info handler.
+ * @retval  0 Success.
+ * @retval -1 Memory error.
+ */
+int
+iproto_latency_stat(struct info_handler *h);
+
 /**
  * String representation of the address served by
  * iproto. To be shown in box.info.
@@ -87,11 +181,28 @@ iproto_reset_stat(void);
 const char *
 iproto_bound_address(void);
 
+/**
+ * Check if @a uri is a "shm/:<path>" URI. Clients connected
+ * to it exchange data with the server over shared memory rather
+ * than over the unix socket <path>, which is used only to set
+ * up the channel.
+ */
+static inline bool
+iproto_uri_is_shm(const char *uri)
+{
+	return strncmp(uri, "shm/:", strlen("shm/:")) == 0;
+}
+
 #if defined(__cplusplus)
 } /* extern "C" */
 
+/**
+ * Start @a threads_count network threads. If @a use_io_uring is
+ * set, the threads do socket I/O via io_uring when the kernel
+ * supports it, and fall back to epoll otherwise.
+ */
 void
-iproto_init(void);
+iproto_init(int threads_count, bool use_io_uring);
 
 void
 iproto_listen(const char *uri);
@@ -99,6 +210,20 @@ iproto_listen(const char *uri);
 void
 iproto_set_msg_max(int iproto_msg_max);
 
+/**
+ * Set the maximal average time requests may wait for tx thread
+ * before new requests are rejected. 0 disables the check.
+ */
+void
+iproto_set_queue_delay_max(double delay);
+
+/**
+ * Let the network threads choose readahead of connections and
+ * the limit of requests in flight from the observed load.
+ */
+void
+iproto_set_adaptive(bool is_adaptive);
+
 void
 iproto_free(void);
 
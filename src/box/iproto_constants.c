@@ -45,9 +45,12 @@ const unsigned char iproto_key_type[IPROTO_KEY_MAX] =
 		/* 0x09 */	MP_UINT,   /* IPROTO_FLAGS */
 	/* }}} */
 
+	/* {{{ header */
+		/* 0x0a */	MP_UINT,   /* IPROTO_STREAM_ID */
+		/* 0x0b */	MP_DOUBLE, /* IPROTO_TIMEOUT */
+	/* }}} */
+
 	/* {{{ unused */
-		/* 0x0a */	MP_UINT,
-		/* 0x0b */	MP_UINT,
 		/* 0x0c */	MP_UINT,
 		/* 0x0d */	MP_UINT,
 		/* 0x0e */	MP_UINT,
@@ -73,7 +76,10 @@ const unsigned char iproto_key_type[IPROTO_KEY_MAX] =
 		/* 0x1c */	MP_UINT,
 		/* 0x1d */	MP_UINT,
 		/* 0x1e */	MP_UINT,
-		/* 0x1f */	MP_UINT,
+	/* }}} */
+
+	/* {{{ body -- boolean keys */
+		/* 0x1f */	MP_BOOL, /* IPROTO_FETCH_POSITION */
 	/* }}} */
 
 	/* {{{ body -- all keys */
@@ -89,6 +95,10 @@ const unsigned char iproto_key_type[IPROTO_KEY_MAX] =
 	/* 0x29 */	MP_MAP, /* IPROTO_BALLOT */
 	/* 0x2a */	MP_MAP, /* IPROTO_TUPLE_META */
 	/* 0x2b */	MP_MAP, /* IPROTO_OPTIONS */
+	/* 0x2c */	MP_UINT,
+	/* 0x2d */	MP_UINT,
+	/* 0x2e */	MP_STR, /* IPROTO_AFTER_POSITION */
+	/* 0x2f */	MP_ARRAY, /* IPROTO_REQUESTS */
 	/* }}} */
 };
 
@@ -108,6 +118,10 @@ const char *iproto_type_strs[] =
 	"EXECUTE",
 	NULL, /* NOP */
 	"PREPARE",
+	"BEGIN",
+	"COMMIT",
+	"ROLLBACK",
+	"BATCH",
 };
 
 #define bit(c) (1ULL<<IPROTO_##c)
@@ -126,6 +140,10 @@ const uint64_t iproto_body_key_map[IPROTO_TYPE_STAT_MAX] = {
 	0,                                                     /* EXECUTE */
 	0,                                                     /* NOP */
 	0,                                                     /* PREPARE */
+	0,                                                     /* BEGIN */
+	0,                                                     /* COMMIT */
+	0,                                                     /* ROLLBACK */
+	0,                                                     /* BATCH */
 };
 #undef bit
 
@@ -140,8 +158,8 @@ const char *iproto_key_strs[IPROTO_KEY_MAX] = {
 	"group id",         /* 0x07 */
 	"tsn",              /* 0x08 */
 	"flags",            /* 0x09 */
-	NULL,               /* 0x0a */
-	NULL,               /* 0x0b */
+	"stream id",        /* 0x0a */
+	"timeout",          /* 0x0b */
 	NULL,               /* 0x0c */
 	NULL,               /* 0x0d */
 	NULL,               /* 0x0e */
@@ -161,7 +179,7 @@ const char *iproto_key_strs[IPROTO_KEY_MAX] = {
 	NULL,               /* 0x1c */
 	NULL,               /* 0x1d */
 	NULL,               /* 0x1e */
-	NULL,               /* 0x1f */
+	"fetch position",   /* 0x1f */
 	"key",              /* 0x20 */
 	"tuple",            /* 0x21 */
 	"function name",    /* 0x22 */
@@ -176,14 +194,14 @@ const char *iproto_key_strs[IPROTO_KEY_MAX] = {
 	"options",          /* 0x2b */
 	NULL,               /* 0x2c */
 	NULL,               /* 0x2d */
-	NULL,               /* 0x2e */
-	NULL,               /* 0x2f */
+	"after position",   /* 0x2e */
+	"requests",         /* 0x2f */
 	"data",             /* 0x30 */
 	"error",            /* 0x31 */
 	"metadata",         /* 0x32 */
 	"bind meta",        /* 0x33 */
 	"bind count",       /* 0x34 */
-	NULL,               /* 0x35 */
+	"position",         /* 0x35 */
 	NULL,               /* 0x36 */
 	NULL,               /* 0x37 */
 	NULL,               /* 0x38 */
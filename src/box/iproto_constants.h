@@ -46,7 +46,12 @@ enum {
 	/* Maximal length of text handshake (greeting) */
 	IPROTO_GREETING_SIZE = 128,
 	/** marker + len + prev crc32 + cur crc32 + (padding) */
-	XLOG_FIXHEADER_SIZE = 19
+	XLOG_FIXHEADER_SIZE = 19,
+	/**
+	 * Size of the header of a compressed frame: the packet
+	 * length and the uncompressed size, both as MP_UINT32.
+	 */
+	IPROTO_COMPRESS_HEADER_SIZE = 10,
 };
 
 enum {
@@ -67,6 +72,19 @@ enum iproto_key {
 	IPROTO_GROUP_ID = 0x07,
 	IPROTO_TSN = 0x08,
 	IPROTO_FLAGS = 0x09,
+	/**
+	 * Identifier of a stream the request belongs to, chosen
+	 * by the client. Requests of one stream are executed one
+	 * after another, and may form an interactive transaction.
+	 * 0 means no stream.
+	 */
+	IPROTO_STREAM_ID = 0x0a,
+	/**
+	 * Time in seconds the client waits for the reply, as
+	 * MP_DOUBLE. A request that has waited longer in the
+	 * queue is not executed.
+	 */
+	IPROTO_TIMEOUT = 0x0b,
 	/* Leave a gap for other keys in the header. */
 	IPROTO_SPACE_ID = 0x10,
 	IPROTO_INDEX_ID = 0x11,
@@ -74,6 +92,8 @@ enum iproto_key {
 	IPROTO_OFFSET = 0x13,
 	IPROTO_ITERATOR = 0x14,
 	IPROTO_INDEX_BASE = 0x15,
+	/** SELECT: return the position of the last tuple. */
+	IPROTO_FETCH_POSITION = 0x1f,
 
 	/* Leave a gap between integer values and other keys */
 	IPROTO_KEY = 0x20,
@@ -98,6 +118,13 @@ enum iproto_key {
 	IPROTO_BALLOT = 0x29,
 	IPROTO_TUPLE_META = 0x2a,
 	IPROTO_OPTIONS = 0x2b,
+	/** SELECT: resume the scan after this position. */
+	IPROTO_AFTER_POSITION = 0x2e,
+	/**
+	 * BATCH: array of DML request bodies, each with its
+	 * IPROTO_REQUEST_TYPE.
+	 */
+	IPROTO_REQUESTS = 0x2f,
 
 	/* Leave a gap between request keys and response keys */
 	IPROTO_DATA = 0x30,
@@ -112,6 +139,11 @@ enum iproto_key {
 	IPROTO_METADATA = 0x32,
 	IPROTO_BIND_METADATA = 0x33,
 	IPROTO_BIND_COUNT = 0x34,
+	/**
+	 * SELECT reply: opaque position of the last returned
+	 * tuple, see IPROTO_FETCH_POSITION.
+	 */
+	IPROTO_POSITION = 0x35,
 
 	/* Leave a gap between response keys and SQL keys. */
 	IPROTO_SQL_TEXT = 0x40,
@@ -158,7 +190,8 @@ enum iproto_ballot_key {
 			  bit(LSN) | bit(SCHEMA_VERSION))
 #define IPROTO_DML_BODY_BMAP (bit(SPACE_ID) | bit(INDEX_ID) | bit(LIMIT) |\
 			      bit(OFFSET) | bit(ITERATOR) | bit(INDEX_BASE) |\
-			      bit(KEY) | bit(TUPLE) | bit(OPS) | bit(TUPLE_META))
+			      bit(KEY) | bit(TUPLE) | bit(OPS) | bit(TUPLE_META) |\
+			      bit(FETCH_POSITION) | bit(AFTER_POSITION))
 
 static inline bool
 xrow_header_has_key(const char *pos, const char *end)
@@ -217,15 +250,23 @@ enum iproto_type {
 	IPROTO_NOP = 12,
 	/** Prepare SQL statement. */
 	IPROTO_PREPARE = 13,
+	/** Begin a transaction in a stream. */
+	IPROTO_BEGIN = 14,
+	/** Commit the transaction of a stream. */
+	IPROTO_COMMIT = 15,
+	/** Roll back the transaction of a stream. */
+	IPROTO_ROLLBACK = 16,
+	/** Execute several DML requests in one transaction. */
+	IPROTO_BATCH = 17,
 	/** The maximum typecode used for box.stat() */
 	IPROTO_TYPE_STAT_MAX,
 
 	IPROTO_RAFT = 30,
 
 	/** A confirmation message for synchronous transactions. */
-	IPROTO_CONFIRM = 40,
+	IPROTO_RAFT_CONFIRM = 40,
 	/** A rollback message for synchronous transactions. */
-	IPROTO_ROLLBACK = 41,
+	IPROTO_RAFT_ROLLBACK = 41,
 
 	/** PING request */
 	IPROTO_PING = 64,
@@ -241,6 +282,8 @@ enum iproto_type {
 	IPROTO_FETCH_SNAPSHOT = 69,
 	/** REGISTER request to leave anonymous replication. */
 	IPROTO_REGISTER = 70,
+	/** Enable compression of the responses. */
+	IPROTO_COMPRESS = 71,
 
 	/** Vinyl run info stored in .index file */
 	VY_INDEX_RUN_INFO = 100,
@@ -286,10 +329,12 @@ iproto_type_name(uint32_t type)
 		return iproto_type_strs[type];
 
 	switch (type) {
-	case IPROTO_CONFIRM:
+	case IPROTO_RAFT_CONFIRM:
 		return "CONFIRM";
-	case IPROTO_ROLLBACK:
+	case IPROTO_RAFT_ROLLBACK:
 		return "ROLLBACK";
+	case IPROTO_COMPRESS:
+		return "COMPRESS";
 	case VY_INDEX_RUN_INFO:
 		return "RUNINFO";
 	case VY_INDEX_PAGE_INFO:
@@ -339,7 +384,7 @@ dml_request_key_map(uint32_t type)
 static inline bool
 iproto_type_is_synchro_request(uint32_t type)
 {
-	return type == IPROTO_CONFIRM || type == IPROTO_ROLLBACK;
+	return type == IPROTO_RAFT_CONFIRM || type == IPROTO_RAFT_ROLLBACK;
 }
 
 static inline bool
@@ -38,6 +38,8 @@
 
 #include "box/box.h"
 #include "libeio/eio.h"
+#include "coio_task.h"
+#include "coio_file.h"
 
 extern "C" {
 	#include <lua.h>
@@ -131,6 +133,17 @@ lbox_cfg_set_snap_io_rate_limit(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_memtx_snap_write_threads(struct lua_State *L)
+{
+	try {
+		box_set_memtx_snap_write_threads();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
 static int
 lbox_cfg_set_checkpoint_count(struct lua_State *L)
 {
@@ -252,6 +265,25 @@ lbox_cfg_set_net_msg_max(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_iproto_adaptive(struct lua_State *L)
+{
+	(void) L;
+	box_set_iproto_adaptive();
+	return 0;
+}
+
+static int
+lbox_cfg_set_iproto_queue_delay_max(struct lua_State *L)
+{
+	try {
+		box_set_iproto_queue_delay_max();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
 static int
 lbox_set_prepared_stmt_cache_size(struct lua_State *L)
 {
@@ -266,6 +298,23 @@ lbox_cfg_set_worker_pool_threads(struct lua_State *L)
 	(void) L;
 	eio_set_min_parallel(cfg_geti("worker_pool_threads"));
 	eio_set_max_parallel(cfg_geti("worker_pool_threads"));
+	coio_set_thread_count(cfg_geti("worker_pool_threads"));
+	return 0;
+}
+
+static int
+lbox_cfg_set_file_io_uring(struct lua_State *L)
+{
+	(void) L;
+	coio_file_set_uring(cfg_getb("file_io_uring"));
+	return 0;
+}
+
+static int
+lbox_cfg_set_log_overflow(struct lua_State *L)
+{
+	(void) L;
+	say_set_log_overflow(say_overflow_by_name(cfg_gets("log_overflow")));
 	return 0;
 }
 
@@ -392,6 +441,8 @@ box_lua_cfg_init(struct lua_State *L)
 		{"cfg_set_listen", lbox_cfg_set_listen},
 		{"cfg_set_replication", lbox_cfg_set_replication},
 		{"cfg_set_worker_pool_threads", lbox_cfg_set_worker_pool_threads},
+		{"cfg_set_file_io_uring", lbox_cfg_set_file_io_uring},
+		{"cfg_set_log_overflow", lbox_cfg_set_log_overflow},
 		{"cfg_set_readahead", lbox_cfg_set_readahead},
 		{"cfg_set_io_collect_interval", lbox_cfg_set_io_collect_interval},
 		{"cfg_set_too_long_threshold", lbox_cfg_set_too_long_threshold},
@@ -402,6 +453,7 @@ box_lua_cfg_init(struct lua_State *L)
 		{"cfg_set_read_only", lbox_cfg_set_read_only},
 		{"cfg_set_memtx_memory", lbox_cfg_set_memtx_memory},
 		{"cfg_set_memtx_max_tuple_size", lbox_cfg_set_memtx_max_tuple_size},
+		{"cfg_set_memtx_snap_write_threads", lbox_cfg_set_memtx_snap_write_threads},
 		{"cfg_set_vinyl_memory", lbox_cfg_set_vinyl_memory},
 		{"cfg_set_vinyl_max_tuple_size", lbox_cfg_set_vinyl_max_tuple_size},
 		{"cfg_set_vinyl_cache", lbox_cfg_set_vinyl_cache},
@@ -418,6 +470,8 @@ box_lua_cfg_init(struct lua_State *L)
 		{"cfg_set_replication_skip_conflict", lbox_cfg_set_replication_skip_conflict},
 		{"cfg_set_replication_anon", lbox_cfg_set_replication_anon},
 		{"cfg_set_net_msg_max", lbox_cfg_set_net_msg_max},
+		{"cfg_set_iproto_queue_delay_max", lbox_cfg_set_iproto_queue_delay_max},
+		{"cfg_set_iproto_adaptive", lbox_cfg_set_iproto_adaptive},
 		{"cfg_set_sql_cache_size", lbox_set_prepared_stmt_cache_size},
 		{"cfg_set_crash", lbox_cfg_set_crash},
 		{NULL, NULL}
@@ -45,6 +45,7 @@
 #include "box/gc.h"
 #include "box/engine.h"
 #include "box/vinyl.h"
+#include "box/memtx_engine.h"
 #include "box/sql_stmt_cache.h"
 #include "main.h"
 #include "version.h"
@@ -52,6 +53,7 @@
 #include "box/raft.h"
 #include "lua/utils.h"
 #include "fiber.h"
+#include "affinity.h"
 #include "tt_static.h"
 
 static void
@@ -594,6 +596,25 @@ lbox_info_election(struct lua_State *L)
 	return 1;
 }
 
+static int
+lbox_info_affinity(struct lua_State *L)
+{
+	lua_createtable(L, 0, affinity_class_MAX + 1);
+	char cpus[256];
+	for (int cls = 0; cls < affinity_class_MAX; cls++) {
+		if (!affinity_get((enum affinity_class)cls, cpus,
+				  sizeof(cpus)))
+			continue;
+		lua_pushstring(L, cpus);
+		lua_setfield(L, -2, affinity_class_strs[cls]);
+	}
+	struct memtx_engine *memtx =
+		(struct memtx_engine *)engine_by_name("memtx");
+	lua_pushinteger(L, memtx != NULL ? memtx->numa_node : -1);
+	lua_setfield(L, -2, "memtx_numa_node");
+	return 1;
+}
+
 static const struct luaL_Reg lbox_info_dynamic_meta[] = {
 	{"id", lbox_info_id},
 	{"uuid", lbox_info_uuid},
@@ -613,6 +634,7 @@ static const struct luaL_Reg lbox_info_dynamic_meta[] = {
 	{"sql", lbox_info_sql},
 	{"listen", lbox_info_listen},
 	{"election", lbox_info_election},
+	{"affinity", lbox_info_affinity},
 	{NULL, NULL}
 };
 
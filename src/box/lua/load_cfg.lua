@@ -42,6 +42,9 @@ local default_cfg = {
     strip_core          = true,
     memtx_min_tuple_size = 16,
     memtx_max_tuple_size = 1024 * 1024,
+    memtx_huge_pages    = 'off',
+    memtx_snap_read_threads = 1,
+    memtx_snap_write_threads = 1,
     slab_alloc_factor   = 1.05,
     work_dir            = nil,
     memtx_dir           = ".",
@@ -62,7 +65,10 @@ local default_cfg = {
 
     -- logging options are covered by
     -- a separate log module; they are
-    -- 'log_' prefixed
+    -- 'log_' prefixed, except for the
+    -- logger thread ones
+    log_async           = false,
+    log_overflow        = 'block',
 
     io_collect_interval = nil,
     readahead           = 16320,
@@ -87,6 +93,7 @@ local default_cfg = {
     checkpoint_wal_threshold = 1e18,
     checkpoint_count    = 2,
     worker_pool_threads = 4,
+    file_io_uring       = true,
     election_mode       = 'off',
     election_timeout    = 5,
     replication_timeout = 1,
@@ -104,6 +111,10 @@ local default_cfg = {
     feedback_interval     = 3600,
     net_msg_max           = 768,
     sql_cache_size        = 5 * 1024 * 1024,
+    iproto_threads        = 1,
+    iproto_io_uring       = false,
+    iproto_queue_delay_max = 0,
+    iproto_adaptive       = false,
 }
 
 -- cfg variables which are covered by modules
@@ -123,6 +134,10 @@ local template_cfg = {
     strip_core          = 'boolean',
     memtx_min_tuple_size  = 'number',
     memtx_max_tuple_size  = 'number',
+    memtx_numa_node       = 'number',
+    memtx_huge_pages      = 'string',
+    memtx_snap_read_threads = 'number',
+    memtx_snap_write_threads = 'number',
     slab_alloc_factor   = 'number',
     work_dir            = 'string',
     memtx_dir            = 'string',
@@ -144,6 +159,8 @@ local template_cfg = {
     log_nonblock        = 'module',
     log_level           = 'module',
     log_format          = 'module',
+    log_async           = 'boolean',
+    log_overflow        = 'string',
 
     io_collect_interval = 'number',
     readahead           = 'number',
@@ -168,6 +185,7 @@ local template_cfg = {
     hot_standby         = 'boolean',
     memtx_use_mvcc_engine = 'boolean',
     worker_pool_threads = 'number',
+    file_io_uring       = 'boolean',
     election_mode       = 'string',
     election_timeout    = 'number',
     replication_timeout = 'number',
@@ -185,6 +203,16 @@ local template_cfg = {
     feedback_interval     = ifdef_feedback('number'),
     net_msg_max           = 'number',
     sql_cache_size        = 'number',
+    iproto_threads        = 'number',
+    iproto_io_uring       = 'boolean',
+    iproto_queue_delay_max = 'number',
+    iproto_adaptive       = 'boolean',
+    cpu_affinity_tx       = 'string, number',
+    cpu_affinity_iproto   = 'string, number',
+    cpu_affinity_wal      = 'string, number',
+    cpu_affinity_vinyl    = 'string, number',
+    cpu_affinity_relay    = 'string, number',
+    cpu_affinity_coio     = 'string, number',
 }
 
 local function normalize_uri(port)
@@ -263,6 +291,7 @@ local dynamic_cfg = {
     replication             = private.cfg_set_replication,
     log_level               = log.box_api.cfg_set_log_level,
     log_format              = log.box_api.cfg_set_log_format,
+    log_overflow            = private.cfg_set_log_overflow,
     io_collect_interval     = private.cfg_set_io_collect_interval,
     readahead               = private.cfg_set_readahead,
     too_long_threshold      = private.cfg_set_too_long_threshold,
@@ -270,6 +299,7 @@ local dynamic_cfg = {
     read_only               = private.cfg_set_read_only,
     memtx_memory            = private.cfg_set_memtx_memory,
     memtx_max_tuple_size    = private.cfg_set_memtx_max_tuple_size,
+    memtx_snap_write_threads = private.cfg_set_memtx_snap_write_threads,
     vinyl_memory            = private.cfg_set_vinyl_memory,
     vinyl_max_tuple_size    = private.cfg_set_vinyl_max_tuple_size,
     vinyl_cache             = private.cfg_set_vinyl_cache,
@@ -278,6 +308,7 @@ local dynamic_cfg = {
     checkpoint_interval     = private.cfg_set_checkpoint_interval,
     checkpoint_wal_threshold = private.cfg_set_checkpoint_wal_threshold,
     worker_pool_threads     = private.cfg_set_worker_pool_threads,
+    file_io_uring           = private.cfg_set_file_io_uring,
     feedback_enabled        = ifdef_feedback_set_params,
     feedback_crashinfo      = ifdef_feedback_set_params,
     feedback_host           = ifdef_feedback_set_params,
@@ -302,6 +333,8 @@ local dynamic_cfg = {
     instance_uuid           = check_instance_uuid,
     replicaset_uuid         = check_replicaset_uuid,
     net_msg_max             = private.cfg_set_net_msg_max,
+    iproto_queue_delay_max  = private.cfg_set_iproto_queue_delay_max,
+    iproto_adaptive         = private.cfg_set_iproto_adaptive,
     sql_cache_size          = private.cfg_set_sql_cache_size,
 }
 
@@ -381,6 +414,8 @@ local dynamic_cfg_skip_at_load = {
     instance_uuid           = true,
     replicaset_uuid         = true,
     net_msg_max             = true,
+    iproto_queue_delay_max  = true,
+    iproto_adaptive         = true,
     readahead               = true,
 }
 
@@ -48,6 +48,9 @@
 #include "box/errcode.h"
 #include "lua/fiber.h"
 #include "mpstream/mpstream.h"
+#include "fiber.h"
+#include "shm_chan.h"
+#include <zstd.h>
 #include "misc.h" /* lbox_check_tuple_format() */
 
 #define cfg luaL_msgpack_default
@@ -69,8 +72,20 @@ netbox_prepare_request(lua_State *L, struct mpstream *stream, uint32_t r_type)
 	mpstream_reserve(stream, fixheader_size);
 	mpstream_advance(stream, fixheader_size);
 
+	/*
+	 * The timeout is sent in IPROTO_TIMEOUT so that the server
+	 * does not execute the request after the client stops
+	 * waiting for it. nil or 0 if the request has no timeout.
+	 */
+	double timeout = lua_tonumber(L, 3);
+	/*
+	 * The stream of the request, sent in IPROTO_STREAM_ID.
+	 * nil or 0 if the request doesn't belong to a stream.
+	 */
+	uint64_t stream_id = lua_isnoneornil(L, 4) ? 0 : luaL_touint64(L, 4);
+
 	/* encode header */
-	mpstream_encode_map(stream, 2);
+	mpstream_encode_map(stream, 2 + (timeout > 0) + (stream_id != 0));
 
 	mpstream_encode_uint(stream, IPROTO_SYNC);
 	mpstream_encode_uint(stream, sync);
@@ -78,6 +93,16 @@ netbox_prepare_request(lua_State *L, struct mpstream *stream, uint32_t r_type)
 	mpstream_encode_uint(stream, IPROTO_REQUEST_TYPE);
 	mpstream_encode_uint(stream, r_type);
 
+	if (timeout > 0) {
+		mpstream_encode_uint(stream, IPROTO_TIMEOUT);
+		mpstream_encode_double(stream, timeout);
+	}
+
+	if (stream_id != 0) {
+		mpstream_encode_uint(stream, IPROTO_STREAM_ID);
+		mpstream_encode_uint(stream, stream_id);
+	}
+
 	/* Caller should remember how many bytes was used in ibuf */
 	return used;
 }
@@ -111,8 +136,9 @@ netbox_encode_request(struct mpstream *stream, size_t initial_size)
 static int
 netbox_encode_ping(lua_State *L)
 {
-	if (lua_gettop(L) < 2)
-		return luaL_error(L, "Usage: netbox.encode_ping(ibuf, sync)");
+	if (lua_gettop(L) < 4)
+		return luaL_error(L, "Usage: netbox.encode_ping(ibuf, sync, "
+				     "timeout, stream_id)");
 
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_PING);
@@ -120,23 +146,71 @@ netbox_encode_ping(lua_State *L)
 	return 0;
 }
 
+static int
+netbox_encode_compress(lua_State *L)
+{
+	if (lua_gettop(L) < 4) {
+		return luaL_error(L, "Usage: netbox.encode_compress(ibuf, "
+				     "sync, timeout, stream_id)");
+	}
+
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, IPROTO_COMPRESS);
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
+static inline int
+netbox_encode_txn(lua_State *L, enum iproto_type type, const char *name)
+{
+	if (lua_gettop(L) < 4) {
+		return luaL_error(L, "Usage: netbox.encode_%s(ibuf, sync, "
+				     "timeout, stream_id)",
+				  name);
+	}
+
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, type);
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
+static int
+netbox_encode_begin(lua_State *L)
+{
+	return netbox_encode_txn(L, IPROTO_BEGIN, "begin");
+}
+
+static int
+netbox_encode_commit(lua_State *L)
+{
+	return netbox_encode_txn(L, IPROTO_COMMIT, "commit");
+}
+
+static int
+netbox_encode_rollback(lua_State *L)
+{
+	return netbox_encode_txn(L, IPROTO_ROLLBACK, "rollback");
+}
+
 static int
 netbox_encode_auth(lua_State *L)
 {
-	if (lua_gettop(L) < 5) {
+	if (lua_gettop(L) < 7) {
 		return luaL_error(L, "Usage: netbox.encode_update(ibuf, sync, "
-				     "user, password, greeting)");
+				     "timeout, stream_id, user, password, "
+				     "greeting)");
 	}
 
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_AUTH);
 
 	size_t user_len;
-	const char *user = lua_tolstring(L, 3, &user_len);
+	const char *user = lua_tolstring(L, 5, &user_len);
 	size_t password_len;
-	const char *password = lua_tolstring(L, 4, &password_len);
+	const char *password = lua_tolstring(L, 6, &password_len);
 	size_t salt_len;
-	const char *salt = lua_tolstring(L, 5, &salt_len);
+	const char *salt = lua_tolstring(L, 7, &salt_len);
 	if (salt_len < SCRAMBLE_SIZE)
 		return luaL_error(L, "Invalid salt");
 
@@ -160,9 +234,10 @@ netbox_encode_auth(lua_State *L)
 static int
 netbox_encode_call_impl(lua_State *L, enum iproto_type type)
 {
-	if (lua_gettop(L) < 4) {
+	if (lua_gettop(L) < 6) {
 		return luaL_error(L, "Usage: netbox.encode_call(ibuf, sync, "
-				     "function_name, args)");
+				     "timeout, stream_id, function_name, "
+				     "args)");
 	}
 
 	struct mpstream stream;
@@ -172,13 +247,13 @@ netbox_encode_call_impl(lua_State *L, enum iproto_type type)
 
 	/* encode proc name */
 	size_t name_len;
-	const char *name = lua_tolstring(L, 3, &name_len);
+	const char *name = lua_tolstring(L, 5, &name_len);
 	mpstream_encode_uint(&stream, IPROTO_FUNCTION_NAME);
 	mpstream_encode_strn(&stream, name, name_len);
 
 	/* encode args */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 6);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -199,9 +274,9 @@ netbox_encode_call(lua_State *L)
 static int
 netbox_encode_eval(lua_State *L)
 {
-	if (lua_gettop(L) < 4) {
+	if (lua_gettop(L) < 6) {
 		return luaL_error(L, "Usage: netbox.encode_eval(ibuf, sync, "
-				     "expr, args)");
+				     "timeout, stream_id, expr, args)");
 	}
 
 	struct mpstream stream;
@@ -211,13 +286,13 @@ netbox_encode_eval(lua_State *L)
 
 	/* encode expr */
 	size_t expr_len;
-	const char *expr = lua_tolstring(L, 3, &expr_len);
+	const char *expr = lua_tolstring(L, 5, &expr_len);
 	mpstream_encode_uint(&stream, IPROTO_EXPR);
 	mpstream_encode_strn(&stream, expr, expr_len);
 
 	/* encode args */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 6);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -226,22 +301,28 @@ netbox_encode_eval(lua_State *L)
 static int
 netbox_encode_select(lua_State *L)
 {
-	if (lua_gettop(L) < 8) {
+	if (lua_gettop(L) < 10) {
 		return luaL_error(L, "Usage netbox.encode_select(ibuf, sync, "
-				     "space_id, index_id, iterator, offset, "
-				     "limit, key)");
+				     "timeout, stream_id, space_id, index_id, "
+				     "iterator, offset, limit, key[, "
+				     "fetch_position[, after]])");
 	}
 
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_SELECT);
 
-	mpstream_encode_map(&stream, 6);
+	bool fetch_position = lua_toboolean(L, 11);
+	size_t after_len = 0;
+	const char *after = NULL;
+	if (lua_type(L, 12) == LUA_TSTRING)
+		after = lua_tolstring(L, 12, &after_len);
+	mpstream_encode_map(&stream, 6 + fetch_position + (after != NULL));
 
-	uint32_t space_id = lua_tonumber(L, 3);
-	uint32_t index_id = lua_tonumber(L, 4);
-	int iterator = lua_tointeger(L, 5);
-	uint32_t offset = lua_tonumber(L, 6);
-	uint32_t limit = lua_tonumber(L, 7);
+	uint32_t space_id = lua_tonumber(L, 5);
+	uint32_t index_id = lua_tonumber(L, 6);
+	int iterator = lua_tointeger(L, 7);
+	uint32_t offset = lua_tonumber(L, 8);
+	uint32_t limit = lua_tonumber(L, 9);
 
 	/* encode space_id */
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
@@ -265,7 +346,17 @@ netbox_encode_select(lua_State *L)
 
 	/* encode key */
 	mpstream_encode_uint(&stream, IPROTO_KEY);
-	luamp_convert_key(L, cfg, &stream, 8);
+	luamp_convert_key(L, cfg, &stream, 10);
+
+	/* encode position options */
+	if (fetch_position) {
+		mpstream_encode_uint(&stream, IPROTO_FETCH_POSITION);
+		mpstream_encode_bool(&stream, true);
+	}
+	if (after != NULL) {
+		mpstream_encode_uint(&stream, IPROTO_AFTER_POSITION);
+		mpstream_encode_strn(&stream, after, after_len);
+	}
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -274,9 +365,9 @@ netbox_encode_select(lua_State *L)
 static inline int
 netbox_encode_insert_or_replace(lua_State *L, uint32_t reqtype)
 {
-	if (lua_gettop(L) < 4) {
+	if (lua_gettop(L) < 6) {
 		return luaL_error(L, "Usage: netbox.encode_insert(ibuf, sync, "
-				     "space_id, tuple)");
+				     "timeout, stream_id, space_id, tuple)");
 	}
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, reqtype);
@@ -284,13 +375,13 @@ netbox_encode_insert_or_replace(lua_State *L, uint32_t reqtype)
 	mpstream_encode_map(&stream, 2);
 
 	/* encode space_id */
-	uint32_t space_id = lua_tonumber(L, 3);
+	uint32_t space_id = lua_tonumber(L, 5);
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
 	mpstream_encode_uint(&stream, space_id);
 
 	/* encode args */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 6);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -311,9 +402,10 @@ netbox_encode_replace(lua_State *L)
 static int
 netbox_encode_delete(lua_State *L)
 {
-	if (lua_gettop(L) < 5) {
+	if (lua_gettop(L) < 7) {
 		return luaL_error(L, "Usage: netbox.encode_delete(ibuf, sync, "
-				     "space_id, index_id, key)");
+				     "timeout, stream_id, space_id, index_id, "
+				     "key)");
 	}
 
 	struct mpstream stream;
@@ -322,18 +414,18 @@ netbox_encode_delete(lua_State *L)
 	mpstream_encode_map(&stream, 3);
 
 	/* encode space_id */
-	uint32_t space_id = lua_tonumber(L, 3);
+	uint32_t space_id = lua_tonumber(L, 5);
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
 	mpstream_encode_uint(&stream, space_id);
 
 	/* encode space_id */
-	uint32_t index_id = lua_tonumber(L, 4);
+	uint32_t index_id = lua_tonumber(L, 6);
 	mpstream_encode_uint(&stream, IPROTO_INDEX_ID);
 	mpstream_encode_uint(&stream, index_id);
 
 	/* encode key */
 	mpstream_encode_uint(&stream, IPROTO_KEY);
-	luamp_convert_key(L, cfg, &stream, 5);
+	luamp_convert_key(L, cfg, &stream, 7);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -342,9 +434,10 @@ netbox_encode_delete(lua_State *L)
 static int
 netbox_encode_update(lua_State *L)
 {
-	if (lua_gettop(L) < 6) {
+	if (lua_gettop(L) < 8) {
 		return luaL_error(L, "Usage: netbox.encode_update(ibuf, sync, "
-				     "space_id, index_id, key, ops)");
+				     "timeout, stream_id, space_id, index_id, "
+				     "key, ops)");
 	}
 
 	struct mpstream stream;
@@ -353,12 +446,12 @@ netbox_encode_update(lua_State *L)
 	mpstream_encode_map(&stream, 5);
 
 	/* encode space_id */
-	uint32_t space_id = lua_tonumber(L, 3);
+	uint32_t space_id = lua_tonumber(L, 5);
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
 	mpstream_encode_uint(&stream, space_id);
 
 	/* encode index_id */
-	uint32_t index_id = lua_tonumber(L, 4);
+	uint32_t index_id = lua_tonumber(L, 6);
 	mpstream_encode_uint(&stream, IPROTO_INDEX_ID);
 	mpstream_encode_uint(&stream, index_id);
 
@@ -369,12 +462,12 @@ netbox_encode_update(lua_State *L)
 	/* encode in reverse order for speedup - see luamp_encode() code */
 	/* encode ops */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 6);
+	luamp_encode_tuple(L, cfg, &stream, 8);
 	lua_pop(L, 1); /* ops */
 
 	/* encode key */
 	mpstream_encode_uint(&stream, IPROTO_KEY);
-	luamp_convert_key(L, cfg, &stream, 5);
+	luamp_convert_key(L, cfg, &stream, 7);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -383,9 +476,10 @@ netbox_encode_update(lua_State *L)
 static int
 netbox_encode_upsert(lua_State *L)
 {
-	if (lua_gettop(L) != 5) {
+	if (lua_gettop(L) != 7) {
 		return luaL_error(L, "Usage: netbox.encode_upsert(ibuf, sync, "
-				     "space_id, tuple, ops)");
+				     "timeout, stream_id, space_id, tuple, "
+				     "ops)");
 	}
 
 	struct mpstream stream;
@@ -394,7 +488,7 @@ netbox_encode_upsert(lua_State *L)
 	mpstream_encode_map(&stream, 4);
 
 	/* encode space_id */
-	uint32_t space_id = lua_tonumber(L, 3);
+	uint32_t space_id = lua_tonumber(L, 5);
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
 	mpstream_encode_uint(&stream, space_id);
 
@@ -405,17 +499,178 @@ netbox_encode_upsert(lua_State *L)
 	/* encode in reverse order for speedup - see luamp_encode() code */
 	/* encode ops */
 	mpstream_encode_uint(&stream, IPROTO_OPS);
-	luamp_encode_tuple(L, cfg, &stream, 5);
+	luamp_encode_tuple(L, cfg, &stream, 7);
 	lua_pop(L, 1); /* ops */
 
 	/* encode tuple */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 6);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
 }
 
+/**
+ * Encode a BATCH request. Each element of @a ops is an array
+ * {type, space_id, index_id, a, b}, where a and b are the tuple,
+ * the key or the operations depending on the request type, in
+ * the same order as they are passed to the encoders above.
+ */
+static int
+netbox_encode_batch(lua_State *L)
+{
+	if (lua_gettop(L) != 5 || !lua_istable(L, 5)) {
+		return luaL_error(L, "Usage: netbox.encode_batch(ibuf, sync, "
+				     "timeout, stream_id, ops)");
+	}
+
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, IPROTO_BATCH);
+
+	mpstream_encode_map(&stream, 1);
+	mpstream_encode_uint(&stream, IPROTO_REQUESTS);
+	uint32_t count = lua_objlen(L, 5);
+	mpstream_encode_array(&stream, count);
+	for (uint32_t i = 1; i <= count; i++) {
+		lua_rawgeti(L, 5, i);
+		int op = lua_gettop(L);
+		for (int j = 1; j <= 5; j++)
+			lua_rawgeti(L, op, j);
+		uint32_t type = lua_tonumber(L, op + 1);
+		uint32_t space_id = lua_tonumber(L, op + 2);
+		uint32_t index_id = lua_tonumber(L, op + 3);
+		switch (type) {
+		case IPROTO_INSERT:
+		case IPROTO_REPLACE:
+			mpstream_encode_map(&stream, 3);
+			break;
+		case IPROTO_DELETE:
+			mpstream_encode_map(&stream, 4);
+			break;
+		case IPROTO_UPSERT:
+			mpstream_encode_map(&stream, 5);
+			break;
+		case IPROTO_UPDATE:
+			mpstream_encode_map(&stream, 6);
+			break;
+		default:
+			return luaL_error(L, "netbox.encode_batch: unsupported "
+					     "request type %d", (int) type);
+		}
+		mpstream_encode_uint(&stream, IPROTO_REQUEST_TYPE);
+		mpstream_encode_uint(&stream, type);
+		mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
+		mpstream_encode_uint(&stream, space_id);
+		switch (type) {
+		case IPROTO_INSERT:
+		case IPROTO_REPLACE:
+			mpstream_encode_uint(&stream, IPROTO_TUPLE);
+			luamp_encode_tuple(L, cfg, &stream, op + 4);
+			break;
+		case IPROTO_DELETE:
+			mpstream_encode_uint(&stream, IPROTO_INDEX_ID);
+			mpstream_encode_uint(&stream, index_id);
+			mpstream_encode_uint(&stream, IPROTO_KEY);
+			luamp_convert_key(L, cfg, &stream, op + 4);
+			break;
+		case IPROTO_UPSERT:
+			mpstream_encode_uint(&stream, IPROTO_INDEX_BASE);
+			mpstream_encode_uint(&stream, 1);
+			mpstream_encode_uint(&stream, IPROTO_TUPLE);
+			luamp_encode_tuple(L, cfg, &stream, op + 4);
+			mpstream_encode_uint(&stream, IPROTO_OPS);
+			luamp_encode_tuple(L, cfg, &stream, op + 5);
+			break;
+		case IPROTO_UPDATE:
+			mpstream_encode_uint(&stream, IPROTO_INDEX_ID);
+			mpstream_encode_uint(&stream, index_id);
+			mpstream_encode_uint(&stream, IPROTO_INDEX_BASE);
+			mpstream_encode_uint(&stream, 1);
+			mpstream_encode_uint(&stream, IPROTO_KEY);
+			luamp_convert_key(L, cfg, &stream, op + 4);
+			mpstream_encode_uint(&stream, IPROTO_TUPLE);
+			luamp_encode_tuple(L, cfg, &stream, op + 5);
+			break;
+		}
+		lua_settop(L, op - 1);
+	}
+
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
+static const char *netbox_shm_uname = "net.box.shm";
+
+/** Shared memory channel of a connection. */
+struct netbox_shm {
+	struct shm_chan chan;
+	/**
+	 * The socket the channel is set up over. The server
+	 * doesn't ring the doorbell if it dies, so the socket is
+	 * checked for EOF when the channel is idle.
+	 */
+	int fd;
+};
+
+enum {
+	/** How often to check an idle channel for EOF, seconds. */
+	NETBOX_SHM_CHECK_PERIOD = 1,
+};
+
+/**
+ * Return the shared memory channel of a connection passed to
+ * net.box functions instead of a socket file descriptor. NULL
+ * if the argument is not a channel.
+ */
+static inline struct netbox_shm **
+netbox_check_shm(struct lua_State *L, int idx)
+{
+	return (struct netbox_shm **)luaL_testudata(L, idx, netbox_shm_uname);
+}
+
+/**
+ * Set up a shared memory channel over a connected unix socket.
+ * The server sends the channel right after accept, the caller
+ * waits until the socket is readable.
+ * Return the channel or nil and an error message.
+ */
+static int
+netbox_shm_connect(struct lua_State *L)
+{
+	int fd = lua_tointeger(L, 1);
+	struct netbox_shm *shm = (struct netbox_shm *)malloc(sizeof(*shm));
+	if (shm == NULL)
+		return luaL_error(L, "out of memory");
+	if (shm_chan_connect(&shm->chan, fd) != 0) {
+		free(shm);
+		lua_pushnil(L);
+		lua_pushstring(L, strerror(errno));
+		return 2;
+	}
+	shm->fd = fd;
+	struct netbox_shm **ptr =
+		(struct netbox_shm **)lua_newuserdata(L, sizeof(*ptr));
+	*ptr = shm;
+	luaL_getmetatable(L, netbox_shm_uname);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+static int
+netbox_shm_close(struct lua_State *L)
+{
+	struct netbox_shm **ptr = netbox_check_shm(L, 1);
+	if (ptr == NULL)
+		return luaL_error(L, "Usage: chan:close()");
+	if (*ptr != NULL) {
+		/* The socket is owned and closed by Lua. */
+		shm_chan_close(&(*ptr)->chan);
+		free(*ptr);
+		*ptr = NULL;
+	}
+	return 0;
+}
+
 static int
 netbox_decode_greeting(lua_State *L)
 {
@@ -467,7 +722,21 @@ netbox_decode_greeting(lua_State *L)
 static int
 netbox_communicate(lua_State *L)
 {
-	uint32_t fd = lua_tonumber(L, 1);
+	/* A socket or a shared memory channel. */
+	uint32_t fd = 0;
+	struct shm_chan *chan = NULL;
+	struct netbox_shm **shm = netbox_check_shm(L, 1);
+	if (shm != NULL) {
+		if (*shm == NULL) {
+			lua_pushinteger(L, ER_NO_CONNECTION);
+			lua_pushstring(L, "Connection closed");
+			return 2;
+		}
+		chan = &(*shm)->chan;
+		fd = (*shm)->fd;
+	} else {
+		fd = lua_tonumber(L, 1);
+	}
 	const int NETBOX_READAHEAD = 16320;
 	struct ibuf *send_buf = (struct ibuf *) lua_topointer(L, 2);
 	struct ibuf *recv_buf = (struct ibuf *) lua_topointer(L, 3);
@@ -515,8 +784,11 @@ check_limit:
 			void *p = ibuf_reserve(recv_buf, NETBOX_READAHEAD);
 			if (p == NULL)
 				luaL_error(L, "out of memory");
-			ssize_t rc = recv(
-				fd, recv_buf->wpos, ibuf_unused(recv_buf), 0);
+			ssize_t rc = chan != NULL ?
+				shm_chan_read(chan, recv_buf->wpos,
+					      ibuf_unused(recv_buf)) :
+				recv(fd, recv_buf->wpos,
+				     ibuf_unused(recv_buf), 0);
 			if (rc == 0) {
 				lua_pushinteger(L, ER_NO_CONNECTION);
 				lua_pushstring(L, "Peer closed");
@@ -531,8 +803,12 @@ check_limit:
 		}
 
 		while ((revents & COIO_WRITE) && ibuf_used(send_buf) != 0) {
-			ssize_t rc = send(
-				fd, send_buf->rpos, ibuf_used(send_buf), 0);
+			struct iovec iov = {
+				send_buf->rpos, ibuf_used(send_buf)
+			};
+			ssize_t rc = chan != NULL ?
+				shm_chan_writev(chan, &iov, 1) :
+				send(fd, iov.iov_base, iov.iov_len, 0);
 			if (rc >= 0)
 				send_buf->rpos += rc;
 			else if (errno == EAGAIN || errno == EWOULDBLOCK)
@@ -542,8 +818,33 @@ check_limit:
 		}
 
 		ev_tstamp deadline = ev_monotonic_now(loop()) + timeout;
-		revents = coio_wait(fd, EV_READ | (ibuf_used(send_buf) != 0 ?
-				EV_WRITE : 0), timeout);
+		if (chan != NULL) {
+			/*
+			 * The client has one doorbell, rung by the
+			 * server both on new data and on free space.
+			 */
+			int events = SHM_CHAN_READ |
+				(ibuf_used(send_buf) != 0 ? SHM_CHAN_WRITE : 0);
+			int bell = shm_chan_fd(chan, SHM_CHAN_READ);
+			ev_tstamp wait = MIN(timeout, NETBOX_SHM_CHECK_PERIOD);
+			revents = COIO_READ | COIO_WRITE;
+			if (shm_chan_prepare_wait(chan, events) == 0 &&
+			    coio_wait(bell, EV_READ, wait) == 0) {
+				revents = 0;
+				char c;
+				ssize_t rc = recv(fd, &c, 1,
+						  MSG_PEEK | MSG_DONTWAIT);
+				if (rc == 0) {
+					lua_pushinteger(L, ER_NO_CONNECTION);
+					lua_pushstring(L, "Peer closed");
+					return 2;
+				}
+			}
+		} else {
+			revents = coio_wait(fd, EV_READ |
+					    (ibuf_used(send_buf) != 0 ?
+					     EV_WRITE : 0), timeout);
+		}
 		luaL_testcancel(L);
 		timeout = deadline - ev_monotonic_now(loop());
 		timeout = MAX(0.0, timeout);
@@ -559,33 +860,105 @@ handle_error:
 	return 2;
 }
 
+/** Return ER_DECOMPRESSION and @a msg from netbox_decompress(). */
+static int
+netbox_decompress_error(lua_State *L, const char *msg)
+{
+	lua_pushinteger(L, ER_DECOMPRESSION);
+	lua_pushstring(L, msg);
+	return 2;
+}
+
+/**
+ * Replace a compressed frame received at the read position of
+ * the buffer with the replies it is compressed from. The whole
+ * frame must be in the buffer. Returns nothing on success, an
+ * error code and a message on failure.
+ */
+static int
+netbox_decompress(lua_State *L)
+{
+	struct ibuf *recv_buf = (struct ibuf *) lua_topointer(L, 1);
+	static ZSTD_DCtx *zdctx = NULL;
+	if (zdctx == NULL) {
+		zdctx = ZSTD_createDCtx();
+		if (zdctx == NULL)
+			return luaL_error(L, "out of memory");
+	}
+	/*
+	 * See iproto_compress() for the frame format. The frame
+	 * comes from the network, so every field is checked.
+	 */
+	const char *data = recv_buf->rpos;
+	if (ibuf_used(recv_buf) < IPROTO_COMPRESS_HEADER_SIZE ||
+	    (uint8_t) data[0] != 0xce || (uint8_t) data[5] != 0xce)
+		return netbox_decompress_error(L, "invalid frame header");
+	data++;
+	size_t frame_size = (size_t) mp_load_u32(&data) + 5;
+	data++;
+	size_t size = mp_load_u32(&data);
+	if (frame_size < IPROTO_COMPRESS_HEADER_SIZE ||
+	    frame_size > ibuf_used(recv_buf))
+		return netbox_decompress_error(L, "invalid frame size");
+	size_t zsize = frame_size - IPROTO_COMPRESS_HEADER_SIZE;
+	if (size > IPROTO_BODY_LEN_MAX ||
+	    ZSTD_getFrameContentSize(data, zsize) != size)
+		return netbox_decompress_error(L, "invalid uncompressed size");
+
+	struct region *region = &fiber()->gc;
+	size_t used = region_used(region);
+	char *replies = (char *) region_alloc(region, size);
+	if (replies == NULL)
+		return luaL_error(L, "out of memory");
+	size_t rc = ZSTD_decompressDCtx(zdctx, replies, size, data, zsize);
+	if (ZSTD_isError(rc) || rc != size) {
+		region_truncate(region, used);
+		return netbox_decompress_error(L, ZSTD_isError(rc) ?
+					       ZSTD_getErrorName(rc) :
+					       "invalid frame size");
+	}
+	size_t tail = ibuf_used(recv_buf) - frame_size;
+	if (size > frame_size &&
+	    ibuf_reserve(recv_buf, size - frame_size) == NULL) {
+		region_truncate(region, used);
+		return luaL_error(L, "out of memory");
+	}
+	/* The rest of the input follows the replies. */
+	memmove(recv_buf->rpos + size, recv_buf->rpos + frame_size, tail);
+	memcpy(recv_buf->rpos, replies, size);
+	recv_buf->wpos = recv_buf->rpos + size + tail;
+	region_truncate(region, used);
+	return 0;
+}
+
 static int
 netbox_encode_execute(lua_State *L)
 {
-	if (lua_gettop(L) < 5)
+	if (lua_gettop(L) < 7)
 		return luaL_error(L, "Usage: netbox.encode_execute(ibuf, "\
-				  "sync, query, parameters, options)");
+				  "sync, timeout, stream_id, query, "\
+				  "parameters, options)");
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_EXECUTE);
 
 	mpstream_encode_map(&stream, 3);
 
-	if (lua_type(L, 3) == LUA_TNUMBER) {
-		uint32_t query_id = lua_tointeger(L, 3);
+	if (lua_type(L, 5) == LUA_TNUMBER) {
+		uint32_t query_id = lua_tointeger(L, 5);
 		mpstream_encode_uint(&stream, IPROTO_STMT_ID);
 		mpstream_encode_uint(&stream, query_id);
 	} else {
 		size_t len;
-		const char *query = lua_tolstring(L, 3, &len);
+		const char *query = lua_tolstring(L, 5, &len);
 		mpstream_encode_uint(&stream, IPROTO_SQL_TEXT);
 		mpstream_encode_strn(&stream, query, len);
 	}
 
 	mpstream_encode_uint(&stream, IPROTO_SQL_BIND);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 6);
 
 	mpstream_encode_uint(&stream, IPROTO_OPTIONS);
-	luamp_encode_tuple(L, cfg, &stream, 5);
+	luamp_encode_tuple(L, cfg, &stream, 7);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -594,21 +967,21 @@ netbox_encode_execute(lua_State *L)
 static int
 netbox_encode_prepare(lua_State *L)
 {
-	if (lua_gettop(L) < 3)
+	if (lua_gettop(L) < 5)
 		return luaL_error(L, "Usage: netbox.encode_prepare(ibuf, "\
-				     "sync, query)");
+				     "sync, timeout, stream_id, query)");
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_PREPARE);
 
 	mpstream_encode_map(&stream, 1);
 
-	if (lua_type(L, 3) == LUA_TNUMBER) {
-		uint32_t query_id = lua_tointeger(L, 3);
+	if (lua_type(L, 5) == LUA_TNUMBER) {
+		uint32_t query_id = lua_tointeger(L, 5);
 		mpstream_encode_uint(&stream, IPROTO_STMT_ID);
 		mpstream_encode_uint(&stream, query_id);
 	} else {
 		size_t len;
-		const char *query = lua_tolstring(L, 3, &len);
+		const char *query = lua_tolstring(L, 5, &len);
 		mpstream_encode_uint(&stream, IPROTO_SQL_TEXT);
 		mpstream_encode_strn(&stream, query, len);
 	};
@@ -659,15 +1032,27 @@ netbox_decode_select(struct lua_State *L)
 	const char *data = *(const char **)luaL_checkcdata(L, 1, &ctypeid);
 	assert(mp_typeof(*data) == MP_MAP);
 	uint32_t map_size = mp_decode_map(&data);
-	/* Until 2.0 body has no keys except DATA. */
-	assert(map_size == 1);
-	(void) map_size;
+	/*
+	 * Until 2.0 body has no keys except DATA. The position
+	 * follows DATA if it is requested.
+	 */
+	assert(map_size == 1 || map_size == 2);
 	uint32_t key = mp_decode_uint(&data);
 	assert(key == IPROTO_DATA);
 	(void) key;
 	netbox_decode_data(L, &data, format);
+	const char *position = NULL;
+	uint32_t position_len = 0;
+	if (map_size == 2) {
+		key = mp_decode_uint(&data);
+		assert(key == IPROTO_POSITION);
+		position = mp_decode_str(&data, &position_len);
+	}
 	*(const char **)luaL_pushcdata(L, ctypeid) = data;
-	return 2;
+	if (position == NULL)
+		return 2;
+	lua_pushlstring(L, position, position_len);
+	return 3;
 }
 
 /** Decode optional (i.e. may be present in response) metadata fields. */
@@ -889,6 +1274,7 @@ luaopen_net_box(struct lua_State *L)
 {
 	static const luaL_Reg net_box_lib[] = {
 		{ "encode_ping",    netbox_encode_ping },
+		{ "encode_compress", netbox_encode_compress },
 		{ "encode_call_16", netbox_encode_call_16 },
 		{ "encode_call",    netbox_encode_call },
 		{ "encode_eval",    netbox_encode_eval },
@@ -900,14 +1286,26 @@ luaopen_net_box(struct lua_State *L)
 		{ "encode_upsert",  netbox_encode_upsert },
 		{ "encode_execute", netbox_encode_execute},
 		{ "encode_prepare", netbox_encode_prepare},
+		{ "encode_begin",   netbox_encode_begin },
+		{ "encode_commit",  netbox_encode_commit },
+		{ "encode_rollback", netbox_encode_rollback },
+		{ "encode_batch",   netbox_encode_batch },
 		{ "encode_auth",    netbox_encode_auth },
 		{ "decode_greeting",netbox_decode_greeting },
 		{ "communicate",    netbox_communicate },
+		{ "decompress",     netbox_decompress },
 		{ "decode_select",  netbox_decode_select },
 		{ "decode_execute", netbox_decode_execute },
 		{ "decode_prepare", netbox_decode_prepare },
+		{ "shm_connect",    netbox_shm_connect },
+		{ NULL, NULL}
+	};
+	static const luaL_Reg net_box_shm_methods[] = {
+		{ "close",          netbox_shm_close },
+		{ "__gc",           netbox_shm_close },
 		{ NULL, NULL}
 	};
+	luaL_register_type(L, netbox_shm_uname, net_box_shm_methods);
 	/* luaL_register_module polutes _G */
 	lua_newtable(L);
 	luaL_openlib(L, NULL, net_box_lib, 0);
@@ -6,11 +6,13 @@ local socket   = require('socket')
 local fiber    = require('fiber')
 local msgpack  = require('msgpack')
 local urilib   = require('uri')
+local fun      = require('fun')
 local internal = require('net.box.lib')
 local trigger  = require('internal.trigger')
 
 local band              = bit.band
 local max               = math.max
+local min               = math.min
 local fiber_clock       = fiber.clock
 local fiber_self        = fiber.self
 local decode            = msgpack.decode_unchecked
@@ -25,14 +27,18 @@ local check_primary_index = box.internal.check_primary_index
 
 local communicate     = internal.communicate
 local encode_auth     = internal.encode_auth
+local encode_compress = internal.encode_compress
+local decompress      = internal.decompress
 local encode_select   = internal.encode_select
 local decode_greeting = internal.decode_greeting
+local shm_connect     = internal.shm_connect
 
 local TIMEOUT_INFINITY = 500 * 365 * 86400
 local VSPACE_ID        = 281
 local VINDEX_ID        = 289
 local VCOLLATION_ID    = 277
 local DEFAULT_CONNECT_TIMEOUT = 10
+local DEFAULT_PAIRS_BATCH_SIZE = 1000
 
 local IPROTO_STATUS_KEY    = 0x00
 local IPROTO_ERRNO_MASK    = 0x7FFF
@@ -74,6 +80,12 @@ local function decode_tuple(raw_data, raw_data_end, format) -- luacheck: no unus
     local response, raw_end = internal.decode_select(raw_data, nil, format)
     return response[1], raw_end
 end
+-- Tuples and the position of the last one, nil if none.
+local function decode_select_position(raw_data, raw_data_end, format)
+    local tuples, real_end, position =
+        internal.decode_select(raw_data, raw_data_end, format)
+    return {tuples, position}, real_end
+end
 local function decode_get(raw_data, raw_data_end, format) -- luacheck: no unused args
     local body, raw_end = internal.decode_select(raw_data, nil, format)
     if body[2] then
@@ -85,6 +97,18 @@ local function decode_count(raw_data)
     local response, raw_end = decode(raw_data)
     return response[IPROTO_DATA_KEY][1], raw_end
 end
+-- One tuple per request of a batch, box.NULL if the request
+-- didn't return a tuple.
+local function decode_batch(raw_data)
+    local response, raw_end = decode(raw_data)
+    local result = response[IPROTO_DATA_KEY]
+    for i = 1, #result do
+        if result[i] ~= nil then
+            result[i] = box.tuple.new(result[i])
+        end
+    end
+    return result, raw_end
+end
 local function decode_push(raw_data)
     local response, raw_end = decode(raw_data)
     return response[IPROTO_DATA_KEY][1], raw_end
@@ -109,15 +133,20 @@ local method_encoder = {
     update  = internal.encode_update,
     upsert  = internal.encode_upsert,
     select  = internal.encode_select,
+    select_position = internal.encode_select,
     execute = internal.encode_execute,
     prepare = internal.encode_prepare,
     unprepare = internal.encode_prepare,
+    begin   = internal.encode_begin,
+    commit  = internal.encode_commit,
+    rollback = internal.encode_rollback,
+    batch   = internal.encode_batch,
     get     = internal.encode_select,
     min     = internal.encode_select,
     max     = internal.encode_select,
     count   = internal.encode_call,
     -- inject raw data into connection, used by console and tests
-    inject = function(buf, id, bytes) -- luacheck: no unused args
+    inject = function(buf, id, timeout, stream_id, bytes) -- luacheck: no unused args
         local ptr = buf:reserve(#bytes)
         ffi.copy(ptr, bytes, #bytes)
         buf.wpos = ptr + #bytes
@@ -135,9 +164,14 @@ local method_decoder = {
     update  = decode_tuple,
     upsert  = decode_nil,
     select  = internal.decode_select,
+    select_position = decode_select_position,
     execute = internal.decode_execute,
     prepare = internal.decode_prepare,
     unprepare = decode_nil,
+    begin   = decode_nil,
+    commit  = decode_nil,
+    rollback = decode_nil,
+    batch   = decode_batch,
     get     = decode_get,
     min     = decode_get,
     max     = decode_get,
@@ -172,17 +206,68 @@ local response_decoder = {
 
 local function next_id(id) return band(id + 1, 0x7FFFFFFF) end
 
+--
+-- Connect to a local server listening on a "shm/:<path>" URI.
+-- The server passes a shared memory channel over the unix socket
+-- <path> right after accept, and the greeting is sent over the
+-- channel.
+--
+local function establish_shm_connection(path, timeout)
+    local begin = fiber.clock()
+    local s, err = socket.tcp_connect('unix/', path, timeout)
+    if not s then
+        return nil, err
+    end
+    local chan
+    if s:readable(timeout - (fiber.clock() - begin)) then
+        chan, err = shm_connect(s:fd())
+    else
+        err = s:error() or 'Timeout exceeded'
+    end
+    if not chan then
+        s:close()
+        return nil, err
+    end
+    local send_buf = buffer.ibuf()
+    local recv_buf = buffer.ibuf()
+    local msg
+    err, msg = communicate(chan, send_buf, recv_buf, IPROTO_GREETING_SIZE,
+                           timeout - (fiber.clock() - begin))
+    if err == nil then
+        msg = ffi.string(recv_buf.rpos, IPROTO_GREETING_SIZE)
+    end
+    send_buf:recycle()
+    recv_buf:recycle()
+    local greeting
+    if err == nil then
+        greeting, err = decode_greeting(msg)
+    else
+        err = msg
+    end
+    if not greeting then
+        chan:close()
+        s:close()
+        return nil, err
+    end
+    return s, greeting, chan
+end
+
 --
 -- Connect to a remote server, do handshake.
--- @param host Hostname.
+-- @param host Hostname, 'shm/' for a shared memory connection.
 -- @param port TCP port.
 -- @param timeout Timeout to connect and receive greeting.
 --
 -- @retval nil, err Error occured. The reason is returned.
 -- @retval two non-nils A connected socket and a decoded greeting.
+-- @retval three non-nils A socket, a greeting and a shared
+--         memory channel to exchange data over.
 --
 local function establish_connection(host, port, timeout)
     local timeout = timeout or DEFAULT_CONNECT_TIMEOUT
+    if host == 'shm/' then
+        return establish_shm_connection(port, timeout)
+    end
     local begin = fiber.clock()
     local s, err = socket.tcp_connect(host, port, timeout)
     if not s then
@@ -251,6 +336,7 @@ local function on_push_sync_default() end
 --  'state_changed', state, error
 --  'handshake', greeting -> nil (accept) / errno, error (reject)
 --  'will_fetch_schema'   -> true (approve) / false (skip fetch)
+--  'will_compress'       -> true (ask for compressed responses) / false
 --  'did_fetch_schema', schema_version, spaces, indices
 --  'reconnect_timeout'   -> get reconnect timeout if set and > 0,
 --                           else nil is returned.
@@ -284,6 +370,8 @@ local function create_transport(host, port, user, password, callback,
     local next_request_id  = 1
 
     local worker_fiber
+    -- Shared memory channel of the connection, if any.
+    local chan
     local send_buf         = buffer.ibuf(buffer.READAHEAD)
     local recv_buf         = buffer.ibuf(buffer.READAHEAD)
 
@@ -484,6 +572,10 @@ local function create_transport(host, port, user, password, callback,
             if not (ok or is_final_state[state]) then
                 set_state('error', E_UNKNOWN, err)
             end
+            if chan then
+                chan:close()
+                chan = nil
+            end
             if connection then
                 connection:close()
                 connection = nil
@@ -499,7 +591,7 @@ local function create_transport(host, port, user, password, callback,
                 goto stop
             end
     ::do_connect::
-            connection, greeting =
+            connection, greeting, chan =
                 establish_connection(host, port, callback('fetch_connect_timeout'))
             if connection then
                 goto handle_connection
@@ -529,12 +621,14 @@ local function create_transport(host, port, user, password, callback,
     end
 
     --
-    -- Send a request and do not wait for response.
+    -- Send a request the server drops if it is not executed
+    -- before the timeout expires, nil for no timeout. The
+    -- request belongs to stream stream_id, nil for none.
     -- @retval nil, error Error occured.
     -- @retval not nil Future object.
     --
-    local function perform_async_request(buffer, skip_header, method, on_push,
-                                         on_push_ctx, request_ctx, ...)
+    local function send_request(timeout, buffer, skip_header, method, on_push,
+                                on_push_ctx, request_ctx, stream_id, ...)
         if state ~= 'active' and state ~= 'fetch_schema' then
             local code = last_errno or E_NO_CONNECTION
             local msg = last_error or
@@ -548,7 +642,7 @@ local function create_transport(host, port, user, password, callback,
             worker_fiber:wakeup()
         end
         local id = next_request_id
-        method_encoder[method](send_buf, id, ...)
+        method_encoder[method](send_buf, id, timeout, stream_id, ...)
         next_request_id = next_id(id)
         -- Request in most cases has maximum 10 members:
         -- method, buffer, skip_header, id, cond, errno, response,
@@ -566,16 +660,35 @@ local function create_transport(host, port, user, password, callback,
         return request
     end
 
+    --
+    -- Send a request and do not wait for response.
+    -- @retval nil, error Error occured.
+    -- @retval not nil Future object.
+    --
+    local function perform_async_request(buffer, skip_header, method, on_push,
+                                         on_push_ctx, request_ctx, stream_id,
+                                         ...)
+        return send_request(nil, buffer, skip_header, method, on_push,
+                            on_push_ctx, request_ctx, stream_id, ...)
+    end
+
     --
     -- Send a request and wait for response.
     -- @retval nil, error Error occured.
     -- @retval not nil Response object.
     --
     local function perform_request(timeout, buffer, skip_header, method,
-                                   on_push, on_push_ctx, request_ctx, ...)
+                                   on_push, on_push_ctx, request_ctx,
+                                   stream_id, ...)
+        -- Let the server drop the request if it is not
+        -- executed before the timeout expires.
+        local request_timeout
+        if timeout ~= nil and timeout > 0 and timeout < TIMEOUT_INFINITY then
+            request_timeout = timeout
+        end
         local request, err =
-            perform_async_request(buffer, skip_header, method, on_push,
-                                  on_push_ctx, request_ctx, ...)
+            send_request(request_timeout, buffer, skip_header, method,
+                         on_push, on_push_ctx, request_ctx, stream_id, ...)
         if not request then
             return nil, err
         end
@@ -681,7 +794,7 @@ local function create_transport(host, port, user, password, callback,
 
     -- IO (WORKER FIBER) --
     local function send_and_recv(limit_or_boundary, timeout)
-        return communicate(connection:fd(), send_buf, recv_buf,
+        return communicate(chan or connection:fd(), send_buf, recv_buf,
                            limit_or_boundary, timeout)
     end
 
@@ -697,6 +810,15 @@ local function create_transport(host, port, user, password, callback,
             required = (rpos - bufpos) + len
             if data_len >= required then
                 local body_end = rpos + len
+                -- A compressed frame has MP_UINT32 in place of
+                -- the header map.
+                if band(rpos[0], 0xff) == 0xce then
+                    local err, extra = decompress(recv_buf)
+                    if err then
+                        return err, extra
+                    end
+                    return send_and_recv_iproto(timeout)
+                end
                 local hdr, body_rpos = decode(rpos)
                 recv_buf.rpos = body_end
                 return nil, hdr, body_rpos, body_end
@@ -750,7 +872,7 @@ local function create_transport(host, port, user, password, callback,
             log.warn("Netbox text protocol support is deprecated since 1.10, "..
                      "please use require('console').connect() instead")
             local setup_delimiter = 'require("console").delimiter("$EOF$")\n'
-            method_encoder.inject(send_buf, nil, setup_delimiter)
+            method_encoder.inject(send_buf, nil, nil, nil, setup_delimiter)
             local err, response = send_and_recv_console()
             if err then
                 return error_sm(err, response)
@@ -761,6 +883,15 @@ local function create_transport(host, port, user, password, callback,
             set_state('active')
             return console_sm(rid)
         elseif greeting.protocol == 'Binary' then
+            if callback('will_compress') then
+                encode_compress(send_buf, new_request_id(), nil, nil)
+                local err, hdr = send_and_recv_iproto()
+                if err then
+                    return error_sm(err, hdr)
+                end
+                -- An old server replies with an error, the
+                -- connection works without compression then.
+            end
             return iproto_auth_sm(greeting.salt)
         else
             return error_sm(E_NO_CONNECTION,
@@ -791,7 +922,8 @@ local function create_transport(host, port, user, password, callback,
             set_state('fetch_schema')
             return iproto_schema_sm()
         end
-        encode_auth(send_buf, new_request_id(), user, password, salt)
+        encode_auth(send_buf, new_request_id(), nil, nil, user, password,
+                    salt)
         local err, hdr, body_rpos = send_and_recv_iproto()
         if err then
             return error_sm(err, hdr)
@@ -817,14 +949,16 @@ local function create_transport(host, port, user, password, callback,
         local select3_id
         local response = {}
         -- fetch everything from space _vspace, 2 = ITER_ALL
-        encode_select(send_buf, select1_id, VSPACE_ID, 0, 2, 0, 0xFFFFFFFF, nil)
+        encode_select(send_buf, select1_id, nil, nil, VSPACE_ID, 0, 2, 0,
+                      0xFFFFFFFF, nil)
         -- fetch everything from space _vindex, 2 = ITER_ALL
-        encode_select(send_buf, select2_id, VINDEX_ID, 0, 2, 0, 0xFFFFFFFF, nil)
+        encode_select(send_buf, select2_id, nil, nil, VINDEX_ID, 0, 2, 0,
+                      0xFFFFFFFF, nil)
         -- fetch everything from space _vcollation, 2 = ITER_ALL
         if peer_has_vcollation then
             select3_id = new_request_id()
-            encode_select(send_buf, select3_id, VCOLLATION_ID, 0, 2, 0,
-                          0xFFFFFFFF, nil)
+            encode_select(send_buf, select3_id, nil, nil, VCOLLATION_ID, 0, 2,
+                          0, 0xFFFFFFFF, nil)
         end
 
         schema_version = nil -- any schema_version will do provided that
@@ -886,6 +1020,7 @@ local function create_transport(host, port, user, password, callback,
     end
 
     error_sm = function(err, msg)
+        if chan then chan:close(); chan = nil end
         if connection then connection:close(); connection = nil end
         send_buf:recycle()
         recv_buf:recycle()
@@ -947,7 +1082,10 @@ local function parse_connect_params(host_or_uri, ...) -- self? host_or_uri port?
         opts = copy
     end
     local host = host_or_uri
-    if port == nil then
+    if port == nil and type(host) == 'string' and host:startswith('shm/:') then
+        -- Shared memory connection to a local server.
+        host, port = 'shm/', host:sub(#'shm/:' + 1)
+    elseif port == nil then
         local url = urilib.parse(tostring(host))
         if url == nil or url.service == nil then
             box.error(E_PROC_LUA,
@@ -1031,6 +1169,8 @@ local function new_sm(host, port, opts, connection, greeting)
             remote.peer_version_id = greeting.version_id
         elseif what == 'will_fetch_schema' then
             return not opts.console
+        elseif what == 'will_compress' then
+            return not opts.console and opts.compress == true
         elseif what == 'fetch_connect_timeout' then
             return opts.connect_timeout or DEFAULT_CONNECT_TIMEOUT
         elseif what == 'did_fetch_schema' then
@@ -1063,6 +1203,7 @@ local function new_sm(host, port, opts, connection, greeting)
     remote._on_disconnect = trigger.new("on_disconnect")
     remote._on_connect = trigger.new("on_connect")
     remote._is_connected = false
+    remote._last_stream_id = 0
     remote._transport = create_transport(host, port, user, password, callback,
                                          connection, greeting)
     remote._transport.start()
@@ -1171,7 +1312,7 @@ function remote_methods:_request(method, opts, request_ctx, ...)
             local res, err =
                 transport.perform_async_request(buffer, skip_header, method,
                                                 table.insert, {}, request_ctx,
-                                                ...)
+                                                self._stream_id, ...)
             if err then
                 box.error(err)
             end
@@ -1199,7 +1340,8 @@ function remote_methods:_request(method, opts, request_ctx, ...)
     end
     local res, err = transport.perform_request(timeout, buffer, skip_header,
                                                method, on_push, on_push_ctx,
-                                               request_ctx, ...)
+                                               request_ctx, self._stream_id,
+                                               ...)
     if err then
         box.error(err)
     end
@@ -1289,6 +1431,39 @@ function remote_methods:unprepare(query, parameters, sql_opts, netbox_opts)
                          sql_opts or {})
 end
 
+local batch_request_type = {
+    insert = 2, replace = 3, update = 4, delete = 5, upsert = 9,
+}
+
+--
+-- Execute several DML requests in one transaction, so that they
+-- are written to WAL at once. Each request is an array
+-- {'insert' | 'replace', space, tuple}, {'delete', space, key},
+-- {'update', space, key, ops} or {'upsert', space, tuple, ops},
+-- where space is a space name or id. Returns an array with a
+-- tuple per request, box.NULL if the request returned nothing.
+--
+function remote_methods:batch(requests, opts)
+    check_remote_arg(self, 'batch')
+    if type(requests) ~= 'table' then
+        error('Usage: conn:batch({{request, space, ...}, ...}[, opts])')
+    end
+    local encoded = {}
+    for i, request in ipairs(requests) do
+        local code = batch_request_type[request[1]]
+        if code == nil then
+            box.error(box.error.ILLEGAL_PARAMS,
+                      'unsupported batch request ' .. tostring(request[1]))
+        end
+        local space = self.space[request[2]]
+        if space == nil then
+            box.error(E_NO_SUCH_SPACE, tostring(request[2]))
+        end
+        encoded[i] = {code, space.id, 0, request[3], request[4]}
+    end
+    return self:_request('batch', opts, nil, encoded)
+end
+
 function remote_methods:wait_state(state, timeout)
     check_remote_arg(self, 'wait_state')
     if timeout == nil then
@@ -1313,6 +1488,98 @@ function remote_methods:timeout(timeout)
     return self
 end
 
+--
+-- A stream is a sequence of requests of the connection which
+-- the server executes one after another. Requests of a stream
+-- may form an interactive transaction: stream:begin(), requests
+-- to stream.space or stream:call(), and stream:commit() or
+-- stream:rollback(). All the methods of the connection, except
+-- the stream ones, are available in a stream.
+--
+local stream_methods = {}
+local stream_mt = {
+    __index = function(stream, key)
+        local method = stream_methods[key]
+        if method ~= nil then
+            return method
+        end
+        return rawget(stream, '_conn')[key]
+    end,
+    __serialize = function(stream)
+        return {stream_id = stream._stream_id}
+    end,
+    __metatable = false
+}
+
+function stream_methods:begin(opts)
+    check_remote_arg(self, 'begin')
+    self:_request('begin', opts, nil)
+end
+
+function stream_methods:commit(opts)
+    check_remote_arg(self, 'commit')
+    self:_request('commit', opts, nil)
+end
+
+function stream_methods:rollback(opts)
+    check_remote_arg(self, 'rollback')
+    self:_request('rollback', opts, nil)
+end
+
+--
+-- Copy a space of the connection with its indexes, so that
+-- requests to the copy are sent in the stream.
+--
+local function stream_wrap_space(stream, space)
+    local s = setmetatable({}, stream._space_mt)
+    for k, v in pairs(space) do
+        s[k] = v
+    end
+    s.index = {}
+    for key, index in pairs(space.index) do
+        local idx = s.index[index.id]
+        if idx == nil then
+            idx = setmetatable({}, stream._index_mt)
+            for k, v in pairs(index) do
+                idx[k] = v
+            end
+            idx.space = s
+            s.index[index.id] = idx
+        end
+        s.index[key] = idx
+    end
+    return s
+end
+
+function remote_methods:new_stream()
+    check_remote_arg(self, 'new_stream')
+    self._last_stream_id = self._last_stream_id + 1
+    local stream = setmetatable({
+        _stream_id = self._last_stream_id,
+        _conn = self,
+    }, stream_mt)
+    stream._space_mt = space_metatable(stream)
+    stream._index_mt = index_metatable(stream)
+    -- Spaces are copied on demand and dropped when the schema
+    -- of the connection is reloaded.
+    local spaces, schema = {}, nil
+    stream.space = setmetatable({}, {
+        __index = function(_, key)
+            if schema ~= self.space then
+                spaces, schema = {}, self.space
+            end
+            local space = spaces[key]
+            if space == nil and schema ~= nil and schema[key] ~= nil then
+                space = stream_wrap_space(stream, schema[key])
+                spaces[space.id] = space
+                spaces[space.name] = space
+            end
+            return space
+        end
+    })
+    return stream
+end
+
 function remote_methods:_install_schema(schema_version, spaces, indices,
                                         collations)
     local sl, space_mt, index_mt = {}, self._space_mt, self._index_mt
@@ -1441,11 +1708,11 @@ function console_methods:eval(line, timeout)
     end
     if self.protocol == 'Binary' then
         local loader = 'return require("console").eval(...)'
-        res, err = pr(timeout, nil, false, 'eval', nil, nil, nil, loader,
+        res, err = pr(timeout, nil, false, 'eval', nil, nil, nil, nil, loader,
                       {line})
     else
         assert(self.protocol == 'Lua console')
-        res, err = pr(timeout, nil, false, 'inject', nil, nil, nil,
+        res, err = pr(timeout, nil, false, 'inject', nil, nil, nil, nil,
                       line..'$EOF$\n')
     end
     if err then
@@ -1478,6 +1745,11 @@ space_metatable = function(remote)
         return check_primary_index(self):select(key, opts)
     end
 
+    function methods:pairs(key, opts)
+        check_space_arg(self, 'pairs')
+        return check_primary_index(self):pairs(key, opts)
+    end
+
     function methods:delete(key, opts)
         check_space_arg(self, 'delete')
         return check_primary_index(self):delete(key, opts)
@@ -1525,6 +1797,59 @@ index_metatable = function(remote)
                                 limit, key))
     end
 
+    --
+    -- Iterate over the index in batches of opts.batch_size
+    -- tuples. Each batch is a separate SELECT resumed after
+    -- the position of the last tuple of the previous one, so
+    -- neither side keeps the whole result set in memory.
+    -- opts.offset is applied by the first batch, opts.limit
+    -- bounds the total number of tuples.
+    --
+    function methods:pairs(key, opts)
+        check_index_arg(self, 'pairs')
+        if opts and (opts.buffer or opts.is_async) then
+            error("index:pairs() doesn't support `buffer` and `is_async` "..
+                  "arguments")
+        end
+        local key_is_nil = (key == nil or
+                            (type(key) == 'table' and #key == 0))
+        local iterator = check_iterator_type(opts, key_is_nil)
+        local batch_size = tonumber(opts and opts.batch_size) or
+                           DEFAULT_PAIRS_BATCH_SIZE
+        local offset = tonumber(opts and opts.offset) or 0
+        local limit = tonumber(opts and opts.limit) or 0xFFFFFFFF
+        local request_opts = opts and opts.timeout and
+                             {timeout = opts.timeout} or nil
+        local space = self.space
+        local index_id = self.id
+        local tuples = {}
+        local position
+        local is_last = limit <= 0
+        local function gen(_, i)
+            if i == #tuples then
+                if is_last then
+                    return nil
+                end
+                local count = min(batch_size, limit)
+                local res = remote:_request('select_position', request_opts,
+                                            space._format_cdata, space.id,
+                                            index_id, iterator, offset,
+                                            count, key, true, position)
+                tuples, position = res[1], res[2]
+                offset = 0
+                limit = limit - #tuples
+                is_last = #tuples < count or limit <= 0
+                if #tuples == 0 then
+                    return nil
+                end
+                i = 0
+            end
+            i = i + 1
+            return i, tuples[i]
+        end
+        return fun.wrap(gen, nil, 0)
+    end
+
     function methods:get(key, opts)
         check_index_arg(self, 'get')
         if opts and opts.buffer then
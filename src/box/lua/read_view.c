@@ -0,0 +1,304 @@
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "box/lua/read_view.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#include "lua/utils.h"
+#include "box/lua/tuple.h"
+
+#include "box/error.h"
+#include "box/index.h"
+#include "box/read_view.h"
+#include "box/schema.h"
+#include "box/space.h"
+#include "box/tuple.h"
+#include "trivia/util.h"
+
+static const char *read_view_uname = "box.read_view";
+
+/**
+ * Get a read view passed to a method. Raises an error if the
+ * read view has been closed.
+ */
+static struct read_view *
+luaT_check_read_view(struct lua_State *L, int idx)
+{
+	struct read_view **ptr =
+		(struct read_view **)luaL_checkudata(L, idx, read_view_uname);
+	if (*ptr == NULL) {
+		diag_set(ClientError, ER_READ_VIEW_CLOSED);
+		luaT_error(L);
+	}
+	return *ptr;
+}
+
+/**
+ * Get the id of a space given by id or name on a Lua stack.
+ * Returns -1 and sets diag if there is no such space.
+ */
+static int
+luaT_read_view_space_id(struct lua_State *L, int idx, uint32_t *space_id)
+{
+	if (lua_type(L, idx) == LUA_TNUMBER) {
+		*space_id = lua_tointeger(L, idx);
+		return 0;
+	}
+	const char *name = luaL_checkstring(L, idx);
+	struct space *space = space_by_name(name);
+	if (space == NULL) {
+		diag_set(ClientError, ER_NO_SUCH_SPACE, name);
+		return -1;
+	}
+	*space_id = space_id(space);
+	return 0;
+}
+
+/**
+ * Get a space of a read view passed to a method.
+ */
+static struct read_view_space *
+luaT_check_read_view_space(struct lua_State *L, struct read_view *rv,
+			   int idx)
+{
+	uint32_t space_id;
+	if (luaT_read_view_space_id(L, idx, &space_id) != 0)
+		luaT_error(L);
+	struct read_view_space *space = read_view_space_by_id(rv, space_id);
+	if (space == NULL) {
+		luaL_error(L, "Space %u is not in the read view",
+			   (unsigned)space_id);
+	}
+	return space;
+}
+
+/**
+ * box.read_view.open({space, ...}) - open a consistent read
+ * view of memtx spaces given by ids or names.
+ */
+static int
+lbox_read_view_open(struct lua_State *L)
+{
+	if (lua_gettop(L) != 1 || !lua_istable(L, 1))
+		return luaL_error(L, "Usage: box.read_view.open({space, ...})");
+	uint32_t space_count = lua_objlen(L, 1);
+	uint32_t *space_ids = (uint32_t *)calloc(space_count,
+						  sizeof(*space_ids));
+	if (space_ids == NULL && space_count > 0) {
+		diag_set(OutOfMemory, space_count * sizeof(*space_ids),
+			 "calloc", "space_ids");
+		return luaT_error(L);
+	}
+	for (uint32_t i = 0; i < space_count; i++) {
+		lua_rawgeti(L, 1, i + 1);
+		int rc = luaT_read_view_space_id(L, -1, &space_ids[i]);
+		lua_pop(L, 1);
+		if (rc != 0) {
+			free(space_ids);
+			return luaT_error(L);
+		}
+	}
+	struct read_view *rv = read_view_open(space_ids, space_count);
+	free(space_ids);
+	if (rv == NULL)
+		return luaT_error(L);
+	struct read_view **ptr =
+		(struct read_view **)lua_newuserdata(L, sizeof(*ptr));
+	*ptr = rv;
+	luaL_getmetatable(L, read_view_uname);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+/** rv:close() - close a read view, also called on GC. */
+static int
+lbox_read_view_close(struct lua_State *L)
+{
+	struct read_view **ptr =
+		(struct read_view **)luaL_checkudata(L, 1, read_view_uname);
+	if (*ptr != NULL) {
+		read_view_close(*ptr);
+		*ptr = NULL;
+	}
+	return 0;
+}
+
+/** Tuples counted in a read view in a worker thread. */
+struct read_view_count {
+	/** Iterator to count the tuples of. */
+	struct snapshot_iterator *iterator;
+	/** Number of tuples counted. */
+	uint64_t count;
+};
+
+static int
+read_view_count_f(struct read_view *rv, void *arg)
+{
+	(void)rv;
+	struct read_view_count *count = (struct read_view_count *)arg;
+	struct snapshot_iterator *it = count->iterator;
+	const char *data;
+	uint32_t size;
+	int rc;
+	while ((rc = it->next(it, &data, &size)) == 0 && data != NULL)
+		count->count++;
+	return rc;
+}
+
+/**
+ * rv:count(space) - count tuples of a space not fetched from
+ * the read view yet. Fetches all of them.
+ */
+static int
+lbox_read_view_count(struct lua_State *L)
+{
+	struct read_view *rv = luaT_check_read_view(L, 1);
+	struct read_view_space *space = luaT_check_read_view_space(L, rv, 2);
+	struct read_view_count count;
+	count.iterator = space->iterator;
+	count.count = 0;
+	if (read_view_call(rv, read_view_count_f, &count) != 0)
+		return luaT_error(L);
+	luaL_pushuint64(L, count.count);
+	return 1;
+}
+
+/** Tuples fetched from a read view in a worker thread. */
+struct read_view_fetch {
+	/** Iterator to fetch the tuples from. */
+	struct snapshot_iterator *iterator;
+	/** Max number of tuples to fetch. */
+	uint32_t limit;
+	/** Number of tuples fetched. */
+	uint32_t count;
+	/** Data of the tuples fetched, one after another. */
+	char *buf;
+	/** Size of the data. */
+	size_t size;
+	/** Size of the allocated buffer. */
+	size_t capacity;
+};
+
+static int
+read_view_fetch_f(struct read_view *rv, void *arg)
+{
+	(void)rv;
+	struct read_view_fetch *fetch = (struct read_view_fetch *)arg;
+	struct snapshot_iterator *it = fetch->iterator;
+	while (fetch->count < fetch->limit) {
+		const char *data;
+		uint32_t size;
+		if (it->next(it, &data, &size) != 0)
+			return -1;
+		if (data == NULL)
+			break;
+		if (fetch->size + size > fetch->capacity) {
+			size_t capacity = MAX(fetch->capacity * 2,
+					      fetch->size + size);
+			char *buf = (char *)realloc(fetch->buf, capacity);
+			if (buf == NULL) {
+				diag_set(OutOfMemory, capacity,
+					 "realloc", "buf");
+				return -1;
+			}
+			fetch->buf = buf;
+			fetch->capacity = capacity;
+		}
+		memcpy(fetch->buf + fetch->size, data, size);
+		fetch->size += size;
+		fetch->count++;
+	}
+	return 0;
+}
+
+/**
+ * rv:fetch(space, limit) - fetch up to limit next tuples of
+ * a space from the read view. Returns an empty table when all
+ * tuples have been fetched.
+ */
+static int
+lbox_read_view_fetch(struct lua_State *L)
+{
+	struct read_view *rv = luaT_check_read_view(L, 1);
+	struct read_view_space *space = luaT_check_read_view_space(L, rv, 2);
+	lua_Integer limit = luaL_checkinteger(L, 3);
+	if (limit <= 0 || limit > UINT32_MAX)
+		return luaL_error(L, "limit must be a positive number");
+	struct read_view_fetch fetch;
+	memset(&fetch, 0, sizeof(fetch));
+	fetch.iterator = space->iterator;
+	fetch.limit = limit;
+	if (read_view_call(rv, read_view_fetch_f, &fetch) != 0) {
+		free(fetch.buf);
+		return luaT_error(L);
+	}
+	lua_createtable(L, fetch.count, 0);
+	const char *data = fetch.buf;
+	for (uint32_t i = 0; i < fetch.count; i++) {
+		const char *end = data;
+		mp_next(&end);
+		struct tuple *tuple = box_tuple_new(space->format, data,
+						    end);
+		if (tuple == NULL) {
+			free(fetch.buf);
+			return luaT_error(L);
+		}
+		luaT_pushtuple(L, tuple);
+		lua_rawseti(L, -2, i + 1);
+		data = end;
+	}
+	free(fetch.buf);
+	return 1;
+}
+
+void
+box_lua_read_view_init(struct lua_State *L)
+{
+	static const struct luaL_Reg read_view_lib[] = {
+		{"open", lbox_read_view_open},
+		{NULL, NULL}
+	};
+	luaL_register_module(L, "box.read_view", read_view_lib);
+	lua_pop(L, 1);
+
+	static const struct luaL_Reg read_view_methods[] = {
+		{"count", lbox_read_view_count},
+		{"fetch", lbox_read_view_fetch},
+		{"close", lbox_read_view_close},
+		{"__gc", lbox_read_view_close},
+		{NULL, NULL}
+	};
+	luaL_register_type(L, read_view_uname, read_view_methods);
+}
@@ -43,6 +43,7 @@
 #include "box/schema.h"
 #include "box/port.h"
 #include "box/session_settings.h"
+#include "box/iproto.h"
 #include "tt_static.h"
 
 static const char *sessionlib_name = "box.session";
@@ -280,6 +281,40 @@ lbox_session_peer(struct lua_State *L)
 	return 1;
 }
 
+/**
+ * Return request queue statistics of a binary protocol session
+ * connection: the number of requests being processed and the
+ * size of the input waiting for its turn. nil if the session is
+ * not a binary protocol one.
+ */
+static int
+lbox_session_net_queue(struct lua_State *L)
+{
+	if (lua_gettop(L) > 1)
+		luaL_error(L, "session.net_queue(sid): bad arguments");
+
+	struct session *session;
+	if (lua_gettop(L) == 1)
+		session = session_find(luaL_checkint(L, 1));
+	else
+		session = current_session();
+	if (session == NULL)
+		luaL_error(L, "session.net_queue(): session does not exist");
+	struct iproto_queue_stat stat;
+	if (iproto_session_queue_stat(session, &stat) != 0) {
+		lua_pushnil(L);
+		return 1;
+	}
+	lua_createtable(L, 0, 3);
+	lua_pushinteger(L, stat.inflight);
+	lua_setfield(L, -2, "inflight");
+	luaL_pushuint64(L, stat.pending);
+	lua_setfield(L, -2, "pending");
+	luaL_pushuint64(L, stat.readahead);
+	lua_setfield(L, -2, "readahead");
+	return 1;
+}
+
 /**
  * run on_connect|on_disconnect trigger
  */
@@ -565,6 +600,7 @@ box_lua_session_init(struct lua_State *L)
 		{"fd", lbox_session_fd},
 		{"exists", lbox_session_exists},
 		{"peer", lbox_session_peer},
+		{"net_queue", lbox_session_net_queue},
 		{"on_connect", lbox_session_on_connect},
 		{"on_disconnect", lbox_session_on_disconnect},
 		{"on_auth", lbox_session_on_auth},
@@ -41,6 +41,7 @@
 #include "small/small.h"
 #include "small/quota.h"
 #include "memory.h"
+#include "fiber.h"
 #include "box/engine.h"
 #include "box/memtx_engine.h"
 
@@ -198,6 +199,16 @@ lbox_slab_info(struct lua_State *L)
 	lua_pushstring(L, ratio_buf);
 	lua_settable(L, -3);
 
+	/** How the arena is backed by huge pages. */
+	lua_pushstring(L, "huge_pages");
+	lua_pushstring(L, tuple_arena_huge_pages_strs[memtx->huge_pages]);
+	lua_settable(L, -3);
+	/** How much of the arena is actually in huge pages. */
+	lua_pushstring(L, "arena_huge_size");
+	luaL_pushuint64(L, tuple_arena_huge_size(&memtx->arena,
+						 memtx->huge_pages));
+	lua_settable(L, -3);
+
 	/*
 	 * This is pretty much the same as
 	 * box.cfg.slab_alloc_arena, but in bytes
@@ -234,6 +245,14 @@ lbox_slab_info(struct lua_State *L)
 static int
 lbox_runtime_info(struct lua_State *L)
 {
+	bool with_stack_rss = false;
+	if (lua_istable(L, 1)) {
+		lua_pushstring(L, "stack_rss");
+		lua_gettable(L, 1);
+		with_stack_rss = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+	}
+
 	lua_newtable(L);
 
 	lua_pushstring(L, "used");
@@ -251,6 +270,43 @@ lbox_runtime_info(struct lua_State *L)
 	lua_pushinteger(L, G(L)->gc.total);
 	lua_settable(L, -3);
 
+	/*
+	 * Fiber stacks of the TX thread, they are allocated
+	 * from the runtime arena as well.
+	 */
+	struct fiber_stack_stat stack_stat;
+	cord_stack_stat(cord(), &stack_stat, with_stack_rss);
+
+	lua_pushstring(L, "fiber_created");
+	luaL_pushuint64(L, stack_stat.created);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "fiber_reused");
+	luaL_pushuint64(L, stack_stat.reused);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "fiber_stack_used");
+	luaL_pushuint64(L, stack_stat.used);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "fiber_stack_pooled");
+	luaL_pushuint64(L, stack_stat.pooled);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "fiber_stack_trimmed");
+	luaL_pushuint64(L, stack_stat.trimmed);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "fiber_stack_size");
+	luaL_pushuint64(L, stack_stat.size);
+	lua_settable(L, -3);
+
+	if (with_stack_rss) {
+		lua_pushstring(L, "fiber_stack_rss");
+		luaL_pushuint64(L, stack_stat.rss);
+		lua_settable(L, -3);
+	}
+
 	return 1;
 }
 
@@ -43,14 +43,13 @@
 #include "box/engine.h"
 #include "box/vinyl.h"
 #include "box/sql.h"
+#include "coio_task.h"
 #include "info/info.h"
 #include "lua/info.h"
 #include "lua/utils.h"
 
 extern struct rmean *rmean_box;
 extern struct rmean *rmean_error;
-/** network statistics (iproto & cbus) */
-extern struct rmean *rmean_net;
 extern struct rmean *rmean_tx_wal_bus;
 
 static void
@@ -148,7 +147,17 @@ static int
 lbox_stat_net_index(struct lua_State *L)
 {
 	const char *key = luaL_checkstring(L, -1);
-	if (rmean_foreach(rmean_net, seek_stat_item, L) == 0)
+	if (strcmp(key, "MSG_MAX") == 0 || strcmp(key, "READAHEAD") == 0) {
+		struct iproto_tune_stat stat;
+		iproto_tune_stat(&stat);
+		lua_newtable(L);
+		lua_pushstring(L, "current");
+		lua_pushnumber(L, strcmp(key, "MSG_MAX") == 0 ?
+			       stat.msg_max : stat.readahead);
+		lua_rawset(L, -3);
+		return 1;
+	}
+	if (iproto_rmean_foreach(seek_stat_item, L) == 0)
 		return 0;
 
 	if (strcmp(key, "CONNECTIONS") == 0) {
@@ -163,6 +172,52 @@ lbox_stat_net_index(struct lua_State *L)
 	return 1;
 }
 
+/**
+ * Set 'current' fields of CONNECTIONS and REQUESTS metrics in
+ * a table of network metrics on top of a Lua stack.
+ */
+static void
+fill_stat_net_current(struct lua_State *L, size_t connections,
+		      size_t requests)
+{
+	lua_pushstring(L, "CONNECTIONS");
+	lua_rawget(L, -2);
+	lua_pushstring(L, "current");
+	lua_pushnumber(L, connections);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "REQUESTS");
+	lua_rawget(L, -2);
+	lua_pushstring(L, "current");
+	lua_pushnumber(L, requests);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+}
+
+/**
+ * Add MSG_MAX and READAHEAD metrics with the limits chosen by
+ * the adaptive network controller to a table of network
+ * metrics on top of a Lua stack.
+ */
+static void
+fill_stat_net_tune(struct lua_State *L, const struct iproto_tune_stat *stat)
+{
+	lua_pushstring(L, "MSG_MAX");
+	lua_newtable(L);
+	lua_pushstring(L, "current");
+	lua_pushnumber(L, stat->msg_max);
+	lua_rawset(L, -3);
+	lua_rawset(L, -3);
+
+	lua_pushstring(L, "READAHEAD");
+	lua_newtable(L);
+	lua_pushstring(L, "current");
+	lua_pushnumber(L, stat->readahead);
+	lua_rawset(L, -3);
+	lua_rawset(L, -3);
+}
+
 /**
  * Push a table of network metrics to a Lua stack.
  *
@@ -171,6 +226,8 @@ lbox_stat_net_index(struct lua_State *L)
  * - SENT (packets): total, rps;
  * - RECEIVED (packets): total, rps;
  * - CONNECTIONS: current.
+ * - MSG_MAX (limit of requests in flight): current;
+ * - READAHEAD (input buffer size of all connections): current.
  *
  * These fields have the following meaning:
  *
@@ -178,27 +235,63 @@ lbox_stat_net_index(struct lua_State *L)
  * - rps -- amount of events per second, mean over last 5 seconds;
  * - current -- amount of resources currently hold (say, number of
  *   open connections).
+ *
+ * The metrics are summed up over all network threads, see
+ * box.stat.net.thread() for per-thread values.
  */
 static int
 lbox_stat_net_call(struct lua_State *L)
 {
 	lua_newtable(L);
-	rmean_foreach(rmean_net, set_stat_item, L);
+	iproto_rmean_foreach(set_stat_item, L);
+	fill_stat_net_current(L, iproto_connection_count(),
+			      iproto_request_count());
+	struct iproto_tune_stat stat;
+	iproto_tune_stat(&stat);
+	fill_stat_net_tune(L, &stat);
+	return 1;
+}
 
-	lua_pushstring(L, "CONNECTIONS");
-	lua_rawget(L, -2);
-	lua_pushstring(L, "current");
-	lua_pushnumber(L, iproto_connection_count());
-	lua_rawset(L, -3);
-	lua_pop(L, 1);
+/** Push a table of network metrics of one network thread. */
+static void
+push_stat_net_thread(struct lua_State *L, int thread_id)
+{
+	lua_newtable(L);
+	iproto_thread_rmean_foreach(thread_id, set_stat_item, L);
+	fill_stat_net_current(L, iproto_thread_connection_count(thread_id),
+			      iproto_thread_request_count(thread_id));
+	struct iproto_tune_stat stat;
+	iproto_thread_tune_stat(thread_id, &stat);
+	fill_stat_net_tune(L, &stat);
+}
 
-	lua_pushstring(L, "REQUESTS");
-	lua_rawget(L, -2);
-	lua_pushstring(L, "current");
-	lua_pushnumber(L, iproto_request_count());
-	lua_rawset(L, -3);
-	lua_pop(L, 1);
+/**
+ * Push a table with network metrics of a network thread with
+ * the given number (starting from 1), or nil if there is no
+ * such thread.
+ */
+static int
+lbox_stat_net_thread_index(struct lua_State *L)
+{
+	int thread_id = luaL_checkinteger(L, -1) - 1;
+	if (thread_id < 0 || thread_id >= iproto_threads_count)
+		return 0;
+	push_stat_net_thread(L, thread_id);
+	return 1;
+}
 
+/**
+ * Push an array of network metrics tables, one per network
+ * thread. Metrics are the same as in lbox_stat_net_call().
+ */
+static int
+lbox_stat_net_thread_call(struct lua_State *L)
+{
+	lua_newtable(L);
+	for (int i = 0; i < iproto_threads_count; i++) {
+		push_stat_net_thread(L, i);
+		lua_rawseti(L, -2, i + 1);
+	}
 	return 1;
 }
 
@@ -211,6 +304,36 @@ lbox_stat_sql(struct lua_State *L)
 	return 1;
 }
 
+static int
+lbox_stat_latency(struct lua_State *L)
+{
+	struct info_handler info;
+	luaT_info_handler_create(&info, L);
+	if (iproto_latency_stat(&info) != 0)
+		return luaT_error(L);
+	return 1;
+}
+
+static int
+lbox_stat_coio(struct lua_State *L)
+{
+	struct info_handler info;
+	luaT_info_handler_create(&info, L);
+	info_begin(&info);
+	for (int pri = 0; pri < coio_task_pri_MAX; pri++) {
+		struct coio_task_stat stat;
+		coio_task_stat(pri, &stat);
+		info_table_begin(&info, coio_task_pri_strs[pri]);
+		info_append_int(&info, "queue", stat.queue);
+		info_append_int(&info, "count", stat.count);
+		info_append_double(&info, "wait_total", stat.wait_total);
+		info_append_double(&info, "wait_max", stat.wait_max);
+		info_table_end(&info);
+	}
+	info_end(&info);
+	return 1;
+}
+
 static const struct luaL_Reg lbox_stat_meta [] = {
 	{"__index", lbox_stat_index},
 	{"__call",  lbox_stat_call},
@@ -223,6 +346,12 @@ static const struct luaL_Reg lbox_stat_net_meta [] = {
 	{NULL, NULL}
 };
 
+static const struct luaL_Reg lbox_stat_net_thread_meta [] = {
+	{"__index", lbox_stat_net_thread_index},
+	{"__call",  lbox_stat_net_thread_call},
+	{NULL, NULL}
+};
+
 /** Initialize box.stat package. */
 void
 box_lua_stat_init(struct lua_State *L)
@@ -231,6 +360,8 @@ box_lua_stat_init(struct lua_State *L)
 		{"vinyl", lbox_stat_vinyl},
 		{"reset", lbox_stat_reset},
 		{"sql", lbox_stat_sql},
+		{"latency", lbox_stat_latency},
+		{"coio", lbox_stat_coio},
 		{NULL, NULL}
 	};
 
@@ -250,6 +381,13 @@ box_lua_stat_init(struct lua_State *L)
 	lua_newtable(L);
 	luaL_register(L, NULL, lbox_stat_net_meta);
 	lua_setmetatable(L, -2);
+
+	lua_pushstring(L, "thread");
+	lua_newtable(L);
+	lua_newtable(L);
+	luaL_register(L, NULL, lbox_stat_net_thread_meta);
+	lua_setmetatable(L, -2);
+	lua_rawset(L, -3);
 	lua_pop(L, 1); /* stat net module */
 }
 
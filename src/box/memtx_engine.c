@@ -37,7 +37,9 @@
 
 #include "fiber.h"
 #include "errinj.h"
+#include "affinity.h"
 #include "coio_file.h"
+#include "coio_task.h"
 #include "tuple.h"
 #include "txn.h"
 #include "memtx_tx.h"
@@ -50,6 +52,8 @@
 #include "schema.h"
 #include "gc.h"
 #include "raft.h"
+#include "snap_reader.h"
+#include "snap_writer.h"
 
 /* sync snapshot every 16MB */
 #define SNAP_SYNC_INTERVAL	(1 << 24)
@@ -91,41 +95,215 @@ memtx_end_build_primary_key(struct space *space, void *param)
 	return 0;
 }
 
+enum {
+	/** Max number of spaces whose secondary keys are built at once. */
+	MEMTX_BUILD_SPACES_MAX = 4,
+};
+
+static ssize_t
+memtx_build_keys_f(va_list ap)
+{
+	struct index *index = va_arg(ap, struct index *);
+	struct tuple **tuples = va_arg(ap, struct tuple **);
+	size_t count = va_arg(ap, size_t);
+	return memtx_tree_index_build_keys(index, tuples, count);
+}
+
 /**
- * Secondary indexes are built in bulk after all data is
- * recovered. This function enables secondary keys on a space.
- * Data dictionary spaces are an exception, they are fully
- * built right from the start.
+ * Extract and sort keys of a tree index in a worker thread,
+ * while the fiber waits.
  */
 static int
-memtx_build_secondary_keys(struct space *space, void *param)
+memtx_build_index_f(va_list ap)
 {
-	struct memtx_space *memtx_space = (struct memtx_space *)space;
-	if (space->engine != param || space_index(space, 0) == NULL ||
-	    memtx_space->replace == memtx_space_replace_all_keys)
+	struct index *index = va_arg(ap, struct index *);
+	struct tuple **tuples = va_arg(ap, struct tuple **);
+	size_t count = va_arg(ap, size_t);
+	return coio_call(memtx_build_keys_f, index, tuples, count) == 0 ?
+	       0 : -1;
+}
+
+/**
+ * Build secondary indexes of a space. The primary key is scanned
+ * once. Indexes which can be built only on the tx thread are fed
+ * during the scan, while keys of the others are extracted and
+ * sorted by worker threads in parallel. The trees are loaded on
+ * the tx thread in the end.
+ */
+static int
+memtx_space_build_secondary_keys(struct space *space)
+{
+	struct index *pk = space->index[0];
+	ssize_t n_tuples = index_size(pk);
+	assert(n_tuples >= 0);
+	if (n_tuples == 0) {
+		/* Nothing to sort, keep it simple. */
+		for (uint32_t j = 1; j < space->index_count; j++) {
+			if (index_build(space->index[j], pk) != 0)
+				return -1;
+		}
 		return 0;
+	}
+	say_info("Building secondary indexes in space '%s'...",
+		 space_name(space));
+	for (uint32_t j = 1; j < space->index_count; j++) {
+		struct index *index = space->index[j];
+		index_begin_build(index);
+		if (index_reserve(index, n_tuples * 1.2) != 0)
+			return -1;
+		say_info("Adding %zd keys to %s index '%s' ...",
+			 n_tuples, index_type_strs[index->def->type],
+			 index->def->name);
+	}
+	struct tuple **tuples =
+		(struct tuple **)malloc(n_tuples * sizeof(*tuples));
+	if (tuples == NULL) {
+		diag_set(OutOfMemory, n_tuples * sizeof(*tuples),
+			 "malloc", "tuples");
+		return -1;
+	}
+	int rc = 0;
+	size_t count = 0;
+	struct iterator *it = index_create_iterator(pk, ITER_ALL, NULL, 0);
+	if (it == NULL) {
+		free(tuples);
+		return -1;
+	}
+	while (rc == 0) {
+		struct tuple *tuple;
+		rc = iterator_next(it, &tuple);
+		if (rc != 0 || tuple == NULL)
+			break;
+		assert((ssize_t)count < n_tuples);
+		tuples[count++] = tuple;
+		for (uint32_t j = 1; j < space->index_count && rc == 0; j++) {
+			struct index *index = space->index[j];
+			if (!memtx_tree_index_build_is_thread_safe(index))
+				rc = index_build_next(index, tuple);
+		}
+	}
+	iterator_delete(it);
+	struct fiber *builders[BOX_INDEX_MAX];
+	uint32_t builder_count = 0;
+	for (uint32_t j = 1; j < space->index_count && rc == 0; j++) {
+		struct index *index = space->index[j];
+		if (!memtx_tree_index_build_is_thread_safe(index))
+			continue;
+		struct fiber *f = fiber_new("memtx.build", memtx_build_index_f);
+		if (f == NULL) {
+			rc = -1;
+			break;
+		}
+		fiber_set_joinable(f, true);
+		fiber_start(f, index, tuples, count);
+		builders[builder_count++] = f;
+	}
+	/* The tuple array is in use until all builders are done. */
+	for (uint32_t i = 0; i < builder_count; i++) {
+		if (fiber_join(builders[i]) != 0)
+			rc = -1;
+	}
+	free(tuples);
+	if (rc != 0)
+		return -1;
+	for (uint32_t j = 1; j < space->index_count; j++)
+		index_end_build(space->index[j]);
+	say_info("Space '%s': done", space_name(space));
+	return 0;
+}
 
-	if (space->index_id_max > 0) {
-		struct index *pk = space->index[0];
-		ssize_t n_tuples = index_size(pk);
-		assert(n_tuples >= 0);
+struct memtx_build_ctx {
+	struct memtx_engine *memtx;
+	/** Spaces whose secondary keys are to be built. */
+	struct space **spaces;
+	uint32_t space_count;
+	uint32_t space_alloc;
+	/** Index of the next space to build. */
+	uint32_t next;
+	/** Set on error to stop the other builders. */
+	bool is_failed;
+};
 
-		if (n_tuples > 0) {
-			say_info("Building secondary indexes in space '%s'...",
-				 space_name(space));
+static int
+memtx_build_ctx_add_space(struct space *space, void *param)
+{
+	struct memtx_build_ctx *ctx = (struct memtx_build_ctx *)param;
+	struct memtx_space *memtx_space = (struct memtx_space *)space;
+	if (space->engine != (struct engine *)ctx->memtx ||
+	    space_index(space, 0) == NULL ||
+	    memtx_space->replace == memtx_space_replace_all_keys)
+		return 0;
+	if (ctx->space_count == ctx->space_alloc) {
+		uint32_t alloc = MAX(ctx->space_alloc * 2, 16);
+		struct space **spaces = (struct space **)
+			realloc(ctx->spaces, alloc * sizeof(*spaces));
+		if (spaces == NULL) {
+			diag_set(OutOfMemory, alloc * sizeof(*spaces),
+				 "realloc", "spaces");
+			return -1;
 		}
+		ctx->spaces = spaces;
+		ctx->space_alloc = alloc;
+	}
+	ctx->spaces[ctx->space_count++] = space;
+	return 0;
+}
 
-		for (uint32_t j = 1; j < space->index_count; j++) {
-			if (index_build(space->index[j], pk) < 0)
-				return -1;
+static int
+memtx_build_spaces_f(va_list ap)
+{
+	struct memtx_build_ctx *ctx = va_arg(ap, struct memtx_build_ctx *);
+	while (!ctx->is_failed && ctx->next < ctx->space_count) {
+		struct space *space = ctx->spaces[ctx->next++];
+		if (space->index_id_max > 0 &&
+		    memtx_space_build_secondary_keys(space) != 0) {
+			ctx->is_failed = true;
+			return -1;
 		}
+		struct memtx_space *memtx_space = (struct memtx_space *)space;
+		memtx_space->replace = memtx_space_replace_all_keys;
+	}
+	return 0;
+}
 
-		if (n_tuples > 0) {
-			say_info("Space '%s': done", space_name(space));
+/**
+ * Secondary indexes are built in bulk after all data is
+ * recovered. This function enables secondary keys on all memtx
+ * spaces, building several spaces at once. Data dictionary
+ * spaces are an exception, they are fully built right from the
+ * start.
+ */
+static int
+memtx_build_secondary_keys(struct memtx_engine *memtx)
+{
+	struct memtx_build_ctx ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.memtx = memtx;
+	if (space_foreach(memtx_build_ctx_add_space, &ctx) != 0) {
+		free(ctx.spaces);
+		return -1;
+	}
+	struct fiber *builders[MEMTX_BUILD_SPACES_MAX];
+	uint32_t builder_count = 0;
+	int rc = 0;
+	while (builder_count < MIN((uint32_t)MEMTX_BUILD_SPACES_MAX,
+				   ctx.space_count)) {
+		struct fiber *f = fiber_new("memtx.build", memtx_build_spaces_f);
+		if (f == NULL) {
+			ctx.is_failed = true;
+			rc = -1;
+			break;
 		}
+		fiber_set_joinable(f, true);
+		fiber_start(f, &ctx);
+		builders[builder_count++] = f;
 	}
-	memtx_space->replace = memtx_space_replace_all_keys;
-	return 0;
+	for (uint32_t i = 0; i < builder_count; i++) {
+		if (fiber_join(builders[i]) != 0)
+			rc = -1;
+	}
+	free(ctx.spaces);
+	return rc;
 }
 
 static void
@@ -152,17 +330,18 @@ static int
 memtx_engine_recover_snapshot_row(struct memtx_engine *memtx,
 				  struct xrow_header *row, int *is_space_system);
 
-int
-memtx_engine_recover_snapshot(struct memtx_engine *memtx,
-			      const struct vclock *vclock)
-{
-	/* Process existing snapshot */
-	say_info("recovery start");
-	int64_t signature = vclock_sum(vclock);
-	const char *filename = xdir_format_filename(&memtx->snap_dir,
-						    signature, NONE);
+static int
+memtx_engine_recover_snapshot_request(struct memtx_engine *memtx,
+				      struct request *request,
+				      int *is_space_system);
 
-	say_info("recovering from `%s'", filename);
+/**
+ * Read the snapshot in the tx thread.
+ */
+static int
+memtx_engine_read_snapshot(struct memtx_engine *memtx, const char *filename,
+			   int64_t signature, bool *is_eof)
+{
 	struct xlog_cursor cursor;
 	if (xlog_cursor_open(&cursor, filename) < 0)
 		return -1;
@@ -194,16 +373,115 @@ memtx_engine_recover_snapshot(struct memtx_engine *memtx,
 			fiber_yield_timeout(0);
 		}
 	}
+	*is_eof = xlog_cursor_is_eof(&cursor);
 	xlog_cursor_close(&cursor, false);
 	if (rc < 0 || is_space_system < 0)
 		return -1;
+	return 0;
+}
+
+/**
+ * Read the snapshot with a snap_reader: tx blocks are read,
+ * decompressed and decoded by other threads while the tx
+ * thread applies the rows in the file order.
+ */
+static int
+memtx_engine_read_snapshot_parallel(struct memtx_engine *memtx,
+				    const char *filename, int64_t signature,
+				    bool *is_eof)
+{
+	struct snap_reader *reader = snap_reader_new(filename,
+						     memtx->snap_read_threads,
+						     memtx->force_recovery);
+	if (reader == NULL)
+		return -1;
+
+	int rc;
+	struct snap_batch *batch;
+	uint64_t row_count = 0;
+	int is_space_system = -1;
+	bool force_recovery = false;
+	while ((rc = snap_reader_next(reader, &batch)) == 0 &&
+	       batch != NULL) {
+		for (int i = 0; i < batch->row_count; i++) {
+			struct snap_row *row = &batch->rows[i];
+			row->header.lsn = signature;
+			if (row->is_decoded) {
+				rc = memtx_engine_recover_snapshot_request(
+					memtx, &row->request, &is_space_system);
+			} else {
+				rc = memtx_engine_recover_snapshot_row(
+					memtx, &row->header, &is_space_system);
+			}
+			force_recovery = is_space_system == 0 ?
+					 memtx->force_recovery : false;
+			if (rc < 0) {
+				if (!force_recovery)
+					break;
+				say_error("can't apply row: ");
+				diag_log();
+				rc = 0;
+			}
+			++row_count;
+			if (row_count % 100000 == 0) {
+				say_info("%.1fM rows processed",
+					 row_count / 1000000.);
+				fiber_yield_timeout(0);
+			}
+		}
+		/*
+		 * A broken tx block can be skipped the same way
+		 * xlog_cursor_next() does it.
+		 */
+		if (rc == 0 && !diag_is_empty(&batch->diag)) {
+			struct error *e = diag_last_error(&batch->diag);
+			if (force_recovery && e->type == &type_XlogError) {
+				say_error("can't decode tx: %s", e->errmsg);
+			} else {
+				diag_move(&batch->diag, diag_get());
+				rc = -1;
+			}
+		}
+		snap_batch_delete(batch);
+		if (rc < 0)
+			break;
+	}
+	*is_eof = snap_reader_is_eof(reader);
+	snap_reader_delete(reader);
+	if (rc < 0 || is_space_system < 0)
+		return -1;
+	return 0;
+}
+
+int
+memtx_engine_recover_snapshot(struct memtx_engine *memtx,
+			      const struct vclock *vclock)
+{
+	/* Process existing snapshot */
+	say_info("recovery start");
+	int64_t signature = vclock_sum(vclock);
+	const char *filename = xdir_format_filename(&memtx->snap_dir,
+						    signature, NONE);
+
+	say_info("recovering from `%s'", filename);
+	bool is_eof = false;
+	int rc;
+	if (memtx->snap_read_threads > 0) {
+		rc = memtx_engine_read_snapshot_parallel(memtx, filename,
+							 signature, &is_eof);
+	} else {
+		rc = memtx_engine_read_snapshot(memtx, filename, signature,
+						&is_eof);
+	}
+	if (rc != 0)
+		return -1;
 
 	/**
 	 * We should never try to read snapshots with no EOF
 	 * marker - such snapshots are very likely corrupted and
 	 * should not be trusted.
 	 */
-	if (!xlog_cursor_is_eof(&cursor)) {
+	if (!is_eof) {
 		if (!memtx->force_recovery)
 			panic("snapshot `%s' has no EOF marker", filename);
 		else
@@ -237,12 +515,21 @@ memtx_engine_recover_snapshot_row(struct memtx_engine *memtx,
 			 (uint32_t) row->type);
 		return -1;
 	}
-	int rc;
 	struct request request;
 	if (xrow_decode_dml(row, &request, dml_request_key_map(row->type)) != 0)
 		return -1;
-	*is_space_system = (request.space_id < BOX_SYSTEM_ID_MAX);
-	struct space *space = space_cache_find(request.space_id);
+	return memtx_engine_recover_snapshot_request(memtx, &request,
+						     is_space_system);
+}
+
+static int
+memtx_engine_recover_snapshot_request(struct memtx_engine *memtx,
+				      struct request *request,
+				      int *is_space_system)
+{
+	int rc;
+	*is_space_system = (request->space_id < BOX_SYSTEM_ID_MAX);
+	struct space *space = space_cache_find(request->space_id);
 	if (space == NULL)
 		return -1;
 	/* memtx snapshot must contain only memtx spaces */
@@ -257,9 +544,9 @@ memtx_engine_recover_snapshot_row(struct memtx_engine *memtx,
 		goto rollback;
 	/* no access checks here - applier always works with admin privs */
 	struct tuple *unused;
-	if (space_execute_dml(space, txn, &request, &unused) != 0)
+	if (space_execute_dml(space, txn, request, &unused) != 0)
 		goto rollback_stmt;
-	if (txn_commit_stmt(txn, &request) != 0)
+	if (txn_commit_stmt(txn, request) != 0)
 		goto rollback;
 	/*
 	 * Snapshot rows are confirmed by definition. They don't need to go to
@@ -331,7 +618,7 @@ memtx_engine_begin_final_recovery(struct engine *engine)
 		 * unique keys.
 		 */
 		memtx->state = MEMTX_OK;
-		if (space_foreach(memtx_build_secondary_keys, memtx) != 0)
+		if (memtx_build_secondary_keys(memtx) != 0)
 			return -1;
 	}
 	return 0;
@@ -350,7 +637,7 @@ memtx_engine_end_recovery(struct engine *engine)
 	if (memtx->state != MEMTX_OK) {
 		assert(memtx->state == MEMTX_FINAL_RECOVERY);
 		memtx->state = MEMTX_OK;
-		if (space_foreach(memtx_build_secondary_keys, memtx) != 0)
+		if (memtx_build_secondary_keys(memtx) != 0)
 			return -1;
 	}
 	return 0;
@@ -472,7 +759,7 @@ memtx_engine_bootstrap(struct engine *engine)
 }
 
 static int
-checkpoint_write_row(struct xlog *l, struct xrow_header *row)
+checkpoint_write_row(struct snap_writer *writer, struct xrow_header *row)
 {
 	static ev_tstamp last = 0;
 	if (last == 0) {
@@ -489,23 +776,24 @@ checkpoint_write_row(struct xlog *l, struct xrow_header *row)
 	 * WAL. @sa the place which skips old rows in
 	 * recovery_apply_row().
 	 */
-	row->lsn = l->rows + l->tx_rows;
+	row->lsn = snap_writer_row_count(writer);
 	row->sync = 0; /* don't write sync to wal */
 
-	ssize_t written = xlog_write_row(l, row);
+	int rc = snap_writer_write_row(writer, row);
 	fiber_gc();
-	if (written < 0)
+	if (rc < 0)
 		return -1;
 
-	if ((l->rows + l->tx_rows) % 100000 == 0)
-		say_crit("%.1fM rows written", (l->rows + l->tx_rows) / 1000000.0);
+	int64_t rows = snap_writer_row_count(writer);
+	if (rows % 100000 == 0)
+		say_crit("%.1fM rows written", rows / 1000000.0);
 	return 0;
 
 }
 
 static int
-checkpoint_write_tuple(struct xlog *l, uint32_t space_id, uint32_t group_id,
-		       const char *data, uint32_t size)
+checkpoint_write_tuple(struct snap_writer *writer, uint32_t space_id,
+		       uint32_t group_id, const char *data, uint32_t size)
 {
 	struct request_replace_body body;
 	request_replace_body_create(&body, space_id);
@@ -520,7 +808,7 @@ checkpoint_write_tuple(struct xlog *l, uint32_t space_id, uint32_t group_id,
 	row.body[0].iov_len = sizeof(body);
 	row.body[1].iov_base = (char *)data;
 	row.body[1].iov_len = size;
-	return checkpoint_write_row(l, &row);
+	return checkpoint_write_row(writer, &row);
 }
 
 struct checkpoint_entry {
@@ -547,10 +835,13 @@ struct checkpoint {
 	 * checkpoint already exists.
 	 */
 	bool touch;
+	/** Number of threads compressing the snapshot. */
+	int write_threads;
 };
 
 static struct checkpoint *
-checkpoint_new(const char *snap_dirname, uint64_t snap_io_rate_limit)
+checkpoint_new(const char *snap_dirname, uint64_t snap_io_rate_limit,
+	       int write_threads)
 {
 	struct checkpoint *ckpt = malloc(sizeof(*ckpt));
 	if (ckpt == NULL) {
@@ -568,6 +859,7 @@ checkpoint_new(const char *snap_dirname, uint64_t snap_io_rate_limit)
 	vclock_create(&ckpt->vclock);
 	box_raft_checkpoint_local(&ckpt->raft);
 	ckpt->touch = false;
+	ckpt->write_threads = write_threads;
 	return ckpt;
 }
 
@@ -639,7 +931,8 @@ checkpoint_add_space(struct space *sp, void *data)
 };
 
 static int
-checkpoint_write_raft(struct xlog *l, const struct raft_request *req)
+checkpoint_write_raft(struct snap_writer *writer,
+		      const struct raft_request *req)
 {
 	struct xrow_header row;
 	struct region *region = &fiber()->gc;
@@ -647,7 +940,7 @@ checkpoint_write_raft(struct xlog *l, const struct raft_request *req)
 	int rc = -1;
 	if (xrow_encode_raft(&row, region, req) != 0)
 		goto finish;
-	if (checkpoint_write_row(l, &row) != 0)
+	if (checkpoint_write_row(writer, &row) != 0)
 		goto finish;
 	rc = 0;
 finish:
@@ -674,6 +967,13 @@ checkpoint_f(va_list ap)
 	if (xdir_create_xlog(&ckpt->dir, &snap, &ckpt->vclock) != 0)
 		return -1;
 
+	struct snap_writer *writer = snap_writer_new(&snap,
+						     ckpt->write_threads);
+	if (writer == NULL) {
+		xlog_close(&snap, false);
+		return -1;
+	}
+
 	say_info("saving snapshot `%s'", snap.filename);
 	ERROR_INJECT_SLEEP(ERRINJ_SNAP_WRITE_DELAY);
 	struct checkpoint_entry *entry;
@@ -683,22 +983,24 @@ checkpoint_f(va_list ap)
 		const char *data;
 		struct snapshot_iterator *it = entry->iterator;
 		while ((rc = it->next(it, &data, &size)) == 0 && data != NULL) {
-			if (checkpoint_write_tuple(&snap, entry->space_id,
+			if (checkpoint_write_tuple(writer, entry->space_id,
 					entry->group_id, data, size) != 0)
 				goto fail;
 		}
 		if (rc != 0)
 			goto fail;
 	}
-	if (checkpoint_write_raft(&snap, &ckpt->raft) != 0)
+	if (checkpoint_write_raft(writer, &ckpt->raft) != 0)
 		goto fail;
-	if (xlog_flush(&snap) < 0)
+	if (snap_writer_flush(writer) != 0)
 		goto fail;
 
+	snap_writer_delete(writer);
 	xlog_close(&snap, false);
 	say_info("done");
 	return 0;
 fail:
+	snap_writer_delete(writer);
 	xlog_close(&snap, false);
 	return -1;
 }
@@ -711,7 +1013,8 @@ memtx_engine_begin_checkpoint(struct engine *engine, bool is_scheduled)
 
 	assert(memtx->checkpoint == NULL);
 	memtx->checkpoint = checkpoint_new(memtx->snap_dir.dirname,
-					   memtx->snap_io_rate_limit);
+					   memtx->snap_io_rate_limit,
+					   memtx->snap_write_threads);
 	if (memtx->checkpoint == NULL)
 		return -1;
 
@@ -1064,7 +1367,8 @@ memtx_engine_gc_f(va_list va)
 struct memtx_engine *
 memtx_engine_new(const char *snap_dirname, bool force_recovery,
 		 uint64_t tuple_arena_max_size, uint32_t objsize_min,
-		 bool dontdump, float alloc_factor)
+		 bool dontdump, float alloc_factor,
+		 enum tuple_arena_huge_pages huge_pages, int numa_node)
 {
 	struct memtx_engine *memtx = calloc(1, sizeof(*memtx));
 	if (memtx == NULL) {
@@ -1130,6 +1434,27 @@ memtx_engine_new(const char *snap_dirname, bool force_recovery,
 	quota_init(&memtx->quota, tuple_arena_max_size);
 	tuple_arena_create(&memtx->arena, &memtx->quota, tuple_arena_max_size,
 			   SLAB_SIZE, dontdump, "memtx");
+	/* Must precede NUMA binding as it may remap the arena. */
+	memtx->huge_pages = tuple_arena_use_huge_pages(&memtx->arena,
+						       huge_pages, dontdump,
+						       "memtx");
+	memtx->numa_node = -1;
+	if (numa_node >= 0) {
+		/*
+		 * The arena is mapped but not touched yet, so
+		 * binding it now makes all tuples allocated on
+		 * the node regardless of the thread faulting
+		 * the pages in.
+		 */
+		if (numa_bind_memory(memtx->arena.arena,
+				     memtx->arena.prealloc, numa_node) == 0) {
+			memtx->numa_node = numa_node;
+			say_info("memtx tuple arena is bound to NUMA node %d",
+				 numa_node);
+		} else {
+			diag_log();
+		}
+	}
 	slab_cache_create(&memtx->slab_cache, &memtx->arena);
 	float actual_alloc_factor;
 	small_alloc_create(&memtx->alloc, &memtx->slab_cache,
@@ -1177,6 +1502,18 @@ memtx_engine_set_snap_io_rate_limit(struct memtx_engine *memtx, double limit)
 	memtx->snap_io_rate_limit = limit * 1024 * 1024;
 }
 
+void
+memtx_engine_set_snap_read_threads(struct memtx_engine *memtx, int count)
+{
+	memtx->snap_read_threads = count;
+}
+
+void
+memtx_engine_set_snap_write_threads(struct memtx_engine *memtx, int count)
+{
+	memtx->snap_write_threads = count;
+}
+
 int
 memtx_engine_set_memory(struct memtx_engine *memtx, size_t size)
 {
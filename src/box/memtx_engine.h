@@ -38,6 +38,7 @@
 #include <small/mempool.h>
 
 #include "engine.h"
+#include "tuple.h"
 #include "xlog.h"
 #include "salad/stailq.h"
 
@@ -119,6 +120,16 @@ struct memtx_engine {
 	uint64_t snap_io_rate_limit;
 	/** Skip invalid snapshot records if this flag is set. */
 	bool force_recovery;
+	/**
+	 * Number of threads decoding the snapshot on recovery.
+	 * If zero, the snapshot is read by the tx thread.
+	 */
+	int snap_read_threads;
+	/**
+	 * Number of threads compressing the snapshot. If zero,
+	 * the snapshot is compressed by the checkpoint thread.
+	 */
+	int snap_write_threads;
 	/**
 	 * Cord being currently used to join replica. It is only
 	 * needed to be able to cancel it on shutdown.
@@ -133,6 +144,13 @@ struct memtx_engine {
 	 * is reflected in box.slab.info(), @sa lua/slab.c.
 	 */
 	struct slab_arena arena;
+	/**
+	 * NUMA node the arena is bound to or -1 if the arena
+	 * isn't bound to any node.
+	 */
+	int numa_node;
+	/** How the arena is actually backed by huge pages. */
+	enum tuple_arena_huge_pages huge_pages;
 	/** Slab cache for allocating tuples. */
 	struct slab_cache slab_cache;
 	/** Tuple allocator. */
@@ -209,11 +227,18 @@ void
 memtx_engine_schedule_gc(struct memtx_engine *memtx,
 			 struct memtx_gc_task *task);
 
+/**
+ * Create the memtx engine. The tuple arena is backed by huge
+ * pages according to @a huge_pages, if possible. If
+ * @a numa_node is not negative, the arena is bound to the given
+ * NUMA node.
+ */
 struct memtx_engine *
 memtx_engine_new(const char *snap_dirname, bool force_recovery,
 		 uint64_t tuple_arena_max_size,
 		 uint32_t objsize_min, bool dontdump,
-		 float alloc_factor);
+		 float alloc_factor,
+		 enum tuple_arena_huge_pages huge_pages, int numa_node);
 
 int
 memtx_engine_recover_snapshot(struct memtx_engine *memtx,
@@ -222,6 +247,21 @@ memtx_engine_recover_snapshot(struct memtx_engine *memtx,
 void
 memtx_engine_set_snap_io_rate_limit(struct memtx_engine *memtx, double limit);
 
+/**
+ * Set the number of threads decoding the snapshot on recovery,
+ * box.cfg.memtx_snap_read_threads.
+ */
+void
+memtx_engine_set_snap_read_threads(struct memtx_engine *memtx, int count);
+
+/**
+ * Set the number of threads compressing the snapshot,
+ * box.cfg.memtx_snap_write_threads. Takes effect on the next
+ * checkpoint.
+ */
+void
+memtx_engine_set_snap_write_threads(struct memtx_engine *memtx, int count);
+
 int
 memtx_engine_set_memory(struct memtx_engine *memtx, size_t size);
 
@@ -258,7 +298,11 @@ extern struct tuple_format_vtab memtx_tuple_format_vtab;
 
 enum {
 	MEMTX_EXTENT_SIZE = 16 * 1024,
-	MEMTX_SLAB_SIZE = 4 * 1024 * 1024
+	MEMTX_SLAB_SIZE = 4 * 1024 * 1024,
+	/** Max value of box.cfg.memtx_snap_read_threads. */
+	MEMTX_SNAP_READ_THREADS_MAX = 64,
+	/** Max value of box.cfg.memtx_snap_write_threads. */
+	MEMTX_SNAP_WRITE_THREADS_MAX = 64,
 };
 
 /**
@@ -299,13 +343,14 @@ static inline struct memtx_engine *
 memtx_engine_new_xc(const char *snap_dirname, bool force_recovery,
 		    uint64_t tuple_arena_max_size,
 		    uint32_t objsize_min, bool dontdump,
-		    float alloc_factor)
+		    float alloc_factor,
+		    enum tuple_arena_huge_pages huge_pages, int numa_node)
 {
 	struct memtx_engine *memtx;
 	memtx = memtx_engine_new(snap_dirname, force_recovery,
 				 tuple_arena_max_size,
 				 objsize_min, dontdump,
-				 alloc_factor);
+				 alloc_factor, huge_pages, numa_node);
 	if (memtx == NULL)
 		diag_raise();
 	return memtx;
@@ -197,6 +197,8 @@ struct memtx_tree_index {
 	memtx_tree_t<USE_HINT> tree;
 	struct memtx_tree_data<USE_HINT> *build_array;
 	size_t build_array_size, build_array_alloc_size;
+	/** Set if build_array is sorted and deduplicated. */
+	bool build_array_is_sorted;
 	struct memtx_gc_task gc_task;
 	memtx_tree_iterator_t<USE_HINT> gc_iterator;
 };
@@ -1396,12 +1398,15 @@ memtx_tree_index_build_array_deduplicate(struct memtx_tree_index<USE_HINT> *inde
 	index->build_array_size = w_idx + 1;
 }
 
+/**
+ * Sort build_array of specified index and remove duplicates.
+ * Doesn't touch the tree, so it's safe to call from any thread
+ * for plain and multikey indexes.
+ */
 template <bool USE_HINT>
 static void
-memtx_tree_index_end_build(struct index *base)
+memtx_tree_index_sort_build_array(struct memtx_tree_index<USE_HINT> *index)
 {
-	struct memtx_tree_index<USE_HINT> *index =
-		(struct memtx_tree_index<USE_HINT> *)base;
 	struct key_def *cmp_def = memtx_tree_cmp_def(&index->tree);
 	qsort_arg(index->build_array, index->build_array_size,
 		  sizeof(index->build_array[0]),
@@ -1419,6 +1424,17 @@ memtx_tree_index_end_build(struct index *base)
 		memtx_tree_index_build_array_deduplicate<USE_HINT>(index,
 							 tuple_chunk_delete);
 	}
+	index->build_array_is_sorted = true;
+}
+
+template <bool USE_HINT>
+static void
+memtx_tree_index_end_build(struct index *base)
+{
+	struct memtx_tree_index<USE_HINT> *index =
+		(struct memtx_tree_index<USE_HINT> *)base;
+	if (!index->build_array_is_sorted)
+		memtx_tree_index_sort_build_array<USE_HINT>(index);
 	memtx_tree_build(&index->tree, index->build_array,
 			 index->build_array_size);
 
@@ -1426,6 +1442,7 @@ memtx_tree_index_end_build(struct index *base)
 	index->build_array = NULL;
 	index->build_array_size = 0;
 	index->build_array_alloc_size = 0;
+	index->build_array_is_sorted = false;
 }
 
 template <bool USE_HINT>
@@ -1707,6 +1724,45 @@ memtx_tree_index_new_tpl(struct memtx_engine *memtx, struct index_def *def,
 	return &index->base;
 }
 
+bool
+memtx_tree_index_build_is_thread_safe(struct index *index)
+{
+	/*
+	 * Keys of a functional index are produced by a Lua
+	 * function and allocated on the tx thread.
+	 */
+	return index->vtab == &memtx_tree_no_hint_index_vtab ||
+	       index->vtab == &memtx_tree_use_hint_index_vtab ||
+	       index->vtab == &memtx_tree_index_multikey_vtab;
+}
+
+template <bool USE_HINT>
+static int
+memtx_tree_index_build_keys_tpl(struct index *base, struct tuple **tuples,
+				size_t count)
+{
+	struct memtx_tree_index<USE_HINT> *index =
+		(struct memtx_tree_index<USE_HINT> *)base;
+	for (size_t i = 0; i < count; i++) {
+		if (index_build_next(base, tuples[i]) != 0)
+			return -1;
+	}
+	memtx_tree_index_sort_build_array<USE_HINT>(index);
+	return 0;
+}
+
+int
+memtx_tree_index_build_keys(struct index *index, struct tuple **tuples,
+			    size_t count)
+{
+	assert(memtx_tree_index_build_is_thread_safe(index));
+	if (index->vtab == &memtx_tree_no_hint_index_vtab) {
+		return memtx_tree_index_build_keys_tpl<false>(index, tuples,
+							      count);
+	}
+	return memtx_tree_index_build_keys_tpl<true>(index, tuples, count);
+}
+
 struct index *
 memtx_tree_index_new(struct memtx_engine *memtx, struct index_def *def)
 {
@@ -31,6 +31,9 @@
  * SUCH DAMAGE.
  */
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #if defined(__cplusplus)
 extern "C" {
 #endif /* defined(__cplusplus) */
@@ -38,10 +41,30 @@ extern "C" {
 struct index;
 struct index_def;
 struct memtx_engine;
+struct tuple;
 
 struct index *
 memtx_tree_index_new(struct memtx_engine *memtx, struct index_def *def);
 
+/**
+ * Check if memtx_tree_index_build_keys() may be called for
+ * the index from a thread other than tx.
+ */
+bool
+memtx_tree_index_build_is_thread_safe(struct index *index);
+
+/**
+ * Add keys of @a tuples to the index being built and sort them,
+ * so that only the bulk load of the tree is left to
+ * index_end_build(). Called between index_begin_build() and
+ * index_end_build() instead of index_build_next(). Doesn't use
+ * the engine allocators, so it may be called from a worker
+ * thread if memtx_tree_index_build_is_thread_safe() is true.
+ */
+int
+memtx_tree_index_build_keys(struct index *index, struct tuple **tuples,
+			    size_t count);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif /* defined(__cplusplus) */
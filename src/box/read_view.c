@@ -0,0 +1,170 @@
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "read_view.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "coio_task.h"
+#include "diag.h"
+#include "error.h"
+#include "index.h"
+#include "schema.h"
+#include "space.h"
+#include "tuple.h"
+
+/** Free the snapshot iterators of a read view and the view. */
+static void
+read_view_delete(struct read_view *rv)
+{
+	for (uint32_t i = 0; i < rv->space_count; i++) {
+		struct snapshot_iterator *it = rv->spaces[i].iterator;
+		if (it != NULL)
+			it->free(it);
+		struct tuple_format *format = rv->spaces[i].format;
+		if (format != NULL)
+			tuple_format_unref(format);
+	}
+	latch_destroy(&rv->latch);
+	free(rv->spaces);
+	free(rv);
+}
+
+struct read_view *
+read_view_open(const uint32_t *space_ids, uint32_t space_count)
+{
+	struct read_view *rv = malloc(sizeof(*rv));
+	if (rv == NULL) {
+		diag_set(OutOfMemory, sizeof(*rv), "malloc",
+			 "struct read_view");
+		return NULL;
+	}
+	rv->spaces = calloc(space_count, sizeof(*rv->spaces));
+	if (rv->spaces == NULL && space_count > 0) {
+		diag_set(OutOfMemory, space_count * sizeof(*rv->spaces),
+			 "calloc", "struct read_view_space");
+		free(rv);
+		return NULL;
+	}
+	rv->space_count = space_count;
+	latch_create(&rv->latch);
+	rv->n_readers = 0;
+	rv->is_closed = false;
+	/*
+	 * All iterators are created without yields, so the
+	 * read view is consistent across the spaces.
+	 */
+	for (uint32_t i = 0; i < space_count; i++) {
+		struct space *space = space_cache_find(space_ids[i]);
+		if (space == NULL)
+			goto fail;
+		if (!space_is_memtx(space)) {
+			diag_set(ClientError, ER_UNSUPPORTED,
+				 space->engine->name, "read view");
+			goto fail;
+		}
+		if (access_check_space(space, PRIV_R) != 0)
+			goto fail;
+		struct index *pk = space_index(space, 0);
+		if (pk == NULL) {
+			diag_set(ClientError, ER_NO_SUCH_INDEX_ID, 0,
+				 space_name(space));
+			goto fail;
+		}
+		rv->spaces[i].id = space_ids[i];
+		rv->spaces[i].iterator = index_create_snapshot_iterator(pk);
+		if (rv->spaces[i].iterator == NULL)
+			goto fail;
+		struct space_def *def = space->def;
+		struct tuple_format *format = tuple_format_new(
+			&tuple_format_runtime->vtab, NULL, NULL, 0,
+			def->fields, def->field_count, def->exact_field_count,
+			def->dict, false, false);
+		if (format == NULL)
+			goto fail;
+		tuple_format_ref(format);
+		rv->spaces[i].format = format;
+	}
+	return rv;
+fail:
+	read_view_delete(rv);
+	return NULL;
+}
+
+void
+read_view_close(struct read_view *rv)
+{
+	assert(!rv->is_closed);
+	rv->is_closed = true;
+	if (rv->n_readers == 0)
+		read_view_delete(rv);
+}
+
+struct read_view_space *
+read_view_space_by_id(struct read_view *rv, uint32_t space_id)
+{
+	for (uint32_t i = 0; i < rv->space_count; i++) {
+		if (rv->spaces[i].id == space_id)
+			return &rv->spaces[i];
+	}
+	return NULL;
+}
+
+static ssize_t
+read_view_call_f(va_list ap)
+{
+	struct read_view *rv = va_arg(ap, struct read_view *);
+	read_view_f func = va_arg(ap, read_view_f);
+	void *arg = va_arg(ap, void *);
+	return func(rv, arg);
+}
+
+int
+read_view_call(struct read_view *rv, read_view_f func, void *arg)
+{
+	if (rv->is_closed) {
+		diag_set(ClientError, ER_READ_VIEW_CLOSED);
+		return -1;
+	}
+	rv->n_readers++;
+	latch_lock(&rv->latch);
+	int rc;
+	if (rv->is_closed) {
+		diag_set(ClientError, ER_READ_VIEW_CLOSED);
+		rc = -1;
+	} else {
+		rc = coio_call(read_view_call_f, rv, func, arg);
+	}
+	latch_unlock(&rv->latch);
+	if (--rv->n_readers == 0 && rv->is_closed)
+		read_view_delete(rv);
+	return rc;
+}
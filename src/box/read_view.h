@@ -0,0 +1,133 @@
+#pragma once
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "latch.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+struct snapshot_iterator;
+struct tuple_format;
+
+/** A space in a read view. */
+struct read_view_space {
+	/** Space id. */
+	uint32_t id;
+	/**
+	 * Iterator over the primary index of the space as it was
+	 * when the read view was opened.
+	 */
+	struct snapshot_iterator *iterator;
+	/**
+	 * Runtime format with the field names of the space,
+	 * which fetched tuples are created with.
+	 */
+	struct tuple_format *format;
+};
+
+/**
+ * A consistent read view of memtx spaces, built on the snapshot
+ * iterators used for checkpoints. A read view is opened and
+ * closed in tx thread, but is read in a worker thread, see
+ * read_view_call(), so a long scan doesn't block tx thread.
+ *
+ * Until a read view is closed, memtx doesn't free tuples and
+ * index blocks it may refer to (see memtx_enter_delayed_free_mode()),
+ * so a read view shouldn't be kept open for long under a write
+ * load.
+ */
+struct read_view {
+	/** Spaces of the read view. */
+	struct read_view_space *spaces;
+	/** Number of spaces in the read view. */
+	uint32_t space_count;
+	/**
+	 * Serializes readers of the read view: a snapshot
+	 * iterator may be used by one thread at a time.
+	 */
+	struct latch latch;
+	/** Number of fibers reading or waiting to read the view. */
+	int n_readers;
+	/**
+	 * Set if the read view was closed while being read.
+	 * The last reader frees it then.
+	 */
+	bool is_closed;
+};
+
+/**
+ * Open a read view of memtx spaces with the given ids.
+ * The current user must be able to read the spaces.
+ * Must be called in tx thread.
+ * Returns NULL and sets diag on error.
+ */
+struct read_view *
+read_view_open(const uint32_t *space_ids, uint32_t space_count);
+
+/**
+ * Close a read view opened with read_view_open(). If the view
+ * is being read, it is freed when the current reader completes,
+ * while the waiting readers fail. Must be called in tx thread.
+ */
+void
+read_view_close(struct read_view *rv);
+
+/**
+ * Find a space with the given id in a read view.
+ * Returns NULL if there is no such space in the read view.
+ */
+struct read_view_space *
+read_view_space_by_id(struct read_view *rv, uint32_t space_id);
+
+/**
+ * A function reading a read view in a worker thread. Must set
+ * diag and return -1 on error. Must not touch anything but the
+ * read view and @a arg.
+ */
+typedef int (*read_view_f)(struct read_view *rv, void *arg);
+
+/**
+ * Execute @a func in a worker thread of the coio pool, yielding
+ * the current fiber until it completes. Calls of the same read
+ * view are executed one by one.
+ * Returns the value returned by @a func, with diag moved to
+ * the current fiber on error.
+ */
+int
+read_view_call(struct read_view *rv, read_view_f func, void *arg);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
@@ -0,0 +1,481 @@
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "snap_reader.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "fiber.h"
+#include "iproto_constants.h"
+#include "trivia/util.h"
+#include "tt_pthread.h"
+#include "xlog.h"
+
+enum {
+	/** Max number of blocks in flight per decoder thread. */
+	SNAP_READER_BLOCKS_PER_DECODER = 8,
+	/** Initial size of the row array of a batch. */
+	SNAP_BATCH_ROWS_MIN = 64,
+};
+
+/** A decoder thread. */
+struct snap_decoder {
+	struct cord cord;
+	/** Decompression context of the thread. */
+	ZSTD_DStream *zdctx;
+	struct snap_reader *reader;
+};
+
+struct snap_reader {
+	/** Path to the snapshot file. */
+	char filename[PATH_MAX];
+	/** Skip broken tx blocks. */
+	bool force_recovery;
+	/** The reader thread. */
+	struct cord cord;
+	/** Set if the reader thread has been started. */
+	bool is_started;
+	/** Decoder threads. */
+	struct snap_decoder *decoders;
+	/** Number of decoder threads. */
+	int decoder_count;
+	/** Number of decoder threads started. */
+	int decoders_started;
+	/** Protects all members below. */
+	pthread_mutex_t mutex;
+	/** Signalled when a batch is returned to the caller. */
+	pthread_cond_t reader_cond;
+	/** Signalled when a batch is queued for decoding. */
+	pthread_cond_t decoder_cond;
+	/** Signalled when a batch is ready. */
+	pthread_cond_t tx_cond;
+	/** Batches waiting for a decoder, linked by in_decode_queue. */
+	struct stailq decode_queue;
+	/**
+	 * Batches read but not returned to the caller yet,
+	 * indexed by seq modulo window_size.
+	 */
+	struct snap_batch **window;
+	/** Max number of batches in flight. */
+	int window_size;
+	/** Sequence number of the next batch to read. */
+	int64_t read_seq;
+	/** Sequence number of the next batch to return. */
+	int64_t next_seq;
+	/** Set when the reader thread is done with the file. */
+	bool is_done;
+	/** Set if the eof marker has been found. */
+	bool is_eof;
+	/** Set by snap_reader_delete() to stop all threads. */
+	bool is_stopped;
+	/** Error that stopped the reader thread. */
+	struct diag diag;
+};
+
+static struct snap_batch *
+snap_batch_new(void)
+{
+	struct snap_batch *batch = calloc(1, sizeof(*batch));
+	if (batch == NULL) {
+		diag_set(OutOfMemory, sizeof(*batch), "calloc",
+			 "struct snap_batch");
+		return NULL;
+	}
+	diag_create(&batch->diag);
+	return batch;
+}
+
+void
+snap_batch_delete(struct snap_batch *batch)
+{
+	diag_destroy(&batch->diag);
+	free(batch->rows);
+	free(batch->rows_buf);
+	free(batch->data);
+	free(batch);
+}
+
+/**
+ * Decode a raw tx block. Runs in a decoder thread. Errors are
+ * stored in the batch diag.
+ */
+static void
+snap_batch_decode(struct snap_batch *batch, ZSTD_DStream *zdctx)
+{
+	const char *data = batch->data;
+	const char *data_end = data + batch->data_size;
+	struct xlog_tx_cursor tx_cursor;
+	ssize_t rc = xlog_tx_cursor_create(&tx_cursor, &data, data_end,
+					   zdctx);
+	free(batch->data);
+	batch->data = NULL;
+	if (rc != 0) {
+		/* The reader passes whole blocks only. */
+		assert(rc < 0);
+		goto error;
+	}
+	/*
+	 * The tx cursor buffer is allocated on the slab cache of
+	 * this thread, so the rows are copied out to be freed by
+	 * the caller.
+	 */
+	size_t size = ibuf_used(&tx_cursor.rows);
+	batch->rows_buf = malloc(size);
+	if (batch->rows_buf == NULL) {
+		xlog_tx_cursor_destroy(&tx_cursor);
+		diag_set(OutOfMemory, size, "malloc", "snapshot rows");
+		goto error;
+	}
+	memcpy(batch->rows_buf, tx_cursor.rows.rpos, size);
+	xlog_tx_cursor_destroy(&tx_cursor);
+
+	const char *pos = batch->rows_buf;
+	const char *end = pos + size;
+	while (pos < end) {
+		if (batch->row_count == batch->row_capacity) {
+			int capacity = MAX(batch->row_capacity * 2,
+					   SNAP_BATCH_ROWS_MIN);
+			struct snap_row *rows = realloc(batch->rows,
+						capacity * sizeof(*rows));
+			if (rows == NULL) {
+				diag_set(OutOfMemory,
+					 capacity * sizeof(*rows),
+					 "realloc", "snapshot rows");
+				goto error;
+			}
+			batch->rows = rows;
+			batch->row_capacity = capacity;
+		}
+		struct snap_row *row = &batch->rows[batch->row_count];
+		if (xrow_header_decode(&row->header, &pos, end, false) != 0) {
+			diag_set(XlogError, "can't parse row");
+			goto error;
+		}
+		row->is_decoded = false;
+		if (row->header.type == IPROTO_INSERT &&
+		    row->header.bodycnt == 1) {
+			/*
+			 * Leave the row to the caller on failure
+			 * to get the error there.
+			 */
+			if (xrow_decode_dml(&row->header, &row->request,
+				dml_request_key_map(IPROTO_INSERT)) == 0)
+				row->is_decoded = true;
+			else
+				diag_clear(diag_get());
+		}
+		batch->row_count++;
+	}
+	goto out;
+error:
+	diag_move(diag_get(), &batch->diag);
+out:
+	/* The row array could have been moved by realloc(). */
+	for (int i = 0; i < batch->row_count; i++) {
+		struct snap_row *row = &batch->rows[i];
+		if (row->is_decoded)
+			row->request.header = &row->header;
+	}
+}
+
+/**
+ * Pass a batch to decoder threads or, if the batch is ready,
+ * to the caller. Waits for a free slot in the window. Returns
+ * false and frees the batch if the reader is stopped.
+ */
+static bool
+snap_reader_push(struct snap_reader *reader, struct snap_batch *batch)
+{
+	tt_pthread_mutex_lock(&reader->mutex);
+	while (!reader->is_stopped &&
+	       reader->read_seq - reader->next_seq >= reader->window_size)
+		tt_pthread_cond_wait(&reader->reader_cond, &reader->mutex);
+	bool is_stopped = reader->is_stopped;
+	if (!is_stopped) {
+		batch->seq = reader->read_seq++;
+		reader->window[batch->seq % reader->window_size] = batch;
+		if (batch->is_ready) {
+			tt_pthread_cond_signal(&reader->tx_cond);
+		} else {
+			stailq_add_tail_entry(&reader->decode_queue, batch,
+					      in_decode_queue);
+			tt_pthread_cond_signal(&reader->decoder_cond);
+		}
+	}
+	tt_pthread_mutex_unlock(&reader->mutex);
+	if (is_stopped)
+		snap_batch_delete(batch);
+	return !is_stopped;
+}
+
+/**
+ * Push a batch with the current diag error. Used to let the
+ * caller decide whether a broken block can be skipped.
+ */
+static bool
+snap_reader_push_error(struct snap_reader *reader)
+{
+	struct snap_batch *batch = snap_batch_new();
+	if (batch == NULL)
+		return false;
+	diag_move(diag_get(), &batch->diag);
+	batch->is_ready = true;
+	return snap_reader_push(reader, batch);
+}
+
+/** Reader thread function. */
+static int
+snap_reader_f(va_list ap)
+{
+	struct snap_reader *reader = va_arg(ap, struct snap_reader *);
+	struct xlog_cursor cursor;
+	bool is_eof = false;
+	if (xlog_cursor_open(&cursor, reader->filename) != 0)
+		goto done;
+	while (true) {
+		const char *data;
+		size_t size;
+		int rc = xlog_cursor_next_raw_tx(&cursor, &data, &size);
+		if (rc > 0)
+			break;
+		if (rc < 0) {
+			struct error *e = diag_last_error(diag_get());
+			if (!reader->force_recovery ||
+			    e->type != &type_XlogError)
+				break;
+			if (!snap_reader_push_error(reader))
+				break;
+			rc = xlog_cursor_find_tx_magic(&cursor);
+			if (rc != 0)
+				break;
+			continue;
+		}
+		struct snap_batch *batch = snap_batch_new();
+		if (batch == NULL)
+			break;
+		batch->data = malloc(size);
+		if (batch->data == NULL) {
+			snap_batch_delete(batch);
+			diag_set(OutOfMemory, size, "malloc", "snapshot tx");
+			break;
+		}
+		memcpy(batch->data, data, size);
+		batch->data_size = size;
+		if (!snap_reader_push(reader, batch))
+			break;
+	}
+	is_eof = xlog_cursor_is_eof(&cursor);
+	xlog_cursor_close(&cursor, false);
+done:
+	tt_pthread_mutex_lock(&reader->mutex);
+	reader->is_done = true;
+	reader->is_eof = is_eof;
+	if (!diag_is_empty(diag_get()))
+		diag_move(diag_get(), &reader->diag);
+	tt_pthread_cond_broadcast(&reader->decoder_cond);
+	tt_pthread_cond_broadcast(&reader->tx_cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	return 0;
+}
+
+/** Decoder thread function. */
+static int
+snap_decoder_f(va_list ap)
+{
+	struct snap_decoder *decoder = va_arg(ap, struct snap_decoder *);
+	struct snap_reader *reader = decoder->reader;
+	tt_pthread_mutex_lock(&reader->mutex);
+	while (!reader->is_stopped) {
+		if (stailq_empty(&reader->decode_queue)) {
+			if (reader->is_done)
+				break;
+			tt_pthread_cond_wait(&reader->decoder_cond,
+					     &reader->mutex);
+			continue;
+		}
+		struct snap_batch *batch;
+		batch = stailq_shift_entry(&reader->decode_queue,
+					   struct snap_batch, in_decode_queue);
+		tt_pthread_mutex_unlock(&reader->mutex);
+		snap_batch_decode(batch, decoder->zdctx);
+		tt_pthread_mutex_lock(&reader->mutex);
+		batch->is_ready = true;
+		tt_pthread_cond_signal(&reader->tx_cond);
+	}
+	tt_pthread_mutex_unlock(&reader->mutex);
+	return 0;
+}
+
+struct snap_reader *
+snap_reader_new(const char *filename, int decoder_count,
+		bool force_recovery)
+{
+	assert(decoder_count > 0);
+	struct snap_reader *reader = calloc(1, sizeof(*reader));
+	if (reader == NULL) {
+		diag_set(OutOfMemory, sizeof(*reader), "calloc",
+			 "struct snap_reader");
+		return NULL;
+	}
+	snprintf(reader->filename, sizeof(reader->filename), "%s",
+		 filename);
+	reader->force_recovery = force_recovery;
+	tt_pthread_mutex_init(&reader->mutex, NULL);
+	tt_pthread_cond_init(&reader->reader_cond, NULL);
+	tt_pthread_cond_init(&reader->decoder_cond, NULL);
+	tt_pthread_cond_init(&reader->tx_cond, NULL);
+	stailq_create(&reader->decode_queue);
+	diag_create(&reader->diag);
+
+	int window_size = decoder_count * SNAP_READER_BLOCKS_PER_DECODER;
+	reader->window = calloc(window_size, sizeof(*reader->window));
+	if (reader->window == NULL) {
+		diag_set(OutOfMemory, window_size * sizeof(*reader->window),
+			 "calloc", "snap_reader window");
+		goto error;
+	}
+	reader->window_size = window_size;
+	reader->decoders = calloc(decoder_count, sizeof(*reader->decoders));
+	if (reader->decoders == NULL) {
+		diag_set(OutOfMemory,
+			 decoder_count * sizeof(*reader->decoders),
+			 "calloc", "snap_reader decoders");
+		goto error;
+	}
+	reader->decoder_count = decoder_count;
+	for (int i = 0; i < decoder_count; i++) {
+		struct snap_decoder *decoder = &reader->decoders[i];
+		decoder->reader = reader;
+		decoder->zdctx = ZSTD_createDStream();
+		if (decoder->zdctx == NULL) {
+			diag_set(ClientError, ER_DECOMPRESSION,
+				 "failed to create context");
+			goto error;
+		}
+	}
+	if (cord_costart(&reader->cord, "snap.reader",
+			 snap_reader_f, reader) != 0)
+		goto error;
+	reader->is_started = true;
+	for (int i = 0; i < decoder_count; i++) {
+		struct snap_decoder *decoder = &reader->decoders[i];
+		char name[FIBER_NAME_MAX];
+		snprintf(name, sizeof(name), "snap.decoder.%d", i);
+		if (cord_costart(&decoder->cord, name,
+				 snap_decoder_f, decoder) != 0)
+			goto error;
+		reader->decoders_started++;
+	}
+	return reader;
+error:
+	snap_reader_delete(reader);
+	return NULL;
+}
+
+void
+snap_reader_delete(struct snap_reader *reader)
+{
+	tt_pthread_mutex_lock(&reader->mutex);
+	reader->is_stopped = true;
+	tt_pthread_cond_broadcast(&reader->reader_cond);
+	tt_pthread_cond_broadcast(&reader->decoder_cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	/* Don't lose the error the reader was created with. */
+	struct diag diag;
+	diag_create(&diag);
+	diag_move(diag_get(), &diag);
+	if (reader->is_started)
+		cord_join(&reader->cord);
+	for (int i = 0; i < reader->decoders_started; i++)
+		cord_join(&reader->decoders[i].cord);
+	diag_move(&diag, diag_get());
+	diag_destroy(&diag);
+
+	for (int i = 0; i < reader->window_size; i++) {
+		if (reader->window[i] != NULL)
+			snap_batch_delete(reader->window[i]);
+	}
+	for (int i = 0; i < reader->decoder_count; i++) {
+		if (reader->decoders[i].zdctx != NULL)
+			ZSTD_freeDStream(reader->decoders[i].zdctx);
+	}
+	diag_destroy(&reader->diag);
+	tt_pthread_cond_destroy(&reader->tx_cond);
+	tt_pthread_cond_destroy(&reader->decoder_cond);
+	tt_pthread_cond_destroy(&reader->reader_cond);
+	tt_pthread_mutex_destroy(&reader->mutex);
+	free(reader->decoders);
+	free(reader->window);
+	free(reader);
+}
+
+int
+snap_reader_next(struct snap_reader *reader, struct snap_batch **batch)
+{
+	int rc = 0;
+	*batch = NULL;
+	tt_pthread_mutex_lock(&reader->mutex);
+	while (true) {
+		if (reader->next_seq < reader->read_seq) {
+			int i = reader->next_seq % reader->window_size;
+			struct snap_batch *next = reader->window[i];
+			if (next->is_ready) {
+				reader->window[i] = NULL;
+				reader->next_seq++;
+				tt_pthread_cond_signal(&reader->reader_cond);
+				*batch = next;
+				break;
+			}
+		} else if (reader->is_done) {
+			if (!diag_is_empty(&reader->diag)) {
+				diag_move(&reader->diag, diag_get());
+				rc = -1;
+			}
+			break;
+		}
+		tt_pthread_cond_wait(&reader->tx_cond, &reader->mutex);
+	}
+	tt_pthread_mutex_unlock(&reader->mutex);
+	return rc;
+}
+
+bool
+snap_reader_is_eof(struct snap_reader *reader)
+{
+	tt_pthread_mutex_lock(&reader->mutex);
+	bool is_eof = reader->is_eof;
+	tt_pthread_mutex_unlock(&reader->mutex);
+	return is_eof;
+}
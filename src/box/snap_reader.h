@@ -0,0 +1,135 @@
+#pragma once
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "diag.h"
+#include "salad/stailq.h"
+#include "xrow.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Snapshot reader reads a snapshot file with a pipeline of
+ * threads. The reader thread splits the file into raw tx blocks,
+ * decoder threads check and decompress the blocks and decode the
+ * rows, and the caller gets decoded blocks in the file order.
+ */
+struct snap_reader;
+
+/** A row decoded by a decoder thread. */
+struct snap_row {
+	/** Row header, the body points to snap_batch::rows_buf. */
+	struct xrow_header header;
+	/**
+	 * INSERT request decoded from the row body. Set only if
+	 * is_decoded is true. Rows of other types and rows that
+	 * failed to decode are left to the caller.
+	 */
+	struct request request;
+	bool is_decoded;
+};
+
+/** Rows of a snapshot tx block. */
+struct snap_batch {
+	/** Link in snap_reader::decode_queue. */
+	struct stailq_entry in_decode_queue;
+	/** Sequence number of the block in the file. */
+	int64_t seq;
+	/** Set when the block has been decoded. */
+	bool is_ready;
+	/** The raw block, freed once decoded. */
+	char *data;
+	/** Size of the raw block. */
+	size_t data_size;
+	/** Decompressed rows. */
+	char *rows_buf;
+	/** Decoded rows. */
+	struct snap_row *rows;
+	/** Number of decoded rows. */
+	int row_count;
+	/** Number of rows allocated. */
+	int row_capacity;
+	/**
+	 * Error that stopped reading or decoding of the block.
+	 * The rows decoded before the error are valid.
+	 */
+	struct diag diag;
+};
+
+/** Free a batch returned by snap_reader_next(). */
+void
+snap_batch_delete(struct snap_batch *batch);
+
+/**
+ * Start reading snapshot @a filename with @a decoder_count
+ * decoder threads. If @a force_recovery is set, the reader
+ * skips a broken tx block and looks for the next one, otherwise
+ * it stops at the first error.
+ *
+ * Returns NULL and sets diag on error.
+ */
+struct snap_reader *
+snap_reader_new(const char *filename, int decoder_count,
+		bool force_recovery);
+
+/**
+ * Stop the reader threads and free the reader.
+ */
+void
+snap_reader_delete(struct snap_reader *reader);
+
+/**
+ * Wait for the next block of the snapshot to be decoded and
+ * return it in @a batch. The batch must be freed with
+ * snap_batch_delete(). *batch is set to NULL when the whole
+ * file has been read.
+ *
+ * @retval 0 success
+ * @retval -1 the file can't be read further, check diag
+ */
+int
+snap_reader_next(struct snap_reader *reader, struct snap_batch **batch);
+
+/**
+ * Return true if the reader has found the eof marker. Valid
+ * after snap_reader_next() has returned the last batch.
+ */
+bool
+snap_reader_is_eof(struct snap_reader *reader);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
@@ -0,0 +1,432 @@
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "snap_writer.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "error.h"
+#include "fiber.h"
+#include "salad/stailq.h"
+#include "trivia/util.h"
+#include "tt_pthread.h"
+#include "xlog.h"
+#include "xrow.h"
+
+enum {
+	/**
+	 * Size of rows to compress at once, the same as the
+	 * xlog uses.
+	 */
+	SNAP_BLOCK_SIZE = 128 * 1024,
+	/** Max number of blocks in flight per compression thread. */
+	SNAP_WRITER_BLOCKS_PER_THREAD = 4,
+};
+
+/** A tx block of a snapshot. */
+struct snap_block {
+	/** Link in snap_writer::compress_queue. */
+	struct stailq_entry in_compress_queue;
+	/** Set when the block has been compressed. */
+	bool is_ready;
+	/** Encoded rows. */
+	char *rows;
+	/** Size of the encoded rows. */
+	size_t rows_size;
+	/** Size of the rows buffer. */
+	size_t rows_capacity;
+	/** Number of rows in the block. */
+	int64_t row_count;
+	/** The block ready to be written to the xlog. */
+	char *data;
+	/** Size of the block ready to be written. */
+	size_t data_size;
+	/** Compression error. */
+	struct diag diag;
+};
+
+/** A compression thread. */
+struct snap_compressor {
+	struct cord cord;
+	/** Compression context of the thread. */
+	ZSTD_CCtx *zctx;
+	struct snap_writer *writer;
+};
+
+struct snap_writer {
+	/** The xlog to write to. */
+	struct xlog *xlog;
+	/** Compression threads. */
+	struct snap_compressor *compressors;
+	/** Number of compression threads. */
+	int thread_count;
+	/** Number of compression threads started. */
+	int threads_started;
+	/** The block rows are added to. */
+	struct snap_block *block;
+	/** Number of rows added to the writer. */
+	int64_t row_count;
+	/** Protects all members below. */
+	pthread_mutex_t mutex;
+	/** Signalled when a block is queued for compression. */
+	pthread_cond_t compressor_cond;
+	/** Signalled when a block is compressed. */
+	pthread_cond_t writer_cond;
+	/** Blocks waiting for compression. */
+	struct stailq compress_queue;
+	/**
+	 * Blocks queued but not written yet, indexed by
+	 * sequence number modulo window_size.
+	 */
+	struct snap_block **window;
+	/** Max number of blocks in flight. */
+	int window_size;
+	/** Sequence number of the next block to queue. */
+	int64_t queued_seq;
+	/** Sequence number of the next block to write. */
+	int64_t written_seq;
+	/** Set by snap_writer_delete() to stop the threads. */
+	bool is_stopped;
+};
+
+static struct snap_block *
+snap_block_new(void)
+{
+	struct snap_block *block = calloc(1, sizeof(*block));
+	if (block == NULL) {
+		diag_set(OutOfMemory, sizeof(*block), "calloc",
+			 "struct snap_block");
+		return NULL;
+	}
+	diag_create(&block->diag);
+	return block;
+}
+
+static void
+snap_block_delete(struct snap_block *block)
+{
+	diag_destroy(&block->diag);
+	free(block->rows);
+	free(block->data);
+	free(block);
+}
+
+/**
+ * Compress a block. Runs in a compression thread. Errors are
+ * stored in the block diag.
+ */
+static void
+snap_block_compress(struct snap_block *block, ZSTD_CCtx *zctx)
+{
+	size_t size = xlog_tx_encode_bound(block->rows_size);
+	block->data = malloc(size);
+	if (block->data == NULL) {
+		diag_set(OutOfMemory, size, "malloc", "snapshot tx");
+		goto error;
+	}
+	ssize_t rc = xlog_tx_encode(block->rows, block->rows_size,
+				    block->data, zctx);
+	if (rc < 0)
+		goto error;
+	block->data_size = rc;
+	free(block->rows);
+	block->rows = NULL;
+	return;
+error:
+	diag_move(diag_get(), &block->diag);
+}
+
+/** Compression thread function. */
+static int
+snap_compressor_f(va_list ap)
+{
+	struct snap_compressor *compressor =
+		va_arg(ap, struct snap_compressor *);
+	struct snap_writer *writer = compressor->writer;
+	ZSTD_CCtx *zctx = writer->xlog->opts.no_compression ?
+			  NULL : compressor->zctx;
+	tt_pthread_mutex_lock(&writer->mutex);
+	while (!writer->is_stopped) {
+		if (stailq_empty(&writer->compress_queue)) {
+			tt_pthread_cond_wait(&writer->compressor_cond,
+					     &writer->mutex);
+			continue;
+		}
+		struct snap_block *block;
+		block = stailq_shift_entry(&writer->compress_queue,
+					   struct snap_block,
+					   in_compress_queue);
+		tt_pthread_mutex_unlock(&writer->mutex);
+		snap_block_compress(block, zctx);
+		tt_pthread_mutex_lock(&writer->mutex);
+		block->is_ready = true;
+		tt_pthread_cond_signal(&writer->writer_cond);
+	}
+	tt_pthread_mutex_unlock(&writer->mutex);
+	return 0;
+}
+
+/**
+ * Write compressed blocks to the xlog in order until a block
+ * that isn't compressed yet is met. Wait for compression of
+ * the blocks with sequence numbers less than @a until_seq.
+ */
+static int
+snap_writer_drain(struct snap_writer *writer, int64_t until_seq)
+{
+	while (true) {
+		struct snap_block *block = NULL;
+		tt_pthread_mutex_lock(&writer->mutex);
+		while (writer->written_seq < writer->queued_seq) {
+			int i = writer->written_seq % writer->window_size;
+			if (writer->window[i]->is_ready) {
+				block = writer->window[i];
+				writer->window[i] = NULL;
+				writer->written_seq++;
+				break;
+			}
+			if (writer->written_seq >= until_seq)
+				break;
+			tt_pthread_cond_wait(&writer->writer_cond,
+					     &writer->mutex);
+		}
+		tt_pthread_mutex_unlock(&writer->mutex);
+		if (block == NULL)
+			return 0;
+		int rc = 0;
+		if (!diag_is_empty(&block->diag)) {
+			diag_move(&block->diag, diag_get());
+			rc = -1;
+		} else if (xlog_write_raw_tx(writer->xlog, block->data,
+					     block->data_size,
+					     block->row_count) < 0) {
+			rc = -1;
+		}
+		snap_block_delete(block);
+		if (rc != 0)
+			return -1;
+	}
+}
+
+/** Pass the current block to the compression threads. */
+static int
+snap_writer_submit(struct snap_writer *writer)
+{
+	struct snap_block *block = writer->block;
+	writer->block = NULL;
+	/* Wait for a free slot in the window. */
+	if (snap_writer_drain(writer, writer->queued_seq -
+			      writer->window_size + 1) != 0) {
+		snap_block_delete(block);
+		return -1;
+	}
+	tt_pthread_mutex_lock(&writer->mutex);
+	writer->window[writer->queued_seq % writer->window_size] = block;
+	writer->queued_seq++;
+	stailq_add_tail_entry(&writer->compress_queue, block,
+			      in_compress_queue);
+	tt_pthread_cond_signal(&writer->compressor_cond);
+	tt_pthread_mutex_unlock(&writer->mutex);
+	return 0;
+}
+
+/** Append an encoded row to the current block. */
+static int
+snap_block_append(struct snap_block *block, struct iovec *iov, int iovcnt)
+{
+	size_t size = 0;
+	for (int i = 0; i < iovcnt; i++)
+		size += iov[i].iov_len;
+	if (block->rows_size + size > block->rows_capacity) {
+		size_t capacity = MAX(block->rows_capacity * 2,
+				      (size_t)SNAP_BLOCK_SIZE);
+		while (capacity < block->rows_size + size)
+			capacity *= 2;
+		char *rows = realloc(block->rows, capacity);
+		if (rows == NULL) {
+			diag_set(OutOfMemory, capacity, "realloc",
+				 "snapshot rows");
+			return -1;
+		}
+		block->rows = rows;
+		block->rows_capacity = capacity;
+	}
+	for (int i = 0; i < iovcnt; i++) {
+		memcpy(block->rows + block->rows_size, iov[i].iov_base,
+		       iov[i].iov_len);
+		block->rows_size += iov[i].iov_len;
+	}
+	block->row_count++;
+	return 0;
+}
+
+int
+snap_writer_write_row(struct snap_writer *writer,
+		      const struct xrow_header *row)
+{
+	if (writer->thread_count == 0) {
+		if (xlog_write_row(writer->xlog, row) < 0)
+			return -1;
+		writer->row_count++;
+		return 0;
+	}
+	if (writer->block == NULL) {
+		writer->block = snap_block_new();
+		if (writer->block == NULL)
+			return -1;
+	}
+	struct iovec iov[XROW_IOVMAX];
+	/* Don't write sync to the disk. */
+	int iovcnt = xrow_header_encode(row, 0, iov, 0);
+	if (iovcnt < 0)
+		return -1;
+	if (snap_block_append(writer->block, iov, iovcnt) != 0)
+		return -1;
+	writer->row_count++;
+	if (writer->block->rows_size >= SNAP_BLOCK_SIZE)
+		return snap_writer_submit(writer);
+	return 0;
+}
+
+int
+snap_writer_flush(struct snap_writer *writer)
+{
+	if (writer->block != NULL && snap_writer_submit(writer) != 0)
+		return -1;
+	if (writer->thread_count > 0 &&
+	    snap_writer_drain(writer, writer->queued_seq) != 0)
+		return -1;
+	return xlog_flush(writer->xlog) < 0 ? -1 : 0;
+}
+
+int64_t
+snap_writer_row_count(struct snap_writer *writer)
+{
+	return writer->row_count;
+}
+
+struct snap_writer *
+snap_writer_new(struct xlog *xlog, int thread_count)
+{
+	assert(thread_count >= 0);
+	struct snap_writer *writer = calloc(1, sizeof(*writer));
+	if (writer == NULL) {
+		diag_set(OutOfMemory, sizeof(*writer), "calloc",
+			 "struct snap_writer");
+		return NULL;
+	}
+	writer->xlog = xlog;
+	writer->row_count = xlog->rows + xlog->tx_rows;
+	tt_pthread_mutex_init(&writer->mutex, NULL);
+	tt_pthread_cond_init(&writer->compressor_cond, NULL);
+	tt_pthread_cond_init(&writer->writer_cond, NULL);
+	stailq_create(&writer->compress_queue);
+	if (thread_count == 0)
+		return writer;
+
+	int window_size = thread_count * SNAP_WRITER_BLOCKS_PER_THREAD;
+	writer->window = calloc(window_size, sizeof(*writer->window));
+	if (writer->window == NULL) {
+		diag_set(OutOfMemory, window_size * sizeof(*writer->window),
+			 "calloc", "snap_writer window");
+		goto error;
+	}
+	writer->window_size = window_size;
+	writer->compressors = calloc(thread_count,
+				     sizeof(*writer->compressors));
+	if (writer->compressors == NULL) {
+		diag_set(OutOfMemory,
+			 thread_count * sizeof(*writer->compressors),
+			 "calloc", "snap_writer compressors");
+		goto error;
+	}
+	writer->thread_count = thread_count;
+	for (int i = 0; i < thread_count; i++) {
+		struct snap_compressor *compressor = &writer->compressors[i];
+		compressor->writer = writer;
+		compressor->zctx = ZSTD_createCCtx();
+		if (compressor->zctx == NULL) {
+			diag_set(ClientError, ER_COMPRESSION,
+				 "failed to create context");
+			goto error;
+		}
+	}
+	for (int i = 0; i < thread_count; i++) {
+		struct snap_compressor *compressor = &writer->compressors[i];
+		char name[FIBER_NAME_MAX];
+		snprintf(name, sizeof(name), "snap.compress.%d", i);
+		if (cord_costart(&compressor->cord, name,
+				 snap_compressor_f, compressor) != 0)
+			goto error;
+		writer->threads_started++;
+	}
+	return writer;
+error:
+	snap_writer_delete(writer);
+	return NULL;
+}
+
+void
+snap_writer_delete(struct snap_writer *writer)
+{
+	tt_pthread_mutex_lock(&writer->mutex);
+	writer->is_stopped = true;
+	tt_pthread_cond_broadcast(&writer->compressor_cond);
+	tt_pthread_mutex_unlock(&writer->mutex);
+	/* Don't lose the error the writer was stopped with. */
+	struct diag diag;
+	diag_create(&diag);
+	diag_move(diag_get(), &diag);
+	for (int i = 0; i < writer->threads_started; i++)
+		cord_join(&writer->compressors[i].cord);
+	diag_move(&diag, diag_get());
+	diag_destroy(&diag);
+
+	for (int i = 0; i < writer->window_size; i++) {
+		if (writer->window[i] != NULL)
+			snap_block_delete(writer->window[i]);
+	}
+	if (writer->block != NULL)
+		snap_block_delete(writer->block);
+	for (int i = 0; i < writer->thread_count; i++) {
+		if (writer->compressors[i].zctx != NULL)
+			ZSTD_freeCCtx(writer->compressors[i].zctx);
+	}
+	tt_pthread_cond_destroy(&writer->writer_cond);
+	tt_pthread_cond_destroy(&writer->compressor_cond);
+	tt_pthread_mutex_destroy(&writer->mutex);
+	free(writer->compressors);
+	free(writer->window);
+	free(writer);
+}
@@ -0,0 +1,90 @@
+#pragma once
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+struct xlog;
+struct xrow_header;
+
+/**
+ * Snapshot writer accumulates rows in tx blocks and compresses
+ * the blocks in a pool of threads, while the calling thread goes
+ * on with the next rows. Compressed blocks are written to the
+ * xlog by the calling thread in the order the rows were added,
+ * so the file doesn't differ from one written by the xlog itself.
+ * With no threads, the rows are passed to the xlog as is.
+ */
+struct snap_writer;
+
+/**
+ * Create a writer of @a xlog with @a thread_count compression
+ * threads. Returns NULL and sets diag on error.
+ */
+struct snap_writer *
+snap_writer_new(struct xlog *xlog, int thread_count);
+
+/**
+ * Stop compression threads and free the writer. Rows not
+ * flushed with snap_writer_flush() are discarded.
+ */
+void
+snap_writer_delete(struct snap_writer *writer);
+
+/**
+ * Add a row to the writer.
+ *
+ * @retval 0 success
+ * @retval -1 error, check diag
+ */
+int
+snap_writer_write_row(struct snap_writer *writer,
+		      const struct xrow_header *row);
+
+/**
+ * Write all added rows to the xlog.
+ *
+ * @retval 0 success
+ * @retval -1 error, check diag
+ */
+int
+snap_writer_flush(struct snap_writer *writer);
+
+/** Return the number of rows added to the writer. */
+int64_t
+snap_writer_row_count(struct snap_writer *writer);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
@@ -30,6 +30,9 @@
  */
 #include "tuple.h"
 
+#include <stdio.h>
+#include <sys/mman.h>
+
 #include "trivia/util.h"
 #include "memory.h"
 #include "fiber.h"
@@ -372,6 +375,216 @@ tuple_arena_destroy(struct slab_arena *arena)
 	slab_arena_destroy(arena);
 }
 
+const char *tuple_arena_huge_pages_strs[] = { "off", "thp", "hugetlb" };
+
+/** Return the default huge page size or 0 if it is unknown. */
+static size_t
+huge_page_size(void)
+{
+	FILE *f = fopen("/proc/meminfo", "r");
+	if (f == NULL)
+		return 0;
+	size_t size = 0;
+	char line[128];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		unsigned long kb;
+		if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+			size = kb * 1024;
+			break;
+		}
+	}
+	fclose(f);
+	return size;
+}
+
+/**
+ * Replace the arena mapping with a mapping of the same size
+ * backed by explicit huge pages. Slabs must be aligned by their
+ * size, so the new mapping is aligned the same way.
+ */
+static int
+tuple_arena_map_hugetlb(struct slab_arena *arena, bool dontdump)
+{
+#if defined(MAP_HUGETLB)
+	size_t page_size = huge_page_size();
+	if (page_size == 0 || arena->prealloc % page_size != 0 ||
+	    arena->slab_size % page_size != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	size_t size = arena->prealloc + arena->slab_size;
+	char *map = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+				 -1, 0);
+	if (map == MAP_FAILED)
+		return -1;
+	uintptr_t align = arena->slab_size;
+	char *start = (char *)(((uintptr_t)map + align - 1) & ~(align - 1));
+	char *end = start + arena->prealloc;
+	if (start > map)
+		munmap(map, start - map);
+	if (map + size > end)
+		munmap(end, map + size - end);
+	munmap(arena->arena, arena->prealloc);
+	arena->arena = start;
+#if defined(MADV_DONTDUMP)
+	if (dontdump)
+		madvise(start, arena->prealloc, MADV_DONTDUMP);
+#else
+	(void)dontdump;
+#endif
+	return 0;
+#else
+	(void)arena;
+	(void)dontdump;
+	errno = ENOTSUP;
+	return -1;
+#endif
+}
+
+/** Request transparent huge pages for the arena. */
+static int
+tuple_arena_madvise_thp(struct slab_arena *arena)
+{
+#if defined(MADV_HUGEPAGE)
+	/*
+	 * madvise() succeeds even if transparent huge pages are
+	 * disabled system-wide, so check that first.
+	 */
+	FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if (f != NULL) {
+		char line[128];
+		bool is_never = fgets(line, sizeof(line), f) != NULL &&
+				strstr(line, "[never]") != NULL;
+		fclose(f);
+		if (is_never) {
+			errno = ENOTSUP;
+			return -1;
+		}
+	}
+	return madvise(arena->arena, arena->prealloc, MADV_HUGEPAGE);
+#else
+	(void)arena;
+	errno = ENOTSUP;
+	return -1;
+#endif
+}
+
+enum tuple_arena_huge_pages
+tuple_arena_use_huge_pages(struct slab_arena *arena,
+			   enum tuple_arena_huge_pages mode,
+			   bool dontdump, const char *arena_name)
+{
+	assert(arena->used == 0);
+	if (mode == TUPLE_ARENA_HUGE_PAGES_HUGETLB) {
+		if (tuple_arena_map_hugetlb(arena, dontdump) == 0) {
+			say_info("%s tuple arena is backed by explicit huge "
+				 "pages", arena_name);
+			return TUPLE_ARENA_HUGE_PAGES_HUGETLB;
+		}
+		say_syserror("failed to map %s tuple arena with explicit "
+			     "huge pages, trying transparent huge pages",
+			     arena_name);
+		mode = TUPLE_ARENA_HUGE_PAGES_THP;
+	}
+	if (mode == TUPLE_ARENA_HUGE_PAGES_THP) {
+		if (tuple_arena_madvise_thp(arena) == 0) {
+			say_info("%s tuple arena uses transparent huge pages",
+				 arena_name);
+			return TUPLE_ARENA_HUGE_PAGES_THP;
+		}
+		say_syserror("transparent huge pages are not available "
+			     "for %s tuple arena", arena_name);
+	}
+	return TUPLE_ARENA_HUGE_PAGES_OFF;
+}
+
+/**
+ * Return the size of transparent huge pages mapped in the
+ * address range as reported by /proc/self/smaps. smaps has
+ * per-mapping granularity, so if the range was merged with an
+ * adjacent mapping, the size is capped by the overlap.
+ */
+static size_t
+anon_huge_size(const void *addr, size_t size)
+{
+	FILE *f = fopen("/proc/self/smaps", "r");
+	if (f == NULL)
+		return 0;
+	uintptr_t begin = (uintptr_t)addr;
+	uintptr_t end = begin + size;
+	size_t overlap = 0;
+	size_t total = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		unsigned long vma_begin, vma_end, kb;
+		if (sscanf(line, "%lx-%lx ", &vma_begin, &vma_end) == 2) {
+			overlap = 0;
+			if (vma_begin < end && vma_end > begin)
+				overlap = MIN(vma_end, end) -
+					  MAX(vma_begin, begin);
+		} else if (overlap > 0 &&
+			   sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+			total += MIN(kb * 1024, overlap);
+		}
+	}
+	fclose(f);
+	return total;
+}
+
+/**
+ * Minimal interval between two /proc/self/smaps scans done by
+ * tuple_arena_huge_size(), in seconds. The file lists every
+ * mapping of the process, so reading it on each box.slab.info()
+ * call would be too expensive for monitoring which polls the
+ * statistics often.
+ */
+static const double ANON_HUGE_SIZE_UPDATE_INTERVAL = 1.0;
+
+/** The last value returned by anon_huge_size() and its time. */
+static struct {
+	const void *addr;
+	size_t size;
+	double update_time;
+	size_t value;
+} anon_huge_size_cache;
+
+/**
+ * Same as anon_huge_size(), but rescan the address range not
+ * more often than once in ANON_HUGE_SIZE_UPDATE_INTERVAL.
+ */
+static size_t
+anon_huge_size_cached(const void *addr, size_t size)
+{
+	double now = ev_monotonic_now(loop());
+	if (anon_huge_size_cache.addr != addr ||
+	    anon_huge_size_cache.size != size ||
+	    now - anon_huge_size_cache.update_time >=
+	    ANON_HUGE_SIZE_UPDATE_INTERVAL) {
+		anon_huge_size_cache.addr = addr;
+		anon_huge_size_cache.size = size;
+		anon_huge_size_cache.update_time = now;
+		anon_huge_size_cache.value = anon_huge_size(addr, size);
+	}
+	return anon_huge_size_cache.value;
+}
+
+size_t
+tuple_arena_huge_size(struct slab_arena *arena,
+		      enum tuple_arena_huge_pages mode)
+{
+	switch (mode) {
+	case TUPLE_ARENA_HUGE_PAGES_HUGETLB:
+		/* All the touched memory is in huge pages. */
+		return arena->used;
+	case TUPLE_ARENA_HUGE_PAGES_THP:
+		return anon_huge_size_cached(arena->arena,
+					     arena->prealloc);
+	default:
+		return 0;
+	}
+}
+
 void
 tuple_free(void)
 {
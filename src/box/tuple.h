@@ -75,6 +75,45 @@ tuple_arena_create(struct slab_arena *arena, struct quota *quota,
 void
 tuple_arena_destroy(struct slab_arena *arena);
 
+/** How memory of a tuple arena is backed by huge pages. */
+enum tuple_arena_huge_pages {
+	/** Regular pages. */
+	TUPLE_ARENA_HUGE_PAGES_OFF,
+	/** Transparent huge pages, requested with madvise(). */
+	TUPLE_ARENA_HUGE_PAGES_THP,
+	/** Explicit huge pages reserved in hugetlbfs. */
+	TUPLE_ARENA_HUGE_PAGES_HUGETLB,
+	tuple_arena_huge_pages_MAX,
+};
+
+extern const char *tuple_arena_huge_pages_strs[];
+
+/**
+ * Back a tuple arena with huge pages. Must be called right
+ * after tuple_arena_create(), before any slab is allocated. If
+ * explicit huge pages can't be mapped, transparent huge pages
+ * are tried, and if those are not available either, the arena
+ * stays with regular pages.
+ * @param arena Arena to remap.
+ * @param mode Requested huge pages mode.
+ * @param dontdump Exclude the arena from core dumps.
+ * @param arena_name Name of @arena for logs.
+ * @return The mode actually used.
+ */
+enum tuple_arena_huge_pages
+tuple_arena_use_huge_pages(struct slab_arena *arena,
+			   enum tuple_arena_huge_pages mode,
+			   bool dontdump, const char *arena_name);
+
+/**
+ * Return the number of bytes of a tuple arena which are backed
+ * by huge pages. For transparent huge pages the value is taken
+ * from /proc/self/smaps and may be up to a second stale.
+ */
+size_t
+tuple_arena_huge_size(struct slab_arena *arena,
+		      enum tuple_arena_huge_pages mode);
+
 /** \cond public */
 
 typedef struct tuple_format box_tuple_format_t;
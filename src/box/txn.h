@@ -651,6 +651,25 @@ txn_check_singlestatement(struct txn *txn, const char *where);
 bool
 txn_can_yield(struct txn *txn, bool set);
 
+/**
+ * Detach the current transaction from the fiber, so that it
+ * survives the fiber and can be continued by another one with
+ * txn_attach(). Leaving the fiber counts as a yield: a
+ * transaction which can not yield is aborted.
+ *
+ * Returns the detached transaction, or NULL if there is none.
+ */
+struct txn *
+txn_detach(void);
+
+/**
+ * Attach a transaction detached with txn_detach() to the
+ * current fiber.
+ * @pre no transaction is active in the fiber
+ */
+void
+txn_attach(struct txn *txn);
+
 /**
  * Returns true if the transaction has a single statement.
  * Supposed to be used from a space on_replace trigger to
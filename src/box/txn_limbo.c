@@ -368,7 +368,7 @@ txn_limbo_write_confirm(struct txn_limbo *limbo, int64_t lsn)
 	assert(lsn > limbo->confirmed_lsn);
 	assert(!limbo->is_in_rollback);
 	limbo->confirmed_lsn = lsn;
-	txn_limbo_write_synchro(limbo, IPROTO_CONFIRM, lsn);
+	txn_limbo_write_synchro(limbo, IPROTO_RAFT_CONFIRM, lsn);
 }
 
 /** Confirm all the entries <= @a lsn. */
@@ -431,7 +431,7 @@ txn_limbo_write_rollback(struct txn_limbo *limbo, int64_t lsn)
 	assert(lsn > limbo->confirmed_lsn);
 	assert(!limbo->is_in_rollback);
 	limbo->is_in_rollback = true;
-	txn_limbo_write_synchro(limbo, IPROTO_ROLLBACK, lsn);
+	txn_limbo_write_synchro(limbo, IPROTO_RAFT_ROLLBACK, lsn);
 	limbo->is_in_rollback = false;
 }
 
@@ -643,10 +643,10 @@ txn_limbo_process(struct txn_limbo *limbo, const struct synchro_request *req)
 		return;
 	}
 	switch (req->type) {
-	case IPROTO_CONFIRM:
+	case IPROTO_RAFT_CONFIRM:
 		txn_limbo_read_confirm(limbo, req->lsn);
 		break;
-	case IPROTO_ROLLBACK:
+	case IPROTO_RAFT_ROLLBACK:
 		txn_limbo_read_rollback(limbo, req->lsn);
 		break;
 	default:
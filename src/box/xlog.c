@@ -41,6 +41,7 @@
 #include <msgpuck.h>
 
 #include "coio_file.h"
+#include "coio_task.h"
 #include "tt_static.h"
 #include "error.h"
 #include "xrow.h"
@@ -669,13 +670,49 @@ xdir_say_gc(int result, int errorno, const char *filename)
 	}
 }
 
+/** A task to remove a file in background. */
+struct xdir_gc_task {
+	struct coio_task base;
+	char filename[PATH_MAX];
+};
+
+static int
+xdir_gc_cb(struct coio_task *ptr)
+{
+	struct xdir_gc_task *task = (struct xdir_gc_task *)ptr;
+	/* Errors are reported on completion, see below. */
+	return unlink(task->filename);
+}
+
 static int
-xdir_complete_gc(eio_req *req)
+xdir_complete_gc(struct coio_task *ptr)
 {
-	xdir_say_gc(req->result, req->errorno, EIO_PATH(req));
+	struct xdir_gc_task *task = (struct xdir_gc_task *)ptr;
+	xdir_say_gc(task->base.result, task->base.errorno, task->filename);
+	coio_task_destroy(&task->base);
+	free(task);
 	return 0;
 }
 
+/**
+ * Remove a file in a coio worker. File removal is put ahead of
+ * other coio tasks so that disk space is freed as soon as
+ * possible.
+ */
+static void
+xdir_gc_async(const char *filename)
+{
+	struct xdir_gc_task *task = malloc(sizeof(*task));
+	if (task == NULL) {
+		xdir_say_gc(unlink(filename), errno, filename);
+		return;
+	}
+	coio_task_create(&task->base, xdir_gc_cb, xdir_complete_gc);
+	task->base.pri = COIO_PRI_HIGH;
+	strlcpy(task->filename, filename, sizeof(task->filename));
+	coio_task_post(&task->base);
+}
+
 void
 xdir_collect_garbage(struct xdir *dir, int64_t signature, unsigned flags)
 {
@@ -685,7 +722,7 @@ xdir_collect_garbage(struct xdir *dir, int64_t signature, unsigned flags)
 		const char *filename =
 			xdir_format_filename(dir, vclock_sum(vclock), NONE);
 		if (flags & XDIR_GC_ASYNC)
-			eio_unlink(filename, 0, xdir_complete_gc, NULL);
+			xdir_gc_async(filename);
 		else
 			xdir_say_gc(unlink(filename), errno, filename);
 		vclockset_remove(&dir->index, vclock);
@@ -1045,6 +1082,39 @@ xlog_fallocate(struct xlog *log, size_t len)
 #endif /* HAVE_FALLOCATE */
 }
 
+/**
+ * Encode a tx fixheader of XLOG_FIXHEADER_SIZE bytes.
+ *
+ * @param fixheader the buffer to encode the fixheader to
+ * @param magic row_marker or zrow_marker
+ * @param len the size of the tx data following the fixheader
+ * @param crc32c the checksum of the tx data
+ */
+static void
+xlog_fixheader_encode(char *fixheader, log_magic_t magic, uint32_t len,
+		      uint32_t crc32c)
+{
+	*(log_magic_t *)fixheader = magic;
+	char *data = fixheader + sizeof(log_magic_t);
+	data = mp_encode_uint(data, len);
+	/* Encode crc32 for previous row */
+	data = mp_encode_uint(data, 0);
+	/* Encode crc32 for current row */
+	data = mp_encode_uint(data, crc32c);
+	/*
+	 * Encode a padding, to ensure the resulting
+	 * fixheader always has the same size.
+	 */
+	ssize_t padding = XLOG_FIXHEADER_SIZE - (data - fixheader);
+	if (padding > 0) {
+		data = mp_encode_strl(data, padding - 1);
+		if (padding > 1) {
+			memset(data, 0, padding - 1);
+			data += padding - 1;
+		}
+	}
+}
+
 /**
  * Write a sequence of uncompressed xrow objects.
  *
@@ -1059,14 +1129,6 @@ xlog_tx_write_plain(struct xlog *log)
 	 * now populate it with data.
 	 */
 	char *fixheader = (char *)log->obuf.iov[0].iov_base;
-	*(log_magic_t *)fixheader = row_marker;
-	char *data = fixheader + sizeof(log_magic_t);
-
-	data = mp_encode_uint(data,
-			      obuf_size(&log->obuf) - XLOG_FIXHEADER_SIZE);
-	/* Encode crc32 for previous row */
-	data = mp_encode_uint(data, 0);
-	/* Encode crc32 for current row */
 	uint32_t crc32c = 0;
 	struct iovec *iov;
 	size_t offset = XLOG_FIXHEADER_SIZE;
@@ -1076,19 +1138,9 @@ xlog_tx_write_plain(struct xlog *log)
 				    iov->iov_len - offset);
 		offset = 0;
 	}
-	data = mp_encode_uint(data, crc32c);
-	/*
-	 * Encode a padding, to ensure the resulting
-	 * fixheader always has the same size.
-	 */
-	ssize_t padding = XLOG_FIXHEADER_SIZE - (data - fixheader);
-	if (padding > 0) {
-		data = mp_encode_strl(data, padding - 1);
-		if (padding > 1) {
-			memset(data, 0, padding - 1);
-			data += padding - 1;
-		}
-	}
+	xlog_fixheader_encode(fixheader, row_marker,
+			      obuf_size(&log->obuf) - XLOG_FIXHEADER_SIZE,
+			      crc32c);
 
 	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
 		diag_set(ClientError, ER_INJECTION, "xlog write injection");
@@ -1158,25 +1210,9 @@ xlog_tx_write_zstd(struct xlog *log)
 		offset = 0;
 	}
 
-	*(log_magic_t *)fixheader = zrow_marker;
-	char *data;
-	data = fixheader + sizeof(log_magic_t);
-	data = mp_encode_uint(data,
-			      obuf_size(&log->zbuf) - XLOG_FIXHEADER_SIZE);
-	/* Encode crc32 for previous row */
-	data = mp_encode_uint(data, 0);
-	/* Encode crc32 for current row */
-	data = mp_encode_uint(data, crc32c);
-	/* Encode padding */
-	ssize_t padding;
-	padding = XLOG_FIXHEADER_SIZE - (data - fixheader);
-	if (padding > 0) {
-		data = mp_encode_strl(data, padding - 1);
-		if (padding > 1) {
-			memset(data, 0, padding - 1);
-			data += padding - 1;
-		}
-	}
+	xlog_fixheader_encode(fixheader, zrow_marker,
+			      obuf_size(&log->zbuf) - XLOG_FIXHEADER_SIZE,
+			      crc32c);
 
 	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
 		diag_set(ClientError, ER_INJECTION, "xlog write injection");
@@ -1199,33 +1235,53 @@ error:
 	return -1;
 }
 
+size_t
+xlog_tx_encode_bound(size_t size)
+{
+	return XLOG_FIXHEADER_SIZE + ZSTD_compressBound(size);
+}
+
+ssize_t
+xlog_tx_encode(const char *rows, size_t size, char *out,
+	       ZSTD_CCtx *zctx)
+{
+	char *data = out + XLOG_FIXHEADER_SIZE;
+	if (zctx == NULL || size < XLOG_TX_COMPRESS_THRESHOLD) {
+		memcpy(data, rows, size);
+		xlog_fixheader_encode(out, row_marker, size,
+				      crc32_calc(0, data, size));
+		return XLOG_FIXHEADER_SIZE + size;
+	}
+	/* 3 is compression level. */
+	size_t zsize = ZSTD_compressCCtx(zctx, data,
+					 ZSTD_compressBound(size),
+					 rows, size, 3);
+	if (ZSTD_isError(zsize)) {
+		diag_set(ClientError, ER_COMPRESSION,
+			 ZSTD_getErrorName(zsize));
+		return -1;
+	}
+	xlog_fixheader_encode(out, zrow_marker, zsize,
+			      crc32_calc(0, data, zsize));
+	return XLOG_FIXHEADER_SIZE + zsize;
+}
+
 /* file syncing and posix_fadvise() should be rounded by a page boundary */
 #define SYNC_MASK		(4096 - 1)
 #define SYNC_ROUND_DOWN(size)	((size) & ~(4096 - 1))
 #define SYNC_ROUND_UP(size)	(SYNC_ROUND_DOWN(size + SYNC_MASK))
 
 /**
- * Writes xlog batch to file
+ * Account a tx written to the file, sync and throttle
+ * the writer if needed.
+ *
+ * @param written the tx size or -1 if the write failed
+ * @retval -1 error
+ * @retval >= 0 the number of bytes written
  */
 static ssize_t
-xlog_tx_write(struct xlog *log)
+xlog_tx_write_done(struct xlog *log, ssize_t written)
 {
-	if (obuf_size(&log->obuf) == XLOG_FIXHEADER_SIZE)
-		return 0;
-	ssize_t written;
-
-	if (!log->opts.no_compression &&
-	    obuf_size(&log->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
-		written = xlog_tx_write_zstd(log);
-	} else {
-		written = xlog_tx_write_plain(log);
-	}
-	ERROR_INJECT(ERRINJ_WAL_WRITE, {
-		diag_set(ClientError, ER_INJECTION, "xlog write injection");
-		written = -1;
-	});
-
-	obuf_reset(&log->obuf);
 	/*
 	 * Simplify recovery after a temporary write failure:
 	 * truncate the file to the best known good write
@@ -1286,6 +1342,57 @@ xlog_tx_write(struct xlog *log)
 	return written;
 }
 
+/**
+ * Writes xlog batch to file
+ */
+static ssize_t
+xlog_tx_write(struct xlog *log)
+{
+	if (obuf_size(&log->obuf) == XLOG_FIXHEADER_SIZE)
+		return 0;
+	ssize_t written;
+
+	if (!log->opts.no_compression &&
+	    obuf_size(&log->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
+		written = xlog_tx_write_zstd(log);
+	} else {
+		written = xlog_tx_write_plain(log);
+	}
+	ERROR_INJECT(ERRINJ_WAL_WRITE, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		written = -1;
+	});
+
+	obuf_reset(&log->obuf);
+	return xlog_tx_write_done(log, written);
+}
+
+ssize_t
+xlog_write_raw_tx(struct xlog *log, const char *data, size_t size,
+		  int64_t rows)
+{
+	assert(obuf_size(&log->obuf) == 0);
+	ssize_t written = size;
+	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		written = -1;
+	});
+	ERROR_INJECT(ERRINJ_WAL_WRITE, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		written = -1;
+	});
+	if (written >= 0 && fio_writen(log->fd, data, size) < 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 log->filename);
+		written = -1;
+	}
+	log->tx_rows = rows;
+	written = xlog_tx_write_done(log, written);
+	if (written < 0)
+		log->tx_rows = 0;
+	return written;
+}
+
 /*
  * Add a row to a log and possibly flush the log.
  *
@@ -1854,6 +1961,29 @@ xlog_cursor_find_tx_magic(struct xlog_cursor *i)
 	return 0;
 }
 
+/**
+ * A eof marker is found at the read position, check that
+ * there is no more data in the file.
+ *
+ * @retval 1 the eof marker is the last thing in the file
+ * @retval -1 error
+ */
+static int
+xlog_cursor_check_eof_marker(struct xlog_cursor *i)
+{
+	int rc = xlog_cursor_ensure(i, sizeof(log_magic_t) + sizeof(char));
+	if (rc < 0)
+		return -1;
+	if (rc == 0) {
+		diag_set(XlogError, "%s: has some data after "
+			  "eof marker at %lld", i->name,
+			  xlog_cursor_pos(i));
+		return -1;
+	}
+	i->state = XLOG_CURSOR_EOF;
+	return 1;
+}
+
 int
 xlog_cursor_next_tx(struct xlog_cursor *i)
 {
@@ -1888,22 +2018,51 @@ xlog_cursor_next_tx(struct xlog_cursor *i)
 	i->state = XLOG_CURSOR_TX;
 	return 0;
 eof_found:
-	/*
-	 * A eof marker is read, check that there is no
-	 * more data in the file.
-	 */
-	rc = xlog_cursor_ensure(i, sizeof(log_magic_t) + sizeof(char));
+	return xlog_cursor_check_eof_marker(i);
+}
 
+int
+xlog_cursor_next_raw_tx(struct xlog_cursor *i, const char **data,
+			size_t *size)
+{
+	int rc;
+	assert(xlog_cursor_is_open(i));
+	assert(i->state != XLOG_CURSOR_TX);
+
+	/* load at least magic to check eof */
+	rc = xlog_cursor_ensure(i, sizeof(log_magic_t));
 	if (rc < 0)
 		return -1;
-	if (rc == 0) {
-		diag_set(XlogError, "%s: has some data after "
-			  "eof marker at %lld", i->name,
-			  xlog_cursor_pos(i));
-		return -1;
+	if (rc > 0)
+		return 1;
+	if (load_u32(i->rbuf.rpos) == eof_marker)
+		return xlog_cursor_check_eof_marker(i);
+
+	struct xlog_fixheader fixheader;
+	const char *rpos;
+	ssize_t to_load;
+	while (true) {
+		rpos = i->rbuf.rpos;
+		to_load = xlog_fixheader_decode(&fixheader, &rpos,
+						i->rbuf.wpos);
+		if (to_load < 0)
+			return -1;
+		if (to_load == 0) {
+			if (i->rbuf.wpos - rpos >= (ptrdiff_t)fixheader.len)
+				break;
+			to_load = fixheader.len - (i->rbuf.wpos - rpos);
+		}
+		/* not enough data in read buffer */
+		rc = xlog_cursor_ensure(i, ibuf_used(&i->rbuf) + to_load);
+		if (rc < 0)
+			return -1;
+		if (rc > 0)
+			return 1;
 	}
-	i->state = XLOG_CURSOR_EOF;
-	return 1;
+	*data = i->rbuf.rpos;
+	*size = rpos + fixheader.len - i->rbuf.rpos;
+	i->rbuf.rpos = (char *)rpos + fixheader.len;
+	return 0;
 }
 
 int
@@ -531,6 +531,45 @@ xlog_tx_rollback(struct xlog *log);
 ssize_t
 xlog_flush(struct xlog *log);
 
+/**
+ * Return the max size of a tx encoded by xlog_tx_encode()
+ * from @a size bytes of rows.
+ */
+size_t
+xlog_tx_encode_bound(size_t size);
+
+/**
+ * Encode rows to a tx that can be written with
+ * xlog_write_raw_tx(): compress the rows with @a zctx unless
+ * it is NULL or the rows are too small to be compressed, and
+ * prepend a fixheader. Doesn't touch any xlog, so can be used
+ * in any thread.
+ *
+ * @param rows rows encoded with xrow_header_encode()
+ * @param size the size of @a rows
+ * @param out a buffer of at least xlog_tx_encode_bound() bytes
+ * @param zctx compression context or NULL
+ * @retval >= 0 the size of the encoded tx
+ * @retval -1 error, check diag
+ */
+ssize_t
+xlog_tx_encode(const char *rows, size_t size, char *out,
+	       ZSTD_CCtx *zctx);
+
+/**
+ * Write a tx encoded by xlog_tx_encode() to xlog. There must
+ * be no rows buffered in the xlog.
+ *
+ * @param data the encoded tx
+ * @param size the size of the encoded tx
+ * @param rows the number of rows in the tx
+ * @retval >= 0 the number of bytes written
+ * @retval -1 error, check diag
+ */
+ssize_t
+xlog_write_raw_tx(struct xlog *log, const char *data, size_t size,
+		  int64_t rows);
+
 
 /**
  * Sync a log file. The exact action is defined
@@ -743,6 +782,23 @@ xlog_cursor_close(struct xlog_cursor *cursor, bool reuse_fd);
 int
 xlog_cursor_next_tx(struct xlog_cursor *cursor);
 
+/**
+ * Read next tx from xlog without decoding it. The tx is returned
+ * as is, with the fixheader, and can be decoded later, possibly
+ * in another thread, with xlog_tx_cursor_create(). The checksum
+ * isn't verified here.
+ *
+ * @param cursor cursor
+ * @param[out] data the raw tx, valid until the next call
+ * @param[out] size the raw tx size
+ * @retval 0 succes
+ * @retval 1 eof
+ * retval -1 error, check diag
+ */
+int
+xlog_cursor_next_raw_tx(struct xlog_cursor *cursor, const char **data,
+			size_t *size);
+
 /**
  * Fetch next xrow from current xlog tx
  *
@@ -174,6 +174,12 @@ error:
 		case IPROTO_TIMESTAMP:
 			header->tm = mp_decode_double(pos);
 			break;
+		case IPROTO_TIMEOUT:
+			header->timeout = mp_decode_double(pos);
+			break;
+		case IPROTO_STREAM_ID:
+			header->stream_id = mp_decode_uint(pos);
+			break;
 		case IPROTO_SCHEMA_VERSION:
 			header->schema_version = mp_decode_uint(pos);
 			break;
@@ -586,10 +592,18 @@ iproto_prepare_header(struct obuf *buf, struct obuf_svp *svp, size_t size)
 void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t schema_version, uint32_t count)
+{
+	iproto_reply_select_ext(buf, svp, sync, schema_version, count, 0);
+}
+
+void
+iproto_reply_select_ext(struct obuf *buf, struct obuf_svp *svp,
+			uint64_t sync, uint32_t schema_version,
+			uint32_t count, size_t ext_size)
 {
 	char *pos = (char *) obuf_svp_to_ptr(buf, svp);
 	iproto_header_encode(pos, IPROTO_OK, sync, schema_version,
-			        obuf_size(buf) - svp->used -
+			        obuf_size(buf) - svp->used + ext_size -
 				IPROTO_HEADER_LEN);
 
 	struct iproto_body_bin body = iproto_body_bin;
@@ -598,6 +612,28 @@ iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 	memcpy(pos + IPROTO_HEADER_LEN, &body, sizeof(body));
 }
 
+int
+iproto_reply_select_position(struct obuf *buf, struct obuf_svp *svp,
+			     uint64_t sync, uint32_t schema_version,
+			     uint32_t count, const char *position,
+			     const char *position_end)
+{
+	uint32_t len = position_end - position;
+	size_t size = mp_sizeof_uint(IPROTO_POSITION) + mp_sizeof_str(len);
+	char *data = (char *)obuf_alloc(buf, size);
+	if (data == NULL) {
+		diag_set(OutOfMemory, size, "obuf_alloc", "data");
+		return -1;
+	}
+	data = mp_encode_uint(data, IPROTO_POSITION);
+	mp_encode_str(data, position, len);
+	iproto_reply_select(buf, svp, sync, schema_version, count);
+	/* The body map has the position after the data. */
+	char *body = (char *)obuf_svp_to_ptr(buf, svp) + IPROTO_HEADER_LEN;
+	*body = 0x82;
+	return 0;
+}
+
 int
 xrow_decode_sql(const struct xrow_header *row, struct sql_request *request)
 {
@@ -755,6 +791,16 @@ error:
 			request->tuple_meta = value;
 			request->tuple_meta_end = data;
 			break;
+		case IPROTO_FETCH_POSITION:
+			request->fetch_position = mp_decode_bool(&value);
+			break;
+		case IPROTO_AFTER_POSITION: {
+			uint32_t len;
+			request->after_position = mp_decode_str(&value, &len);
+			request->after_position_end =
+				request->after_position + len;
+			break;
+		}
 		default:
 			break;
 		}
@@ -1173,6 +1219,111 @@ error:
 	return 0;
 }
 
+int
+xrow_decode_batch(const struct xrow_header *row,
+		  struct batch_request *request)
+{
+	if (row->bodycnt == 0) {
+		diag_set(ClientError, ER_INVALID_MSGPACK,
+			 "missing request body");
+		return -1;
+	}
+
+	assert(row->bodycnt == 1);
+	const char *data = (const char *) row->body[0].iov_base;
+	const char *end = data + row->body[0].iov_len;
+	assert((end - data) > 0);
+
+	if (mp_typeof(*data) != MP_MAP || mp_check_map(data, end) > 0) {
+error:
+		xrow_on_decode_err(row->body[0].iov_base, end, ER_INVALID_MSGPACK,
+				   "packet body");
+		return -1;
+	}
+
+	memset(request, 0, sizeof(*request));
+	request->header = row;
+
+	uint32_t map_size = mp_decode_map(&data);
+	for (uint32_t i = 0; i < map_size; ++i) {
+		if ((end - data) < 1 || mp_typeof(*data) != MP_UINT)
+			goto error;
+
+		uint64_t key = mp_decode_uint(&data);
+		const char *value = data;
+		if (mp_check(&data, end) != 0)
+			goto error;
+
+		if (key != IPROTO_REQUESTS)
+			continue; /* unknown key */
+		if (mp_typeof(*value) != MP_ARRAY)
+			goto error;
+		request->count = mp_decode_array(&value);
+		request->ops = value;
+		request->ops_end = data;
+	}
+	if (data != end) {
+		xrow_on_decode_err(row->body[0].iov_base, end, ER_INVALID_MSGPACK,
+				   "packet end");
+		return -1;
+	}
+	if (request->ops == NULL) {
+		xrow_on_decode_err(row->body[0].iov_base, end,
+				   ER_MISSING_REQUEST_FIELD,
+				   iproto_key_name(IPROTO_REQUESTS));
+		return -1;
+	}
+	return 0;
+}
+
+int
+xrow_decode_batch_op(const char **pos, const char *end,
+		     struct xrow_header *row, struct request *request)
+{
+	const char *data = *pos;
+	if (data >= end || mp_typeof(*data) != MP_MAP ||
+	    mp_check_map(data, end) > 0) {
+error:
+		xrow_on_decode_err(*pos, end, ER_INVALID_MSGPACK,
+				   "batch request");
+		return -1;
+	}
+	const char *body = data;
+	uint64_t type = IPROTO_TYPE_STAT_MAX;
+	uint32_t map_size = mp_decode_map(&data);
+	for (uint32_t i = 0; i < map_size; ++i) {
+		if ((end - data) < 1 || mp_typeof(*data) != MP_UINT)
+			goto error;
+		uint64_t key = mp_decode_uint(&data);
+		const char *value = data;
+		if (mp_check(&data, end) != 0)
+			goto error;
+		if (key != IPROTO_REQUEST_TYPE)
+			continue;
+		if (mp_typeof(*value) != MP_UINT)
+			goto error;
+		type = mp_decode_uint(&value);
+	}
+	switch (type) {
+	case IPROTO_INSERT:
+	case IPROTO_REPLACE:
+	case IPROTO_UPDATE:
+	case IPROTO_DELETE:
+	case IPROTO_UPSERT:
+		break;
+	default:
+		diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE,
+			 (uint32_t) type);
+		return -1;
+	}
+	row->type = type;
+	row->bodycnt = 1;
+	row->body[0].iov_base = (void *) body;
+	row->body[0].iov_len = data - body;
+	*pos = data;
+	return xrow_decode_dml(row, request, dml_request_key_map(type));
+}
+
 int
 xrow_decode_auth(const struct xrow_header *row, struct auth_request *request)
 {
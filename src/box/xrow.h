@@ -75,6 +75,16 @@ struct xrow_header {
 	 * log.
 	 */
 	double tm;
+	/**
+	 * Time in seconds the client waits for the reply to the
+	 * request, 0 if not set. Not written to the log.
+	 */
+	double timeout;
+	/**
+	 * Stream the request belongs to, 0 if none. Not written
+	 * to the log.
+	 */
+	uint64_t stream_id;
 	/*
 	 * Transaction identifier. LSN of the first row in the
 	 * transaction.
@@ -174,6 +184,11 @@ struct request {
 	const char *tuple_meta_end;
 	/** Base field offset for UPDATE/UPSERT, e.g. 0 for C and 1 for Lua. */
 	int index_base;
+	/** SELECT: position to resume the scan after, without MP_STR. */
+	const char *after_position;
+	const char *after_position_end;
+	/** SELECT: true if the position of the last tuple is needed. */
+	bool fetch_position;
 };
 
 /**
@@ -212,7 +227,7 @@ xrow_encode_dml(const struct request *request, struct region *region,
  * pending synchronous transactions.
  */
 struct synchro_request {
-	/** Operation type - IPROTO_ROLLBACK or IPROTO_CONFIRM. */
+	/** Operation type - IPROTO_RAFT_ROLLBACK or IPROTO_RAFT_CONFIRM. */
 	uint32_t type;
 	/**
 	 * ID of the instance owning the pending transactions.
@@ -309,6 +324,48 @@ struct call_request {
 int
 xrow_decode_call(const struct xrow_header *row, struct call_request *request);
 
+/**
+ * BATCH request: several DML requests executed in one transaction.
+ */
+struct batch_request {
+	/** Request header */
+	const struct xrow_header *header;
+	/** MessagePack array of DML request bodies. */
+	const char *ops;
+	const char *ops_end;
+	/** Number of requests in the batch. */
+	uint32_t count;
+};
+
+/**
+ * Decode BATCH request from MessagePack.
+ * @param row request header.
+ * @param[out] request Request to decode.
+ * @retval  0 on success
+ * @retval -1 on error
+ */
+int
+xrow_decode_batch(const struct xrow_header *row,
+		  struct batch_request *request);
+
+/**
+ * Decode the next DML request of a batch. Each element of the
+ * batch is an ordinary DML request body extended with
+ * IPROTO_REQUEST_TYPE. @a row is filled as if the request came
+ * in a packet of its own, so that @a request can be passed to
+ * box_process1().
+ * @param[in, out] pos position in IPROTO_REQUESTS array.
+ * @param end end of IPROTO_REQUESTS array.
+ * @param[in, out] row header of the batch, type and body are
+ *        overwritten.
+ * @param[out] request Request to decode.
+ * @retval  0 on success
+ * @retval -1 on error
+ */
+int
+xrow_decode_batch_op(const char **pos, const char *end,
+		     struct xrow_header *row, struct request *request);
+
 /**
  * AUTH request
  */
@@ -598,6 +655,31 @@ void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t schema_version, uint32_t count);
 
+/**
+ * Write select header to a preallocated buffer, when
+ * @a ext_size bytes of the result set are not in the buffer but
+ * are spliced into the output when it is sent.
+ * This function doesn't throw.
+ */
+void
+iproto_reply_select_ext(struct obuf *buf, struct obuf_svp *svp,
+			uint64_t sync, uint32_t schema_version,
+			uint32_t count, size_t ext_size);
+
+/**
+ * Append IPROTO_POSITION to the result set and write select
+ * header to a preallocated buffer.
+ * @param position Position of the last tuple, not encoded.
+ *
+ * @retval  0 Success.
+ * @retval -1 Memory error.
+ */
+int
+iproto_reply_select_position(struct obuf *buf, struct obuf_svp *svp,
+			     uint64_t sync, uint32_t schema_version,
+			     uint32_t count, const char *position,
+			     const char *position_end);
+
 /**
  * Encode iproto header with IPROTO_OK response code.
  * @param out Encode to.
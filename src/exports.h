@@ -456,6 +456,7 @@ EXPORT(PMurHash32_Result)
 EXPORT(port_destroy)
 EXPORT(random_bytes)
 EXPORT(_say)
+EXPORT(say_logger_dropped)
 EXPORT(say_logger_init)
 EXPORT(say_logger_initialized)
 EXPORT(say_logrotate)
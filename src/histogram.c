@@ -131,8 +131,21 @@ histogram_discard(struct histogram *hist, int64_t val)
 	hist->total--;
 }
 
+void
+histogram_merge(struct histogram *dst, const struct histogram *src)
+{
+	assert(dst->n_buckets == src->n_buckets);
+	for (size_t i = 0; i < dst->n_buckets; i++) {
+		assert(dst->buckets[i].max == src->buckets[i].max);
+		dst->buckets[i].count += src->buckets[i].count;
+	}
+	if (dst->max < src->max)
+		dst->max = src->max;
+	dst->total += src->total;
+}
+
 int64_t
-histogram_percentile(struct histogram *hist, int pct)
+histogram_percentile(struct histogram *hist, double pct)
 {
 	size_t count = 0;
 
@@ -146,7 +159,7 @@ histogram_percentile(struct histogram *hist, int pct)
 }
 
 int64_t
-histogram_percentile_lower(struct histogram *hist, int pct)
+histogram_percentile_lower(struct histogram *hist, double pct)
 {
 	size_t count = 0;
 
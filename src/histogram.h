@@ -82,19 +82,26 @@ histogram_collect(struct histogram *hist, int64_t val);
 void
 histogram_discard(struct histogram *hist, int64_t val);
 
+/**
+ * Add observations collected by histogram @src to histogram
+ * @dst. The histograms must have the same buckets.
+ */
+void
+histogram_merge(struct histogram *dst, const struct histogram *src);
+
 /**
  * Calculate a percentile, i.e. the value below which a given
  * percentage of observations fall.
  */
 int64_t
-histogram_percentile(struct histogram *hist, int pct);
+histogram_percentile(struct histogram *hist, double pct);
 
 /**
  * Same as histogram_percentile(), but return a lower bound
  * estimate of the percentile.
  */
 int64_t
-histogram_percentile_lower(struct histogram *hist, int pct);
+histogram_percentile_lower(struct histogram *hist, double pct);
 
 /**
  * Print string representation of a histogram.
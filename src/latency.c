@@ -89,8 +89,24 @@ latency_collect(struct latency *latency, double value)
 	histogram_collect(latency->histogram, value_usec);
 }
 
+void
+latency_merge(struct latency *dst, const struct latency *src)
+{
+	histogram_merge(dst->histogram, src->histogram);
+	/* Drop the dummy observation of @src, see latency_create(). */
+	histogram_discard(dst->histogram, 0);
+}
+
+size_t
+latency_count(const struct latency *latency)
+{
+	/* Do not count the dummy observation. */
+	size_t total = latency->histogram->total;
+	return total > 0 ? total - 1 : 0;
+}
+
 double
-latency_get(struct latency *latency, int pct)
+latency_get(struct latency *latency, double pct)
 {
 	int64_t value_usec = histogram_percentile(latency->histogram, pct);
 	return (double)value_usec / USEC_PER_SEC;
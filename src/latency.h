@@ -31,6 +31,8 @@
  * SUCH DAMAGE.
  */
 
+#include <stddef.h>
+
 struct histogram;
 
 /**
@@ -70,11 +72,25 @@ latency_reset(struct latency *latency);
 void
 latency_collect(struct latency *latency, double value);
 
+/**
+ * Add observations collected by latency counter @src
+ * to latency counter @dst.
+ */
+void
+latency_merge(struct latency *dst, const struct latency *src);
+
+/**
+ * Return the number of observations collected by
+ * a latency counter.
+ */
+size_t
+latency_count(const struct latency *latency);
+
 /**
  * Get accumulated latency value, in seconds.
  * Returns @pct-th percentile of all observations.
  */
 double
-latency_get(struct latency *latency, int pct);
+latency_get(struct latency *latency, double pct);
 
 #endif /* TARANTOOL_LATENCY_H_INCLUDED */
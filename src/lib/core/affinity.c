@@ -0,0 +1,412 @@
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "affinity.h"
+
+#include <trivia/config.h>
+#include <trivia/util.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diag.h"
+#include "say.h"
+#include "tt_pthread.h"
+
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+#include <sched.h>
+#endif
+#if defined(HAVE_MBIND)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+const char *affinity_class_strs[] = {
+	"tx",
+	"iproto",
+	"wal",
+	"vinyl",
+	"relay",
+	"coio",
+};
+
+static_assert(lengthof(affinity_class_strs) == affinity_class_MAX,
+	      "affinity_class_strs must match enum affinity_class");
+
+/** The maximal CPU or NUMA node number + 1. */
+enum { AFFINITY_BIT_MAX = 1024 };
+
+/** A set of CPUs or NUMA nodes. */
+struct affinity_mask {
+	uint64_t bits[AFFINITY_BIT_MAX / 64];
+};
+
+static inline void
+affinity_mask_add(struct affinity_mask *mask, int i)
+{
+	mask->bits[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+static inline bool
+affinity_mask_test(const struct affinity_mask *mask, int i)
+{
+	return (mask->bits[i / 64] & ((uint64_t)1 << (i % 64))) != 0;
+}
+
+/**
+ * Parse a list like "0-3,8". A trailing new line is allowed, so
+ * that lists read from sysfs can be parsed as well.
+ */
+static int
+affinity_mask_parse(const char *str, struct affinity_mask *mask)
+{
+	memset(mask, 0, sizeof(*mask));
+	const char *p = str;
+	while (true) {
+		char *end;
+		while (*p == ' ')
+			p++;
+		if (*p < '0' || *p > '9')
+			return -1;
+		unsigned long first = strtoul(p, &end, 10);
+		unsigned long last = first;
+		p = end;
+		if (*p == '-') {
+			p++;
+			if (*p < '0' || *p > '9')
+				return -1;
+			last = strtoul(p, &end, 10);
+			p = end;
+		}
+		if (first > last || last >= AFFINITY_BIT_MAX)
+			return -1;
+		for (unsigned long i = first; i <= last; i++)
+			affinity_mask_add(mask, i);
+		while (*p == ' ')
+			p++;
+		if (*p == '\0' || *p == '\n')
+			return 0;
+		if (*p != ',')
+			return -1;
+		p++;
+	}
+}
+
+/** Format a mask as a list like "0-3,8". */
+static void
+affinity_mask_format(const struct affinity_mask *mask, char *buf, size_t size)
+{
+	size_t len = 0;
+	buf[0] = '\0';
+	for (int i = 0; i < AFFINITY_BIT_MAX && len < size; i++) {
+		if (!affinity_mask_test(mask, i))
+			continue;
+		int last = i;
+		while (last + 1 < AFFINITY_BIT_MAX &&
+		       affinity_mask_test(mask, last + 1))
+			last++;
+		const char *sep = len > 0 ? "," : "";
+		int rc = last == i ?
+			 snprintf(buf + len, size - len, "%s%d", sep, i) :
+			 snprintf(buf + len, size - len, "%s%d-%d",
+				  sep, i, last);
+		if (rc < 0)
+			break;
+		len += rc;
+		i = last;
+	}
+}
+
+static struct {
+	pthread_mutex_t mutex;
+	/** Set once any thread class is given a CPU set. */
+	bool is_configured;
+	/** CPU set of the main thread before it was pinned. */
+	struct affinity_mask initial;
+	/** Configured CPU sets of thread classes. */
+	bool is_set[affinity_class_MAX];
+	struct affinity_mask cpus[affinity_class_MAX];
+	/** CPU sets the last started threads run on. */
+	bool has_actual[affinity_class_MAX];
+	struct affinity_mask actual[affinity_class_MAX];
+} affinity = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/** Return the class of a thread by its cord name or -1. */
+static int
+affinity_class_by_cord_name(const char *name)
+{
+	if (strcmp(name, "main") == 0)
+		return AFFINITY_TX;
+	if (strcmp(name, "iproto") == 0)
+		return AFFINITY_IPROTO;
+	if (strcmp(name, "wal") == 0)
+		return AFFINITY_WAL;
+	if (strncmp(name, "vinyl.", strlen("vinyl.")) == 0)
+		return AFFINITY_VINYL;
+	if (strcmp(name, "subscribe") == 0 ||
+	    strcmp(name, "final_join") == 0 ||
+	    strcmp(name, "initial_join") == 0)
+		return AFFINITY_RELAY;
+	if (strcmp(name, "coio") == 0)
+		return AFFINITY_COIO;
+	return -1;
+}
+
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+
+bool
+affinity_is_supported(void)
+{
+	return true;
+}
+
+/** Pin the calling thread to a CPU set. Returns an errno. */
+static int
+affinity_pin_self(const struct affinity_mask *mask)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int i = 0; i < AFFINITY_BIT_MAX && i < CPU_SETSIZE; i++) {
+		if (affinity_mask_test(mask, i))
+			CPU_SET(i, &set);
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/** Get the CPU set of the calling thread. Returns an errno. */
+static int
+affinity_get_self(struct affinity_mask *mask)
+{
+	cpu_set_t set;
+	int rc = pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+	if (rc != 0)
+		return rc;
+	memset(mask, 0, sizeof(*mask));
+	for (int i = 0; i < AFFINITY_BIT_MAX && i < CPU_SETSIZE; i++) {
+		if (CPU_ISSET(i, &set))
+			affinity_mask_add(mask, i);
+	}
+	return 0;
+}
+
+#else /* !defined(HAVE_PTHREAD_SETAFFINITY_NP) */
+
+bool
+affinity_is_supported(void)
+{
+	return false;
+}
+
+static int
+affinity_pin_self(const struct affinity_mask *mask)
+{
+	(void)mask;
+	return ENOTSUP;
+}
+
+static int
+affinity_get_self(struct affinity_mask *mask)
+{
+	(void)mask;
+	return ENOTSUP;
+}
+
+#endif /* defined(HAVE_PTHREAD_SETAFFINITY_NP) */
+
+int
+affinity_check(const char *cpus)
+{
+	struct affinity_mask mask;
+	if (!affinity_is_supported()) {
+		diag_set(IllegalParams, "CPU affinity is not supported");
+		return -1;
+	}
+	if (affinity_mask_parse(cpus, &mask) != 0) {
+		diag_set(IllegalParams, "CPU list must look like '0-3,8' "
+			 "with CPU numbers less than %d", AFFINITY_BIT_MAX);
+		return -1;
+	}
+	return 0;
+}
+
+/** Remember the CPU set a thread of a class runs on. */
+static void
+affinity_update_actual(int cls)
+{
+	struct affinity_mask actual;
+	if (cls < 0 || affinity_get_self(&actual) != 0)
+		return;
+	tt_pthread_mutex_lock(&affinity.mutex);
+	affinity.actual[cls] = actual;
+	affinity.has_actual[cls] = true;
+	tt_pthread_mutex_unlock(&affinity.mutex);
+}
+
+int
+affinity_set(enum affinity_class cls, const char *cpus)
+{
+	struct affinity_mask mask;
+	memset(&mask, 0, sizeof(mask));
+	if (cpus != NULL) {
+		if (affinity_check(cpus) != 0)
+			return -1;
+		affinity_mask_parse(cpus, &mask);
+	}
+	tt_pthread_mutex_lock(&affinity.mutex);
+	if (!affinity.is_configured && cpus != NULL) {
+		if (affinity_get_self(&affinity.initial) != 0) {
+			tt_pthread_mutex_unlock(&affinity.mutex);
+			diag_set(SystemError, "failed to get CPU affinity");
+			return -1;
+		}
+		affinity.is_configured = true;
+	}
+	affinity.is_set[cls] = cpus != NULL;
+	affinity.cpus[cls] = mask;
+	if (cpus == NULL)
+		mask = affinity.initial;
+	bool is_configured = affinity.is_configured;
+	tt_pthread_mutex_unlock(&affinity.mutex);
+	if (cls != AFFINITY_TX || !is_configured)
+		return 0;
+	int rc = affinity_pin_self(&mask);
+	if (rc != 0) {
+		errno = rc;
+		diag_set(SystemError, "failed to set CPU affinity");
+		return -1;
+	}
+	affinity_update_actual(cls);
+	return 0;
+}
+
+void
+affinity_apply(const char *cord_name)
+{
+	int cls = affinity_class_by_cord_name(cord_name);
+	struct affinity_mask mask;
+	tt_pthread_mutex_lock(&affinity.mutex);
+	bool is_configured = affinity.is_configured;
+	if (cls >= 0 && affinity.is_set[cls])
+		mask = affinity.cpus[cls];
+	else
+		mask = affinity.initial;
+	tt_pthread_mutex_unlock(&affinity.mutex);
+	if (is_configured) {
+		int rc = affinity_pin_self(&mask);
+		if (rc != 0) {
+			errno = rc;
+			say_syserror("failed to set CPU affinity of %s",
+				     cord_name);
+		}
+	}
+	affinity_update_actual(cls);
+}
+
+bool
+affinity_get(enum affinity_class cls, char *buf, size_t size)
+{
+	tt_pthread_mutex_lock(&affinity.mutex);
+	bool has_actual = affinity.has_actual[cls];
+	struct affinity_mask actual = affinity.actual[cls];
+	tt_pthread_mutex_unlock(&affinity.mutex);
+	if (has_actual)
+		affinity_mask_format(&actual, buf, size);
+	return has_actual;
+}
+
+#if defined(HAVE_MBIND)
+
+int
+numa_node_count(void)
+{
+	FILE *f = fopen("/sys/devices/system/node/online", "r");
+	if (f == NULL)
+		return 0;
+	char buf[256];
+	struct affinity_mask nodes;
+	bool is_read = fgets(buf, sizeof(buf), f) != NULL &&
+		       affinity_mask_parse(buf, &nodes) == 0;
+	fclose(f);
+	if (!is_read)
+		return 0;
+	int count = 0;
+	for (int i = 0; i < AFFINITY_BIT_MAX; i++) {
+		if (affinity_mask_test(&nodes, i))
+			count = i + 1;
+	}
+	return count;
+}
+
+int
+numa_bind_memory(void *addr, size_t size, int node)
+{
+	struct affinity_mask nodes;
+	memset(&nodes, 0, sizeof(nodes));
+	if (node < 0 || node >= AFFINITY_BIT_MAX) {
+		errno = EINVAL;
+		diag_set(SystemError, "invalid NUMA node %d", node);
+		return -1;
+	}
+	affinity_mask_add(&nodes, node);
+	if (syscall(__NR_mbind, addr, size, MPOL_BIND, nodes.bits,
+		    (unsigned long)AFFINITY_BIT_MAX, MPOL_MF_MOVE) != 0) {
+		diag_set(SystemError, "failed to bind memory to NUMA node %d",
+			 node);
+		return -1;
+	}
+	return 0;
+}
+
+#else /* !defined(HAVE_MBIND) */
+
+int
+numa_node_count(void)
+{
+	return 0;
+}
+
+int
+numa_bind_memory(void *addr, size_t size, int node)
+{
+	(void)addr;
+	(void)size;
+	(void)node;
+	errno = ENOTSUP;
+	diag_set(SystemError, "NUMA memory binding is not supported");
+	return -1;
+}
+
+#endif /* defined(HAVE_MBIND) */
@@ -0,0 +1,124 @@
+#pragma once
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * CPU affinity and NUMA placement of threads.
+ *
+ * Threads are grouped in classes by their cord names. Each class
+ * can be pinned to a set of CPUs given as a list like "0-3,8".
+ * A thread applies the CPU set of its class when its cord is
+ * created, so a class must be configured before its threads are
+ * started, except tx, which is pinned right away. Once any class
+ * is configured, threads of the classes without a CPU set use the
+ * CPU set the process was started with instead of inheriting the
+ * one of the thread that spawned them.
+ */
+enum affinity_class {
+	AFFINITY_TX,
+	AFFINITY_IPROTO,
+	AFFINITY_WAL,
+	AFFINITY_VINYL,
+	AFFINITY_RELAY,
+	AFFINITY_COIO,
+	affinity_class_MAX,
+};
+
+/** Class names, used in box.cfg options and box.info. */
+extern const char *affinity_class_strs[];
+
+/** Return true if thread affinity is supported by the system. */
+bool
+affinity_is_supported(void);
+
+/**
+ * Check a CPU list.
+ * @retval  0 The list is valid.
+ * @retval -1 The list is malformed or CPU affinity isn't
+ *            supported, diag is set.
+ */
+int
+affinity_check(const char *cpus);
+
+/**
+ * Set the CPU list of a thread class. NULL resets it. If the
+ * class is tx, the calling thread, which must be the main one,
+ * is pinned immediately.
+ * @retval  0 Success.
+ * @retval -1 Invalid list or system error, diag is set.
+ */
+int
+affinity_set(enum affinity_class cls, const char *cpus);
+
+/**
+ * Pin the calling thread according to the class its cord name
+ * belongs to and remember the CPU set it ended up with. Called
+ * on cord creation.
+ */
+void
+affinity_apply(const char *cord_name);
+
+/**
+ * Format the CPU set the last started thread of a class runs on
+ * into @a buf.
+ * @retval true  Success.
+ * @retval false No thread of the class has been started or CPU
+ *               affinity is not supported.
+ */
+bool
+affinity_get(enum affinity_class cls, char *buf, size_t size);
+
+/**
+ * Return the number of NUMA nodes known to the system, which is
+ * the highest online node number + 1, or 0 if NUMA memory
+ * binding is not supported.
+ */
+int
+numa_node_count(void);
+
+/**
+ * Bind memory [addr, addr + size) to NUMA node @a node. Pages
+ * already allocated are moved to the node.
+ * @retval  0 Success.
+ * @retval -1 System error, diag is set.
+ */
+int
+numa_bind_memory(void *addr, size_t size, int node);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
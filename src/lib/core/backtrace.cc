@@ -33,6 +33,8 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <dlfcn.h>
 
 #include <cxxabi.h>
 
@@ -176,6 +178,54 @@ out:
 	return start;
 }
 
+int
+backtrace_collect(void **ip, int count)
+{
+	unw_context_t unw_context;
+	unw_getcontext(&unw_context);
+	unw_cursor_t unw_cur;
+	unw_init_local(&unw_cur, &unw_context);
+	unw_word_t sp = 0, old_sp = 0, reg;
+	int n = 0;
+	while (n < count && unw_step(&unw_cur) > 0) {
+		old_sp = sp;
+		unw_get_reg(&unw_cur, UNW_REG_SP, &sp);
+		if (sp == old_sp)
+			break;
+		unw_get_reg(&unw_cur, UNW_REG_IP, &reg);
+		ip[n++] = (void *)reg;
+	}
+	return n;
+}
+
+char *
+backtrace_symbolize(void *const *ip, int count, char *buf, size_t size)
+{
+	char *p = buf;
+	char *end = buf + size - 1;
+	*p = '\0';
+	for (int i = 0; i < count && p < end; i++) {
+		Dl_info info;
+		if (dladdr(ip[i], &info) == 0) {
+			p += snprintf(p, end - p, "#%-2d %p in ??" CRLF,
+				      i, ip[i]);
+		} else if (info.dli_sname != NULL) {
+			p += snprintf(p, end - p, "#%-2d %p in %s+%lx" CRLF,
+				      i, ip[i], info.dli_sname,
+				      (long)((char *)ip[i] -
+					     (char *)info.dli_saddr));
+		} else {
+			const char *obj = strrchr(info.dli_fname, '/');
+			obj = obj != NULL ? obj + 1 : info.dli_fname;
+			p += snprintf(p, end - p, "#%-2d %p in %s+%lx" CRLF,
+				      i, ip[i], obj,
+				      (long)((char *)ip[i] -
+					     (char *)info.dli_fbase));
+		}
+	}
+	return buf;
+}
+
 /*
  * Libunwind unw_getcontext wrapper.
  * unw_getcontext can be a macros on some platform and can not be called
@@ -55,6 +55,24 @@ backtrace_foreach(backtrace_cb cb, coro_context *coro_ctx, void *cb_ctx);
 void
 backtrace_proc_cache_clear(void);
 
+/**
+ * Store return addresses of up to @a count frames of the
+ * current thread stack in @a ip. Only unwinds the stack, so it
+ * is async signal safe, unlike backtrace().
+ * @return Number of stored addresses.
+ */
+int
+backtrace_collect(void **ip, int count);
+
+/**
+ * Format addresses collected by backtrace_collect() into
+ * @a buf the same way backtrace() does. Symbols not exported by
+ * the executable are printed as an object offset, which can be
+ * resolved with addr2line.
+ */
+char *
+backtrace_symbolize(void *const *ip, int count, char *buf, size_t size);
+
 #endif /* ENABLE_BACKTRACE */
 
 #if defined(__cplusplus)
@@ -31,9 +31,20 @@
 #include "cbus.h"
 
 #include <limits.h>
+#include "clock.h"
 #include "fiber.h"
 #include "trigger.h"
 
+enum {
+	/**
+	 * Time a consumer running cbus_loop() spins waiting for
+	 * new messages before going to sleep, in microseconds.
+	 */
+	CBUS_SPIN_USEC = 20,
+	/** Number of spin iterations between clock checks. */
+	CBUS_SPIN_CHECK_PERIOD = 64,
+};
+
 /**
  * Cord interconnect.
  */
@@ -87,6 +98,43 @@ static void
 cpipe_flush_cb(ev_loop * /* loop */, struct ev_async *watcher,
 	       int /* events */);
 
+/**
+ * Move all messages of @a input to the endpoint without locks.
+ * See cbus_endpoint::output for the details.
+ */
+static void
+cbus_endpoint_push(struct cbus_endpoint *endpoint, struct stailq *input)
+{
+	if (stailq_empty(input))
+		return;
+	struct stailq_entry *last = stailq_first(input);
+	stailq_reverse(input);
+	struct stailq_entry *first = stailq_first(input);
+	struct stailq_entry *head = __atomic_load_n(&endpoint->output,
+						    __ATOMIC_RELAXED);
+	do {
+		last->next = head;
+	} while (!__atomic_compare_exchange_n(&endpoint->output, &head, first,
+					      true, __ATOMIC_SEQ_CST,
+					      __ATOMIC_RELAXED));
+	stailq_create(input);
+}
+
+/**
+ * Wake the consumer up unless it has already been woken up and
+ * has not fetched the messages yet, or is spinning.
+ */
+static void
+cbus_endpoint_signal(struct cbus_endpoint *endpoint)
+{
+	if (__atomic_exchange_n(&endpoint->is_signaled, true,
+				__ATOMIC_SEQ_CST))
+		return;
+	/* Count statistics */
+	rmean_collect(cbus.stats, CBUS_STAT_EVENTS, 1);
+	ev_async_send(endpoint->consumer, &endpoint->async);
+}
+
 void
 cpipe_create(struct cpipe *pipe, const char *consumer)
 {
@@ -156,19 +204,20 @@ cpipe_destroy(struct cpipe *pipe)
 	 * delivered.
 	 */
 	tt_pthread_mutex_lock(&endpoint->mutex);
-	/* Flush input */
-	stailq_concat(&endpoint->output, &pipe->input);
-	pipe->n_input = 0;
 	/* Add the pipe shutdown message as the last one. */
-	stailq_add_tail_entry(&endpoint->output, poison, msg.fifo);
+	stailq_add_tail_entry(&pipe->input, poison, msg.fifo);
+	cbus_endpoint_push(endpoint, &pipe->input);
+	pipe->n_input = 0;
 	/* Count statistics */
 	rmean_collect(cbus.stats, CBUS_STAT_EVENTS, 1);
 	/*
 	 * Keep the lock for the duration of ev_async_send():
 	 * this will avoid a race condition between
 	 * ev_async_send() and execution of the poison
-	 * message, after which the endpoint may disappear.
+	 * message, after which the endpoint may disappear
+	 * (see cbus_endpoint_destroy()).
 	 */
+	__atomic_store_n(&endpoint->is_signaled, true, __ATOMIC_SEQ_CST);
 	ev_async_send(endpoint->consumer, &endpoint->async);
 	tt_pthread_mutex_unlock(&endpoint->mutex);
 
@@ -227,7 +276,8 @@ cbus_endpoint_create(struct cbus_endpoint *endpoint, const char *name,
 	endpoint->n_pipes = 0;
 	fiber_cond_create(&endpoint->cond);
 	tt_pthread_mutex_init(&endpoint->mutex, NULL);
-	stailq_create(&endpoint->output);
+	endpoint->output = NULL;
+	endpoint->is_signaled = false;
 	ev_async_init(&endpoint->async,
 		      (void (*)(ev_loop *, struct ev_async *, int)) fetch_cb);
 	endpoint->async.data = fetch_data;
@@ -261,14 +311,14 @@ cbus_endpoint_destroy(struct cbus_endpoint *endpoint,
 	while (true) {
 		if (process_cb)
 			process_cb(endpoint);
-		if (endpoint->n_pipes == 0 && stailq_empty(&endpoint->output))
+		if (endpoint->n_pipes == 0 && cbus_endpoint_is_empty(endpoint))
 			break;
 		 fiber_cond_wait(&endpoint->cond);
 	}
 
 	/*
-	 * Pipe flush func can still lock mutex, so just lock and unlock
-	 * it.
+	 * Pipe destroy func can still lock mutex, so just lock and
+	 * unlock it.
 	 */
 	tt_pthread_mutex_lock(&endpoint->mutex);
 	tt_pthread_mutex_unlock(&endpoint->mutex);
@@ -290,8 +340,6 @@ cpipe_flush_cb(ev_loop *loop, struct ev_async *watcher, int events)
 		return;
 
 	trigger_run(&pipe->on_flush, pipe);
-	/* Trigger task processing when the queue becomes non-empty. */
-	bool output_was_empty;
 
 	/*
 	 * We need to set a thread cancellation guard, because
@@ -304,19 +352,11 @@ cpipe_flush_cb(ev_loop *loop, struct ev_async *watcher, int events)
 	int old_cancel_state;
 	tt_pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancel_state);
 
-	tt_pthread_mutex_lock(&endpoint->mutex);
-	output_was_empty = stailq_empty(&endpoint->output);
 	/** Flush input */
-	stailq_concat(&endpoint->output, &pipe->input);
-	tt_pthread_mutex_unlock(&endpoint->mutex);
-
+	cbus_endpoint_push(endpoint, &pipe->input);
 	pipe->n_input = 0;
-	if (output_was_empty) {
-		/* Count statistics */
-		rmean_collect(cbus.stats, CBUS_STAT_EVENTS, 1);
-
-		ev_async_send(endpoint->consumer, &endpoint->async);
-	}
+	/* Trigger task processing unless it is already triggered. */
+	cbus_endpoint_signal(endpoint);
 
 	tt_pthread_setcancelstate(old_cancel_state, NULL);
 }
@@ -657,6 +697,44 @@ cbus_process(struct cbus_endpoint *endpoint)
 		cmsg_deliver(msg);
 }
 
+static inline void
+cbus_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * Busy-wait for new messages for a short while before going to
+ * sleep, unless there are other fibers ready to run in the cord.
+ * While the consumer spins, producers don't wake it up.
+ * Return true if there are new messages.
+ */
+static bool
+cbus_endpoint_spin(struct cbus_endpoint *endpoint)
+{
+	if (!rlist_empty(&cord()->ready))
+		return false;
+	__atomic_store_n(&endpoint->is_signaled, true, __ATOMIC_SEQ_CST);
+	double deadline = clock_monotonic() + CBUS_SPIN_USEC / 1e6;
+	do {
+		for (int i = 0; i < CBUS_SPIN_CHECK_PERIOD; i++) {
+			if (!cbus_endpoint_is_empty(endpoint))
+				return true;
+			cbus_cpu_relax();
+		}
+	} while (clock_monotonic() < deadline);
+	/*
+	 * Going to sleep: let producers wake us up and check
+	 * the messages pushed before they could see the flag.
+	 */
+	__atomic_store_n(&endpoint->is_signaled, false, __ATOMIC_SEQ_CST);
+	return !cbus_endpoint_is_empty(endpoint);
+}
+
 void
 cbus_loop(struct cbus_endpoint *endpoint)
 {
@@ -664,6 +742,8 @@ cbus_loop(struct cbus_endpoint *endpoint)
 		cbus_process(endpoint);
 		if (fiber_is_cancelled())
 			break;
+		if (cbus_endpoint_spin(endpoint))
+			continue;
 		fiber_yield();
 	}
 }
@@ -118,7 +118,7 @@ struct cpipe {
 	/**
 	 * When pushing messages, keep the staged input size under
 	 * this limit (speeds up message delivery and reduces
-	 * latency, while still keeping the bus mutex cold enough).
+	 * latency, while still keeping the consumer wakeups rare enough).
 	 */
 	int max_input;
 	/**
@@ -166,7 +166,7 @@ cpipe_destroy(struct cpipe *pipe);
  * Otherwise, the messages flushed once per event loop iteration.
  *
  * @todo: collect bus stats per second and adjust max_input once
- * a second to keep the mutex cold regardless of the message load,
+ * a second to keep the wakeups rare regardless of the message load,
  * while still keeping the latency low if there are few
  * long-to-process messages.
  */
@@ -255,10 +255,25 @@ struct cbus_endpoint {
 	char name[FIBER_NAME_MAX];
 	/** Member of cbus->endpoints */
 	struct rlist in_cbus;
-	/** The lock around the pipe. */
+	/**
+	 * The lock held by a pipe while it is being destroyed,
+	 * see cpipe_destroy(). Not used for message passing.
+	 */
 	pthread_mutex_t mutex;
-	/** A queue with incoming messages. */
-	struct stailq output;
+	/**
+	 * Lock-free stack of incoming messages. Producers push
+	 * batches of messages in reverse order, the consumer
+	 * takes the whole stack and reverses it back, so the
+	 * order of messages of each pipe is preserved.
+	 */
+	struct stailq_entry *output;
+	/**
+	 * Set by a producer which has woken up the consumer, or
+	 * by the consumer spinning for new messages. Producers
+	 * don't send a wakeup until the consumer clears the flag
+	 * taking the messages, so wakeups are coalesced.
+	 */
+	bool is_signaled;
 	/** Consumer cord loop */
 	ev_loop *consumer;
 	/** Async to notify the consumer */
@@ -269,15 +284,35 @@ struct cbus_endpoint {
 	struct fiber_cond cond;
 };
 
+/** Check if there are no incoming messages. */
+static inline bool
+cbus_endpoint_is_empty(struct cbus_endpoint *endpoint)
+{
+	return __atomic_load_n(&endpoint->output, __ATOMIC_ACQUIRE) == NULL;
+}
+
 /**
  * Fetch incomming messages to output
  */
 static inline void
 cbus_endpoint_fetch(struct cbus_endpoint *endpoint, struct stailq *output)
 {
-	tt_pthread_mutex_lock(&endpoint->mutex);
-	stailq_concat(output, &endpoint->output);
-	tt_pthread_mutex_unlock(&endpoint->mutex);
+	/*
+	 * Clear the flag before taking the messages: a producer
+	 * pushing after that must wake the consumer up again.
+	 */
+	__atomic_store_n(&endpoint->is_signaled, false, __ATOMIC_SEQ_CST);
+	struct stailq_entry *elem = __atomic_exchange_n(&endpoint->output,
+							NULL, __ATOMIC_SEQ_CST);
+	/* Restore the order of messages, see cbus_endpoint::output. */
+	struct stailq batch;
+	stailq_create(&batch);
+	while (elem != NULL) {
+		struct stailq_entry *next = elem->next;
+		stailq_add(&batch, elem);
+		elem = next;
+	}
+	stailq_concat(output, &batch);
 }
 
 /** Initialize the global singleton bus. */
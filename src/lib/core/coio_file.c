@@ -34,6 +34,7 @@
 #include "say.h"
 #include "fio.h"
 #include "errinj.h"
+#include "uring.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <dirent.h>
@@ -47,6 +48,8 @@ struct coio_file_task {
 	int errorno;
 	struct fiber *fiber;
 	bool done;
+	/** Request used instead of eio if io_uring is available. */
+	struct uring_req req;
 
 	union {
 		struct {
@@ -110,6 +113,94 @@ struct coio_file_task {
 	struct coio_file_task name;		\
 	memset(&name, 0, sizeof(name));		\
 	name.fiber = fiber();			\
+	uring_req_create(&name.req, coio_uring_complete, &name);
+
+/**
+ * Size of the ring used for file I/O. The number of fibers
+ * doing file I/O at the same time rarely exceeds it, and if it
+ * does, the excess requests go to eio.
+ */
+enum { COIO_FILE_URING_ENTRIES = 256 };
+
+/**
+ * io_uring used for file I/O of the main cord. It is created
+ * on first use and lives until the process exits. Other cords
+ * and kernels without io_uring use eio.
+ */
+static struct uring coio_file_ring;
+
+static enum {
+	/** The ring hasn't been created yet. */
+	COIO_URING_UNKNOWN,
+	/** The ring is created and used for file I/O. */
+	COIO_URING_ON,
+	/** io_uring isn't available, eio is used. */
+	COIO_URING_OFF,
+} coio_file_ring_state = COIO_URING_UNKNOWN;
+
+/** Set if io_uring may be used for file I/O. */
+static bool coio_file_ring_is_enabled = true;
+
+void
+coio_file_set_uring(bool enabled)
+{
+	coio_file_ring_is_enabled = enabled;
+}
+
+/**
+ * Return the ring to submit a file I/O request of the current
+ * cord to or NULL if the request should go to eio.
+ */
+static struct uring *
+coio_file_uring(void)
+{
+	if (!coio_file_ring_is_enabled || !cord_is_main())
+		return NULL;
+	if (coio_file_ring_state == COIO_URING_UNKNOWN) {
+		if (uring_create(&coio_file_ring, loop(),
+				 COIO_FILE_URING_ENTRIES) != 0) {
+			diag_clear(diag_get());
+			coio_file_ring_state = COIO_URING_OFF;
+		} else if (!coio_file_ring.has_file_rw) {
+			uring_destroy(&coio_file_ring);
+			coio_file_ring_state = COIO_URING_OFF;
+		} else {
+			/* Let a script doing file I/O exit. */
+			uring_unref(&coio_file_ring);
+			coio_file_ring_state = COIO_URING_ON;
+		}
+		if (coio_file_ring_state == COIO_URING_OFF)
+			say_verbose("io_uring is not available for file "
+				    "I/O, using a thread pool");
+	}
+	return coio_file_ring_state == COIO_URING_ON ?
+	       &coio_file_ring : NULL;
+}
+
+/** A callback invoked by the event loop when a ring request is done. */
+static void
+coio_uring_complete(struct uring_req *req, int res)
+{
+	struct coio_file_task *eio = (struct coio_file_task *)req->data;
+	if (res < 0) {
+		eio->result = -1;
+		eio->errorno = -res;
+	} else {
+		eio->result = res;
+	}
+	eio->done = true;
+	fiber_wakeup(eio->fiber);
+}
+
+/** Wait for completion of a request submitted to the ring. */
+static ssize_t
+coio_uring_wait(struct coio_file_task *eio)
+{
+	while (!eio->done)
+		fiber_yield();
+	errno = eio->errorno;
+	return eio->result;
+}
 
 /** A callback invoked by eio when a task is complete. */
 static int
@@ -175,10 +266,17 @@ coio_pwrite(int fd, const void *buf, size_t count, off_t offset)
 			chunk = 1;
 		});
 
-		req = eio_write(fd, (char *)buf + pos, chunk,
-				offset + pos, EIO_PRI_DEFAULT,
-				coio_complete, &eio);
-		res = coio_wait_done(req, &eio);
+		struct uring *ring = coio_file_uring();
+		if (ring != NULL && offset >= 0 &&
+		    uring_write(ring, &eio.req, fd, (char *)buf + pos,
+				chunk, offset + pos) == 0) {
+			res = coio_uring_wait(&eio);
+		} else {
+			req = eio_write(fd, (char *)buf + pos, chunk,
+					offset + pos, EIO_PRI_DEFAULT,
+					coio_complete, &eio);
+			res = coio_wait_done(req, &eio);
+		}
 		if (res < 0) {
 			pos = -1;
 			break;
@@ -194,6 +292,10 @@ ssize_t
 coio_pread(int fd, void *buf, size_t count, off_t offset)
 {
 	INIT_COEIO_FILE(eio);
+	struct uring *ring = coio_file_uring();
+	if (ring != NULL && offset >= 0 &&
+	    uring_read(ring, &eio.req, fd, buf, count, offset) == 0)
+		return coio_uring_wait(&eio);
 	eio_req *req = eio_read(fd, buf, count,
 				offset, 0, coio_complete, &eio);
 	return coio_wait_done(req, &eio);
@@ -243,9 +345,20 @@ coio_write(int fd, const void *buf, size_t count)
 		eio.write.count	= left;
 		eio.write.fd	= fd;
 
-		req = eio_custom(coio_do_write, EIO_PRI_DEFAULT,
-				 coio_complete, &eio);
-		res = coio_wait_done(req, &eio);
+		size_t chunk = left;
+		ERROR_INJECT(ERRINJ_COIO_WRITE_CHUNK, {
+			chunk = 1;
+		});
+		struct uring *ring = coio_file_uring();
+		if (ring != NULL &&
+		    uring_write(ring, &eio.req, fd, eio.write.buf,
+				chunk, -1) == 0) {
+			res = coio_uring_wait(&eio);
+		} else {
+			req = eio_custom(coio_do_write, EIO_PRI_DEFAULT,
+					 coio_complete, &eio);
+			res = coio_wait_done(req, &eio);
+		}
 		if (res < 0) {
 			pos = -1;
 			break;
@@ -272,6 +385,10 @@ coio_read(int fd, void *buf, size_t count)
 	eio.read.buf = buf;
 	eio.read.count = count;
 	eio.read.fd = fd;
+	struct uring *ring = coio_file_uring();
+	if (ring != NULL &&
+	    uring_read(ring, &eio.req, fd, buf, count, -1) == 0)
+		return coio_uring_wait(&eio);
 	eio_req *req = eio_custom(coio_do_read, 0,
 				  coio_complete, &eio);
 	return coio_wait_done(req, &eio);
@@ -534,6 +651,9 @@ int
 coio_fsync(int fd)
 {
 	INIT_COEIO_FILE(eio);
+	struct uring *ring = coio_file_uring();
+	if (ring != NULL && uring_fsync(ring, &eio.req, fd, false) == 0)
+		return coio_uring_wait(&eio);
 	eio_req *req = eio_fsync(fd, 0, coio_complete, &eio);
 	return coio_wait_done(req, &eio);
 }
@@ -542,6 +662,9 @@ int
 coio_fdatasync(int fd)
 {
 	INIT_COEIO_FILE(eio);
+	struct uring *ring = coio_file_uring();
+	if (ring != NULL && uring_fsync(ring, &eio.req, fd, true) == 0)
+		return coio_uring_wait(&eio);
 	eio_req *req = eio_fdatasync(fd, 0, coio_complete, &eio);
 	return coio_wait_done(req, &eio);
 }
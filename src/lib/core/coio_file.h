@@ -34,6 +34,7 @@
 extern "C" {
 #endif /* defined(__cplusplus) */
 
+#include <stdbool.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <glob.h>
@@ -45,7 +46,19 @@ extern "C" {
  *
  * It follows the error reporting convention of the respective
  * system calls, i.e. it doesn't throw exceptions either.
+ *
+ * In the main cord, reads, writes and fsyncs are submitted to
+ * an io_uring polled by the cord event loop, if the kernel
+ * supports it. All other requests, and all requests from other
+ * cords, are executed in the eio thread pool.
+ */
+
+/**
+ * Allow or forbid io_uring for file I/O. If forbidden or not
+ * supported by the kernel, eio is used for all requests.
  */
+void
+coio_file_set_uring(bool enabled);
 
 int     coio_file_open(const char *path, int flags, mode_t mode);
 int     coio_file_close(int fd);
@@ -39,41 +39,457 @@
 #include <sys/socket.h>
 
 #include "fiber.h"
+#include "clock.h"
+#include "say.h"
+#include "tt_pthread.h"
 #include "third_party/tarantool_ev.h"
 
 /*
- * Asynchronous IO Tasks (libeio wrapper).
- * ---------------------------------------
+ * Asynchronous IO Tasks.
+ * ----------------------
  *
- * libeio request processing is designed in edge-trigger
- * manner, when libeio is ready to process some requests it
- * calls coio_poller callback.
+ * Tasks are run by a pool of worker threads. A submitted task
+ * is put to the queue of its priority class of an idle worker,
+ * or of the next worker in round-robin order if all of them are
+ * busy. A worker takes tasks from the head of its own queues and,
+ * when they are empty, steals from the tail of the queues of the
+ * other workers, so a task doesn't wait behind a slow one while
+ * there is a free worker. Classes are served in priority order.
  *
- * Due to libeio design, want_poll callback is called while
- * locks are being held, so it's not possible to call any libeio
- * function inside this callback. Thus coio_want_poll raises an
- * async event which will be dealt with normally as part of the
- * main Tarantool event loop.
+ * A finished task is put to the list of done tasks of the thread
+ * which submitted it, and the thread is woken up with an async
+ * event to complete the task in its event loop.
  *
- * The async event handler, in turn, performs eio_poll(), which
- * will run on_complete callback for all ready eio tasks.
- * In case if some of the requests are not complete by the time
- * eio_poll() has been called, coio_idle watcher is started, which
- * would periodically invoke eio_poll() until all requests are
- * complete.
+ * libeio is still used for file operations, see coio_file.c.
+ * libeio request processing is designed in edge-trigger manner,
+ * when libeio is ready to process some requests it calls
+ * coio_want_poll_cb. The callback is called while locks are
+ * being held, so it raises an async event which is dealt with
+ * as part of the event loop: it performs eio_poll(), which runs
+ * on_complete callbacks for all ready eio requests. In case
+ * some of the requests are not complete by the time eio_poll()
+ * has been called, coio_idle watcher is started, which would
+ * periodically invoke eio_poll() until all requests are complete.
  *
  * See for details:
  * http://pod.tst.eu/http://cvs.schmorp.de/libeio/eio.pod
 */
 
+enum {
+	/** Default number of worker threads. */
+	COIO_THREADS_DEFAULT = 4,
+	/** Max number of worker threads. */
+	COIO_THREADS_MAX = 256,
+};
+
+const char *coio_task_pri_strs[] = { "high", "normal", "low" };
+
+static_assert(lengthof(coio_task_pri_strs) == coio_task_pri_MAX,
+	      "each priority class must have a name");
+
 struct coio_manager {
 	ev_loop *loop;
 	ev_idle coio_idle;
 	ev_async coio_async;
+	/** Tasks done by workers, protected by the mutex. */
+	struct rlist done;
+	pthread_mutex_t mutex;
+	/** Raised by a worker when it adds a task to the list. */
+	ev_async done_async;
 };
 
 static __thread struct coio_manager coio_manager;
 
+struct coio_worker {
+	/** Index in the pool. */
+	int id;
+	/** Protects the members below. */
+	pthread_mutex_t mutex;
+	/** Signalled when a task is added to an idle worker. */
+	pthread_cond_t cond;
+	/** Task queues, by priority class. */
+	struct rlist queue[coio_task_pri_MAX];
+	/** Set if the worker thread is running. */
+	bool is_running;
+	/** Set if the worker thread waits for tasks. */
+	bool is_idle;
+};
+
+/** Statistics of a priority class, updated atomically. */
+struct coio_pool_stat {
+	int64_t queue;
+	int64_t count;
+	/** In microseconds. */
+	int64_t wait_total;
+	int64_t wait_max;
+};
+
+static struct coio_pool {
+	/** Protects worker creation and round-robin. */
+	pthread_mutex_t mutex;
+	/** Workers, created on demand and never freed. */
+	struct coio_worker *workers[COIO_THREADS_MAX];
+	/** Number of created workers. */
+	int worker_count;
+	/** Number of workers to run tasks. */
+	int thread_count;
+	/** Next worker to post a task to if all are busy. */
+	int next;
+	/** Number of workers running low priority tasks. */
+	int low_running;
+	/**
+	 * Incremented on each submitted task, so that a worker
+	 * going to sleep can tell if it might have missed a task
+	 * to steal.
+	 */
+	uint64_t submit_seq;
+	/** Set on shutdown, workers stop when idle. */
+	bool is_shutdown;
+	struct coio_pool_stat stat[coio_task_pri_MAX];
+} coio_pool = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.thread_count = COIO_THREADS_DEFAULT,
+};
+
+/**
+ * Try to reserve a worker for a low priority task: leave at
+ * least one worker for the other classes.
+ */
+static bool
+coio_pool_reserve_low(struct coio_pool *pool)
+{
+	int limit = MAX(__atomic_load_n(&pool->thread_count,
+					__ATOMIC_RELAXED) - 1, 1);
+	int running = __atomic_load_n(&pool->low_running, __ATOMIC_RELAXED);
+	do {
+		if (running >= limit)
+			return false;
+	} while (!__atomic_compare_exchange_n(&pool->low_running, &running,
+					      running + 1, false,
+					      __ATOMIC_ACQ_REL,
+					      __ATOMIC_RELAXED));
+	return true;
+}
+
+static void
+coio_pool_release_low(struct coio_pool *pool)
+{
+	__atomic_sub_fetch(&pool->low_running, 1, __ATOMIC_ACQ_REL);
+}
+
+/** Account a task taken by a worker in the class statistics. */
+static void
+coio_pool_stat_take(struct coio_pool *pool, struct coio_task *task)
+{
+	struct coio_pool_stat *stat = &pool->stat[task->pri];
+	int64_t wait = (clock_monotonic() - task->submit_time) * 1e6;
+	__atomic_sub_fetch(&stat->queue, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stat->count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stat->wait_total, wait, __ATOMIC_RELAXED);
+	int64_t max = __atomic_load_n(&stat->wait_max, __ATOMIC_RELAXED);
+	while (wait > max &&
+	       !__atomic_compare_exchange_n(&stat->wait_max, &max, wait,
+					    false, __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED));
+}
+
+void
+coio_task_stat(enum coio_task_pri pri, struct coio_task_stat *stat)
+{
+	assert(pri < coio_task_pri_MAX);
+	struct coio_pool_stat *s = &coio_pool.stat[pri];
+	stat->queue = __atomic_load_n(&s->queue, __ATOMIC_RELAXED);
+	stat->count = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+	stat->wait_total = __atomic_load_n(&s->wait_total,
+					   __ATOMIC_RELAXED) / 1e6;
+	stat->wait_max = __atomic_load_n(&s->wait_max,
+					 __ATOMIC_RELAXED) / 1e6;
+}
+
+/**
+ * Take a task of the given class from a worker queue: from the
+ * head of the own queue, from the tail of a queue of another
+ * worker.
+ */
+static struct coio_task *
+coio_worker_take(struct coio_worker *worker, enum coio_task_pri pri,
+		 bool is_own)
+{
+	struct coio_task *task = NULL;
+	tt_pthread_mutex_lock(&worker->mutex);
+	struct rlist *queue = &worker->queue[pri];
+	if (!rlist_empty(queue)) {
+		task = is_own ? rlist_first_entry(queue, struct coio_task,
+						  link) :
+				rlist_last_entry(queue, struct coio_task, link);
+		rlist_del_entry(task, link);
+	}
+	tt_pthread_mutex_unlock(&worker->mutex);
+	return task;
+}
+
+/** Find a task for a worker to run, in priority order. */
+static struct coio_task *
+coio_worker_next(struct coio_worker *worker)
+{
+	struct coio_pool *pool = &coio_pool;
+	int worker_count = __atomic_load_n(&pool->worker_count,
+					   __ATOMIC_ACQUIRE);
+	for (int pri = 0; pri < coio_task_pri_MAX; pri++) {
+		if (pri == COIO_PRI_LOW && !coio_pool_reserve_low(pool))
+			continue;
+		struct coio_task *task = coio_worker_take(worker, pri, true);
+		for (int i = 1; task == NULL && i < worker_count; i++) {
+			struct coio_worker *victim =
+				pool->workers[(worker->id + i) % worker_count];
+			task = coio_worker_take(victim, pri, false);
+		}
+		if (task != NULL) {
+			coio_pool_stat_take(pool, task);
+			return task;
+		}
+		if (pri == COIO_PRI_LOW)
+			coio_pool_release_low(pool);
+	}
+	return NULL;
+}
+
+/** Pass a task run by a worker to the thread which submitted it. */
+static void
+coio_task_done(struct coio_task *task)
+{
+	struct coio_manager *manager = task->manager;
+	tt_pthread_mutex_lock(&manager->mutex);
+	rlist_add_tail_entry(&manager->done, task, link);
+	tt_pthread_mutex_unlock(&manager->mutex);
+	ev_async_send(manager->loop, &manager->done_async);
+}
+
+/**
+ * Check if a worker has nothing to run in its own queues and
+ * may go to sleep. Called with the worker mutex held.
+ */
+static bool
+coio_worker_is_idle(struct coio_worker *worker)
+{
+	for (int pri = 0; pri < coio_task_pri_MAX; pri++) {
+		if (rlist_empty(&worker->queue[pri]))
+			continue;
+		if (pri != COIO_PRI_LOW)
+			return false;
+		/* Low priority tasks wait for a free slot. */
+		int limit = MAX(coio_pool.thread_count - 1, 1);
+		if (__atomic_load_n(&coio_pool.low_running,
+				    __ATOMIC_RELAXED) < limit)
+			return false;
+	}
+	return true;
+}
+
+static void *
+coio_worker_f(void *arg)
+{
+	struct coio_worker *worker = arg;
+	struct coio_pool *pool = &coio_pool;
+	struct cord *cord = (struct cord *)calloc(1, sizeof(*cord));
+	if (cord == NULL)
+		panic("failed to allocate coio worker cord");
+	cord_create(cord, "coio");
+	for (;;) {
+		uint64_t seq = __atomic_load_n(&pool->submit_seq,
+					       __ATOMIC_ACQUIRE);
+		struct coio_task *task = coio_worker_next(worker);
+		if (task != NULL) {
+			enum coio_task_pri pri = task->pri;
+			task->run(task);
+			if (pri == COIO_PRI_LOW)
+				coio_pool_release_low(pool);
+			coio_task_done(task);
+			continue;
+		}
+		tt_pthread_mutex_lock(&worker->mutex);
+		if (coio_worker_is_idle(worker) &&
+		    seq == __atomic_load_n(&pool->submit_seq,
+					   __ATOMIC_ACQUIRE)) {
+			if (pool->is_shutdown ||
+			    worker->id >= pool->thread_count) {
+				worker->is_running = false;
+				tt_pthread_mutex_unlock(&worker->mutex);
+				break;
+			}
+			worker->is_idle = true;
+			tt_pthread_cond_wait(&worker->cond, &worker->mutex);
+			worker->is_idle = false;
+		}
+		tt_pthread_mutex_unlock(&worker->mutex);
+	}
+	cord_destroy(cord);
+	free(cord);
+	return NULL;
+}
+
+/**
+ * Return the worker with the given index, creating it if needed.
+ * Called with the pool mutex held.
+ */
+static struct coio_worker *
+coio_pool_worker(struct coio_pool *pool, int id)
+{
+	if (id < pool->worker_count)
+		return pool->workers[id];
+	assert(id == pool->worker_count);
+	struct coio_worker *worker = (struct coio_worker *)
+		calloc(1, sizeof(*worker));
+	if (worker == NULL)
+		panic("failed to allocate coio worker");
+	worker->id = id;
+	tt_pthread_mutex_init(&worker->mutex, NULL);
+	tt_pthread_cond_init(&worker->cond, NULL);
+	for (int pri = 0; pri < coio_task_pri_MAX; pri++)
+		rlist_create(&worker->queue[pri]);
+	pool->workers[id] = worker;
+	__atomic_store_n(&pool->worker_count, id + 1, __ATOMIC_RELEASE);
+	return worker;
+}
+
+/**
+ * Start a worker thread. Called with the worker mutex held.
+ * On failure the worker's tasks stay queued and are picked up
+ * by other workers.
+ */
+static void
+coio_worker_start(struct coio_worker *worker)
+{
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, coio_worker_f, worker) != 0) {
+		say_syserror("failed to start coio worker thread");
+		return;
+	}
+	pthread_detach(thread);
+	worker->is_running = true;
+}
+
+/** Queue a task to a worker. */
+static void
+coio_task_submit(struct coio_task *task)
+{
+	struct coio_pool *pool = &coio_pool;
+	assert(task->pri < coio_task_pri_MAX);
+	assert(coio_manager.loop != NULL);
+	task->manager = &coio_manager;
+	task->submit_time = clock_monotonic();
+	__atomic_add_fetch(&pool->stat[task->pri].queue, 1,
+			   __ATOMIC_RELAXED);
+
+	tt_pthread_mutex_lock(&pool->mutex);
+	int count = pool->thread_count;
+	/*
+	 * Prefer a worker which is idle or not started yet,
+	 * fall back on round-robin.
+	 */
+	int id = -1;
+	for (int i = 0; i < count; i++) {
+		int candidate = (pool->next + i) % count;
+		if (candidate >= pool->worker_count) {
+			id = candidate;
+			break;
+		}
+		struct coio_worker *worker = pool->workers[candidate];
+		if (__atomic_load_n(&worker->is_idle, __ATOMIC_RELAXED) ||
+		    !__atomic_load_n(&worker->is_running, __ATOMIC_RELAXED)) {
+			id = candidate;
+			break;
+		}
+	}
+	if (id < 0)
+		id = pool->next % count;
+	pool->next = (id + 1) % count;
+	/* Workers are created in order. */
+	if (id >= pool->worker_count)
+		id = pool->worker_count;
+	struct coio_worker *worker = coio_pool_worker(pool, id);
+
+	tt_pthread_mutex_lock(&worker->mutex);
+	rlist_add_tail_entry(&worker->queue[task->pri], task, link);
+	bool is_busy = false;
+	if (!worker->is_running)
+		coio_worker_start(worker);
+	else if (worker->is_idle)
+		tt_pthread_cond_signal(&worker->cond);
+	else
+		is_busy = true;
+	tt_pthread_mutex_unlock(&worker->mutex);
+	__atomic_add_fetch(&pool->submit_seq, 1, __ATOMIC_RELEASE);
+	if (is_busy) {
+		/*
+		 * Wake up an idle worker, if any, to steal the
+		 * task. A worker which is just going to sleep
+		 * notices the new submission sequence number.
+		 */
+		for (int i = 0; i < pool->worker_count; i++) {
+			struct coio_worker *idle = pool->workers[i];
+			if (idle == worker)
+				continue;
+			tt_pthread_mutex_lock(&idle->mutex);
+			bool found = idle->is_idle;
+			if (found)
+				tt_pthread_cond_signal(&idle->cond);
+			tt_pthread_mutex_unlock(&idle->mutex);
+			if (found)
+				break;
+		}
+	}
+	tt_pthread_mutex_unlock(&pool->mutex);
+}
+
+void
+coio_set_thread_count(int count)
+{
+	struct coio_pool *pool = &coio_pool;
+	count = MIN(MAX(count, 1), COIO_THREADS_MAX);
+	tt_pthread_mutex_lock(&pool->mutex);
+	__atomic_store_n(&pool->thread_count, count, __ATOMIC_RELAXED);
+	if (pool->next >= count)
+		pool->next = 0;
+	/* Wake up extra workers to let them stop. */
+	for (int i = count; i < pool->worker_count; i++) {
+		struct coio_worker *worker = pool->workers[i];
+		tt_pthread_mutex_lock(&worker->mutex);
+		tt_pthread_cond_signal(&worker->cond);
+		tt_pthread_mutex_unlock(&worker->mutex);
+	}
+	tt_pthread_mutex_unlock(&pool->mutex);
+}
+
+/** Complete the tasks done by workers in the submitting thread. */
+static void
+coio_done_cb(ev_loop *loop, struct ev_async *w, int events)
+{
+	(void)loop;
+	(void)events;
+	struct coio_manager *manager = container_of(w, struct coio_manager,
+						    done_async);
+	RLIST_HEAD(done);
+	tt_pthread_mutex_lock(&manager->mutex);
+	rlist_splice(&done, &manager->done);
+	tt_pthread_mutex_unlock(&manager->mutex);
+	struct coio_task *task, *tmp;
+	rlist_foreach_entry_safe(task, &done, link, tmp) {
+		rlist_del_entry(task, link);
+		if (task->fiber == NULL) {
+			/*
+			 * Timed out or detached, free
+			 * the resources.
+			 */
+			if (task->timeout_cb != NULL)
+				task->timeout_cb(task);
+			continue;
+		}
+		task->complete = 1;
+		fiber_wakeup(task->fiber);
+	}
+}
+
 static void
 coio_idle_cb(ev_loop *loop, struct ev_idle *w, int events)
 {
@@ -149,56 +565,37 @@ coio_enable(void)
 	ev_async_init(&coio_manager.coio_async, coio_async_cb);
 
 	ev_async_start(loop(), &coio_manager.coio_async);
+
+	rlist_create(&coio_manager.done);
+	tt_pthread_mutex_init(&coio_manager.mutex, NULL);
+	ev_async_init(&coio_manager.done_async, coio_done_cb);
+	ev_async_start(loop(), &coio_manager.done_async);
 }
 
 void
 coio_shutdown(void)
 {
 	eio_set_max_parallel(0);
-}
-
-static void
-coio_on_feed(eio_req *req)
-{
-	struct coio_task *task = (struct coio_task *) req;
-	req->result = task->task_cb(task);
-	if (req->result)
-		diag_move(diag_get(), &task->diag);
-}
 
-/**
- * A callback invoked by eio_poll when associated
- * eio_request is complete.
- */
-static int
-coio_on_finish(eio_req *req)
-{
-	struct coio_task *task = (struct coio_task *) req;
-	if (task->fiber == NULL) {
-		/*
-		 * Timed out. Resources will be freed by coio_on_destroy.
-		 * NOTE: it is not safe to run timeout_cb handler here.
-		 */
-		return 0;
+	struct coio_pool *pool = &coio_pool;
+	tt_pthread_mutex_lock(&pool->mutex);
+	pool->is_shutdown = true;
+	for (int i = 0; i < pool->worker_count; i++) {
+		struct coio_worker *worker = pool->workers[i];
+		tt_pthread_mutex_lock(&worker->mutex);
+		tt_pthread_cond_signal(&worker->cond);
+		tt_pthread_mutex_unlock(&worker->mutex);
 	}
-
-	task->complete = 1;
-	/* Reset on_timeout hook - resources will be freed by coio_task user */
-	task->base.destroy = NULL;
-	fiber_wakeup(task->fiber);
-	return 0;
+	tt_pthread_mutex_unlock(&pool->mutex);
 }
 
-/*
- * Free resources on timeout.
- */
 static void
-coio_on_destroy(eio_req *req)
+coio_on_feed(struct coio_task *task)
 {
-	struct coio_task *task = (struct coio_task *) req;
-	assert(task->fiber == NULL && task->complete == 0);
-	if (task->timeout_cb != NULL)
-		task->timeout_cb(task);
+	task->result = task->task_cb(task);
+	task->errorno = errno;
+	if (task->result)
+		diag_move(diag_get(), &task->diag);
 }
 
 void
@@ -207,13 +604,13 @@ coio_task_create(struct coio_task *task,
 {
 	assert(func != NULL && on_timeout != NULL);
 
-	/* from eio.c: REQ() definition */
-	memset(&task->base, 0, sizeof(task->base));
-	task->base.type = EIO_CUSTOM;
-	task->base.feed = coio_on_feed;
-	task->base.finish = coio_on_finish;
-	task->base.destroy = coio_on_destroy;
-	/* task->base.pri = 0; */
+	rlist_create(&task->link);
+	task->run = coio_on_feed;
+	task->manager = NULL;
+	task->pri = COIO_PRI_NORMAL;
+	task->submit_time = 0;
+	task->result = 0;
+	task->errorno = 0;
 
 	task->fiber = fiber();
 	task->task_cb = func;
@@ -231,19 +628,19 @@ coio_task_destroy(struct coio_task *task)
 void
 coio_task_post(struct coio_task *task)
 {
-	assert(task->base.type == EIO_CUSTOM);
+	assert(task->run == coio_on_feed);
 	assert(task->fiber == fiber());
-	eio_submit(&task->base);
 	task->fiber = NULL;
+	coio_task_submit(task);
 }
 
 int
 coio_task_execute(struct coio_task *task, double timeout)
 {
-	assert(task->base.type == EIO_CUSTOM);
+	assert(task->run == coio_on_feed);
 	assert(task->fiber == fiber());
 
-	eio_submit(&task->base);
+	coio_task_submit(task);
 	fiber_yield_timeout(timeout);
 	if (!task->complete) {
 		/* timed out or cancelled. */
@@ -258,11 +655,11 @@ coio_task_execute(struct coio_task *task, double timeout)
 }
 
 static void
-coio_on_call(eio_req *req)
+coio_on_call(struct coio_task *task)
 {
-	struct coio_task *task = (struct coio_task *) req;
-	req->result = task->call_cb(task->ap);
-	if (req->result)
+	task->result = task->call_cb(task->ap);
+	task->errorno = errno;
+	if (task->result)
 		diag_move(diag_get(), &task->diag);
 }
 
@@ -272,12 +669,8 @@ coio_call(ssize_t (*func)(va_list ap), ...)
 	struct coio_task *task = (struct coio_task *) calloc(1, sizeof(*task));
 	if (task == NULL)
 		return -1; /* errno = ENOMEM */
-	/* from eio.c: REQ() definition */
-	task->base.type = EIO_CUSTOM;
-	task->base.feed = coio_on_call;
-	task->base.finish = coio_on_finish;
-	/* task->base.destroy = NULL; */
-	/* task->base.pri = 0; */
+	task->run = coio_on_call;
+	task->pri = COIO_PRI_NORMAL;
 
 	task->fiber = fiber();
 	task->call_cb = func;
@@ -285,15 +678,15 @@ coio_call(ssize_t (*func)(va_list ap), ...)
 	diag_create(&task->diag);
 
 	va_start(task->ap, func);
-	eio_submit(&task->base);
+	coio_task_submit(task);
 
 	do {
 		fiber_yield();
 	} while (task->complete == 0);
 	va_end(task->ap);
 
-	ssize_t result = task->base.result;
-	int save_errno = errno;
+	ssize_t result = task->result;
+	int save_errno = task->errorno;
 	if (result)
 		diag_move(&task->diag, diag_get());
 	free(task);
@@ -372,6 +765,8 @@ coio_getaddrinfo(const char *host, const char *port,
 	}
 
 	coio_task_create(&task->base, getaddrinfo_cb, getaddrinfo_free_cb);
+	/* Name resolution may take long, don't let it delay others. */
+	task->base.pri = COIO_PRI_LOW;
 
 	/*
 	 * getaddrinfo() on osx upto osx 10.8 crashes when AI_NUMERICSERV is
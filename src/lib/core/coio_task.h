@@ -35,8 +35,10 @@
 
 #include <sys/types.h> /* ssize_t */
 #include <stdarg.h>
+#include <stdint.h>
 
 #include "third_party/tarantool_eio.h"
+#include "small/rlist.h"
 #include "diag.h"
 
 #if defined(__cplusplus)
@@ -44,25 +46,88 @@ extern "C" {
 #endif /* defined(__cplusplus) */
 
 /**
- * Asynchronous IO Tasks (libeio wrapper)
+ * Asynchronous IO Tasks
  *
  * Yield the current fiber until a created task is complete.
+ *
+ * Tasks are run by a pool of worker threads. Each worker has
+ * its own queue per priority class and steals tasks from other
+ * workers when its own queues are empty. File operations
+ * (coio_file.h) are run by libeio threads.
  */
 
 void coio_init(void);
 void coio_enable(void);
 void coio_shutdown(void);
 
+/**
+ * Set the number of worker threads. Threads are started on
+ * demand, extra threads stop once they have nothing to do.
+ */
+void
+coio_set_thread_count(int count);
+
+/**
+ * Priority classes of coio tasks. A worker always picks a task
+ * of the highest priority available, and low priority tasks may
+ * occupy all workers but one, so that a flood of slow tasks
+ * doesn't block the others.
+ */
+enum coio_task_pri {
+	/** Short housekeeping tasks: log rotation, file removal. */
+	COIO_PRI_HIGH,
+	/** Default class. */
+	COIO_PRI_NORMAL,
+	/** Tasks which may block for long, e.g. name resolution. */
+	COIO_PRI_LOW,
+	coio_task_pri_MAX,
+};
+
+extern const char *coio_task_pri_strs[];
+
+/** Statistics of a coio task priority class. */
+struct coio_task_stat {
+	/** Number of tasks waiting for a worker. */
+	int64_t queue;
+	/** Number of tasks taken by workers. */
+	int64_t count;
+	/** Total time tasks spent in queue, in seconds. */
+	double wait_total;
+	/** Max time a task spent in queue, in seconds. */
+	double wait_max;
+};
+
+/** Get statistics of a task priority class. */
+void
+coio_task_stat(enum coio_task_pri pri, struct coio_task_stat *stat);
+
 struct coio_task;
+struct coio_manager;
 
 typedef ssize_t (*coio_call_cb)(va_list ap);
-typedef int (*coio_task_cb)(struct coio_task *task); /* like eio_req */
+typedef int (*coio_task_cb)(struct coio_task *task);
 
 /**
  * A single task context.
  */
 struct coio_task {
-	struct eio_req base; /* eio_task - must be first */
+	/** Link in a worker queue or in the list of done tasks. */
+	struct rlist link;
+	/** Function run by a worker, calls task_cb or call_cb. */
+	void (*run)(struct coio_task *task);
+	/** Manager of the thread which submitted the task. */
+	struct coio_manager *manager;
+	/**
+	 * Priority class, COIO_PRI_NORMAL by default. May be
+	 * changed after coio_task_create().
+	 */
+	enum coio_task_pri pri;
+	/** Time the task was submitted, for statistics. */
+	double submit_time;
+	/** Return value of the callback. */
+	ssize_t result;
+	/** errno set by the callback. */
+	int errorno;
 	/**
 	 * The calling fiber. When set to NULL, the task is
 	 * detached - its resources are freed eventually, and such
@@ -90,7 +155,7 @@ struct coio_task {
  * Create coio_task.
  *
  * @param task coio task
- * @param func a callback to execute in EIO thread pool.
+ * @param func a callback to execute in the coio thread pool.
  * @param on_timeout a callback to execute on timeout
  */
 void
@@ -111,7 +176,7 @@ coio_task_destroy(struct coio_task *task);
  * @param task coio task.
  * @param timeout timeout in seconds.
  * @retval 0  the task completed successfully. Check the result
- *            code in task->base.result and free the task.
+ *            code in task->result and free the task.
  * @retval -1 timeout or the waiting fiber was cancelled (check diag);
  *            the caller should not free the task, it
  *            will be freed when it's finished in the timeout
@@ -130,7 +195,7 @@ coio_task_post(struct coio_task *task);
 /** \cond public */
 
 /**
- * Create new eio task with specified function and
+ * Create new coio task with specified function and
  * arguments. Yield and wait until the task is complete.
  *
  * This function doesn't throw exceptions to avoid double error
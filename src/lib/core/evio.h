@@ -121,6 +121,22 @@ evio_service_listen(struct evio_service *service);
 void
 evio_service_stop(struct evio_service *service);
 
+/**
+ * Start accepting connections on the bound and listening
+ * socket of @a src service, which may belong to another
+ * thread. The socket is shared, @a src remains its owner.
+ */
+void
+evio_service_attach(struct evio_service *dst, const struct evio_service *src);
+
+/**
+ * Stop accepting connections on a service attached with
+ * evio_service_attach(). Unlike evio_service_stop(), the
+ * acceptor socket is left open for its owner.
+ */
+void
+evio_service_detach(struct evio_service *service);
+
 int
 evio_socket(struct ev_io *coio, int domain, int type, int protocol);
 
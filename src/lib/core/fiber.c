@@ -36,8 +36,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <pmatomic.h>
 
+#include "affinity.h"
 #include "assoc.h"
 #include "memory.h"
 #include "trigger.h"
@@ -276,6 +278,32 @@ static const struct fiber_attr fiber_attr_default = {
        .flags = FIBER_DEFAULT_FLAGS
 };
 
+enum {
+	/** Max number of stacks trimmed per event loop iteration. */
+	FIBER_STACK_TRIM_BATCH = 32,
+};
+
+/**
+ * Size class of a stack of the given size: the order of the slab
+ * it is allocated from. fiber_stack_create() asks slab_get() for
+ * stack_size - slab_sizeof() bytes, and slab_get() adds the slab
+ * header back, so the order is computed for the full size, the
+ * same as slab::order of a recycled stack.
+ */
+static inline unsigned
+fiber_stack_class(struct cord *cord, size_t stack_size)
+{
+	return slab_order(&cord->slabc, stack_size);
+}
+
+/** Check if dead fibers of the stack size class can be reused. */
+static inline bool
+fiber_stack_class_is_pooled(struct cord *cord, unsigned stack_class)
+{
+	return stack_class < FIBER_STACK_CLASS_COUNT &&
+	       stack_class <= cord->slabc.order_max;
+}
+
 #ifdef HAVE_MADV_DONTNEED
 /*
  * Random values generated with uuid.
@@ -688,6 +716,115 @@ fiber_schedule_timeout(ev_loop *loop,
 	fiber_wakeup(state->f);
 }
 
+/**
+ * Timeouts shorter than this are served by the libev timer heap,
+ * which is precise, longer ones go to the cord timer wheel, which
+ * has a granularity of 1 ms.
+ */
+static const ev_tstamp FIBER_TIMER_WHEEL_MIN_DELAY = 0.01;
+/**
+ * Longer timeouts are clamped, they can't expire anyway, but the
+ * tick count would overflow.
+ */
+static const ev_tstamp FIBER_TIMER_WHEEL_MAX_DELAY = 100 * 365 * 86400.0;
+/** Timer wheel ticks per second. */
+static const ev_tstamp FIBER_TIMER_WHEEL_TICKS = 1000;
+
+/** A fiber waiting on the cord timer wheel. */
+struct fiber_wheel_timer {
+	struct timer_wheel_entry entry;
+	struct fiber_watcher_data state;
+};
+
+/**
+ * Current monotonic time of the cord event loop, in wheel ticks.
+ * The libev timer driving the wheel is monotonic, so the wheel
+ * must not follow the wall clock, which may jump.
+ */
+static inline uint64_t
+fiber_timer_wheel_now(struct ev_loop *loop)
+{
+	return (uint64_t)(ev_monotonic_now(loop) * FIBER_TIMER_WHEEL_TICKS);
+}
+
+/**
+ * Set the libev timer driving the wheel to fire at the tick the
+ * wheel needs to be advanced to next, or stop it if the wheel is
+ * empty.
+ */
+static void
+fiber_timer_wheel_rearm(struct cord *cord)
+{
+	struct ev_loop *loop = cord->loop;
+	uint64_t next = timer_wheel_next(&cord->timer_wheel);
+	if (next == cord->timer_wheel_deadline)
+		return;
+	ev_timer_stop(loop, &cord->timer_wheel_event);
+	cord->timer_wheel_deadline = next;
+	if (next == UINT64_MAX)
+		return;
+	ev_tstamp delay = next / FIBER_TIMER_WHEEL_TICKS -
+			  ev_monotonic_now(loop);
+	ev_timer_set(&cord->timer_wheel_event, MAX(delay, 0), 0);
+	ev_timer_start(loop, &cord->timer_wheel_event);
+}
+
+static void
+fiber_schedule_timer_wheel(ev_loop *loop, ev_timer *watcher, int revents)
+{
+	(void) watcher;
+	(void) revents;
+
+	assert(fiber() == &cord()->sched);
+	struct cord *cord = cord();
+	/*
+	 * The timer may fire a bit earlier than the tick it
+	 * was set to due to rounding.
+	 */
+	uint64_t now = MAX(fiber_timer_wheel_now(loop),
+			   cord->timer_wheel_deadline);
+	cord->timer_wheel_deadline = UINT64_MAX;
+	RLIST_HEAD(expired);
+	timer_wheel_advance(&cord->timer_wheel, now, &expired);
+	struct fiber_wheel_timer *timer, *tmp;
+	rlist_foreach_entry_safe(timer, &expired, entry.link, tmp) {
+		rlist_del_entry(timer, entry.link);
+		timer->state.timed_out = true;
+		fiber_wakeup(timer->state.f);
+	}
+	fiber_timer_wheel_rearm(cord);
+}
+
+/** Put the current fiber on the cord timer wheel. */
+static void
+fiber_timer_wheel_start(struct fiber_wheel_timer *timer, ev_tstamp delay)
+{
+	struct cord *cord = cord();
+	struct timer_wheel *wheel = &cord->timer_wheel;
+	if (delay > FIBER_TIMER_WHEEL_MAX_DELAY)
+		delay = FIBER_TIMER_WHEEL_MAX_DELAY;
+	struct ev_loop *loop = loop();
+	if (timer_wheel_is_empty(wheel))
+		timer_wheel_advance(wheel, fiber_timer_wheel_now(loop), NULL);
+	/* Round up so as never to wake the fiber too early. */
+	uint64_t expire = (uint64_t)ceil((ev_monotonic_now(loop) + delay) *
+					 FIBER_TIMER_WHEEL_TICKS);
+	timer_wheel_entry_create(&timer->entry);
+	timer_wheel_add(wheel, &timer->entry, expire);
+	if (expire < cord->timer_wheel_deadline)
+		fiber_timer_wheel_rearm(cord);
+}
+
+/** Remove a timer which has not expired from the cord wheel. */
+static void
+fiber_timer_wheel_stop(struct fiber_wheel_timer *timer)
+{
+	struct cord *cord = cord();
+	timer_wheel_del(&cord->timer_wheel, &timer->entry);
+	if (timer_wheel_is_empty(&cord->timer_wheel))
+		fiber_timer_wheel_rearm(cord);
+}
+
 /**
  * @brief yield & check timeout
  * @return true if timeout exceeded
@@ -695,6 +832,16 @@ fiber_schedule_timeout(ev_loop *loop,
 bool
 fiber_yield_timeout(ev_tstamp delay)
 {
+	if (delay >= FIBER_TIMER_WHEEL_MIN_DELAY) {
+		struct fiber_wheel_timer timer;
+		timer.state.f = fiber();
+		timer.state.timed_out = false;
+		fiber_timer_wheel_start(&timer, delay);
+		fiber_yield();
+		if (!timer.state.timed_out)
+			fiber_timer_wheel_stop(&timer);
+		return timer.state.timed_out;
+	}
 	struct ev_timer timer;
 	ev_timer_init(&timer, fiber_schedule_timeout, delay, 0);
 	struct fiber_watcher_data state = { fiber(), false };
@@ -851,8 +998,6 @@ fiber_recycle(struct fiber *fiber)
 	assert(diag_is_empty(&fiber->diag));
 	/* no pending wakeup */
 	assert(rlist_empty(&fiber->state));
-	bool has_custom_stack = fiber->flags & FIBER_CUSTOM_STACK;
-	fiber_stack_recycle(fiber);
 	fiber_reset(fiber);
 	fiber->name[0] = '\0';
 	fiber->f = NULL;
@@ -861,10 +1006,16 @@ fiber_recycle(struct fiber *fiber)
 	unregister_fid(fiber);
 	fiber->fid = 0;
 	region_free(&fiber->gc);
-	if (!has_custom_stack) {
-		rlist_move_entry(&cord()->dead, fiber, link);
+	struct cord *cord = cord();
+	unsigned stack_class = fiber->stack_slab->order;
+	if (fiber_stack_class_is_pooled(cord, stack_class) &&
+	    (stack_class == cord->default_stack_class ||
+	     cord->dead_count[stack_class] < FIBER_STACK_POOL_MAX)) {
+		fiber_stack_recycle(fiber);
+		rlist_move_entry(&cord->dead[stack_class], fiber, link);
+		cord->dead_count[stack_class]++;
 	} else {
-		fiber_destroy(cord(), fiber);
+		fiber_destroy(cord, fiber);
 	}
 }
 
@@ -994,17 +1145,12 @@ stack_put_watermark(void *addr)
 }
 
 /**
- * Free stack memory above the watermark when a fiber is recycled.
- * To avoid a pointless syscall invocation in case the fiber hasn't
- * touched memory above the watermark, we only call madvise() if
- * the fiber has overwritten a poison value.
+ * Free stack memory above the watermark and put the watermark
+ * back.
  */
 static void
-fiber_stack_recycle(struct fiber *fiber)
+fiber_stack_trim(struct fiber *fiber)
 {
-	if (fiber->stack_watermark == NULL ||
-	    stack_has_watermark(fiber->stack_watermark))
-		return;
 	/*
 	 * When dropping pages make sure the page containing
 	 * the watermark isn't touched since we're updating
@@ -1028,6 +1174,42 @@ fiber_stack_recycle(struct fiber *fiber)
 	stack_put_watermark(fiber->stack_watermark);
 }
 
+/**
+ * Schedule freeing of stack memory above the watermark when a
+ * fiber is recycled. To avoid a pointless syscall invocation in
+ * case the fiber hasn't touched memory above the watermark, we
+ * only call madvise() if the fiber has overwritten a poison value.
+ */
+static void
+fiber_stack_recycle(struct fiber *fiber)
+{
+	if (fiber->stack_watermark == NULL ||
+	    stack_has_watermark(fiber->stack_watermark))
+		return;
+	struct cord *cord = cord();
+	if (rlist_empty(&cord->stack_trim))
+		ev_idle_start(cord->loop, &cord->stack_trim_event);
+	rlist_add_tail_entry(&cord->stack_trim, fiber, stack_trim_link);
+}
+
+static void
+fiber_schedule_stack_trim(ev_loop *loop, ev_idle *watcher, int revents)
+{
+	(void) revents;
+
+	struct cord *cord = cord();
+	for (int i = 0; i < FIBER_STACK_TRIM_BATCH &&
+	     !rlist_empty(&cord->stack_trim); i++) {
+		struct fiber *fiber = rlist_shift_entry(&cord->stack_trim,
+							struct fiber,
+							stack_trim_link);
+		fiber_stack_trim(fiber);
+		cord->stack_stat.trimmed++;
+	}
+	if (rlist_empty(&cord->stack_trim))
+		ev_idle_stop(loop, watcher);
+}
+
 /**
  * Initialize fiber stack watermark.
  */
@@ -1036,8 +1218,8 @@ fiber_stack_watermark_create(struct fiber *fiber)
 {
 	assert(fiber->stack_watermark == NULL);
 
-	/* No tracking on custom stacks for simplicity. */
-	if (fiber->flags & FIBER_CUSTOM_STACK)
+	/* Small stacks have nothing to trim. */
+	if (fiber->stack_size <= FIBER_STACK_SIZE_WATERMARK)
 		return;
 
 	/*
@@ -1072,6 +1254,13 @@ fiber_stack_recycle(struct fiber *fiber)
 	(void)fiber;
 }
 
+static void
+fiber_schedule_stack_trim(ev_loop *loop, ev_idle *watcher, int revents)
+{
+	(void)revents;
+	ev_idle_stop(loop, watcher);
+}
+
 static void
 fiber_stack_watermark_create(struct fiber *fiber)
 {
@@ -1133,6 +1322,11 @@ fiber_stack_create(struct fiber *fiber, struct slab_cache *slabc,
 			 "runtime arena", "fiber stack");
 		return -1;
 	}
+	/*
+	 * Use the whole slab so that all stacks of a size class
+	 * are interchangeable.
+	 */
+	stack_size = fiber->stack_slab->size - slab_sizeof();
 	void *guard;
 	/* Adjust begin and size for stack memory chunk. */
 	if (stack_direction < 0) {
@@ -1184,12 +1378,17 @@ fiber_new_ex(const char *name, const struct fiber_attr *fiber_attr,
 	struct fiber *fiber = NULL;
 	assert(fiber_attr != NULL);
 
-	/* Now we can not reuse fiber if custom attribute was set */
-	if (!(fiber_attr->flags & FIBER_CUSTOM_STACK) &&
-	    !rlist_empty(&cord->dead)) {
-		fiber = rlist_first_entry(&cord->dead,
+	unsigned stack_class = fiber_stack_class(cord, fiber_attr->stack_size);
+	if (fiber_stack_class_is_pooled(cord, stack_class) &&
+	    !rlist_empty(&cord->dead[stack_class])) {
+		fiber = rlist_first_entry(&cord->dead[stack_class],
 					  struct fiber, link);
 		rlist_move_entry(&cord->alive, fiber, link);
+		cord->dead_count[stack_class]--;
+		/* The stack is going to be used, don't trim it. */
+		rlist_del_entry(fiber, stack_trim_link);
+		fiber->flags = fiber_attr->flags;
+		cord->stack_stat.reused++;
 	} else {
 		fiber = (struct fiber *)
 			mempool_alloc(&cord->fiber_mempool);
@@ -1212,11 +1411,13 @@ fiber_new_ex(const char *name, const struct fiber_attr *fiber_attr,
 
 		rlist_create(&fiber->state);
 		rlist_create(&fiber->wake);
+		rlist_create(&fiber->stack_trim_link);
 		diag_create(&fiber->diag);
 		fiber_reset(fiber);
 		fiber->flags = fiber_attr->flags;
 
 		rlist_add_entry(&cord->alive, fiber, link);
+		cord->stack_stat.created++;
 	}
 
 	fiber->f = f;
@@ -1268,6 +1469,7 @@ fiber_destroy(struct cord *cord, struct fiber *f)
 	trigger_destroy(&f->on_stop);
 	rlist_del(&f->state);
 	rlist_del(&f->link);
+	rlist_del(&f->stack_trim_link);
 	region_destroy(&f->gc);
 	fiber_stack_destroy(f, &cord->slabc);
 	diag_destroy(&f->diag);
@@ -1282,9 +1484,13 @@ fiber_destroy_all(struct cord *cord)
 	while (!rlist_empty(&cord->alive))
 		fiber_destroy(cord, rlist_first_entry(&cord->alive,
 						      struct fiber, link));
-	while (!rlist_empty(&cord->dead))
-		fiber_destroy(cord, rlist_first_entry(&cord->dead,
-						      struct fiber, link));
+	for (int i = 0; i < FIBER_STACK_CLASS_COUNT; i++) {
+		while (!rlist_empty(&cord->dead[i]))
+			fiber_destroy(cord, rlist_first_entry(&cord->dead[i],
+							      struct fiber,
+							      link));
+		cord->dead_count[i] = 0;
+	}
 }
 
 #if ENABLE_FIBER_TOP
@@ -1411,7 +1617,15 @@ cord_create(struct cord *cord, const char *name)
 		       sizeof(struct fiber));
 	rlist_create(&cord->alive);
 	rlist_create(&cord->ready);
-	rlist_create(&cord->dead);
+	for (int i = 0; i < FIBER_STACK_CLASS_COUNT; i++) {
+		rlist_create(&cord->dead[i]);
+		cord->dead_count[i] = 0;
+	}
+	cord->default_stack_class = fiber_stack_class(cord,
+						FIBER_STACK_SIZE_DEFAULT);
+	rlist_create(&cord->stack_trim);
+	ev_idle_init(&cord->stack_trim_event, fiber_schedule_stack_trim);
+	memset(&cord->stack_stat, 0, sizeof(cord->stack_stat));
 	cord->fiber_registry = mh_i32ptr_new();
 
 	/* sched fiber is not present in alive/ready/dead list. */
@@ -1433,6 +1647,11 @@ cord_create(struct cord *cord, const char *name)
 
 	ev_idle_init(&cord->idle_event, fiber_schedule_idle);
 
+	timer_wheel_create(&cord->timer_wheel, 0);
+	ev_timer_init(&cord->timer_wheel_event, fiber_schedule_timer_wheel,
+		      0, 0);
+	cord->timer_wheel_deadline = UINT64_MAX;
+
 #if ENABLE_FIBER_TOP
 	/* fiber.top() currently works only for the main thread. */
 	if (cord_is_main()) {
@@ -1440,6 +1659,7 @@ cord_create(struct cord *cord, const char *name)
 	}
 #endif /* ENABLE_FIBER_TOP */
 	cord_set_name(name);
+	affinity_apply(name);
 
 #if ENABLE_ASAN
 	/* Record stack extents */
@@ -1459,8 +1679,11 @@ void
 cord_destroy(struct cord *cord)
 {
 	slab_cache_set_thread(&cord->slabc);
-	if (cord->loop)
+	if (cord->loop) {
+		ev_timer_stop(cord->loop, &cord->timer_wheel_event);
+		ev_idle_stop(cord->loop, &cord->stack_trim_event);
 		ev_loop_destroy(cord->loop);
+	}
 	/* Only clean up if initialized. */
 	if (cord->fiber_registry) {
 		fiber_destroy_all(cord);
@@ -1788,3 +2011,56 @@ int fiber_stat(fiber_stat_cb cb, void *cb_ctx)
 	}
 	return 0;
 }
+
+size_t
+fiber_stack_rss(struct fiber *f)
+{
+	if (f->stack == NULL || f->stack_slab == NULL)
+		return 0;
+#ifdef HAVE_MINCORE
+	char *start = page_align_down(f->stack);
+	char *end = page_align_up(f->stack + f->stack_size);
+	size_t rss = 0;
+	unsigned char vec[256];
+	while (start < end) {
+		size_t pages = MIN((size_t)(end - start) / page_size,
+				   lengthof(vec));
+		if (mincore(start, pages * page_size, (void *)vec) != 0)
+			return f->stack_size;
+		for (size_t i = 0; i < pages; i++) {
+			if (vec[i] & 1)
+				rss += page_size;
+		}
+		start += pages * page_size;
+	}
+	return rss;
+#else
+	return f->stack_size;
+#endif /* HAVE_MINCORE */
+}
+
+void
+cord_stack_stat(struct cord *cord, struct fiber_stack_stat *stat,
+		bool with_rss)
+{
+	*stat = cord->stack_stat;
+	stat->used = 0;
+	stat->pooled = 0;
+	stat->size = 0;
+	stat->rss = 0;
+	struct fiber *fiber;
+	rlist_foreach_entry(fiber, &cord->alive, link) {
+		stat->used++;
+		stat->size += fiber->stack_size;
+		if (with_rss)
+			stat->rss += fiber_stack_rss(fiber);
+	}
+	for (int i = 0; i < FIBER_STACK_CLASS_COUNT; i++) {
+		rlist_foreach_entry(fiber, &cord->dead[i], link) {
+			stat->pooled++;
+			stat->size += fiber->stack_size;
+			if (with_rss)
+				stat->rss += fiber_stack_rss(fiber);
+		}
+	}
+}
@@ -42,6 +42,7 @@
 #include "small/region.h"
 #include "small/rlist.h"
 #include "salad/stailq.h"
+#include "timer_wheel.h"
 
 #include <third_party/coro/coro.h>
 
@@ -165,6 +166,21 @@ enum {
 	FIBER_DEFAULT_FLAGS = FIBER_IS_CANCELLABLE
 };
 
+enum {
+	/**
+	 * Number of fiber stack size classes. A class is the
+	 * order of the slab the stack is allocated from, stacks
+	 * of larger orders aren't pooled.
+	 */
+	FIBER_STACK_CLASS_COUNT = 16,
+	/**
+	 * Max number of dead fibers kept for reuse per stack size
+	 * class, except the class of the default stack size,
+	 * which isn't limited.
+	 */
+	FIBER_STACK_POOL_MAX = 16,
+};
+
 /** \cond public */
 
 /**
@@ -538,6 +554,8 @@ struct fiber {
 #endif /* ENABLE_FIBER_TOP */
 	/** Link in cord->alive or cord->dead list. */
 	struct rlist link;
+	/** Link in cord->stack_trim list. */
+	struct rlist stack_trim_link;
 	/** Link in cord->ready list. */
 	struct rlist state;
 
@@ -608,6 +626,11 @@ struct fiber {
 		 */
 		struct {
 			uint64_t sync;
+			/**
+			 * Time spent waiting for WAL writes
+			 * while processing the request.
+			 */
+			double wal_time;
 		} net;
 	} storage;
 	/** An object to wait for incoming message or a reader. */
@@ -628,6 +651,27 @@ fiber_on_stop(struct fiber *f);
 
 struct cord_on_exit;
 
+/** Fiber stack statistics of a cord, see cord_stack_stat(). */
+struct fiber_stack_stat {
+	/** Number of fibers created with a newly allocated stack. */
+	uint64_t created;
+	/** Number of fibers created with a stack from the pool. */
+	uint64_t reused;
+	/** Number of stacks trimmed in background. */
+	uint64_t trimmed;
+	/** Number of stacks of alive fibers. */
+	size_t used;
+	/** Number of stacks of dead fibers kept for reuse. */
+	size_t pooled;
+	/** Total size of all stacks, in bytes. */
+	size_t size;
+	/**
+	 * Resident memory of all stacks, in bytes. Collected
+	 * only on demand, see cord_stack_stat().
+	 */
+	size_t rss;
+};
+
 /**
  * @brief An independent execution unit that can be managed by a separate OS
  * thread. Each cord consists of fibers to implement cooperative multitasking
@@ -654,8 +698,26 @@ struct cord {
 	struct rlist alive;
 	/** Fibers, ready for execution */
 	struct rlist ready;
-	/** A cache of dead fibers for reuse */
-	struct rlist dead;
+	/** A cache of dead fibers for reuse, by stack size class. */
+	struct rlist dead[FIBER_STACK_CLASS_COUNT];
+	/** Number of fibers in each of the dead lists. */
+	uint32_t dead_count[FIBER_STACK_CLASS_COUNT];
+	/** Size class of the default fiber stack. */
+	uint8_t default_stack_class;
+	/**
+	 * Dead fibers which stacks grew above the watermark and
+	 * have to be trimmed with madvise(). The trimming is done
+	 * in background, when the event loop is idle, so that a
+	 * fiber reused soon after death doesn't pay for it.
+	 */
+	struct rlist stack_trim;
+	/** An event to trim fiber stacks when the loop is idle. */
+	ev_idle stack_trim_event;
+	/**
+	 * Fiber creation counters. Other members are
+	 * calculated by cord_stack_stat().
+	 */
+	struct fiber_stack_stat stack_stat;
 	/** A watcher to have a single async event for all ready fibers.
 	 * This technique is necessary to be able to suspend
 	 * a single fiber on a few watchers (for example,
@@ -671,6 +733,20 @@ struct cord {
 	 * is no 1 ms delay in case of zero sleep timeout.
 	 */
 	ev_idle idle_event;
+	/**
+	 * Coarse fiber timeouts, in milliseconds. Arming and
+	 * cancelling a timer in the wheel is O(1), unlike the
+	 * libev timer heap, which matters when there are lots
+	 * of fibers waiting with a timeout.
+	 */
+	struct timer_wheel timer_wheel;
+	/** The only libev timer driving the wheel. */
+	ev_timer timer_wheel_event;
+	/**
+	 * The tick the wheel timer is set to fire at, or
+	 * UINT64_MAX if it is stopped.
+	 */
+	uint64_t timer_wheel_deadline;
 #if ENABLE_FIBER_TOP
 	/** An event triggered on every event loop iteration start. */
 	ev_check check_event;
@@ -821,6 +897,23 @@ fiber_is_dead(struct fiber *f)
 
 typedef int (*fiber_stat_cb)(struct fiber *f, void *ctx);
 
+/**
+ * Return the resident memory of the fiber stack, in bytes. Pages
+ * of a stack are committed on first use and released only when
+ * the stack is trimmed.
+ */
+size_t
+fiber_stack_rss(struct fiber *f);
+
+/**
+ * Collect fiber stack statistics of a cord. Resident memory
+ * takes a mincore() call per stack, so it is counted only if
+ * @a with_rss is set, otherwise @a stat->rss is 0.
+ */
+void
+cord_stack_stat(struct cord *cord, struct fiber_stack_stat *stat,
+		bool with_rss);
+
 int
 fiber_stat(fiber_stat_cb cb, void *cb_ctx);
 
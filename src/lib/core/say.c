@@ -47,6 +47,9 @@
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <coio_task.h>
+#include <signal.h>
+#include <time.h>
+#include "tt_pthread.h"
 
 pid_t log_pid = 0;
 int log_level = S_INFO;
@@ -77,6 +80,10 @@ say_format_syslog(struct log *log, char *buf, int len, int level,
 		  const char *filename, int line, const char *error,
 		  const char *format, va_list ap);
 
+/** Drain the rings and stop the logger thread. */
+static void
+say_logger_async_stop(void);
+
 /** A utility function to handle va_list from different varargs functions. */
 static inline int
 log_vsay(struct log *log, int level, const char *filename, int line,
@@ -355,6 +362,7 @@ say_logrotate(struct ev_loop *loop, struct ev_signal *w, int revents)
 		ev_async_start(loop(), &log->log_async);
 		log->rotating_threads++;
 		coio_task_create(&task->base, logrotate_cb, logrotate_cleanup_cb);
+		task->base.pri = COIO_PRI_HIGH;
 		task->log = log;
 		task->loop = loop();
 		coio_task_post(&task->base);
@@ -750,6 +758,7 @@ fail:
 void
 say_logger_free(void)
 {
+	say_logger_async_stop();
 	if (say_logger_initialized())
 		log_destroy(&log_std);
 }
@@ -1070,6 +1079,444 @@ write_to_syslog(struct log *log, int total)
 	}
 }
 
+/** {{{ Asynchronous logger */
+
+enum {
+	/**
+	 * Size of a per-thread ring. Must be big enough to hold
+	 * the largest message, which is SAY_BUF_LEN_MAX.
+	 */
+	SAY_RING_SIZE = 256 * 1024,
+	/** How long the logger thread sleeps between checks. */
+	SAY_ASYNC_IDLE_MS = 100,
+	/** How long a thread waits for ring space between checks. */
+	SAY_ASYNC_WAIT_MS = 10,
+};
+
+/** Header of a message stored in a ring. */
+struct say_record {
+	/** Logger the message is addressed to. */
+	struct log *log;
+	int level;
+	/** Length of the formatted text following the header. */
+	int len;
+};
+
+/**
+ * Single producer single consumer byte ring. The producer is
+ * the thread owning the ring, the consumer is the logger
+ * thread. Positions grow monotonically and are reduced modulo
+ * the ring size on access.
+ */
+struct say_ring {
+	/** Next byte to write. Updated by the owner thread only. */
+	uint64_t head;
+	/** Next byte to read. Updated by the logger thread only. */
+	uint64_t tail;
+	/** Number of messages dropped on overflow. */
+	uint64_t dropped;
+	/** Part of @dropped already reported to the log. */
+	uint64_t dropped_reported;
+	/**
+	 * Set when the owner thread exits. The logger thread
+	 * frees an orphan ring once it is drained.
+	 */
+	bool is_orphan;
+	/** Link in say_async.rings. */
+	struct say_ring *next;
+	char data[SAY_RING_SIZE];
+};
+
+static struct {
+	/** True once the logger thread is started. */
+	bool is_running;
+	/** Set to ask the logger thread to drain and exit. */
+	bool is_stopping;
+	/** Set while the logger thread is about to sleep. */
+	bool is_sleeping;
+	enum say_overflow overflow;
+	/** Number of threads waiting for the rings to drain. */
+	int waiters;
+	/** Dropped counters of the freed orphan rings. */
+	uint64_t dropped;
+	/** All rings, protected by @mutex. */
+	struct say_ring *rings;
+	pthread_mutex_t mutex;
+	/** Signalled to wake up the logger thread. */
+	pthread_cond_t wakeup_cond;
+	/** Broadcast by the logger thread after a drain pass. */
+	pthread_cond_t drain_cond;
+	/** Marks the ring of an exiting thread as orphan. */
+	pthread_key_t ring_key;
+	pthread_t thread;
+} say_async = {
+	.overflow = SAY_OVERFLOW_BLOCK,
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.wakeup_cond = PTHREAD_COND_INITIALIZER,
+	.drain_cond = PTHREAD_COND_INITIALIZER,
+};
+
+/** Ring of the current thread, created on the first message. */
+static __thread struct say_ring *say_ring;
+/** True in the logger thread, which writes synchronously. */
+static __thread bool say_is_logger_thread;
+
+static const char *say_overflow_strs[] = {
+	[SAY_OVERFLOW_BLOCK] = "block",
+	[SAY_OVERFLOW_DROP] = "drop",
+	[say_overflow_MAX] = "unknown"
+};
+
+enum say_overflow
+say_overflow_by_name(const char *name)
+{
+	return STR2ENUM(say_overflow, name);
+}
+
+void
+say_set_log_overflow(enum say_overflow overflow)
+{
+	assert(overflow < say_overflow_MAX);
+	pm_atomic_store(&say_async.overflow, overflow);
+}
+
+static void
+log_write(struct log *log, int level, int total);
+
+/** Compute an absolute deadline @a ms milliseconds from now. */
+static void
+say_async_deadline(struct timespec *ts, long ms)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_sec += ms / 1000;
+	ts->tv_nsec += (ms % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+static void
+say_ring_write(struct say_ring *ring, uint64_t pos, const void *src,
+	       size_t size)
+{
+	size_t offset = pos % SAY_RING_SIZE;
+	size_t n = MIN(size, SAY_RING_SIZE - offset);
+	memcpy(ring->data + offset, src, n);
+	memcpy(ring->data, (const char *)src + n, size - n);
+}
+
+static void
+say_ring_read(struct say_ring *ring, uint64_t pos, void *dst, size_t size)
+{
+	size_t offset = pos % SAY_RING_SIZE;
+	size_t n = MIN(size, SAY_RING_SIZE - offset);
+	memcpy(dst, ring->data + offset, n);
+	memcpy((char *)dst + n, ring->data, size - n);
+}
+
+static bool
+say_ring_is_empty(struct say_ring *ring)
+{
+	return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) ==
+	       __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+}
+
+/** Thread exit destructor of say_async.ring_key. */
+static void
+say_ring_orphan(void *arg)
+{
+	struct say_ring *ring = (struct say_ring *)arg;
+	__atomic_store_n(&ring->is_orphan, true, __ATOMIC_RELEASE);
+}
+
+/** Return the ring of the current thread, creating it if needed. */
+static struct say_ring *
+say_ring_get(void)
+{
+	if (say_ring != NULL)
+		return say_ring;
+	struct say_ring *ring = (struct say_ring *)calloc(1, sizeof(*ring));
+	if (ring == NULL)
+		return NULL;
+	tt_pthread_setspecific(say_async.ring_key, ring);
+	tt_pthread_mutex_lock(&say_async.mutex);
+	ring->next = say_async.rings;
+	say_async.rings = ring;
+	tt_pthread_mutex_unlock(&say_async.mutex);
+	say_ring = ring;
+	return ring;
+}
+
+/**
+ * Wait for the logger thread to complete a drain pass, or for
+ * a short timeout to re-check the condition the caller is
+ * waiting for.
+ */
+static void
+say_async_wait(void)
+{
+	struct timespec deadline;
+	say_async_deadline(&deadline, SAY_ASYNC_WAIT_MS);
+	tt_pthread_mutex_lock(&say_async.mutex);
+	say_async.waiters++;
+	tt_pthread_cond_signal(&say_async.wakeup_cond);
+	tt_pthread_cond_timedwait(&say_async.drain_cond, &say_async.mutex,
+				  &deadline);
+	say_async.waiters--;
+	tt_pthread_mutex_unlock(&say_async.mutex);
+}
+
+/**
+ * Queue a formatted message for the logger thread.
+ *
+ * @retval true the message is queued or dropped
+ * @retval false the caller must write the message itself
+ */
+static bool
+say_async_push(struct log *log, int level, const char *text, int len)
+{
+	struct say_ring *ring = say_ring_get();
+	if (ring == NULL)
+		return false;
+	struct say_record record = { log, level, len };
+	size_t size = sizeof(record) + len;
+	uint64_t head = ring->head;
+	while (head + size - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >
+	       SAY_RING_SIZE) {
+		if (pm_atomic_load(&say_async.overflow) == SAY_OVERFLOW_DROP) {
+			__atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return true;
+		}
+		if (!__atomic_load_n(&say_async.is_running, __ATOMIC_ACQUIRE))
+			return false;
+		say_async_wait();
+	}
+	say_ring_write(ring, head, &record, sizeof(record));
+	say_ring_write(ring, head + sizeof(record), text, len);
+	__atomic_store_n(&ring->head, head + size, __ATOMIC_SEQ_CST);
+	/*
+	 * Pairs with the store of is_sleeping in the logger
+	 * thread: either it sees the new head on re-check or
+	 * we see it is going to sleep and wake it up.
+	 */
+	if (__atomic_load_n(&say_async.is_sleeping, __ATOMIC_SEQ_CST)) {
+		tt_pthread_mutex_lock(&say_async.mutex);
+		tt_pthread_cond_signal(&say_async.wakeup_cond);
+		tt_pthread_mutex_unlock(&say_async.mutex);
+	}
+	return true;
+}
+
+/**
+ * Write out all messages queued in a ring so far.
+ * @retval true if there was something to write
+ */
+static bool
+say_ring_drain(struct say_ring *ring)
+{
+	uint64_t tail = ring->tail;
+	uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint64_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	if (tail == head && dropped == ring->dropped_reported)
+		return false;
+	while (tail != head) {
+		struct say_record record;
+		say_ring_read(ring, tail, &record, sizeof(record));
+		say_ring_read(ring, tail + sizeof(record), buf, record.len);
+		tail += sizeof(record) + record.len;
+		log_write(record.log, record.level, record.len);
+		/* Release the space as soon as possible. */
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+	}
+	if (dropped != ring->dropped_reported) {
+		log_say(log_default, S_WARN, __FILE__, __LINE__, NULL,
+			"%llu log messages dropped: logger is overloaded",
+			(unsigned long long)(dropped - ring->dropped_reported));
+		ring->dropped_reported = dropped;
+	}
+	return true;
+}
+
+/**
+ * Free drained rings of exited threads.
+ * Must be called with say_async.mutex locked.
+ */
+static void
+say_async_collect_orphans(void)
+{
+	struct say_ring **prev = &say_async.rings;
+	while (*prev != NULL) {
+		struct say_ring *ring = *prev;
+		if (__atomic_load_n(&ring->is_orphan, __ATOMIC_ACQUIRE) &&
+		    say_ring_is_empty(ring) &&
+		    ring->dropped == ring->dropped_reported) {
+			say_async.dropped += ring->dropped;
+			*prev = ring->next;
+			free(ring);
+		} else {
+			prev = &ring->next;
+		}
+	}
+}
+
+/**
+ * Check if any ring has something to write.
+ * Must be called with say_async.mutex locked.
+ */
+static bool
+say_async_has_pending(void)
+{
+	for (struct say_ring *ring = say_async.rings; ring != NULL;
+	     ring = ring->next) {
+		if (!say_ring_is_empty(ring) ||
+		    __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED) !=
+		    ring->dropped_reported)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Pause the logger thread for ERRINJ_LOG_ASYNC_DELAY seconds
+ * before a drain pass. The pause ends early if the injection is
+ * reset, so a test can stall the logger and release it.
+ */
+static void
+say_async_inject_delay(void)
+{
+	struct errinj *inj = errinj(ERRINJ_LOG_ASYNC_DELAY, ERRINJ_DOUBLE);
+	if (inj == NULL)
+		return;
+	for (double slept = 0; slept < inj->dparam; slept += 0.001)
+		usleep(1000);
+}
+
+static void *
+say_async_f(void *arg)
+{
+	(void)arg;
+	say_is_logger_thread = true;
+	tt_pthread_mutex_lock(&say_async.mutex);
+	while (true) {
+		/*
+		 * New rings are only prepended, and only this
+		 * thread unlinks them, so the list can be walked
+		 * without the mutex, which is not held during
+		 * the writes.
+		 */
+		struct say_ring *first = say_async.rings;
+		tt_pthread_mutex_unlock(&say_async.mutex);
+		say_async_inject_delay();
+		bool progress = false;
+		for (struct say_ring *ring = first; ring != NULL;
+		     ring = ring->next) {
+			if (say_ring_drain(ring))
+				progress = true;
+		}
+		tt_pthread_mutex_lock(&say_async.mutex);
+		say_async_collect_orphans();
+		if (say_async.waiters > 0)
+			tt_pthread_cond_broadcast(&say_async.drain_cond);
+		if (progress)
+			continue;
+		if (say_async.is_stopping)
+			break;
+		__atomic_store_n(&say_async.is_sleeping, true,
+				 __ATOMIC_SEQ_CST);
+		if (!say_async_has_pending()) {
+			struct timespec deadline;
+			say_async_deadline(&deadline, SAY_ASYNC_IDLE_MS);
+			tt_pthread_cond_timedwait(&say_async.wakeup_cond,
+						  &say_async.mutex, &deadline);
+		}
+		__atomic_store_n(&say_async.is_sleeping, false,
+				 __ATOMIC_SEQ_CST);
+	}
+	tt_pthread_mutex_unlock(&say_async.mutex);
+	return NULL;
+}
+
+static bool
+say_async_is_enabled(struct log *log)
+{
+	return __atomic_load_n(&say_async.is_running, __ATOMIC_ACQUIRE) &&
+	       !say_is_logger_thread && log->type != SAY_LOGGER_BOOT;
+}
+
+void
+say_logger_async_flush(void)
+{
+	if (!__atomic_load_n(&say_async.is_running, __ATOMIC_ACQUIRE) ||
+	    say_is_logger_thread)
+		return;
+	tt_pthread_mutex_lock(&say_async.mutex);
+	bool pending = say_async_has_pending();
+	tt_pthread_mutex_unlock(&say_async.mutex);
+	while (pending) {
+		say_async_wait();
+		tt_pthread_mutex_lock(&say_async.mutex);
+		pending = say_async_has_pending();
+		tt_pthread_mutex_unlock(&say_async.mutex);
+	}
+}
+
+/** Drain the rings and stop the logger thread. */
+static void
+say_logger_async_stop(void)
+{
+	if (!__atomic_load_n(&say_async.is_running, __ATOMIC_ACQUIRE))
+		return;
+	tt_pthread_mutex_lock(&say_async.mutex);
+	say_async.is_stopping = true;
+	tt_pthread_cond_signal(&say_async.wakeup_cond);
+	tt_pthread_mutex_unlock(&say_async.mutex);
+	tt_pthread_join(say_async.thread, NULL);
+	/*
+	 * The rings are not freed: a thread may still be
+	 * looking at its ring. Messages logged from now on are
+	 * written synchronously.
+	 */
+	__atomic_store_n(&say_async.is_running, false, __ATOMIC_RELEASE);
+}
+
+int
+say_logger_async_start(void)
+{
+	if (say_async.is_running || say_async.is_stopping)
+		return 0;
+	tt_pthread_key_create(&say_async.ring_key, say_ring_orphan);
+	/* Signals are handled in the main thread. */
+	sigset_t set, oldset;
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &oldset);
+	int rc = pthread_create(&say_async.thread, NULL, say_async_f, NULL);
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	if (rc != 0) {
+		errno = rc;
+		diag_set(SystemError, "failed to start the logger thread");
+		return -1;
+	}
+	__atomic_store_n(&say_async.is_running, true, __ATOMIC_RELEASE);
+	/* Don't lose the queued messages on exit(). */
+	atexit(say_logger_async_flush);
+	return 0;
+}
+
+uint64_t
+say_logger_dropped(void)
+{
+	tt_pthread_mutex_lock(&say_async.mutex);
+	uint64_t dropped = say_async.dropped;
+	for (struct say_ring *ring = say_async.rings; ring != NULL;
+	     ring = ring->next)
+		dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	tt_pthread_mutex_unlock(&say_async.mutex);
+	return dropped;
+}
+
+/** Asynchronous logger }}} */
+
 /** Loggers }}} */
 
 /*
@@ -1217,6 +1664,8 @@ void
 log_destroy(struct log *log)
 {
 	assert(log != NULL);
+	/* The logger thread must not write to the log anymore. */
+	say_logger_async_flush();
 	while(log->rotating_threads > 0)
 		fiber_cond_wait(&log->rotate_cond);
 	pm_atomic_store(&log->type, SAY_LOGGER_BOOT);
@@ -1240,6 +1689,29 @@ log_vsay(struct log *log, int level, const char *filename, int line,
 	}
 	int total = log->format_func(log, buf, sizeof(buf), level,
 				     filename, line, error, format, ap);
+	if (say_async_is_enabled(log)) {
+		if (level != S_FATAL &&
+		    say_async_push(log, level, buf,
+				   MIN(total, SAY_BUF_LEN_MAX - 1))) {
+			errno = errsv; /* Preserve the errno. */
+			return total;
+		}
+		/*
+		 * A fatal message is likely the last one, write it
+		 * out right away, but after everything queued
+		 * before it.
+		 */
+		say_logger_async_flush();
+	}
+	log_write(log, level, total);
+	errno = errsv; /* Preserve the errno. */
+	return total;
+}
+
+/** Write a message formatted in buf to the log destination. */
+static void
+log_write(struct log *log, int level, int total)
+{
 	switch (log->type) {
 	case SAY_LOGGER_FILE:
 	case SAY_LOGGER_PIPE:
@@ -1260,8 +1732,6 @@ log_vsay(struct log *log, int level, const char *filename, int line,
 	default:
 		unreachable();
 	}
-	errno = errsv; /* Preserve the errno. */
-	return total;
 }
 
 int
@@ -34,6 +34,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <errno.h>
 #include <sys/types.h> /* pid_t */
 #include <tarantool_ev.h>
@@ -68,6 +69,18 @@ enum say_format {
 	say_format_MAX
 };
 
+/**
+ * What to do when a thread logs faster than the asynchronous
+ * logger thread manages to write the messages out.
+ */
+enum say_overflow {
+	/** Wait until the logger thread frees some space. */
+	SAY_OVERFLOW_BLOCK,
+	/** Discard the message and bump the dropped counter. */
+	SAY_OVERFLOW_DROP,
+	say_overflow_MAX
+};
+
 extern int log_level;
 
 static inline bool
@@ -282,6 +295,48 @@ say_logger_initialized(void);
 void
 say_logger_free(void);
 
+/**
+ * Return overflow policy by name.
+ *
+ * @retval say_overflow_MAX on error
+ * @retval say_overflow otherwise
+ */
+enum say_overflow
+say_overflow_by_name(const char *name);
+
+/**
+ * Set the policy applied when a thread's log ring is full.
+ * Can be used dynamically.
+ */
+void
+say_set_log_overflow(enum say_overflow overflow);
+
+/**
+ * Start the logger thread. Since then every thread formats
+ * its messages into a private ring buffer, which the logger
+ * thread drains to the default logger's destination. Must be
+ * called after the process has daemonized, if it has to.
+ *
+ * @retval 0 on success
+ * @retval -1 on error, the diagnostics area is set
+ */
+int
+say_logger_async_start(void);
+
+/**
+ * Block until all messages queued so far in all the threads'
+ * rings are written out. No-op if the logger is synchronous.
+ */
+void
+say_logger_async_flush(void);
+
+/**
+ * Number of messages discarded because of a full ring with
+ * the SAY_OVERFLOW_DROP policy.
+ */
+uint64_t
+say_logger_dropped(void);
+
 /** \cond public */
 typedef void (*sayfunc_t)(int, const char *, int, const char *,
 		    const char *, ...);
@@ -0,0 +1,558 @@
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "shm_chan.h"
+
+#include <trivia/config.h>
+#include <trivia/util.h>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(HAVE_SHM_CHAN)
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+enum {
+	SHM_CHAN_CACHELINE = 64,
+	/** Minimal size of a ring. */
+	SHM_CHAN_RING_SIZE_MIN = 4096,
+	/** Descriptors passed to the client, see shm_chan_accept(). */
+	SHM_CHAN_FD_COUNT = 4,
+};
+
+/**
+ * Ring header in shared memory, followed by the data area. The
+ * fields of the producer and of the consumer are on different
+ * cache lines.
+ */
+struct shm_ring {
+	/** Number of bytes ever written, advanced by the producer. */
+	uint64_t head;
+	/** Set by the producer when it closes the channel. */
+	uint32_t is_writer_closed;
+	/** Set by the consumer before it sleeps on an empty ring. */
+	uint32_t reader_wait;
+	char pad1[SHM_CHAN_CACHELINE - 16];
+	/** Number of bytes ever read, advanced by the consumer. */
+	uint64_t tail;
+	/** Set by the consumer when it closes the channel. */
+	uint32_t is_reader_closed;
+	/** Set by the producer before it sleeps on a full ring. */
+	uint32_t writer_wait;
+	char pad2[SHM_CHAN_CACHELINE - 16];
+	char data[];
+};
+
+/** The message passing a channel to the client. */
+struct shm_chan_hello {
+	char magic[8];
+	uint64_t ring_size;
+};
+
+static const char shm_chan_magic[8] = "tntshm1";
+
+static inline size_t
+shm_chan_map_size(size_t ring_size)
+{
+	return 2 * (sizeof(struct shm_ring) + ring_size);
+}
+
+/**
+ * Point the rings of the channel to the mapping. The first ring
+ * carries data from the client to the server, the second one
+ * from the server to the client.
+ */
+static void
+shm_chan_map_rings(struct shm_chan *ch)
+{
+	struct shm_ring *up = (struct shm_ring *)ch->map;
+	struct shm_ring *down = (struct shm_ring *)
+		((char *)ch->map + sizeof(struct shm_ring) + ch->ring_size);
+	ch->rx = ch->is_server ? up : down;
+	ch->tx = ch->is_server ? down : up;
+}
+
+static void
+shm_chan_create(struct shm_chan *ch)
+{
+	memset(ch, 0, sizeof(*ch));
+	ch->map = MAP_FAILED;
+	ch->rx_bell = ch->tx_bell = -1;
+	ch->peer_rx_bell = ch->peer_tx_bell = -1;
+}
+
+/** Close the descriptors of the channel, preserving errno. */
+static void
+shm_chan_destroy(struct shm_chan *ch)
+{
+	int save_errno = errno;
+	if (ch->map != MAP_FAILED)
+		munmap(ch->map, ch->map_size);
+	if (ch->rx_bell >= 0)
+		close(ch->rx_bell);
+	if (ch->tx_bell >= 0 && ch->tx_bell != ch->rx_bell)
+		close(ch->tx_bell);
+	if (ch->peer_rx_bell >= 0)
+		close(ch->peer_rx_bell);
+	if (ch->peer_tx_bell >= 0 && ch->peer_tx_bell != ch->peer_rx_bell)
+		close(ch->peer_tx_bell);
+	shm_chan_create(ch);
+	errno = save_errno;
+}
+
+/** Reset a doorbell, so that it can be waited on again. */
+static inline void
+shm_chan_drain(int bell)
+{
+	uint64_t value;
+	while (read(bell, &value, sizeof(value)) < 0 && errno == EINTR)
+		;
+}
+
+/**
+ * Ring the doorbell of the peer if it waits on @a wait. The
+ * fence orders the preceding update of the ring with the check,
+ * the peer does the same in shm_chan_prepare_wait(), so either
+ * we see the flag, or the peer sees the update.
+ */
+static inline void
+shm_chan_ring(uint32_t *wait, int bell)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(wait, __ATOMIC_RELAXED) == 0)
+		return;
+	if (__atomic_exchange_n(wait, 0, __ATOMIC_SEQ_CST) == 0)
+		return;
+	uint64_t one = 1;
+	while (write(bell, &one, sizeof(one)) < 0 && errno == EINTR)
+		;
+}
+
+/**
+ * Load a counter advanced by the peer. A valid value is not
+ * behind the one seen last time and at most @a max bytes ahead
+ * of it, otherwise the peer has corrupted the ring.
+ * @retval  0 Success, @a value is set.
+ * @retval -1 errno is EPROTO.
+ */
+static inline int
+shm_chan_load_counter(const uint64_t *counter, uint64_t last, uint64_t max,
+		      uint64_t *value)
+{
+	uint64_t v = __atomic_load_n(counter, __ATOMIC_ACQUIRE);
+	if (v - last > max) {
+		errno = EPROTO;
+		return -1;
+	}
+	*value = v;
+	return 0;
+}
+
+/**
+ * Load the head of the ring the peer writes to. It may be up to
+ * the ring size ahead of the tail.
+ */
+static inline int
+shm_chan_load_rx_head(struct shm_chan *ch)
+{
+	uint64_t max = ch->ring_size - (ch->rx_head - ch->rx_tail);
+	return shm_chan_load_counter(&ch->rx->head, ch->rx_head, max,
+				     &ch->rx_head);
+}
+
+/**
+ * Load the tail of the ring the peer reads from. It may not be
+ * ahead of the head.
+ */
+static inline int
+shm_chan_load_tx_tail(struct shm_chan *ch)
+{
+	return shm_chan_load_counter(&ch->tx->tail, ch->tx_tail,
+				     ch->tx_head - ch->tx_tail, &ch->tx_tail);
+}
+
+/**
+ * Load a closed flag set by the peer.
+ * @retval  0 Not closed.
+ * @retval  1 Closed.
+ * @retval -1 errno is EPROTO.
+ */
+static inline int
+shm_chan_load_flag(const uint32_t *flag)
+{
+	uint32_t v = __atomic_load_n(flag, __ATOMIC_ACQUIRE);
+	if (v > 1) {
+		errno = EPROTO;
+		return -1;
+	}
+	return v;
+}
+
+int
+shm_chan_accept(struct shm_chan *ch, int sock, size_t ring_size)
+{
+	shm_chan_create(ch);
+	ch->is_server = true;
+	ch->ring_size = SHM_CHAN_RING_SIZE_MIN;
+	while (ch->ring_size < ring_size)
+		ch->ring_size *= 2;
+	ch->map_size = shm_chan_map_size(ch->ring_size);
+
+	int memfd = memfd_create("shm_chan", MFD_CLOEXEC);
+	if (memfd < 0)
+		return -1;
+	/* The file is zero-filled, so are the ring headers. */
+	if (ftruncate(memfd, ch->map_size) != 0)
+		goto fail;
+	ch->map = mmap(NULL, ch->map_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED, memfd, 0);
+	if (ch->map == MAP_FAILED)
+		goto fail;
+	shm_chan_map_rings(ch);
+	ch->rx_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	ch->tx_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	ch->peer_rx_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	ch->peer_tx_bell = ch->peer_rx_bell;
+	if (ch->rx_bell < 0 || ch->tx_bell < 0 || ch->peer_rx_bell < 0)
+		goto fail;
+
+	struct shm_chan_hello hello;
+	memcpy(hello.magic, shm_chan_magic, sizeof(hello.magic));
+	hello.ring_size = ch->ring_size;
+	struct iovec iov = { &hello, sizeof(hello) };
+	int fds[SHM_CHAN_FD_COUNT] = {
+		memfd, ch->rx_bell, ch->tx_bell, ch->peer_rx_bell,
+	};
+	char control[CMSG_SPACE(sizeof(fds))];
+	memset(control, 0, sizeof(control));
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	ssize_t rc;
+	while ((rc = sendmsg(sock, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+		;
+	if (rc != (ssize_t)sizeof(hello)) {
+		/* The socket buffer of a new socket can't be full. */
+		if (rc >= 0)
+			errno = EPIPE;
+		goto fail;
+	}
+	/* The mapping keeps the memory. */
+	close(memfd);
+	return 0;
+fail:
+	shm_chan_destroy(ch);
+	int save_errno = errno;
+	close(memfd);
+	errno = save_errno;
+	return -1;
+}
+
+int
+shm_chan_connect(struct shm_chan *ch, int sock)
+{
+	shm_chan_create(ch);
+	struct shm_chan_hello hello;
+	struct iovec iov = { &hello, sizeof(hello) };
+	int fds[SHM_CHAN_FD_COUNT];
+	char control[CMSG_SPACE(sizeof(fds))];
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	ssize_t rc;
+	while ((rc = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0 &&
+	       errno == EINTR)
+		;
+	if (rc < 0)
+		return -1;
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET ||
+	    cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+		/* Not a shared memory server or the peer is gone. */
+		errno = rc == 0 ? ECONNRESET : EPROTO;
+		return -1;
+	}
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	int memfd = fds[0];
+	ch->peer_rx_bell = fds[1];
+	ch->peer_tx_bell = fds[2];
+	ch->rx_bell = ch->tx_bell = fds[3];
+	if (rc != (ssize_t)sizeof(hello) ||
+	    memcmp(hello.magic, shm_chan_magic, sizeof(hello.magic)) != 0 ||
+	    hello.ring_size < SHM_CHAN_RING_SIZE_MIN ||
+	    (hello.ring_size & (hello.ring_size - 1)) != 0) {
+		errno = EPROTO;
+		goto fail;
+	}
+	ch->ring_size = hello.ring_size;
+	ch->map_size = shm_chan_map_size(ch->ring_size);
+	ch->map = mmap(NULL, ch->map_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED, memfd, 0);
+	if (ch->map == MAP_FAILED)
+		goto fail;
+	shm_chan_map_rings(ch);
+	close(memfd);
+	return 0;
+fail:
+	shm_chan_destroy(ch);
+	int save_errno = errno;
+	close(memfd);
+	errno = save_errno;
+	return -1;
+}
+
+void
+shm_chan_close(struct shm_chan *ch)
+{
+	if (ch->map != MAP_FAILED) {
+		__atomic_store_n(&ch->tx->is_writer_closed, 1,
+				 __ATOMIC_RELEASE);
+		__atomic_store_n(&ch->rx->is_reader_closed, 1,
+				 __ATOMIC_RELEASE);
+		/* Wake the peer up whatever it waits for. */
+		__atomic_store_n(&ch->tx->reader_wait, 1, __ATOMIC_RELAXED);
+		shm_chan_ring(&ch->tx->reader_wait, ch->peer_rx_bell);
+		__atomic_store_n(&ch->rx->writer_wait, 1, __ATOMIC_RELAXED);
+		shm_chan_ring(&ch->rx->writer_wait, ch->peer_tx_bell);
+	}
+	shm_chan_destroy(ch);
+}
+
+ssize_t
+shm_chan_read(struct shm_chan *ch, void *buf, size_t size)
+{
+	struct shm_ring *ring = ch->rx;
+	uint64_t tail = ch->rx_tail;
+	if (shm_chan_load_rx_head(ch) != 0)
+		return -1;
+	if (ch->rx_head == tail) {
+		int is_closed = shm_chan_load_flag(&ring->is_writer_closed);
+		if (is_closed < 0)
+			return -1;
+		if (is_closed == 0) {
+			errno = EAGAIN;
+			return -1;
+		}
+		/* The last data is written before the flag is set. */
+		if (shm_chan_load_rx_head(ch) != 0)
+			return -1;
+		if (ch->rx_head == tail)
+			return 0;
+	}
+	uint64_t head = ch->rx_head;
+	assert(head - tail <= ch->ring_size);
+	size_t n = MIN(head - tail, size);
+	size_t pos = tail & (ch->ring_size - 1);
+	size_t part = MIN(n, ch->ring_size - pos);
+	memcpy(buf, ring->data + pos, part);
+	memcpy((char *)buf + part, ring->data, n - part);
+	ch->rx_tail = tail + n;
+	__atomic_store_n(&ring->tail, ch->rx_tail, __ATOMIC_RELEASE);
+	shm_chan_ring(&ring->writer_wait, ch->peer_tx_bell);
+	return n;
+}
+
+ssize_t
+shm_chan_writev(struct shm_chan *ch, const struct iovec *iov, int iovcnt)
+{
+	struct shm_ring *ring = ch->tx;
+	int is_closed = shm_chan_load_flag(&ring->is_reader_closed);
+	if (is_closed != 0) {
+		if (is_closed > 0)
+			errno = EPIPE;
+		return -1;
+	}
+	if (shm_chan_load_tx_tail(ch) != 0)
+		return -1;
+	uint64_t head = ch->tx_head;
+	uint64_t tail = ch->tx_tail;
+	assert(head - tail <= ch->ring_size);
+	size_t space = ch->ring_size - (head - tail);
+	if (space == 0) {
+		errno = EAGAIN;
+		return -1;
+	}
+	size_t total = 0;
+	for (int i = 0; i < iovcnt && space > 0; i++) {
+		const char *src = (const char *)iov[i].iov_base;
+		size_t n = MIN(iov[i].iov_len, space);
+		size_t pos = (head + total) & (ch->ring_size - 1);
+		size_t part = MIN(n, ch->ring_size - pos);
+		memcpy(ring->data + pos, src, part);
+		memcpy(ring->data, src + part, n - part);
+		total += n;
+		space -= n;
+	}
+	if (total == 0) {
+		/* Nothing to write. */
+		return 0;
+	}
+	ch->tx_head = head + total;
+	__atomic_store_n(&ring->head, ch->tx_head, __ATOMIC_RELEASE);
+	shm_chan_ring(&ring->reader_wait, ch->peer_rx_bell);
+	return total;
+}
+
+int
+shm_chan_prepare_wait(struct shm_chan *ch, int events)
+{
+	if ((events & SHM_CHAN_READ) != 0) {
+		shm_chan_drain(ch->rx_bell);
+		__atomic_store_n(&ch->rx->reader_wait, 1, __ATOMIC_RELAXED);
+	}
+	if ((events & SHM_CHAN_WRITE) != 0) {
+		if ((events & SHM_CHAN_READ) == 0 || ch->tx_bell != ch->rx_bell)
+			shm_chan_drain(ch->tx_bell);
+		__atomic_store_n(&ch->tx->writer_wait, 1, __ATOMIC_RELAXED);
+	}
+	/* See shm_chan_ring(). */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	/*
+	 * A corrupted ring is reported as ready, so that the
+	 * caller gets EPROTO from read or write.
+	 */
+	int ready = 0;
+	if ((events & SHM_CHAN_READ) != 0 &&
+	    (shm_chan_load_rx_head(ch) != 0 || ch->rx_head != ch->rx_tail ||
+	     shm_chan_load_flag(&ch->rx->is_writer_closed) != 0))
+		ready |= SHM_CHAN_READ;
+	if ((events & SHM_CHAN_WRITE) != 0 &&
+	    (shm_chan_load_tx_tail(ch) != 0 ||
+	     ch->tx_head - ch->tx_tail < ch->ring_size ||
+	     shm_chan_load_flag(&ch->tx->is_reader_closed) != 0))
+		ready |= SHM_CHAN_WRITE;
+	return ready;
+}
+
+int
+shm_chan_wait(struct shm_chan *ch, int events, int timeout)
+{
+	struct pollfd pfd[2];
+	int count = 0;
+	if ((events & SHM_CHAN_READ) != 0) {
+		pfd[count].fd = ch->rx_bell;
+		pfd[count].events = POLLIN;
+		count++;
+	}
+	if ((events & SHM_CHAN_WRITE) != 0 &&
+	    (count == 0 || ch->tx_bell != ch->rx_bell)) {
+		pfd[count].fd = ch->tx_bell;
+		pfd[count].events = POLLIN;
+		count++;
+	}
+	int rc = poll(pfd, count, timeout);
+	if (rc <= 0)
+		return rc;
+	/* A doorbell doesn't tell which event has happened. */
+	return events;
+}
+
+#else /* !defined(HAVE_SHM_CHAN) */
+
+int
+shm_chan_accept(struct shm_chan *ch, int sock, size_t ring_size)
+{
+	(void)ch;
+	(void)sock;
+	(void)ring_size;
+	errno = ENOTSUP;
+	return -1;
+}
+
+int
+shm_chan_connect(struct shm_chan *ch, int sock)
+{
+	(void)ch;
+	(void)sock;
+	errno = ENOTSUP;
+	return -1;
+}
+
+void
+shm_chan_close(struct shm_chan *ch)
+{
+	(void)ch;
+}
+
+ssize_t
+shm_chan_read(struct shm_chan *ch, void *buf, size_t size)
+{
+	(void)ch;
+	(void)buf;
+	(void)size;
+	errno = ENOTSUP;
+	return -1;
+}
+
+ssize_t
+shm_chan_writev(struct shm_chan *ch, const struct iovec *iov, int iovcnt)
+{
+	(void)ch;
+	(void)iov;
+	(void)iovcnt;
+	errno = ENOTSUP;
+	return -1;
+}
+
+int
+shm_chan_prepare_wait(struct shm_chan *ch, int events)
+{
+	(void)ch;
+	return events;
+}
+
+int
+shm_chan_wait(struct shm_chan *ch, int events, int timeout)
+{
+	(void)ch;
+	(void)events;
+	(void)timeout;
+	errno = ENOTSUP;
+	return -1;
+}
+
+#endif /* defined(HAVE_SHM_CHAN) */
@@ -0,0 +1,208 @@
+#ifndef TARANTOOL_LIB_CORE_SHM_CHAN_H_INCLUDED
+#define TARANTOOL_LIB_CORE_SHM_CHAN_H_INCLUDED 1
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * A bidirectional byte stream between two processes of the same
+ * host over shared memory. It is a replacement of a socket for
+ * co-located clients: in a busy pipeline data is passed without
+ * any system calls.
+ *
+ * The channel is a memfd mapping with two single-producer,
+ * single-consumer rings, one per direction. A side sleeping on
+ * an empty or full ring is woken up with an eventfd "doorbell",
+ * which the peer rings only if the side announced that it
+ * waits. The server has two doorbells, for new data and for
+ * free space, so that they can be watched by separate event
+ * loop watchers. The client has one for both.
+ *
+ * A channel is set up over a connected unix socket: the server
+ * creates it and passes the file descriptors to the client with
+ * SCM_RIGHTS. The socket is kept open to detect the death of
+ * the peer.
+ *
+ * The module depends only on libc and reports errors in errno,
+ * so a client application may build it in as is.
+ *
+ * Usage:
+ * server: shm_chan_accept(&ch, sock, size);
+ * client: shm_chan_connect(&ch, sock);
+ * while ((n = shm_chan_read(&ch, buf, size)) < 0 && errno == EAGAIN) {
+ *         if (shm_chan_prepare_wait(&ch, SHM_CHAN_READ) == 0)
+ *                 wait until shm_chan_fd(&ch, SHM_CHAN_READ)
+ *                 is readable;
+ * }
+ */
+
+/** Events of shm_chan_prepare_wait(). */
+enum {
+	/** The channel has data to read or the peer is closed. */
+	SHM_CHAN_READ = 1,
+	/** The channel has space to write or the peer is closed. */
+	SHM_CHAN_WRITE = 2,
+};
+
+/** Default size of a ring, for each direction. */
+enum { SHM_CHAN_RING_SIZE_DEFAULT = 1024 * 1024 };
+
+struct shm_ring;
+
+struct shm_chan {
+	/** Ring the peer writes to. */
+	struct shm_ring *rx;
+	/** Ring the peer reads from. */
+	struct shm_ring *tx;
+	/** Size of the data area of each ring, a power of 2. */
+	size_t ring_size;
+	/**
+	 * Ring counters as known to this side. The peer can
+	 * write anything to the shared memory, so the counters
+	 * we advance are never read back from it, and the ones
+	 * the peer advances are validated against these.
+	 */
+	uint64_t rx_head;
+	uint64_t rx_tail;
+	uint64_t tx_head;
+	uint64_t tx_tail;
+	/** Shared memory mapping of both rings. */
+	void *map;
+	size_t map_size;
+	/**
+	 * Our doorbells, rung by the peer when it has written
+	 * to rx and when it has freed space in tx. The same
+	 * eventfd on the client side.
+	 */
+	int rx_bell;
+	int tx_bell;
+	/**
+	 * Doorbells of the peer, rung when we have written to tx
+	 * and when we have freed space in rx.
+	 */
+	int peer_rx_bell;
+	int peer_tx_bell;
+	/** True for the side which accepted the channel. */
+	bool is_server;
+};
+
+/**
+ * Create a channel on the server side and pass it to the client
+ * connected to unix socket @a sock.
+ * @param ring_size Size of each ring, rounded up to a power of 2.
+ * @retval  0 Success.
+ * @retval -1 System error, errno is set.
+ */
+int
+shm_chan_accept(struct shm_chan *ch, int sock, size_t ring_size);
+
+/**
+ * Receive a channel from the server over unix socket @a sock.
+ * The server sends it right after accepting the socket.
+ * @retval  0 Success.
+ * @retval -1 System error, errno is set. EAGAIN means that the
+ *            channel has not arrived yet and @a sock is
+ *            non-blocking.
+ */
+int
+shm_chan_connect(struct shm_chan *ch, int sock);
+
+/**
+ * Close the channel. The peer reads the data which is already
+ * in the ring and then gets EOF.
+ */
+void
+shm_chan_close(struct shm_chan *ch);
+
+/**
+ * Read up to @a size bytes.
+ * @retval >0 Number of bytes read.
+ * @retval  0 EOF: the peer is closed and all data is read.
+ * @retval -1 errno is EAGAIN if there is no data or EPROTO if
+ *            the peer has corrupted the ring.
+ */
+ssize_t
+shm_chan_read(struct shm_chan *ch, void *buf, size_t size);
+
+/**
+ * Write as much of @a iov as fits into the ring.
+ * @retval >0 Number of bytes written.
+ * @retval -1 errno is EAGAIN if the ring is full, EPIPE if
+ *            the peer is closed or EPROTO if the peer has
+ *            corrupted the ring.
+ */
+ssize_t
+shm_chan_writev(struct shm_chan *ch, const struct iovec *iov, int iovcnt);
+
+/**
+ * Announce that the caller is going to wait for @a events and
+ * reset the doorbells. After that the peer rings the doorbell
+ * as soon as the events happen, so it is safe to sleep on
+ * shm_chan_fd() if the function returns 0.
+ * @return Events which have already happened.
+ */
+int
+shm_chan_prepare_wait(struct shm_chan *ch, int events);
+
+/**
+ * Return the doorbell to wait on for @a events. It becomes
+ * readable when the events may have happened.
+ */
+static inline int
+shm_chan_fd(const struct shm_chan *ch, int events)
+{
+	return (events & SHM_CHAN_READ) != 0 ? ch->rx_bell : ch->tx_bell;
+}
+
+/**
+ * Wait for @a events for up to @a timeout milliseconds, -1 for
+ * infinity. A helper for blocking clients.
+ * @retval >0 Events which may have happened.
+ * @retval  0 Timeout.
+ * @retval -1 System error, errno is set.
+ */
+int
+shm_chan_wait(struct shm_chan *ch, int events, int timeout);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_SHM_CHAN_H_INCLUDED */
@@ -0,0 +1,339 @@
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "stall.h"
+
+#include <trivia/config.h>
+#include <trivia/util.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "backtrace.h"
+#include "clock.h"
+#include "diag.h"
+#include "fiber.h"
+#include "say.h"
+#include "tt_pthread.h"
+
+/**
+ * The signal used to interrupt the tx thread. Its default
+ * action is to ignore it, so a stray one is harmless.
+ */
+enum { STALL_SIGNAL = SIGURG };
+
+/** Max number of frames in a sampled backtrace. */
+enum { STALL_FRAME_MAX = 64 };
+
+static struct {
+	/** True while the watchdog thread is running. */
+	bool is_enabled;
+	/** Threshold, in nanoseconds. */
+	uint64_t threshold;
+	/**
+	 * Monotonic time the current loop iteration started at,
+	 * 0 while the loop is waiting for events. Written by the
+	 * tx thread, read by the watchdog.
+	 */
+	uint64_t iteration_start;
+	/**
+	 * Set while the tx thread is inside a loop iteration and
+	 * a sample can be taken.
+	 */
+	volatile sig_atomic_t in_iteration;
+	/** Set by the signal handler once a sample is taken. */
+	volatile sig_atomic_t has_sample;
+	/** The sample of the current iteration. */
+	struct stall_report sample;
+	/**
+	 * Return addresses of the sampled stack. They are
+	 * resolved to symbols when the iteration ends, since
+	 * that isn't async signal safe.
+	 */
+	void *sample_ip[STALL_FRAME_MAX];
+	/** Number of addresses in sample_ip. */
+	int sample_ip_count;
+	/** Ring of the last reports. */
+	struct stall_report reports[STALL_REPORT_MAX];
+	/** Total number of reports, the ring position. */
+	uint64_t count;
+	stall_interrupt_f interrupt;
+	stall_interrupt_cancel_f interrupt_cancel;
+	struct ev_check on_iteration_start;
+	struct ev_prepare on_iteration_end;
+	pthread_t tx;
+	pthread_t watchdog;
+	/** Protects is_stopping and wakes up the watchdog. */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool is_stopping;
+} stall = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void
+stall_signal_cb(int signo)
+{
+	(void)signo;
+	if (!stall.in_iteration || stall.has_sample)
+		return;
+	int errsv = errno;
+	/*
+	 * The watchdog may have checked an iteration which ended
+	 * before the signal was delivered, so check the current
+	 * one is long enough to be sampled.
+	 */
+	uint64_t start = __atomic_load_n(&stall.iteration_start,
+					 __ATOMIC_RELAXED);
+	uint64_t threshold = __atomic_load_n(&stall.threshold,
+					     __ATOMIC_RELAXED);
+	if (start == 0 || clock_monotonic64() - start < threshold) {
+		errno = errsv;
+		return;
+	}
+	struct stall_report *sample = &stall.sample;
+	struct fiber *f = fiber();
+	sample->time = clock_realtime();
+	sample->duration = 0;
+	sample->fid = f->fid;
+	strlcpy(sample->name, fiber_name(f), sizeof(sample->name));
+	sample->lua_backtrace[0] = '\0';
+	sample->backtrace[0] = '\0';
+	/*
+	 * The handler may interrupt malloc() or the dynamic
+	 * linker, so it only unwinds the stack and leaves
+	 * symbol lookup to stall_on_iteration_end().
+	 */
+#ifdef ENABLE_BACKTRACE
+	stall.sample_ip_count = backtrace_collect(stall.sample_ip,
+						  STALL_FRAME_MAX);
+#else
+	stall.sample_ip_count = 0;
+#endif
+	stall.has_sample = 1;
+	if (stall.interrupt != NULL)
+		stall.interrupt();
+	errno = errsv;
+}
+
+static void
+stall_on_iteration_start(ev_loop *loop, ev_check *watcher, int revents)
+{
+	(void)loop;
+	(void)watcher;
+	(void)revents;
+	__atomic_store_n(&stall.iteration_start, clock_monotonic64(),
+			 __ATOMIC_RELEASE);
+	stall.in_iteration = 1;
+}
+
+static void
+stall_on_iteration_end(ev_loop *loop, ev_prepare *watcher, int revents)
+{
+	(void)loop;
+	(void)watcher;
+	(void)revents;
+	uint64_t start = stall.iteration_start;
+	stall.in_iteration = 0;
+	__atomic_store_n(&stall.iteration_start, 0, __ATOMIC_RELEASE);
+	/* The signal handler must not touch the sample anymore. */
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	if (!stall.has_sample)
+		return;
+	/* The fiber may have run no Lua code since the sample. */
+	if (stall.interrupt_cancel != NULL)
+		stall.interrupt_cancel();
+	struct stall_report *report =
+		&stall.reports[stall.count++ % STALL_REPORT_MAX];
+	*report = stall.sample;
+	report->duration = (clock_monotonic64() - start) / 1e9;
+#ifdef ENABLE_BACKTRACE
+	backtrace_symbolize(stall.sample_ip, stall.sample_ip_count,
+			    report->backtrace, sizeof(report->backtrace));
+#endif
+	stall.has_sample = 0;
+	say_warn("event loop iteration took %.3f sec, fiber %llu (%s) "
+		 "was running", report->duration,
+		 (unsigned long long)report->fid, report->name);
+	if (report->backtrace[0] != '\0')
+		say_warn("stalled fiber backtrace:\n%s", report->backtrace);
+	if (report->lua_backtrace[0] != '\0')
+		say_warn("stalled fiber Lua %s", report->lua_backtrace);
+}
+
+void
+stall_detector_set_lua_backtrace(const char *backtrace)
+{
+	if (!stall.in_iteration || !stall.has_sample)
+		return;
+	strlcpy(stall.sample.lua_backtrace, backtrace,
+		sizeof(stall.sample.lua_backtrace));
+}
+
+static void *
+stall_watchdog_f(void *arg)
+{
+	(void)arg;
+	/* Start of the last iteration the tx thread was signalled. */
+	uint64_t sampled = 0;
+	tt_pthread_mutex_lock(&stall.mutex);
+	while (!stall.is_stopping) {
+		uint64_t threshold = __atomic_load_n(&stall.threshold,
+						     __ATOMIC_RELAXED);
+		uint64_t start = __atomic_load_n(&stall.iteration_start,
+						 __ATOMIC_ACQUIRE);
+		if (start != 0 && start != sampled &&
+		    clock_monotonic64() - start >= threshold) {
+			sampled = start;
+			pthread_kill(stall.tx, STALL_SIGNAL);
+		}
+		/* Check a few times per threshold. */
+		uint64_t period = MAX(threshold / 4, (uint64_t)1000000);
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		period += deadline.tv_nsec;
+		deadline.tv_sec += period / 1000000000;
+		deadline.tv_nsec = period % 1000000000;
+		tt_pthread_cond_timedwait(&stall.cond, &stall.mutex,
+					  &deadline);
+	}
+	tt_pthread_mutex_unlock(&stall.mutex);
+	return NULL;
+}
+
+int
+stall_detector_enable(double threshold, stall_interrupt_f interrupt,
+		      stall_interrupt_cancel_f interrupt_cancel)
+{
+	if (threshold <= 0) {
+		diag_set(IllegalParams, "stall threshold must be positive");
+		return -1;
+	}
+	__atomic_store_n(&stall.threshold, (uint64_t)(threshold * 1e9),
+			 __ATOMIC_RELAXED);
+	stall.interrupt = interrupt;
+	stall.interrupt_cancel = interrupt_cancel;
+	if (stall.is_enabled)
+		return 0;
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_handler = stall_signal_cb;
+	sa.sa_flags = SA_RESTART;
+	if (sigaction(STALL_SIGNAL, &sa, NULL) != 0) {
+		diag_set(SystemError, "sigaction");
+		return -1;
+	}
+	stall.tx = pthread_self();
+	stall.is_stopping = false;
+	/* Signals are handled in the tx thread. */
+	sigset_t set, oldset;
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &oldset);
+	int rc = pthread_create(&stall.watchdog, NULL, stall_watchdog_f,
+				NULL);
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	if (rc != 0) {
+		errno = rc;
+		diag_set(SystemError, "failed to start stall watchdog");
+		return -1;
+	}
+	struct ev_loop *loop = cord()->loop;
+	ev_check_init(&stall.on_iteration_start, stall_on_iteration_start);
+	ev_prepare_init(&stall.on_iteration_end, stall_on_iteration_end);
+	/* Cover all the other watchers of the iteration. */
+	ev_set_priority(&stall.on_iteration_start, EV_MAXPRI);
+	ev_set_priority(&stall.on_iteration_end, EV_MINPRI);
+	ev_check_start(loop, &stall.on_iteration_start);
+	ev_prepare_start(loop, &stall.on_iteration_end);
+	/*
+	 * The detector is enabled in the middle of an iteration,
+	 * which is measured from now on.
+	 */
+	stall_on_iteration_start(loop, &stall.on_iteration_start, 0);
+	stall.is_enabled = true;
+	return 0;
+}
+
+void
+stall_detector_disable(void)
+{
+	if (!stall.is_enabled)
+		return;
+	tt_pthread_mutex_lock(&stall.mutex);
+	stall.is_stopping = true;
+	tt_pthread_cond_signal(&stall.cond);
+	tt_pthread_mutex_unlock(&stall.mutex);
+	tt_pthread_join(stall.watchdog, NULL);
+	struct ev_loop *loop = cord()->loop;
+	ev_check_stop(loop, &stall.on_iteration_start);
+	ev_prepare_stop(loop, &stall.on_iteration_end);
+	stall.in_iteration = 0;
+	stall.iteration_start = 0;
+	if (stall.has_sample && stall.interrupt_cancel != NULL)
+		stall.interrupt_cancel();
+	stall.has_sample = 0;
+	stall.is_enabled = false;
+}
+
+bool
+stall_detector_is_enabled(void)
+{
+	return stall.is_enabled;
+}
+
+double
+stall_detector_threshold(void)
+{
+	return stall.threshold / 1e9;
+}
+
+uint64_t
+stall_detector_count(void)
+{
+	return stall.count;
+}
+
+int
+stall_detector_foreach(stall_report_cb cb, void *cb_ctx)
+{
+	uint64_t first = stall.count > STALL_REPORT_MAX ?
+			 stall.count - STALL_REPORT_MAX : 0;
+	for (uint64_t i = first; i < stall.count; i++) {
+		int rc = cb(&stall.reports[i % STALL_REPORT_MAX], cb_ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
+}
@@ -0,0 +1,134 @@
+#pragma once
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Event loop stall detector.
+ *
+ * A watchdog thread checks how long the current iteration of
+ * the tx event loop has been running. Once it exceeds the
+ * threshold, the watchdog signals the tx thread, which samples
+ * the running fiber and the return addresses of its stack right
+ * in the signal handler. A Lua backtrace is captured when the
+ * fiber executes its next Lua instruction. When the iteration
+ * ends, the addresses are resolved to a C backtrace, and the
+ * sample is logged and stored in a ring of the last reports.
+ */
+enum {
+	/** Number of reports kept. */
+	STALL_REPORT_MAX = 16,
+	/** Size of a backtrace text buffer. */
+	STALL_BACKTRACE_MAX = 4096,
+	/** Max length of the stored fiber name. */
+	STALL_NAME_MAX = 64,
+};
+
+struct stall_report {
+	/** Wall clock time the stall was detected at. */
+	double time;
+	/** Duration of the stalled loop iteration, in seconds. */
+	double duration;
+	/** The fiber that was running. */
+	uint64_t fid;
+	char name[STALL_NAME_MAX];
+	/** C backtrace, empty if not supported. */
+	char backtrace[STALL_BACKTRACE_MAX];
+	/** Lua backtrace, empty if the fiber ran no Lua code. */
+	char lua_backtrace[STALL_BACKTRACE_MAX];
+};
+
+/**
+ * A callback invoked from the signal handler to arrange
+ * capturing of a Lua backtrace. Must be async signal safe.
+ */
+typedef void (*stall_interrupt_f)(void);
+
+/**
+ * A callback invoked when a sampled iteration ends to undo
+ * what the interrupt callback arranged if the backtrace was
+ * not captured.
+ */
+typedef void (*stall_interrupt_cancel_f)(void);
+
+/**
+ * Start detecting event loop iterations longer than @a threshold
+ * seconds. Must be called from the tx thread. If the detector
+ * is running, only the threshold and the callbacks are updated.
+ *
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set.
+ */
+int
+stall_detector_enable(double threshold, stall_interrupt_f interrupt,
+		      stall_interrupt_cancel_f interrupt_cancel);
+
+/** Stop the detector. The collected reports are kept. */
+void
+stall_detector_disable(void);
+
+bool
+stall_detector_is_enabled(void);
+
+/** Threshold of the detector, in seconds. */
+double
+stall_detector_threshold(void);
+
+/** Total number of stalls detected so far. */
+uint64_t
+stall_detector_count(void);
+
+/**
+ * Store the Lua backtrace of the stall being sampled. Ignored
+ * if there is no such stall. Called from the Lua hook set up
+ * by the interrupt callback.
+ */
+void
+stall_detector_set_lua_backtrace(const char *backtrace);
+
+typedef int (*stall_report_cb)(const struct stall_report *report,
+			       void *cb_ctx);
+
+/**
+ * Invoke @a cb for each stored report, from the oldest to the
+ * newest, until it returns non-zero.
+ */
+int
+stall_detector_foreach(stall_report_cb cb, void *cb_ctx);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "timer_wheel.h"
+
+#include <assert.h>
+
+/** Number of ticks covered by the whole wheel. */
+static const uint64_t TIMER_WHEEL_SPAN =
+	(uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+
+void
+timer_wheel_create(struct timer_wheel *wheel, uint64_t now)
+{
+	wheel->now = now;
+	wheel->count = 0;
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		wheel->bitmap[level] = 0;
+		for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+			rlist_create(&wheel->slots[level][slot]);
+	}
+}
+
+/**
+ * Link a timer into the slot its deadline falls into, relative
+ * to the current wheel time.
+ */
+static void
+timer_wheel_insert(struct timer_wheel *wheel, struct timer_wheel_entry *entry)
+{
+	uint64_t pos = entry->expire;
+	if (pos <= wheel->now)
+		pos = wheel->now + 1;
+	else if (pos - wheel->now >= TIMER_WHEEL_SPAN)
+		pos = wheel->now + TIMER_WHEEL_SPAN - 1;
+	/*
+	 * The lowest level where the deadline and the current
+	 * time share the slot of the level above. The top
+	 * level has no level above, it may wrap around once.
+	 */
+	uint64_t diff = pos ^ wheel->now;
+	int level = 0;
+	while (level < TIMER_WHEEL_LEVELS - 1 &&
+	       (diff >> (TIMER_WHEEL_BITS * (level + 1))) != 0)
+		level++;
+	int slot = (pos >> (TIMER_WHEEL_BITS * level)) &
+		   (TIMER_WHEEL_SLOTS - 1);
+	entry->level = level;
+	entry->slot = slot;
+	rlist_add_tail_entry(&wheel->slots[level][slot], entry, link);
+	wheel->bitmap[level] |= (uint64_t)1 << slot;
+}
+
+void
+timer_wheel_add(struct timer_wheel *wheel, struct timer_wheel_entry *entry,
+		uint64_t expire)
+{
+	assert(!timer_wheel_entry_is_armed(entry));
+	entry->expire = expire;
+	timer_wheel_insert(wheel, entry);
+	wheel->count++;
+}
+
+void
+timer_wheel_del(struct timer_wheel *wheel, struct timer_wheel_entry *entry)
+{
+	if (!timer_wheel_entry_is_armed(entry))
+		return;
+	struct rlist *slot = &wheel->slots[entry->level][entry->slot];
+	rlist_del_entry(entry, link);
+	if (rlist_empty(slot))
+		wheel->bitmap[entry->level] &= ~((uint64_t)1 << entry->slot);
+	entry->level = -1;
+	assert(wheel->count > 0);
+	wheel->count--;
+}
+
+uint64_t
+timer_wheel_next(const struct timer_wheel *wheel)
+{
+	uint64_t next = UINT64_MAX;
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		uint64_t bitmap = wheel->bitmap[level];
+		if (bitmap == 0)
+			continue;
+		int shift = TIMER_WHEEL_BITS * level;
+		uint64_t cur = wheel->now >> shift;
+		/*
+		 * Look for the first non-empty slot after the
+		 * current one, wrapping around. The current slot
+		 * itself is the last candidate: it can only hold
+		 * timers of the next turn of the level.
+		 */
+		int start = (cur + 1) & (TIMER_WHEEL_SLOTS - 1);
+		uint64_t rotated = start == 0 ? bitmap :
+				   (bitmap >> start) |
+				   (bitmap << (TIMER_WHEEL_SLOTS - start));
+		uint64_t tick = (cur + 1 + __builtin_ctzll(rotated)) << shift;
+		if (tick < next)
+			next = tick;
+	}
+	return next;
+}
+
+/**
+ * Unlink all timers of a slot and either put them to the expired
+ * list or re-insert them at the current wheel time.
+ */
+static void
+timer_wheel_flush_slot(struct timer_wheel *wheel, int level, int slot,
+		       struct rlist *expired)
+{
+	struct rlist *list = &wheel->slots[level][slot];
+	wheel->bitmap[level] &= ~((uint64_t)1 << slot);
+	struct timer_wheel_entry *entry, *tmp;
+	rlist_foreach_entry_safe(entry, list, link, tmp) {
+		rlist_del_entry(entry, link);
+		if (entry->expire <= wheel->now) {
+			entry->level = -1;
+			wheel->count--;
+			rlist_add_tail_entry(expired, entry, link);
+		} else {
+			assert(level > 0);
+			timer_wheel_insert(wheel, entry);
+		}
+	}
+}
+
+void
+timer_wheel_advance(struct timer_wheel *wheel, uint64_t now,
+		    struct rlist *expired)
+{
+	uint64_t next;
+	while ((next = timer_wheel_next(wheel)) <= now) {
+		assert(next > wheel->now);
+		wheel->now = next;
+		/*
+		 * Cascade the slots starting at this tick, from
+		 * the top level down, then fire the slot of the
+		 * bottom level.
+		 */
+		for (int level = TIMER_WHEEL_LEVELS - 1; level >= 0; level--) {
+			int shift = TIMER_WHEEL_BITS * level;
+			if ((next & (((uint64_t)1 << shift) - 1)) != 0)
+				continue;
+			int slot = (next >> shift) & (TIMER_WHEEL_SLOTS - 1);
+			if ((wheel->bitmap[level] & ((uint64_t)1 << slot)) != 0)
+				timer_wheel_flush_slot(wheel, level, slot,
+						       expired);
+		}
+	}
+	if (now > wheel->now)
+		wheel->now = now;
+}
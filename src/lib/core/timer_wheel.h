@@ -0,0 +1,144 @@
+#pragma once
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include "small/rlist.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Hierarchical timer wheel.
+ *
+ * Time is measured in abstract integer ticks. The wheel consists
+ * of TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots each;
+ * a slot of level N covers TIMER_WHEEL_SLOTS^N ticks. A timer is
+ * put into the lowest level which can hold its deadline, so
+ * arming and cancelling a timer are O(1). When the wheel time
+ * reaches the start of a slot of a higher level, the timers of
+ * this slot are redistributed (cascaded) to the lower levels.
+ *
+ * Timers further than the wheel span are parked in the last
+ * slot of the top level and are re-inserted when it is reached.
+ */
+enum {
+	TIMER_WHEEL_BITS = 6,
+	TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS,
+	TIMER_WHEEL_LEVELS = 6,
+};
+
+/** A timer linked into a timer wheel. */
+struct timer_wheel_entry {
+	/** Link in the list of timers of a slot. */
+	struct rlist link;
+	/** Tick at which the timer expires. */
+	uint64_t expire;
+	/** Wheel level, or -1 if the timer is not armed. */
+	int8_t level;
+	/** Slot in the level. */
+	uint8_t slot;
+};
+
+struct timer_wheel {
+	/** Current wheel time, in ticks. */
+	uint64_t now;
+	/** Number of armed timers. */
+	uint32_t count;
+	/** Bit N is set if slot N of the level is not empty. */
+	uint64_t bitmap[TIMER_WHEEL_LEVELS];
+	/** Lists of timers, per level and slot. */
+	struct rlist slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+/** Initialize an empty wheel starting at the given tick. */
+void
+timer_wheel_create(struct timer_wheel *wheel, uint64_t now);
+
+/** Initialize a timer which is not armed. */
+static inline void
+timer_wheel_entry_create(struct timer_wheel_entry *entry)
+{
+	rlist_create(&entry->link);
+	entry->expire = 0;
+	entry->level = -1;
+	entry->slot = 0;
+}
+
+/** Return true if the timer is armed. */
+static inline bool
+timer_wheel_entry_is_armed(const struct timer_wheel_entry *entry)
+{
+	return entry->level >= 0;
+}
+
+/** Return true if no timer is armed in the wheel. */
+static inline bool
+timer_wheel_is_empty(const struct timer_wheel *wheel)
+{
+	return wheel->count == 0;
+}
+
+/**
+ * Arm a timer to expire at the given tick. A deadline not later
+ * than the current wheel time is treated as the next tick. The
+ * timer must not be armed.
+ */
+void
+timer_wheel_add(struct timer_wheel *wheel, struct timer_wheel_entry *entry,
+		uint64_t expire);
+
+/** Disarm a timer. Does nothing if the timer is not armed. */
+void
+timer_wheel_del(struct timer_wheel *wheel, struct timer_wheel_entry *entry);
+
+/**
+ * Return the tick the wheel must be advanced to in order to make
+ * progress, i.e. the start of the earliest non-empty slot, or
+ * UINT64_MAX if the wheel is empty. The returned tick is never
+ * later than the earliest deadline.
+ */
+uint64_t
+timer_wheel_next(const struct timer_wheel *wheel);
+
+/**
+ * Advance the wheel time to the given tick and move all timers
+ * expired by then to the @a expired list. The moved timers are
+ * disarmed. The wheel time never goes backwards.
+ */
+void
+timer_wheel_advance(struct timer_wheel *wheel, uint64_t now,
+		    struct rlist *expired);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
@@ -0,0 +1,566 @@
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "uring.h"
+
+#include <trivia/config.h>
+#include <trivia/util.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "diag.h"
+#include "errinj.h"
+#include "fiber.h"
+#include "say.h"
+
+#if defined(HAVE_IO_URING)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+static inline int
+sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+enum {
+	/** Delay before resubmitting requests after a failure. */
+	URING_RETRY_TIMEOUT_MS = 1,
+};
+
+static inline int
+sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+		   unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+/**
+ * Number of requests queued but not consumed by the kernel yet,
+ * including the ones a previous io_uring_enter() failed to
+ * submit.
+ */
+static inline unsigned
+uring_pending(struct uring *ring)
+{
+	return ring->sq_tail_local -
+	       __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Reap all available completions and invoke their callbacks.
+ * A callback may queue new requests to the same ring.
+ */
+static void
+uring_reap(struct uring *ring)
+{
+	struct io_uring_cqe *cqes = (struct io_uring_cqe *)ring->cqes;
+	unsigned head = *ring->cq_head;
+	while (true) {
+		unsigned tail = __atomic_load_n(ring->cq_tail,
+						__ATOMIC_ACQUIRE);
+		if (head == tail)
+			break;
+		struct io_uring_cqe *cqe = &cqes[head & *ring->cq_mask];
+		struct uring_req *req =
+			(struct uring_req *)(uintptr_t)cqe->user_data;
+		int res = cqe->res;
+		/*
+		 * Release the entry before invoking the callback
+		 * so that it can queue a new request.
+		 */
+		__atomic_store_n(ring->cq_head, ++head, __ATOMIC_RELEASE);
+		assert(ring->inflight > 0);
+		ring->inflight--;
+		/* Cancel requests have no callback. */
+		if (req != NULL)
+			req->cb(req, res);
+	}
+}
+
+static void
+uring_complete_cb(ev_loop *loop, struct ev_io *watcher, int revents)
+{
+	(void)loop;
+	(void)revents;
+	uring_reap((struct uring *)watcher->data);
+}
+
+static void
+uring_submit_cb(ev_loop *loop, struct ev_prepare *watcher, int revents)
+{
+	(void)loop;
+	(void)revents;
+	uring_submit((struct uring *)watcher->data);
+}
+
+static void
+uring_retry_cb(ev_loop *loop, struct ev_timer *watcher, int revents)
+{
+	(void)loop;
+	(void)revents;
+	uring_submit((struct uring *)watcher->data);
+}
+
+bool
+uring_is_supported(void)
+{
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	int fd = sys_io_uring_setup(1, &p);
+	if (fd < 0)
+		return false;
+	close(fd);
+	return true;
+}
+
+int
+uring_create(struct uring *ring, ev_loop *loop, unsigned entries)
+{
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	int fd = sys_io_uring_setup(entries, &p);
+	if (fd < 0) {
+		diag_set(SystemError, "io_uring_setup failed");
+		return -1;
+	}
+	ring->fd = fd;
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes +
+			p.cq_entries * sizeof(struct io_uring_cqe);
+	if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+		ring->sq_size = MAX(ring->sq_size, ring->cq_size);
+		ring->cq_size = ring->sq_size;
+	}
+	ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED) {
+		ring->sq_ptr = NULL;
+		diag_set(SystemError, "failed to map io_uring");
+		goto error;
+	}
+	if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ring->cq_ptr = mmap(NULL, ring->cq_size,
+				    PROT_READ | PROT_WRITE,
+				    MAP_SHARED | MAP_POPULATE, fd,
+				    IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED) {
+			ring->cq_ptr = NULL;
+			diag_set(SystemError, "failed to map io_uring");
+			goto error;
+		}
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		diag_set(SystemError, "failed to map io_uring");
+		goto error;
+	}
+	char *sq = (char *)ring->sq_ptr;
+	ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+	ring->sq_entries = p.sq_entries;
+	char *cq = (char *)ring->cq_ptr;
+	ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	ring->cqes = cq + p.cq_off.cqes;
+	ring->cq_entries = p.cq_entries;
+#if defined(IORING_FEAT_RW_CUR_POS)
+	ring->has_file_rw = (p.features & IORING_FEAT_RW_CUR_POS) != 0;
+#endif
+	ring->sq_tail_local = *ring->sq_tail;
+
+	ring->loop = loop;
+	ev_io_init(&ring->complete_ev, uring_complete_cb, fd, EV_READ);
+	ring->complete_ev.data = ring;
+	ev_prepare_init(&ring->submit_ev, uring_submit_cb);
+	ring->submit_ev.data = ring;
+	ev_timer_init(&ring->retry_ev, uring_retry_cb,
+		      URING_RETRY_TIMEOUT_MS / 1000.0, 0);
+	ring->retry_ev.data = ring;
+	ev_io_start(loop, &ring->complete_ev);
+	ev_prepare_start(loop, &ring->submit_ev);
+	return 0;
+error:
+	uring_destroy(ring);
+	return -1;
+}
+
+void
+uring_unref(struct uring *ring)
+{
+	assert(ring->loop != NULL && !ring->is_unref);
+	ev_unref(ring->loop);
+	ev_unref(ring->loop);
+	ring->is_unref = true;
+}
+
+void
+uring_destroy(struct uring *ring)
+{
+	if (ring->loop != NULL) {
+		if (ring->is_unref) {
+			ev_ref(ring->loop);
+			ev_ref(ring->loop);
+		}
+		ev_io_stop(ring->loop, &ring->complete_ev);
+		ev_prepare_stop(ring->loop, &ring->submit_ev);
+		ev_timer_stop(ring->loop, &ring->retry_ev);
+		ring->loop = NULL;
+	}
+	if (ring->sqes != NULL)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_size);
+	if (ring->sq_ptr != NULL)
+		munmap(ring->sq_ptr, ring->sq_size);
+	ring->sqes = ring->cq_ptr = ring->sq_ptr = NULL;
+	if (ring->fd >= 0)
+		close(ring->fd);
+	ring->fd = -1;
+}
+
+/**
+ * Get a free submission queue entry or NULL if the ring is full.
+ * The returned entry is zeroed and already queued, so the caller
+ * must fill it in.
+ */
+static struct io_uring_sqe *
+uring_get_sqe(struct uring *ring)
+{
+	/*
+	 * Every queued request produces a completion, so the
+	 * number of requests in flight must be limited by the
+	 * completion queue size, otherwise completions could be
+	 * dropped by older kernels.
+	 */
+	if (ring->inflight >= ring->cq_entries)
+		return NULL;
+	unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (ring->sq_tail_local - head >= ring->sq_entries) {
+		/* Flush the queue to make room. */
+		uring_submit(ring);
+		head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+		if (ring->sq_tail_local - head >= ring->sq_entries)
+			return NULL;
+	}
+	unsigned idx = ring->sq_tail_local & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &((struct io_uring_sqe *)ring->sqes)[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[idx] = idx;
+	ring->sq_tail_local++;
+	ring->inflight++;
+	ring->req_count++;
+	return sqe;
+}
+
+int
+uring_recv(struct uring *ring, struct uring_req *req, int fd,
+	   void *buf, size_t size)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(ring);
+	if (sqe == NULL)
+		return -1;
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)buf;
+	sqe->len = size;
+	sqe->user_data = (uintptr_t)req;
+	return 0;
+}
+
+int
+uring_writev(struct uring *ring, struct uring_req *req, int fd,
+	     const struct iovec *iov, int iovcnt)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(ring);
+	if (sqe == NULL)
+		return -1;
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)iov;
+	sqe->len = iovcnt;
+	sqe->user_data = (uintptr_t)req;
+	return 0;
+}
+
+/**
+ * The maximal number of bytes transferred by a single read or
+ * write, the same limit as Linux read(2) and write(2) have.
+ */
+enum { URING_RW_MAX = 0x7ffff000 };
+
+#if defined(IORING_FEAT_RW_CUR_POS)
+
+/** Queue a file read or write request. */
+static int
+uring_file_rw(struct uring *ring, struct uring_req *req, int opcode,
+	      int fd, uintptr_t addr, size_t size, off_t offset)
+{
+	if (!ring->has_file_rw)
+		return -1;
+	struct io_uring_sqe *sqe = uring_get_sqe(ring);
+	if (sqe == NULL)
+		return -1;
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->off = (uint64_t)offset;
+	sqe->addr = addr;
+	sqe->len = MIN(size, (size_t)URING_RW_MAX);
+	sqe->user_data = (uintptr_t)req;
+	return 0;
+}
+
+int
+uring_read(struct uring *ring, struct uring_req *req, int fd,
+	   void *buf, size_t size, off_t offset)
+{
+	return uring_file_rw(ring, req, IORING_OP_READ, fd,
+			     (uintptr_t)buf, size, offset);
+}
+
+int
+uring_write(struct uring *ring, struct uring_req *req, int fd,
+	    const void *buf, size_t size, off_t offset)
+{
+	return uring_file_rw(ring, req, IORING_OP_WRITE, fd,
+			     (uintptr_t)buf, size, offset);
+}
+
+#else /* !defined(IORING_FEAT_RW_CUR_POS) */
+
+int
+uring_read(struct uring *ring, struct uring_req *req, int fd,
+	   void *buf, size_t size, off_t offset)
+{
+	(void)ring;
+	(void)req;
+	(void)fd;
+	(void)buf;
+	(void)size;
+	(void)offset;
+	return -1;
+}
+
+int
+uring_write(struct uring *ring, struct uring_req *req, int fd,
+	    const void *buf, size_t size, off_t offset)
+{
+	(void)ring;
+	(void)req;
+	(void)fd;
+	(void)buf;
+	(void)size;
+	(void)offset;
+	return -1;
+}
+
+#endif /* defined(IORING_FEAT_RW_CUR_POS) */
+
+int
+uring_fsync(struct uring *ring, struct uring_req *req, int fd,
+	    bool datasync)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(ring);
+	if (sqe == NULL)
+		return -1;
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->fd = fd;
+	sqe->fsync_flags = datasync ? IORING_FSYNC_DATASYNC : 0;
+	sqe->user_data = (uintptr_t)req;
+	return 0;
+}
+
+int
+uring_cancel(struct uring *ring, struct uring_req *req)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(ring);
+	if (sqe == NULL)
+		return -1;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (uintptr_t)req;
+	sqe->user_data = 0;
+	return 0;
+}
+
+void
+uring_submit(struct uring *ring)
+{
+	unsigned pending = uring_pending(ring);
+	if (pending == 0)
+		return;
+	__atomic_store_n(ring->sq_tail, ring->sq_tail_local,
+			 __ATOMIC_RELEASE);
+	int rc;
+	do {
+		rc = sys_io_uring_enter(ring->fd, pending, 0, 0);
+		ERROR_INJECT(ERRINJ_URING_ENTER, {
+			rc = -1;
+			errno = EAGAIN;
+		});
+	} while (rc < 0 && errno == EINTR);
+	ring->submit_count++;
+	if (rc < 0 && errno != EAGAIN && errno != EBUSY)
+		say_ratelimited(S_SYSERROR, strerror(errno),
+				"io_uring_enter");
+	if (rc >= 0 && (unsigned)rc >= pending)
+		return;
+	/*
+	 * The entries the kernel failed to consume stay in
+	 * the queue past sq_head and are counted as pending,
+	 * so they are submitted on the next attempt. Make sure
+	 * it happens even if the loop has no other events.
+	 */
+	if (!ev_is_active(&ring->retry_ev))
+		ev_timer_start(ring->loop, &ring->retry_ev);
+}
+
+#else /* !defined(HAVE_IO_URING) */
+
+bool
+uring_is_supported(void)
+{
+	return false;
+}
+
+int
+uring_create(struct uring *ring, ev_loop *loop, unsigned entries)
+{
+	(void)loop;
+	(void)entries;
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+	errno = ENOSYS;
+	diag_set(SystemError, "io_uring is not supported");
+	return -1;
+}
+
+void
+uring_unref(struct uring *ring)
+{
+	(void)ring;
+}
+
+void
+uring_destroy(struct uring *ring)
+{
+	(void)ring;
+}
+
+int
+uring_recv(struct uring *ring, struct uring_req *req, int fd,
+	   void *buf, size_t size)
+{
+	(void)ring;
+	(void)req;
+	(void)fd;
+	(void)buf;
+	(void)size;
+	return -1;
+}
+
+int
+uring_writev(struct uring *ring, struct uring_req *req, int fd,
+	     const struct iovec *iov, int iovcnt)
+{
+	(void)ring;
+	(void)req;
+	(void)fd;
+	(void)iov;
+	(void)iovcnt;
+	return -1;
+}
+
+int
+uring_read(struct uring *ring, struct uring_req *req, int fd,
+	   void *buf, size_t size, off_t offset)
+{
+	(void)ring;
+	(void)req;
+	(void)fd;
+	(void)buf;
+	(void)size;
+	(void)offset;
+	return -1;
+}
+
+int
+uring_write(struct uring *ring, struct uring_req *req, int fd,
+	    const void *buf, size_t size, off_t offset)
+{
+	(void)ring;
+	(void)req;
+	(void)fd;
+	(void)buf;
+	(void)size;
+	(void)offset;
+	return -1;
+}
+
+int
+uring_fsync(struct uring *ring, struct uring_req *req, int fd,
+	    bool datasync)
+{
+	(void)ring;
+	(void)req;
+	(void)fd;
+	(void)datasync;
+	return -1;
+}
+
+int
+uring_cancel(struct uring *ring, struct uring_req *req)
+{
+	(void)ring;
+	(void)req;
+	return -1;
+}
+
+void
+uring_submit(struct uring *ring)
+{
+	(void)ring;
+}
+
+#endif /* defined(HAVE_IO_URING) */
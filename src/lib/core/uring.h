@@ -0,0 +1,254 @@
+#ifndef TARANTOOL_LIB_CORE_URING_H_INCLUDED
+#define TARANTOOL_LIB_CORE_URING_H_INCLUDED 1
+/*
+ * Copyright 2010-2021, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "third_party/tarantool_ev.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * A thin wrapper around Linux io_uring, driven by a libev event
+ * loop. Requests prepared during an event loop iteration are
+ * submitted with a single system call right before the loop
+ * blocks, and completions are reaped when the ring file
+ * descriptor becomes readable. No liburing is required: the
+ * kernel interface is used directly.
+ *
+ * The ring is not thread-safe and must be used in the thread
+ * whose event loop it is attached to.
+ *
+ * Usage:
+ * struct uring ring;
+ * if (uring_create(&ring, loop(), 256) != 0)
+ *         fall back to readiness-based I/O;
+ * uring_req_create(&req, on_complete, ctx);
+ * if (uring_recv(&ring, &req, fd, buf, size) != 0)
+ *         the ring is full, do the I/O synchronously;
+ * if (uring_read(&ring, &req, fd, buf, size, offset) != 0)
+ *         the ring is full or the kernel is too old to
+ *         read files via io_uring, use a thread pool;
+ * ...
+ * on_complete(&req, res) is called from the event loop with
+ * the result of the operation: a non-negative number of bytes
+ * or a negated errno.
+ */
+struct uring_req;
+
+typedef void
+(*uring_req_f)(struct uring_req *req, int res);
+
+/** An asynchronous operation submitted to a ring. */
+struct uring_req {
+	/** Completion callback. */
+	uring_req_f cb;
+	/** Opaque user data. */
+	void *data;
+};
+
+static inline void
+uring_req_create(struct uring_req *req, uring_req_f cb, void *data)
+{
+	req->cb = cb;
+	req->data = data;
+}
+
+struct uring {
+	/** Ring file descriptor, -1 if the ring is not created. */
+	int fd;
+	/** Submission queue ring, mapped from the kernel. */
+	void *sq_ptr;
+	size_t sq_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	/** Submission queue entries. */
+	void *sqes;
+	size_t sqes_size;
+	/** Completion queue ring, mapped from the kernel. */
+	void *cq_ptr;
+	size_t cq_size;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	void *cqes;
+	/** Number of entries in the submission queue. */
+	unsigned sq_entries;
+	/** Number of entries in the completion queue. */
+	unsigned cq_entries;
+	/**
+	 * Set if the kernel can read and write files at the
+	 * current file position (Linux 5.6+), which is required
+	 * by uring_read() and uring_write().
+	 */
+	bool has_file_rw;
+	/** Local submission queue tail, not yet seen by the kernel. */
+	unsigned sq_tail_local;
+	/**
+	 * Number of submitted operations whose completions have
+	 * not been reaped yet. Never exceeds cq_entries, so the
+	 * completion queue can not overflow.
+	 */
+	unsigned inflight;
+	/** Event loop the ring is attached to. */
+	ev_loop *loop;
+	/** Watches the ring fd for new completions. */
+	struct ev_io complete_ev;
+	/** Submits prepared requests before the loop blocks. */
+	struct ev_prepare submit_ev;
+	/**
+	 * Retries submission of the requests the kernel failed
+	 * to consume, so that they aren't stuck in the queue if
+	 * the loop has nothing else to do.
+	 */
+	struct ev_timer retry_ev;
+	/** Set if the ring doesn't keep the event loop alive. */
+	bool is_unref;
+	/** Statistics: number of submit system calls. */
+	uint64_t submit_count;
+	/** Statistics: number of submitted requests. */
+	uint64_t req_count;
+};
+
+/** Return true if the running kernel supports io_uring. */
+bool
+uring_is_supported(void);
+
+/**
+ * Create a ring with @a entries submission queue entries and
+ * attach it to @a loop.
+ * @retval  0 Success.
+ * @retval -1 io_uring is not supported or a system error,
+ *            diag is set.
+ */
+int
+uring_create(struct uring *ring, ev_loop *loop, unsigned entries);
+
+/**
+ * Detach the ring from the event loop and destroy it.
+ * Completions of the operations in flight are lost, so the
+ * caller must make sure there are none or that their buffers
+ * outlive the ring.
+ */
+void
+uring_destroy(struct uring *ring);
+
+/**
+ * Don't let the ring keep the event loop running, like
+ * ev_unref() does for a single watcher. Useful for a ring
+ * which lives as long as the process does.
+ */
+void
+uring_unref(struct uring *ring);
+
+/**
+ * Queue a recv(2) of up to @a size bytes from socket @a fd into
+ * @a buf.
+ * @retval  0 The request is queued.
+ * @retval -1 The ring is full, the caller should fall back to
+ *            synchronous I/O. Diag is not set.
+ */
+int
+uring_recv(struct uring *ring, struct uring_req *req, int fd,
+	   void *buf, size_t size);
+
+/**
+ * Queue a writev(2) of @a iov to @a fd. The iovec array must
+ * stay valid until the request completes.
+ * @retval  0 The request is queued.
+ * @retval -1 The ring is full, see uring_recv().
+ */
+int
+uring_writev(struct uring *ring, struct uring_req *req, int fd,
+	     const struct iovec *iov, int iovcnt);
+
+/**
+ * Queue a read of up to @a size bytes from file @a fd at
+ * @a offset into @a buf. If @a offset is -1, the current file
+ * position is used and advanced, like read(2) does.
+ * @retval  0 The request is queued.
+ * @retval -1 The ring is full or the kernel doesn't support
+ *            file reads, see uring_recv().
+ */
+int
+uring_read(struct uring *ring, struct uring_req *req, int fd,
+	   void *buf, size_t size, off_t offset);
+
+/**
+ * Queue a write of up to @a size bytes from @a buf to file
+ * @a fd at @a offset, -1 meaning the current file position.
+ * @retval  0 The request is queued.
+ * @retval -1 See uring_read().
+ */
+int
+uring_write(struct uring *ring, struct uring_req *req, int fd,
+	    const void *buf, size_t size, off_t offset);
+
+/**
+ * Queue fsync(2) of file @a fd, or fdatasync(2) if @a datasync
+ * is set.
+ * @retval  0 The request is queued.
+ * @retval -1 The ring is full, see uring_recv().
+ */
+int
+uring_fsync(struct uring *ring, struct uring_req *req, int fd,
+	    bool datasync);
+
+/**
+ * Queue cancellation of a request in flight. The request is
+ * completed with -ECANCELED, unless it has already completed.
+ * @retval  0 The cancellation is queued.
+ * @retval -1 The ring is full, see uring_recv().
+ */
+int
+uring_cancel(struct uring *ring, struct uring_req *req);
+
+/**
+ * Submit all queued requests to the kernel right away, without
+ * waiting for the end of the event loop iteration.
+ */
+void
+uring_submit(struct uring *ring);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_URING_H_INCLUDED */
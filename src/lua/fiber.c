@@ -33,6 +33,7 @@
 #include <fiber.h>
 #include "lua/utils.h"
 #include "backtrace.h"
+#include "stall.h"
 #include "tt_static.h"
 
 #include <lua.h>
@@ -262,10 +263,24 @@ fiber_backtrace_cb(int frameno, void *frameret, const char *func, size_t offset,
 }
 #endif
 
+/** Options of fiber.info(). */
+struct lbox_fiber_info_ctx {
+	struct lua_State *L;
+	/** Report backtraces of the fibers. */
+	bool backtrace;
+	/**
+	 * Report resident stack size of the fibers. It takes a
+	 * mincore() call per fiber, so it is off by default.
+	 */
+	bool stack_rss;
+};
+
 static int
-lbox_fiber_statof(struct fiber *f, void *cb_ctx, bool backtrace)
+lbox_fiber_statof(struct fiber *f, void *cb_ctx)
 {
-	struct lua_State *L = (struct lua_State *) cb_ctx;
+	struct lbox_fiber_info_ctx *ctx =
+		(struct lbox_fiber_info_ctx *) cb_ctx;
+	struct lua_State *L = ctx->L;
 
 	lua_pushinteger(L, f->fid);
 	lua_newtable(L);
@@ -297,9 +312,17 @@ lbox_fiber_statof(struct fiber *f, void *cb_ctx, bool backtrace)
 	lua_pushnumber(L, region_total(&f->gc) + f->stack_size +
 		       sizeof(struct fiber));
 	lua_settable(L, -3);
+	lua_pushstring(L, "stack");
+	lua_pushnumber(L, f->stack_size);
+	lua_settable(L, -3);
+	if (ctx->stack_rss) {
+		lua_pushstring(L, "stack_rss");
+		lua_pushnumber(L, fiber_stack_rss(f));
+		lua_settable(L, -3);
+	}
 	lua_settable(L, -3);
 
-	if (backtrace) {
+	if (ctx->backtrace) {
 #ifdef ENABLE_BACKTRACE
 		struct lua_fiber_tb_ctx tb_ctx;
 		tb_ctx.L = L;
@@ -317,20 +340,6 @@ lbox_fiber_statof(struct fiber *f, void *cb_ctx, bool backtrace)
 	return 0;
 }
 
-#ifdef ENABLE_BACKTRACE
-static int
-lbox_fiber_statof_bt(struct fiber *f, void *cb_ctx)
-{
-	return lbox_fiber_statof(f, cb_ctx, true);
-}
-#endif /* ENABLE_BACKTRACE */
-
-static int
-lbox_fiber_statof_nobt(struct fiber *f, void *cb_ctx)
-{
-	return lbox_fiber_statof(f, cb_ctx, false);
-}
-
 #if ENABLE_FIBER_TOP
 static int
 lbox_fiber_top_entry(struct fiber *f, void *cb_ctx)
@@ -403,15 +412,121 @@ lbox_fiber_top_disable(struct lua_State *L)
 }
 #endif /* ENABLE_FIBER_TOP */
 
+/**
+ * Lua hook set up on a stall: it runs on the next instruction
+ * executed by the stalled fiber and captures its Lua backtrace.
+ */
+static void
+lbox_fiber_stall_hook(struct lua_State *L, lua_Debug *ar)
+{
+	(void) ar;
+	lua_sethook(L, NULL, 0, 0);
+	luaL_traceback(L, L, NULL, 0);
+	stall_detector_set_lua_backtrace(lua_tostring(L, -1));
+	lua_pop(L, 1);
+}
+
+/**
+ * Invoked from a signal handler, so it can only set a hook,
+ * which is safe to do asynchronously. A hook set by the user,
+ * e.g. a coverage tool, is left intact.
+ */
+static void
+lbox_fiber_stall_interrupt(void)
+{
+	if (lua_gethook(tarantool_L) == NULL)
+		lua_sethook(tarantool_L, lbox_fiber_stall_hook,
+			    LUA_MASKCOUNT, 1);
+}
+
+/**
+ * Remove the hook if it hasn't fired during the stalled
+ * iteration, so it doesn't slow down the code run later and
+ * doesn't capture a backtrace of another fiber.
+ */
+static void
+lbox_fiber_stall_interrupt_cancel(void)
+{
+	if (lua_gethook(tarantool_L) == lbox_fiber_stall_hook)
+		lua_sethook(tarantool_L, NULL, 0, 0);
+}
+
+static int
+lbox_fiber_stall_detector_enable(struct lua_State *L)
+{
+	double threshold = luaL_optnumber(L, 1, 0.2);
+	if (stall_detector_enable(threshold, lbox_fiber_stall_interrupt,
+				  lbox_fiber_stall_interrupt_cancel) != 0)
+		return luaT_error(L);
+	return 0;
+}
+
+static int
+lbox_fiber_stall_detector_disable(struct lua_State *L)
+{
+	(void) L;
+	stall_detector_disable();
+	return 0;
+}
+
+static int
+lbox_fiber_stall_report_entry(const struct stall_report *report,
+			      void *cb_ctx)
+{
+	struct lua_State *L = (struct lua_State *) cb_ctx;
+	lua_newtable(L);
+	lua_pushnumber(L, report->time);
+	lua_setfield(L, -2, "time");
+	lua_pushnumber(L, report->duration);
+	lua_setfield(L, -2, "duration");
+	lua_pushnumber(L, report->fid);
+	lua_setfield(L, -2, "fid");
+	lua_pushstring(L, report->name);
+	lua_setfield(L, -2, "name");
+	lua_pushstring(L, report->backtrace);
+	lua_setfield(L, -2, "backtrace");
+	lua_pushstring(L, report->lua_backtrace);
+	lua_setfield(L, -2, "lua_backtrace");
+	lua_rawseti(L, -2, lua_objlen(L, -2) + 1);
+	return 0;
+}
+
+/**
+ * Return the state of the stall detector and the last stalls
+ * it has caught, from the oldest to the newest.
+ */
+static int
+lbox_fiber_stall_report(struct lua_State *L)
+{
+	lua_newtable(L);
+	lua_pushboolean(L, stall_detector_is_enabled());
+	lua_setfield(L, -2, "enabled");
+	lua_pushnumber(L, stall_detector_threshold());
+	lua_setfield(L, -2, "threshold");
+	lua_pushnumber(L, stall_detector_count());
+	lua_setfield(L, -2, "count");
+	lua_newtable(L);
+	stall_detector_foreach(lbox_fiber_stall_report_entry, L);
+	lua_setfield(L, -2, "stalls");
+	return 1;
+}
+
 /**
  * Return fiber statistics.
  */
 static int
 lbox_fiber_info(struct lua_State *L)
 {
+	struct lbox_fiber_info_ctx ctx;
+	ctx.L = L;
 #ifdef ENABLE_BACKTRACE
-	bool do_backtrace = true;
+	ctx.backtrace = true;
+#else
+	ctx.backtrace = false;
+#endif /* ENABLE_BACKTRACE */
+	ctx.stack_rss = false;
 	if (lua_istable(L, 1)) {
+#ifdef ENABLE_BACKTRACE
 		lua_pushstring(L, "backtrace");
 		lua_gettable(L, 1);
 		if (lua_isnil(L, -1)){
@@ -420,18 +535,16 @@ lbox_fiber_info(struct lua_State *L)
 			lua_gettable(L, 1);
 		}
 		if (!lua_isnil(L, -1))
-			do_backtrace = lua_toboolean(L, -1);
+			ctx.backtrace = lua_toboolean(L, -1);
 		lua_pop(L, 1);
-	}
-	if (do_backtrace) {
-		lua_newtable(L);
-		fiber_stat(lbox_fiber_statof_bt, L);
-	} else
 #endif /* ENABLE_BACKTRACE */
-	{
-		lua_newtable(L);
-		fiber_stat(lbox_fiber_statof_nobt, L);
+		lua_pushstring(L, "stack_rss");
+		lua_gettable(L, 1);
+		ctx.stack_rss = lua_toboolean(L, -1);
+		lua_pop(L, 1);
 	}
+	lua_newtable(L);
+	fiber_stat(lbox_fiber_statof, &ctx);
 	lua_createtable(L, 0, 1);
 	lua_pushliteral(L, "mapping"); /* YAML will use block mode */
 	lua_setfield(L, -2, LUAL_SERIALIZE);
@@ -870,6 +983,9 @@ static const struct luaL_Reg fiberlib[] = {
 	{"top_enable", lbox_fiber_top_enable},
 	{"top_disable", lbox_fiber_top_disable},
 #endif /* ENABLE_FIBER_TOP */
+	{"stall_detector_enable", lbox_fiber_stall_detector_enable},
+	{"stall_detector_disable", lbox_fiber_stall_detector_disable},
+	{"stall_report", lbox_fiber_stall_report},
 	{"sleep", lbox_fiber_sleep},
 	{"yield", lbox_fiber_yield},
 	{"self", lbox_fiber_self},
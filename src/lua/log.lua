@@ -29,6 +29,9 @@ ffi.cdef[[
     extern bool
     say_logger_initialized(void);
 
+    extern uint64_t
+    say_logger_dropped(void);
+
     extern sayfunc_t _say;
     extern struct ev_loop;
     extern struct ev_signal;
@@ -395,6 +398,12 @@ local function log_pid()
     return tonumber(ffi.C.log_pid)
 end
 
+-- Returns number of messages dropped by the logger
+-- thread on overflow (see box.cfg.log_overflow).
+local function log_dropped()
+    return tonumber(ffi.C.say_logger_dropped())
+end
+
 -- Fetch a value from log to box.cfg{}.
 local function box_api_cfg_get(key)
     return log_cfg[box2log_keys[key]]
@@ -576,6 +585,7 @@ local log = {
     error = say_closure(S_ERROR),
     rotate = log_rotate,
     pid = log_pid,
+    dropped = log_dropped,
     level = log_level,
     log_format = log_format,
     cfg = setmetatable(log_cfg, {
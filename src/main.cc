@@ -447,6 +447,15 @@ load_cfg(void)
 	if (background)
 		daemonize();
 
+	/*
+	 * The logger thread must be started after daemonizing,
+	 * since fork() doesn't clone threads.
+	 */
+	if (cfg_getb("log_async") == 1 && say_logger_async_start() != 0) {
+		diag_log();
+		panic("failed to start the logger thread");
+	}
+
 	/*
 	 * after (optional) daemonising to avoid confusing messages with
 	 * different pids
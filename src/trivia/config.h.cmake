@@ -76,6 +76,7 @@
 #define MAP_ANONYMOUS MAP_ANON
 #endif
 #cmakedefine HAVE_MADV_DONTNEED 1
+#cmakedefine HAVE_MINCORE 1
 /*
  * Defined if O_DSYNC mode exists for open(2).
  */
@@ -171,9 +172,13 @@
 
 #cmakedefine HAVE_PTHREAD_YIELD 1
 #cmakedefine HAVE_SCHED_YIELD 1
+#cmakedefine HAVE_PTHREAD_SETAFFINITY_NP 1
+#cmakedefine HAVE_MBIND 1
 #cmakedefine HAVE_POSIX_FADVISE 1
 #cmakedefine HAVE_FALLOCATE 1
 #cmakedefine HAVE_MREMAP 1
+#cmakedefine HAVE_IO_URING 1
+#cmakedefine HAVE_SHM_CHAN 1
 #cmakedefine HAVE_SYNC_FILE_RANGE 1
 
 #cmakedefine HAVE_MSG_NOSIGNAL 1
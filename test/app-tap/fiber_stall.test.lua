@@ -0,0 +1,53 @@
+#!/usr/bin/env tarantool
+
+local tap = require('tap')
+local fiber = require('fiber')
+local clock = require('clock')
+local test = tap.test("fiber_stall")
+
+test:plan(12)
+
+local report = fiber.stall_report()
+test:is(report.enabled, false, 'detector is disabled by default')
+test:is(report.count, 0, 'no stalls yet')
+test:ok(not pcall(fiber.stall_detector_enable, 0),
+        'threshold must be positive')
+
+fiber.stall_detector_enable(0.05)
+report = fiber.stall_report()
+test:is(report.enabled, true, 'detector is enabled')
+test:is(report.threshold, 0.05, 'threshold')
+
+-- Hooks don't fire in JIT-compiled code, keep it interpreted.
+local function busy_loop(timeout)
+    local deadline = clock.monotonic() + timeout
+    while clock.monotonic() < deadline do end
+end
+jit.off(busy_loop, true)
+
+local f = fiber.new(function() busy_loop(0.3) end)
+f:name('stall_test')
+local fid = f:id()
+f:set_joinable(true)
+f:join()
+-- Let the stalled event loop iteration end.
+fiber.sleep(0.01)
+
+local stall
+for _, s in ipairs(fiber.stall_report().stalls) do
+    if s.name == 'stall_test' then
+        stall = s
+    end
+end
+test:ok(stall ~= nil, 'stall is detected')
+test:is(stall.fid, fid, 'fiber id')
+test:ok(stall.duration >= 0.3, 'duration covers the whole iteration')
+test:is(type(stall.backtrace), 'string', 'C backtrace')
+test:ok(stall.lua_backtrace:find('busy_loop') ~= nil, 'Lua backtrace')
+
+fiber.stall_detector_disable()
+report = fiber.stall_report()
+test:is(report.enabled, false, 'detector is disabled')
+test:ok(#report.stalls >= 1, 'reports are kept')
+
+os.exit(test:check() and 0 or 1)
@@ -329,6 +329,10 @@ info = fiber.info({bt = false})
 info[f1:id()].backtrace == nil
 info = fiber.info({backtrace = false})
 info[f1:id()].backtrace == nil
+-- Resident stack size is reported on demand only.
+info[f1:id()].memory.stack_rss == nil
+info = fiber.info({stack_rss = true})
+type(info[f1:id()].memory.stack_rss)
 
 f1:cancel()
 f2:cancel()
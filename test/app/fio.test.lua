@@ -526,3 +526,23 @@ fio.tempdir()
 tmpdir = nil
 
 os.setenv('TMPDIR', old_tmpdir)
+
+--
+-- A file request queued to io_uring is submitted again if
+-- io_uring_enter() fails, so the fiber waiting for it doesn't
+-- hang. With eio the test passes as well.
+--
+file = fio.pathjoin(fio.tempdir(), 'uring')
+fh = fio.open(file, {'O_RDWR', 'O_CREAT', 'O_TRUNC'}, tonumber('0644', 8))
+errinj.set('ERRINJ_URING_ENTER', true)
+done = false
+_ = fiber.create(function() done = fh:pwrite('data', 0) end)
+fiber.sleep(0.01)
+errinj.set('ERRINJ_URING_ENTER', false)
+test_run:wait_cond(function() return done ~= false end, 10)
+done = false
+_ = fiber.create(function() done = fh:pread(4, 0) end)
+test_run:wait_cond(function() return done ~= false end, 10)
+done
+fh:close()
+fio.unlink(file)
@@ -0,0 +1,16 @@
+#!/usr/bin/env tarantool
+
+require('console').listen(os.getenv('ADMIN'))
+
+if arg[1] == 'invalid' then
+    _G.invalid_cfg_error = select(2, pcall(box.cfg, {
+        cpu_affinity_iproto = '3-1',
+    }))
+end
+
+box.cfg({
+    listen = os.getenv('LISTEN'),
+    cpu_affinity_tx = '0',
+    cpu_affinity_wal = 0,
+    cpu_affinity_coio = '0-0',
+})
@@ -0,0 +1,25 @@
+test_run = require('test_run').new()
+
+--
+-- Thread classes can be pinned to CPU sets and the memtx arena
+-- can be bound to a NUMA node. The options are static.
+--
+type(box.info.affinity.tx)
+box.info.affinity.memtx_numa_node
+box.cfg{cpu_affinity_wal = '0'}
+box.cfg{memtx_numa_node = 0}
+
+test_run:cmd("create server test with script='box/affinity.lua'")
+test_run:cmd("start server test with args='invalid'")
+test_run:cmd("switch test")
+invalid_cfg_error
+box.info.affinity.tx
+box.info.affinity.wal
+box.info.affinity.memtx_numa_node
+-- coio threads are started on demand.
+_ = require('socket').getaddrinfo('localhost', 80)
+box.info.affinity.coio
+test_run:cmd("switch default")
+test_run:cmd("stop server test")
+test_run:cmd("cleanup server test")
+test_run:cmd("delete server test")
@@ -0,0 +1,48 @@
+net_box = require('net.box')
+test_run = require('test_run').new()
+
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+box.schema.user.grant('guest', 'read,write', 'space', 'test')
+box.schema.user.grant('guest', 'execute', 'universe')
+
+box.cfg.iproto_adaptive
+box.cfg{iproto_adaptive = 'on'}
+box.stat.net.MSG_MAX.current == box.cfg.net_msg_max
+
+--
+-- Without the adaptive controller every connection reads
+-- with box.cfg.readahead.
+--
+c = net_box.connect(box.cfg.listen)
+sid = c:eval('return box.session.id()')
+box.session.net_queue(sid).readahead == box.cfg.readahead
+box.stat.net.READAHEAD.current >= box.cfg.readahead
+
+--
+-- A client sending small requests one by one gets the
+-- smallest readahead.
+--
+box.cfg{iproto_adaptive = true}
+c:ping()
+box.session.net_queue(sid).readahead
+
+--
+-- Big pipelined requests make readahead grow.
+--
+data = string.rep('x', 30000)
+for i = 1, 20 do c.space.test:replace({i, data}, {is_async = true}) end
+c:ping()
+test_run:wait_cond(function() return box.session.net_queue(sid).readahead > box.cfg.readahead end)
+s:count()
+box.stat.net.MSG_MAX.current <= box.cfg.net_msg_max
+box.stat.net.thread[1].MSG_MAX.current == box.stat.net.MSG_MAX.current
+
+box.cfg{iproto_adaptive = false}
+c:ping()
+box.session.net_queue(sid).readahead == box.cfg.readahead
+box.stat.net.MSG_MAX.current == box.cfg.net_msg_max
+
+c:close()
+s:drop()
+box.schema.user.revoke('guest', 'execute', 'universe')
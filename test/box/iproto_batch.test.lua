@@ -0,0 +1,50 @@
+net_box = require('net.box')
+
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+box.schema.user.grant('guest', 'read,write', 'space', 'test')
+
+--
+-- All requests of a batch are executed in one transaction,
+-- the reply has a tuple per request.
+--
+c = net_box.connect(box.cfg.listen)
+inserts = box.stat().INSERT.total
+batches = box.stat().BATCH.total
+c:batch({{'insert', 'test', {1, 1}}, {'replace', 'test', {2, 2}}, {'update', 'test', {1}, {{'+', 2, 10}}}, {'upsert', s.id, {3, 3}, {}}, {'delete', 'test', {2}}})
+s:select()
+box.stat().INSERT.total - inserts
+box.stat().BATCH.total - batches
+
+--
+-- If one of the requests fails, the whole batch is rolled
+-- back.
+--
+c:batch({{'replace', 'test', {4}}, {'insert', 'test', {1}}})
+s:select()
+c:batch({{'replace', 'test', {4}}, {'insert', 'test', {'a'}}})
+s:select()
+c:batch({})
+c:batch({{'select', 'test', {1}}})
+c:batch({{'insert', 'unknown', {1}}})
+
+--
+-- A batch in a stream joins its transaction. On failure only
+-- the batch statements are rolled back.
+--
+v = box.schema.space.create('test_v', {engine = 'vinyl'})
+_ = v:create_index('primary')
+box.schema.user.grant('guest', 'read,write', 'space', 'test_v')
+c:reload_schema()
+stream = c:new_stream()
+stream:begin()
+stream.space.test_v:replace({1})
+stream:batch({{'replace', 'test_v', {2}}, {'insert', 'test_v', {1}}})
+stream:batch({{'replace', 'test_v', {3}}, {'replace', 'test_v', {4}}})
+v:select()
+stream:commit()
+v:select()
+
+c:close()
+s:drop()
+v:drop()
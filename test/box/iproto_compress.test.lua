@@ -0,0 +1,57 @@
+net_box = require('net.box')
+fiber = require('fiber')
+test_run = require('test_run').new()
+
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+data = string.rep('x', 1000)
+for i = 1, 1000 do s:replace({i, data}) end
+box.schema.user.grant('guest', 'read', 'space', 'test')
+
+--
+-- The client asks for compressed replies, large replies
+-- are compressed and small ones are sent as is.
+--
+c = net_box.connect(box.cfg.listen, {compress = true})
+c:ping()
+sent = box.stat.net().SENT.total
+r = c.space.test:select()
+#r
+r[1][1], r[1000][1], r[1000][2] == data
+box.stat.net().SENT.total - sent < 100000
+r = c.space.test:get({10})
+r[1], r[2] == data
+
+--
+-- Replies of different sizes are interleaved on one
+-- connection, and the order of the output is kept.
+--
+test_run:cmd("setopt delimiter ';'")
+ok = 0
+done = 0
+for i = 1, 100 do
+    fiber.create(function()
+        local limit = i % 2 == 0 and 1 or 100
+        local r = c.space.test:select({i}, {iterator = 'GE', limit = limit})
+        if #r == limit and r[1][1] == i and r[#r][1] == i + limit - 1 then
+            ok = ok + 1
+        end
+        done = done + 1
+    end)
+end;
+test_run:cmd("setopt delimiter ''");
+test_run:wait_cond(function() return done == 100 end)
+ok
+c:close()
+
+--
+-- Without the option the output is not compressed.
+--
+c = net_box.connect(box.cfg.listen)
+sent = box.stat.net().SENT.total
+r = c.space.test:select()
+#r
+box.stat.net().SENT.total - sent > 1000000
+c:close()
+
+s:drop()
@@ -0,0 +1,49 @@
+net_box = require('net.box')
+
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+_ = s:create_index('sk', {parts = {2, 'unsigned'}, unique = false})
+for i = 1, 10 do s:replace({i, i % 3}) end
+box.schema.user.grant('guest', 'read', 'space', 'test')
+c = net_box.connect(box.cfg.listen)
+function ids(gen, param, state) return gen:map(function(t) return t[1] end):totable() end
+
+--
+-- net.box pairs() fetches the result set in batches, each
+-- resumed after the position of the previous one.
+--
+ids(c.space.test:pairs(nil, {batch_size = 3}))
+ids(c.space.test:pairs({5}, {iterator = 'GT', batch_size = 2}))
+ids(c.space.test:pairs({5}, {iterator = 'LE', batch_size = 2}))
+ids(c.space.test.index.sk:pairs({1}, {batch_size = 2}))
+ids(c.space.test.index.sk:pairs({1}, {iterator = 'REQ', batch_size = 3}))
+ids(c.space.test.index.sk:pairs({1}, {iterator = 'GE', batch_size = 3}))
+ids(c.space.test.index.sk:pairs({1}, {batch_size = 4}))
+ids(c.space.test:pairs({100}, {iterator = 'GE'}))
+c.space.test:pairs(nil, {iterator = 'BITS_ALL_SET'}):totable()
+
+--
+-- The offset is applied once, the limit bounds the total
+-- number of tuples rather than the batch.
+--
+ids(c.space.test:pairs(nil, {offset = 2, limit = 5, batch_size = 2}))
+ids(c.space.test.index.sk:pairs({1}, {offset = 1, limit = 2, batch_size = 1}))
+ids(c.space.test:pairs(nil, {offset = 20}))
+ids(c.space.test:pairs(nil, {limit = 0}))
+
+--
+-- The tuples inserted during the iteration after the position
+-- are seen, the deleted ones are not.
+--
+gen, param, state = c.space.test:pairs(nil, {batch_size = 2})
+state, t = gen(param, state)
+t
+s:delete({3})
+s:replace({4, 100})
+state, t = gen(param, state)
+t
+state, t = gen(param, state)
+t
+
+c:close()
+s:drop()
@@ -0,0 +1,47 @@
+net_box = require('net.box')
+clock = require('clock')
+
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+box.schema.user.grant('guest', 'read,write', 'space', 'test')
+box.schema.user.grant('guest', 'execute', 'universe')
+
+test_run = require('test_run').new()
+test_run:cmd("setopt delimiter ';'")
+function busy(timeout)
+    local deadline = clock.monotonic() + timeout
+    while clock.monotonic() < deadline do end
+end;
+test_run:cmd("setopt delimiter ''");
+
+--
+-- A request which waited in the queue longer than its timeout
+-- is dropped by the server without execution.
+--
+c = net_box.connect(box.cfg.listen)
+f = c:call('busy', {0.3}, {is_async = true})
+ok, err = pcall(c.space.test.replace, c.space.test, {1}, {timeout = 0.05})
+ok, err.code == box.error.TIMEOUT
+_ = f:wait_result()
+s:get({1})
+
+-- Requests which did not expire are executed.
+c.space.test:replace({2}, {timeout = 10})
+s:get({2})
+c:close()
+
+--
+-- iproto_queue_delay_max option.
+--
+box.cfg.iproto_queue_delay_max
+box.cfg{iproto_queue_delay_max = -1}
+box.cfg{iproto_queue_delay_max = 10}
+box.cfg.iproto_queue_delay_max
+c = net_box.connect(box.cfg.listen)
+c.space.test:select()
+c:close()
+box.cfg{iproto_queue_delay_max = 0}
+
+box.schema.user.revoke('guest', 'execute', 'universe')
+busy = nil
+s:drop()
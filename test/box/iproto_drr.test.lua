@@ -0,0 +1,52 @@
+test_run = require('test_run').new()
+net_box = require('net.box')
+fiber = require('fiber')
+
+box.schema.user.grant('guest', 'execute', 'universe')
+
+--
+-- box.session.net_queue() shows request queue of a binary
+-- protocol connection.
+--
+box.session.net_queue()
+c = net_box.connect(box.cfg.listen)
+q = c:eval('return box.session.net_queue()')
+q.inflight, q.pending
+box.session.net_queue(c:eval('return box.session.id()')).inflight
+box.session.net_queue(1, 2)
+box.session.net_queue(1000000)
+
+--
+-- A client pipelining a lot of requests doesn't starve others:
+-- requests of the connections waiting for net_msg_max are sent
+-- to tx in deficit round-robin order. A request larger than the
+-- quantum lets a small request of another connection go first.
+--
+old_msg_max = box.cfg.net_msg_max
+box.cfg{net_msg_max = 2}
+log = {}
+ch = fiber.channel(1000)
+function hold() table.insert(log, 'large') ch:get() end
+function small() table.insert(log, 'small') end
+sid = c:eval('return box.session.id()')
+large = net_box.connect(box.cfg.listen)
+large_sid = large:eval('return box.session.id()')
+data = string.rep('x', 8192)
+futures = {}
+for i = 1, 50 do futures[i] = large:call('hold', {data}, {is_async = true}) end
+function is_stopped(sid) local q = box.session.net_queue(sid) return q.pending > 0 and q.inflight == #log end
+test_run:wait_cond(function() return #log > 0 and is_stopped(large_sid) end)
+mark = #log
+_ = fiber.create(function() c:call('small') end)
+test_run:wait_cond(function() return box.session.net_queue(sid).pending > 0 end)
+-- The number of large requests executed before the small one.
+function delay() for i = mark + 1, #log do if log[i] == 'small' then return i - mark - 1 end end end
+test_run:wait_cond(function() ch:put(true) fiber.sleep(0.01) return delay() ~= nil end)
+delay()
+for i = 1, 50 do ch:put(true) end
+for i = 1, 50 do futures[i]:wait_result() end
+
+large:close()
+c:close()
+box.cfg{net_msg_max = old_msg_max}
+box.schema.user.revoke('guest', 'execute', 'universe')
@@ -0,0 +1,15 @@
+#!/usr/bin/env tarantool
+
+require('console').listen(os.getenv('ADMIN'))
+
+box.cfg({
+    listen = os.getenv('LISTEN'),
+    iproto_io_uring = arg[1] ~= 'false',
+    iproto_threads = tonumber(arg[2]) or 1,
+})
+
+box.once('bootstrap', function()
+    box.schema.user.grant('guest', 'read,write,execute', 'universe')
+    box.schema.space.create('test')
+    box.space.test:create_index('primary')
+end)
@@ -0,0 +1,63 @@
+env = require('test_run')
+test_run = env.new()
+net_box = require('net.box')
+fiber = require('fiber')
+
+--
+-- Network threads may read and write client sockets via
+-- io_uring. If the kernel does not support it, the epoll path
+-- is used, so the test passes either way.
+--
+test_run:cmd("create server test with script='box/iproto_io_uring.lua'")
+test_run:cmd("start server test with args='true 2'")
+test_run:cmd("switch test")
+box.cfg.iproto_io_uring
+box.cfg{iproto_io_uring = false}
+s = box.space.test
+test_run:cmd("switch default")
+
+server_addr = test_run:cmd("eval test 'return box.cfg.listen'")[1]
+conns = {}
+for i = 1, 8 do conns[i] = net_box.connect(server_addr) end
+for i = 1, 8 do conns[i].space.test:replace({i}) end
+conns[1].space.test:select()
+
+--
+-- Pipelined requests from many fibers share the connections.
+--
+test_run:cmd("setopt delimiter ';'")
+ok = 0
+done = 0
+for i = 1, 100 do
+    fiber.create(function()
+        local c = conns[i % 8 + 1]
+        for j = 1, 10 do
+            local k = i * 100 + j
+            if c.space.test:replace({k})[1] == k then
+                ok = ok + 1
+            end
+        end
+        done = done + 1
+    end)
+end;
+test_run:cmd("setopt delimiter ''");
+test_run:wait_cond(function() return done == 100 end)
+ok
+
+--
+-- Replies larger than the socket buffer are written in several
+-- parts.
+--
+big = string.rep('x', 4 * 1024 * 1024)
+#conns[2].space.test:replace({0, big})[2]
+#conns[3].space.test:get({0})[2]
+
+for i = 1, 8 do conns[i]:close() end
+test_run:cmd("switch test")
+test_run:wait_cond(function() return box.stat.net.CONNECTIONS.current == 0 end)
+s:count()
+test_run:cmd("switch default")
+
+test_run:cmd("stop server test")
+test_run:cmd("cleanup server test")
+test_run:cmd("delete server test")
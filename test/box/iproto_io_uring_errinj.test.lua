@@ -0,0 +1,42 @@
+env = require('test_run')
+test_run = env.new()
+net_box = require('net.box')
+fiber = require('fiber')
+
+--
+-- Requests the kernel failed to consume because io_uring_enter()
+-- failed stay queued and are submitted again, even if the network
+-- thread has no other events. With epoll the test passes as well.
+--
+test_run:cmd("create server test with script='box/iproto_io_uring.lua'")
+test_run:cmd("start server test with args='true 1'")
+server_addr = test_run:cmd("eval test 'return box.cfg.listen'")[1]
+c = net_box.connect(server_addr)
+c:ping()
+
+test_run:cmd("switch test")
+box.error.injection.set('ERRINJ_URING_ENTER', true)
+test_run:cmd("switch default")
+futures = {}
+for i = 1, 10 do futures[i] = c.space.test:replace({i}, {is_async = true}) end
+fiber.sleep(0.1)
+test_run:cmd("switch test")
+box.error.injection.set('ERRINJ_URING_ENTER', false)
+test_run:cmd("switch default")
+
+test_run:cmd("setopt delimiter ';'")
+ok = 0
+for i = 1, 10 do
+    local res = futures[i]:wait_result(10)
+    if res ~= nil and res[1] == i then
+        ok = ok + 1
+    end
+end;
+test_run:cmd("setopt delimiter ''");
+ok
+c.space.test:count()
+
+c:close()
+test_run:cmd("stop server test")
+test_run:cmd("cleanup server test")
+test_run:cmd("delete server test")
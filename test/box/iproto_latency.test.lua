@@ -0,0 +1,36 @@
+net_box = require('net.box')
+
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+box.schema.user.grant('guest', 'read,write', 'space', 'test')
+
+--
+-- Latency of requests is tracked per request type and
+-- processing stage.
+--
+box.stat.reset()
+box.stat.latency().INSERT
+c = net_box.connect(box.cfg.listen)
+c.space.test:insert({1})
+c.space.test:insert({2})
+lat = box.stat.latency().INSERT
+lat.count
+stages = {}
+for k in pairs(lat) do table.insert(stages, k) end
+table.sort(stages)
+stages
+lat.total.p50 > 0
+lat.total.p50 <= lat.total.p90
+lat.total.p90 <= lat.total.p99
+lat.total.p99 <= lat.total.p999
+lat.wal.p50 <= lat.total.p50
+box.stat.latency().SELECT ~= nil
+
+--
+-- Reset drops the histograms.
+--
+box.stat.reset()
+box.stat.latency().INSERT
+
+c:close()
+s:drop()
@@ -0,0 +1,56 @@
+env = require('test_run')
+test_run = env.new()
+net_box = require('net.box')
+fiber = require('fiber')
+
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+box.schema.user.grant('guest', 'read,write', 'space', 'test')
+old_listen = box.cfg.listen
+
+--
+-- A local client may exchange data with the server over
+-- shared memory. The channel is set up over a unix socket.
+--
+box.cfg{listen = 'shm/:iproto_shm.sock'}
+connections = box.stat.net().CONNECTIONS.current
+c = net_box.connect('shm/:iproto_shm.sock')
+c.state
+c.host, c.port
+c:ping()
+box.stat.net().CONNECTIONS.current - connections
+c.space.test:insert({1, 'a'})
+c.space.test:select()
+
+--
+-- Data larger than the rings is passed in parts.
+--
+_ = c.space.test:replace({2, string.rep('x', 3 * 1024 * 1024)})
+#s:get({2})[2]
+#c.space.test:get({2})[2]
+
+--
+-- Many requests in flight.
+--
+done = 0
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 100 do
+    fiber.create(function()
+        for j = 1, 10 do
+            c.space.test:replace({100 + i, j})
+        end
+        done = done + 1
+    end)
+end;
+test_run:cmd("setopt delimiter ''");
+test_run:wait_cond(function() return done == 100 end)
+s:count()
+
+--
+-- The server notices the client has closed the connection.
+--
+c:close()
+test_run:wait_cond(function() return box.stat.net().CONNECTIONS.current == connections end)
+
+box.cfg{listen = old_listen}
+s:drop()
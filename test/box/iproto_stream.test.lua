@@ -0,0 +1,74 @@
+net_box = require('net.box')
+test_run = require('test_run').new()
+
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('primary')
+box.schema.user.grant('guest', 'read,write', 'space', 'test')
+box.schema.user.grant('guest', 'execute', 'universe')
+
+--
+-- An interactive transaction in a stream. Its changes are
+-- visible only inside the stream until commit.
+--
+c = net_box.connect(box.cfg.listen)
+stream = c:new_stream()
+stream
+stream:begin()
+stream.space.test:replace({1})
+stream.space.test.index.primary:select()
+c.space.test:select()
+s:select()
+stream:commit()
+s:select()
+
+-- Rollback.
+stream:begin()
+stream.space.test:replace({2})
+stream:call('box.space.test:get', {2})
+stream:rollback()
+s:select()
+
+-- Two streams of one connection are independent.
+stream2 = c:new_stream()
+stream:begin()
+stream2:begin()
+stream.space.test:replace({3})
+stream2.space.test:replace({4})
+stream2:rollback()
+stream:commit()
+s:select()
+
+-- Transaction requests out of a stream are rejected.
+c:_request('begin', nil, nil)
+stream:begin()
+stream:begin()
+stream:rollback()
+
+--
+-- A transaction which is not finished is rolled back when
+-- the connection is closed.
+--
+stream:begin()
+stream.space.test:replace({5})
+c:close()
+test_run:wait_cond(function() return box.stat.net.CONNECTIONS.current == 0 end)
+s:select()
+
+--
+-- Without MVCC memtx transactions can not yield, so they can
+-- not span several requests.
+--
+m = box.schema.space.create('test_memtx')
+_ = m:create_index('primary')
+box.schema.user.grant('guest', 'read,write', 'space', 'test_memtx')
+c = net_box.connect(box.cfg.listen)
+stream = c:new_stream()
+stream:begin()
+stream.space.test_memtx:replace({1})
+stream:commit()
+m:select()
+c:close()
+
+box.schema.user.revoke('guest', 'execute', 'universe')
+m:drop()
+s:drop()
@@ -0,0 +1,44 @@
+env = require('test_run')
+test_run = env.new()
+net_box = require('net.box')
+
+--
+-- Several network threads serve connections accepted from the
+-- same listening socket.
+--
+test_run:cmd("create server test with script='box/iproto_threads.lua'")
+test_run:cmd("start server test")
+test_run:cmd("switch test")
+box.cfg.iproto_threads
+box.cfg{iproto_threads = 2}
+#box.stat.net.thread()
+box.stat.net.thread[5]
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+test_run:cmd("switch default")
+
+server_addr = test_run:cmd("eval test 'return box.cfg.listen'")[1]
+conns = {}
+for i = 1, 16 do conns[i] = net_box.connect(server_addr) end
+for i = 1, 16 do conns[i].space.test:replace({i}) end
+
+test_run:cmd("switch test")
+s:count()
+test_run:cmd("setopt delimiter ';'")
+connections = 0
+requests = 0
+for _, stat in ipairs(box.stat.net.thread()) do
+    connections = connections + stat.CONNECTIONS.total
+    requests = requests + stat.REQUESTS.total
+end;
+test_run:cmd("setopt delimiter ''");
+connections == box.stat.net.CONNECTIONS.total
+requests == box.stat.net.REQUESTS.total
+connections >= 16
+test_run:cmd("switch default")
+
+for i = 1, 16 do conns[i]:close() end
+test_run:cmd("stop server test")
+test_run:cmd("cleanup server test")
+test_run:cmd("delete server test")
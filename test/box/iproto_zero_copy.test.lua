@@ -0,0 +1,57 @@
+net_box = require('net.box')
+fiber = require('fiber')
+
+--
+-- Large SELECT result sets are sent right from the tuples
+-- instead of being copied to the output buffer.
+--
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+data = string.rep('x', 2000)
+for i = 1, 1000 do s:replace({i, data}) end
+box.schema.user.grant('guest', 'read', 'space', 'test')
+c = net_box.connect(box.cfg.listen)
+
+r = c.space.test:select()
+#r
+r[1][1], r[1000][1], r[1000][2] == data
+r = c.space.test:select({500}, {iterator = 'GE', limit = 100})
+#r
+r[1][1], r[100][1]
+
+--
+-- Small and large replies are interleaved on one connection,
+-- and the order of the output is kept.
+--
+test_run = require('test_run').new()
+test_run:cmd("setopt delimiter ';'")
+ok = 0
+done = 0
+for i = 1, 100 do
+    fiber.create(function()
+        local limit = i % 2 == 0 and 1 or 100
+        local r = c.space.test:select({i}, {iterator = 'GE', limit = limit})
+        if #r == limit and r[1][1] == i and r[#r][1] == i + limit - 1 then
+            ok = ok + 1
+        end
+        done = done + 1
+    end)
+end;
+test_run:cmd("setopt delimiter ''");
+test_run:wait_cond(function() return done == 100 end)
+ok
+
+--
+-- Small tuples are copied to the output buffer in between the
+-- large ones sent without copying.
+--
+small = string.rep('y', 10)
+for i = 1001, 1100 do s:replace({i, i % 3 == 0 and data or small}) end
+r = c.space.test:select({1001}, {iterator = 'GE'})
+#r
+ok = true
+for i, t in ipairs(r) do ok = ok and t[1] == 1000 + i and t[2] == (t[1] % 3 == 0 and data or small) end
+ok
+
+c:close()
+s:drop()
@@ -0,0 +1,32 @@
+#!/usr/bin/env tarantool
+
+local fio = require('fio')
+
+require('console').listen(os.getenv('ADMIN'))
+
+box.cfg({
+    listen = os.getenv('LISTEN'),
+    log = 'log_async.log',
+    log_async = true,
+})
+
+function log_grep(path, pattern)
+    local f = fio.open(path)
+    if f == nil then
+        return false
+    end
+    local data = f:read()
+    f:close()
+    return data:find(pattern) ~= nil
+end
+
+function log_count(path, pattern)
+    local f = fio.open(path)
+    if f == nil then
+        return 0
+    end
+    local data = f:read()
+    f:close()
+    local _, count = data:gsub(pattern, '')
+    return count
+end
@@ -0,0 +1,58 @@
+test_run = require('test_run').new()
+log = require('log')
+
+--
+-- Messages can be written out by a dedicated logger thread.
+-- log_async is static, log_overflow is dynamic.
+--
+box.cfg.log_async
+box.cfg.log_overflow
+log.dropped()
+box.cfg{log_async = true}
+box.cfg{log_overflow = 'lose'}
+box.cfg.log_overflow
+
+test_run:cmd("create server test with script='box/log_async.lua'")
+test_run:cmd("start server test")
+test_run:cmd("switch test")
+test_run = require('test_run').new()
+log = require('log')
+fio = require('fio')
+box.cfg.log_async
+log.info('log_async hello')
+test_run:wait_cond(function() return log_grep('log_async.log', 'log_async hello') end)
+
+-- With the 'drop' policy messages that don't fit in the ring
+-- of a stalled logger thread are dropped and counted.
+errinj = box.error.injection
+box.cfg{log_overflow = 'drop'}
+dropped = log.dropped()
+errinj.set('ERRINJ_LOG_ASYNC_DELAY', 1000)
+for i = 1, 100000 do log.info('log_async drop %d', i) end
+errinj.set('ERRINJ_LOG_ASYNC_DELAY', 0)
+log.dropped() > dropped
+test_run:wait_cond(function() return log_grep('log_async.log', 'log messages dropped') end)
+
+-- With the 'block' policy a slow logger thread loses nothing.
+box.cfg{log_overflow = 'block'}
+dropped = log.dropped()
+errinj.set('ERRINJ_LOG_ASYNC_DELAY', 0.01)
+for i = 1, 20000 do log.info('log_async block %d', i) end
+errinj.set('ERRINJ_LOG_ASYNC_DELAY', 0)
+log.info('log_async after burst')
+test_run:wait_cond(function() return log_grep('log_async.log', 'log_async after burst') end)
+log_count('log_async.log', 'log_async block %d+')
+log.dropped() == dropped
+
+-- Log rotation goes through the logger thread too.
+fio.rename('log_async.log', 'log_async.log.1')
+log.rotate()
+test_run:wait_cond(function() return log_grep('log_async.log', 'log file has been reopened') end)
+log.info('log_async rotated')
+test_run:wait_cond(function() return log_grep('log_async.log', 'log_async rotated') end)
+log_grep('log_async.log.1', 'log_async rotated')
+
+test_run:cmd("switch default")
+test_run:cmd("stop server test")
+test_run:cmd("cleanup server test")
+test_run:cmd("delete server test")
@@ -0,0 +1,61 @@
+test_run = require('test_run').new()
+
+--
+-- Secondary keys of memtx spaces are built in parallel worker
+-- threads on recovery. Check all index kinds are consistent
+-- after restart.
+--
+s1 = box.schema.space.create('s1')
+_ = s1:create_index('pk')
+_ = s1:create_index('sk', {parts = {2, 'string'}, unique = false})
+_ = s1:create_index('hint', {parts = {3, 'unsigned'}, hint = false})
+_ = s1:create_index('hash', {type = 'hash', parts = {3, 'unsigned'}})
+_ = s1:create_index('null', {parts = {{4, 'unsigned', is_nullable = true, exclude_null = true}}, unique = false})
+s2 = box.schema.space.create('s2')
+_ = s2:create_index('pk')
+_ = s2:create_index('mk', {parts = {{'[2][*]', 'unsigned'}}, unique = false})
+lua_code = [[function(tuple) return {tostring(tuple[1]) .. '!'} end]]
+box.schema.func.create('s2_func', {body = lua_code, is_deterministic = true})
+_ = s2:create_index('func', {parts = {{1, 'string'}}, func = 's2_func', unique = false})
+s3 = box.schema.space.create('s3')
+_ = s3:create_index('pk')
+_ = s3:create_index('sk', {parts = {2, 'unsigned'}})
+s4 = box.schema.space.create('s4')
+_ = s4:create_index('pk')
+_ = s4:create_index('sk', {parts = {2, 'unsigned'}})
+
+box.begin() for i = 1, 5000 do s1:insert{i, tostring(i % 100), 10000 - i, i % 2 == 0 and i or nil} end box.commit()
+box.begin() for i = 1, 1000 do s2:insert{i, {i % 7, i % 7 + 1, i % 7}} end box.commit()
+box.begin() for i = 1, 1000 do s3:insert{i, 1000 - i} end box.commit()
+box.snapshot()
+-- Some rows are recovered from WAL.
+box.begin() for i = 5001, 6000 do s1:insert{i, tostring(i % 100), 10000 - i} end box.commit()
+s4:insert{1, 1}
+
+test_run:cmd("restart server default")
+
+s1 = box.space.s1
+s2 = box.space.s2
+s3 = box.space.s3
+s4 = box.space.s4
+s1.index.sk:count(), s1.index.hint:count(), s1.index.hash:count(), s1.index.null:count()
+s1.index.sk:count('7')
+s1.index.hint:min()[1], s1.index.hint:max()[1]
+s1.index.hash:get(9000)[1]
+s1.index.null:min()[4], s1.index.null:max()[4]
+s2.index.mk:count(0), s2.index.mk:count(7), s2.index.mk:count()
+s2.index.func:count()
+s2.index.func:select('10!')[1][1]
+s3.index.sk:min()[1], s3.index.sk:max()[1]
+s4.index.sk:select()
+-- Tuples are ordered the same way as with single threaded build.
+ok = true
+prev = nil
+for _, t in s1.index.sk:pairs() do if prev ~= nil and (prev[2] > t[2] or (prev[2] == t[2] and prev[1] > t[1])) then ok = false end prev = t end
+ok
+
+s1:drop()
+s2:drop()
+s3:drop()
+s4:drop()
+box.schema.func.drop('s2_func')
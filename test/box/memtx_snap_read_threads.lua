@@ -0,0 +1,20 @@
+#!/usr/bin/env tarantool
+
+require('console').listen(os.getenv('ADMIN'))
+
+_G.invalid_cfg_error = select(2, pcall(box.cfg, {
+    memtx_snap_read_threads = -1,
+}))
+
+box.cfg({
+    listen = os.getenv('LISTEN'),
+    memtx_snap_read_threads = tonumber(arg[1]),
+})
+
+function checksum()
+    local sum = 0
+    for _, t in box.space.test:pairs() do
+        sum = (sum * 31 + t[1] + #t[2] + #t[3]) % 4294967291
+    end
+    return sum
+end
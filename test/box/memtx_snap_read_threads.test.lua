@@ -0,0 +1,46 @@
+test_run = require('test_run').new()
+
+--
+-- A snapshot is read, decompressed and decoded by a pipeline of
+-- threads on recovery, unless memtx_snap_read_threads is 0. The
+-- option is static.
+--
+box.cfg.memtx_snap_read_threads
+box.cfg{memtx_snap_read_threads = 2}
+
+test_run:cmd("create server test with script='box/memtx_snap_read_threads.lua'")
+test_run:cmd("start server test with args='0'")
+test_run:cmd("switch test")
+invalid_cfg_error
+box.cfg.memtx_snap_read_threads
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+_ = s:create_index('sk', {parts = {2, 'string'}, unique = false})
+-- Big enough for the snapshot to consist of many tx blocks.
+box.begin() for i = 1, 50000 do s:insert{i, tostring(i % 100), string.rep('x', i % 50)} end box.commit()
+box.snapshot()
+test_run:cmd("switch default")
+sum = test_run:eval('test', 'checksum()')[1]
+
+-- Read the snapshot with one and several decoder threads.
+test_run:cmd("stop server test")
+test_run:cmd("start server test with args='1'")
+test_run:eval('test', 'box.cfg.memtx_snap_read_threads')[1]
+test_run:eval('test', 'box.space.test:count()')[1]
+test_run:eval('test', 'box.space.test.index.sk:count("7")')[1]
+test_run:eval('test', 'checksum()')[1] == sum
+
+test_run:cmd("stop server test")
+test_run:cmd("start server test with args='4'")
+test_run:eval('test', 'box.cfg.memtx_snap_read_threads')[1]
+test_run:eval('test', 'box.space.test:count()')[1]
+test_run:eval('test', 'checksum()')[1] == sum
+
+-- Back to the tx thread.
+test_run:cmd("stop server test")
+test_run:cmd("start server test with args='0'")
+test_run:eval('test', 'checksum()')[1] == sum
+
+test_run:cmd("stop server test")
+test_run:cmd("cleanup server test")
+test_run:cmd("delete server test")
@@ -0,0 +1,59 @@
+test_run = require('test_run').new()
+fio = require('fio')
+xlog = require('xlog')
+
+--
+-- A snapshot can be compressed by several threads. The blocks are
+-- written in order, so the file reads the same as one written by
+-- the checkpoint thread alone. The option is dynamic.
+--
+box.cfg.memtx_snap_write_threads
+box.cfg{memtx_snap_write_threads = -1}
+box.cfg{memtx_snap_write_threads = 0}
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+box.begin() for i = 1, 50000 do s:insert{i, string.rep('x', i % 100)} end box.commit()
+
+test_run:cmd("setopt delimiter ';'")
+function snapshot(threads)
+    box.cfg{memtx_snap_write_threads = threads}
+    -- Make sure a new snapshot is created.
+    s:replace(s:get(1))
+    box.snapshot()
+    local path = fio.pathjoin(box.cfg.memtx_dir,
+        string.format('%020d.snap', box.info.signature))
+    local rows, sum, ok = 0, 0, true
+    local prev_lsn = nil
+    for _, row in xlog.pairs(path) do
+        local lsn = row.HEADER.lsn or 0
+        if prev_lsn ~= nil and lsn ~= prev_lsn + 1 then
+            ok = false
+        end
+        prev_lsn = lsn
+        rows = rows + 1
+        if row.BODY.space_id == s.id then
+            local t = row.BODY.tuple
+            sum = (sum * 31 + t[1] + #t[2]) % 4294967291
+        end
+    end
+    return {rows = rows, sum = sum, ok = ok}
+end;
+test_run:cmd("setopt delimiter ''");
+
+expected = snapshot(0)
+expected.ok, expected.sum
+r = snapshot(1)
+r.ok, r.rows == expected.rows, r.sum == expected.sum
+r = snapshot(4)
+r.ok, r.rows == expected.rows, r.sum == expected.sum
+box.cfg.memtx_snap_write_threads
+
+-- The snapshot is recovered.
+test_run:cmd("restart server default")
+s = box.space.test
+s:count()
+sum = 0
+for _, t in s:pairs() do sum = (sum * 31 + t[1] + #t[2]) % 4294967291 end
+sum
+s:drop()
@@ -43,6 +43,8 @@ test_run:cmd("setopt delimiter ';'")
 for k, v in pairs(box.stat()) do
     table.insert(t, k)
 end;
+-- The order of pairs() depends on the set of keys.
+table.sort(t);
 for k, v in pairs(box.stat().DELETE) do
     table.insert(t, k)
 end;
@@ -73,9 +75,14 @@ t = {};
 for k, v in pairs(box.slab.info()) do
     table.insert(t, k)
 end;
+table.sort(t);
 t;
+box.slab.info().huge_pages;
+box.slab.info().arena_huge_size;
 box.runtime.info().used > 0;
 box.runtime.info().maxalloc > 0;
+box.runtime.info().fiber_stack_rss == nil;
+box.runtime.info({stack_rss = true}).fiber_stack_rss > 0;
 
 --
 -- gh-502: box.slab.info() excessively sparse array
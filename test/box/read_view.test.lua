@@ -0,0 +1,59 @@
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+for i = 1, 100 do s:insert({i, i}) end
+v = box.schema.space.create('test_vinyl', {engine = 'vinyl'})
+_ = v:create_index('pk')
+
+--
+-- Read views are supported by memtx only.
+--
+box.read_view.open({'test_vinyl'})
+box.read_view.open({'no_such_space'})
+box.read_view.open()
+
+--
+-- Changes made after a read view is opened are not visible
+-- through it.
+--
+rv = box.read_view.open({'test'})
+for i = 1, 50 do s:delete({i}) end
+_ = s:replace({51, 'x'})
+s:count()
+rv:fetch('test', 3)
+rv:fetch(s.id, 2)
+rv:count('test')
+rv:fetch('test', 10)
+rv:fetch('test', 0)
+rv:fetch('test_vinyl', 1)
+
+--
+-- A read view can't be used after close.
+--
+rv:close()
+rv:fetch('test', 1)
+rv:close()
+
+--
+-- A read view may be closed while it is being read.
+--
+fiber = require('fiber')
+rv = box.read_view.open({'test'})
+ch = fiber.channel(1)
+_ = fiber.create(function() ch:put(rv:count('test')) end)
+_ = fiber.create(function() ch:put(pcall(rv.count, rv, 'test')) end)
+rv:close()
+ch:get()
+ch:get()
+
+--
+-- Fetched tuples have the space field names.
+--
+s:format({{'id', 'unsigned'}, {'value', 'any'}})
+rv = box.read_view.open({'test'})
+t = rv:fetch('test', 1)[1]
+t.value
+t.id
+rv:close()
+
+s:drop()
+v:drop()
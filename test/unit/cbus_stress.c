@@ -27,6 +27,15 @@ static const int connect_prob = 30;
 /* Chance of disconnecting from a random neighbor in a loop iteration. */
 static const int disconnect_prob = 20;
 
+/*
+ * Number of messages sent by each test thread to the main thread
+ * in the batch test.
+ */
+static const int batch_msg_count = 20000;
+
+/* Size of message batches sent in the batch test. */
+static const int batch_size = 64;
+
 /* This structure represents a connection to a test thread. */
 struct conn {
 	bool active;
@@ -71,6 +80,8 @@ struct thread {
 	 * Sum 'send' must be equal to sum 'received' over all test threads.
 	 */
 	int sent, received;
+	/* Messages sent by this thread in the batch test. */
+	struct cmsg *batch_msgs;
 };
 
 /* Array of test threads. */
@@ -80,6 +91,8 @@ static struct thread *threads;
  * When it reaches 0, the main thread is signalled to stop.
  */
 static int active_thread_count;
+/* Number of batch test messages received by the main thread. */
+static int batch_received;
 
 static const char *
 thread_name(int id)
@@ -164,6 +177,7 @@ thread_destroy(struct thread *t)
 	if (cord_join(&t->cord) != 0)
 		unreachable();
 
+	free(t->batch_msgs);
 	free(t->connected);
 	free(t->disconnected);
 	free(t->connections);
@@ -277,10 +291,7 @@ test_complete_cb(struct cmsg *cmsg)
 {
 	(void)cmsg;
 	assert(active_thread_count > 0);
-	if (--active_thread_count == 0) {
-		/* Stop the main fiber when all workers are done. */
-		fiber_cancel(fiber());
-	}
+	active_thread_count--;
 }
 
 static int
@@ -307,6 +318,70 @@ test_func(va_list ap)
 	return 0;
 }
 
+static void
+batch_msg_received_cb(struct cmsg *cmsg)
+{
+	(void)cmsg;
+	batch_received++;
+}
+
+static int
+batch_func(va_list ap)
+{
+	struct thread *t = va_arg(ap, struct thread *);
+	static struct cmsg_hop route[] = {
+		{ batch_msg_received_cb, NULL }
+	};
+	struct cmsg *msgs = calloc(batch_msg_count, sizeof(*msgs));
+	assert(msgs != NULL);
+	t->batch_msgs = msgs;
+	/* The pipe is flushed whenever a batch is complete. */
+	cpipe_set_max_input(&t->main_pipe, batch_size);
+	for (int i = 0; i < batch_msg_count; i++) {
+		cmsg_init(&msgs[i], route);
+		cpipe_push_input(&t->main_pipe, &msgs[i]);
+	}
+	static struct cmsg_hop complete_route[] = {
+		{ test_complete_cb, NULL }
+	};
+	cmsg_init(&t->cmsg, complete_route);
+	cpipe_push_input(&t->main_pipe, &t->cmsg);
+	cpipe_deliver_now(&t->main_pipe);
+	return 0;
+}
+
+static void
+thread_start_batch_cb(struct cmsg *cmsg)
+{
+	struct thread *t = container_of(cmsg, struct thread, cmsg);
+	struct fiber *batch_fiber = fiber_new("batch", batch_func);
+	assert(batch_fiber != NULL);
+	fiber_start(batch_fiber, t);
+}
+
+/* Signal a test thread to start the batch test. */
+static void
+thread_start_batch(struct thread *t)
+{
+	static struct cmsg_hop start_route[] = {
+		{ thread_start_batch_cb, NULL }
+	};
+	cmsg_init(&t->cmsg, start_route);
+	cpipe_push(&t->thread_pipe, &t->cmsg);
+}
+
+/* Process messages until all test threads are done. */
+static void
+main_loop(struct cbus_endpoint *endpoint)
+{
+	while (true) {
+		cbus_process(endpoint);
+		if (active_thread_count == 0)
+			break;
+		fiber_yield();
+	}
+}
+
 static int
 thread_func(va_list ap)
 {
@@ -342,17 +417,31 @@ main_func(va_list ap)
 	for (int i = 0; i < thread_count; i++)
 		thread_start_test(&threads[i]);
 
-	cbus_loop(&endpoint);
+	main_loop(&endpoint);
 
 	int sent = 0, received = 0;
 	for (int i = 0; i < thread_count; i++) {
 		struct thread *t = &threads[i];
 		sent += t->sent;
 		received += t->received;
-		thread_destroy(t);
 	}
 	assert(sent == received);
 
+	/*
+	 * Many producers send batches of messages to one
+	 * consumer, none of them may be lost.
+	 */
+	active_thread_count = thread_count;
+	for (int i = 0; i < thread_count; i++)
+		thread_start_batch(&threads[i]);
+
+	main_loop(&endpoint);
+
+	assert(batch_received == thread_count * batch_msg_count);
+
+	for (int i = 0; i < thread_count; i++)
+		thread_destroy(&threads[i]);
+
 	cbus_endpoint_destroy(&endpoint, cbus_process);
 
 	free(threads);
@@ -6,6 +6,8 @@
 #include "unit.h"
 #include "unit.h"
 
+#include <unistd.h>
+
 int
 touch_f(va_list ap)
 {
@@ -135,6 +137,81 @@ test_getaddrinfo(void)
 	footer();
 }
 
+static int block_started = 0;
+static int block_finished = 0;
+static bool block_is_released = false;
+
+static int
+block_cb(struct coio_task *task)
+{
+	(void)task;
+	__atomic_add_fetch(&block_started, 1, __ATOMIC_SEQ_CST);
+	while (!__atomic_load_n(&block_is_released, __ATOMIC_SEQ_CST))
+		usleep(1000);
+	__atomic_add_fetch(&block_finished, 1, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+static int
+block_free_cb(struct coio_task *task)
+{
+	coio_task_destroy(task);
+	free(task);
+	return 0;
+}
+
+static int
+noop_cb(struct coio_task *task)
+{
+	(void)task;
+	return 0;
+}
+
+static void
+test_priority(void)
+{
+	header();
+	plan(4);
+
+	coio_set_thread_count(2);
+	struct coio_task_stat stat;
+	coio_task_stat(COIO_PRI_HIGH, &stat);
+	int64_t high_count = stat.count;
+	/*
+	 * Low priority tasks may occupy all workers but one,
+	 * so the second task has to wait for the first one.
+	 */
+	for (int i = 0; i < 2; i++) {
+		struct coio_task *task =
+			(struct coio_task *)malloc(sizeof(*task));
+		fail_unless(task != NULL);
+		coio_task_create(task, block_cb, block_free_cb);
+		task->pri = COIO_PRI_LOW;
+		coio_task_post(task);
+	}
+	while (__atomic_load_n(&block_started, __ATOMIC_SEQ_CST) == 0)
+		fiber_sleep(0.001);
+
+	struct coio_task task;
+	coio_task_create(&task, noop_cb, noop_cb);
+	task.pri = COIO_PRI_HIGH;
+	is(coio_task_execute(&task, 10), 0,
+	   "high priority task is not blocked by low priority ones");
+	coio_task_destroy(&task);
+	is(__atomic_load_n(&block_started, __ATOMIC_SEQ_CST), 1,
+	   "low priority tasks leave a worker free");
+
+	__atomic_store_n(&block_is_released, true, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&block_finished, __ATOMIC_SEQ_CST) < 2)
+		fiber_sleep(0.001);
+	ok(true, "low priority tasks are done");
+	coio_task_stat(COIO_PRI_HIGH, &stat);
+	is(stat.count, high_count + 1, "high priority task is accounted");
+
+	check_plan();
+	footer();
+}
+
 static int
 main_f(va_list ap)
 {
@@ -154,6 +231,7 @@ main_f(va_list ap)
 	fiber_join(call_fiber);
 
 	test_getaddrinfo();
+	test_priority();
 
 	ev_break(loop(), EVBREAK_ALL);
 	return 0;
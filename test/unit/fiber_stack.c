@@ -12,6 +12,16 @@ noop_f(va_list ap)
 	return 0;
 }
 
+static int
+deep_stack_f(va_list ap)
+{
+	(void)ap;
+	/* Overwrite the stack watermark. */
+	volatile char buf[128 * 1024];
+	memset((char *)buf, 1, sizeof(buf));
+	return buf[0] - 1;
+}
+
 static int
 main_f(va_list ap)
 {
@@ -19,9 +29,11 @@ main_f(va_list ap)
 	size_t used_before, used_after;
 	struct errinj *inj;
 	struct fiber *fiber;
+	struct fiber *fibers[FIBER_STACK_POOL_MAX + 1];
+	struct fiber_stack_stat stat_before, stat_after;
 
 	header();
-	plan(6);
+	plan(10);
 
 	/*
 	 * Set non-default stack size to prevent reusing of an
@@ -63,7 +75,9 @@ main_f(va_list ap)
 	/*
 	 * Check if we leak on fiber destruction.
 	 * We will print an error and result get
-	 * compared by testing engine.
+	 * compared by testing engine. Dead fibers with
+	 * a custom stack are pooled, so make one more
+	 * than the pool can hold to get one destroyed.
 	 */
 	fiber_attr_delete(fiber_attr);
 	fiber_attr = fiber_attr_new();
@@ -74,20 +88,79 @@ main_f(va_list ap)
 
 	used_before = slabc->allocated.stats.used;
 
-	fiber = fiber_new_ex("test_madvise", fiber_attr, noop_f);
-	ok(fiber != NULL, "fiber with custom stack");
-	fiber_set_joinable(fiber, true);
+	bool created = true;
+	for (int i = 0; i < (int)lengthof(fibers); i++) {
+		fibers[i] = fiber_new_ex("test_madvise", fiber_attr, noop_f);
+		if (fibers[i] == NULL) {
+			created = false;
+			break;
+		}
+		fiber_set_joinable(fibers[i], true);
+	}
+	ok(created, "fiber with custom stack");
 
 	inj = errinj(ERRINJ_FIBER_MPROTECT, ERRINJ_INT);
 	inj->iparam = PROT_READ | PROT_WRITE;
 
-	fiber_start(fiber);
-	fiber_join(fiber);
+	for (int i = 0; created && i < (int)lengthof(fibers); i++) {
+		fiber_start(fibers[i]);
+		fiber_join(fibers[i]);
+	}
 	inj->iparam = -1;
 
 	used_after = slabc->allocated.stats.used;
 	ok(used_after > used_before, "expected leak detected");
 
+	/*
+	 * A dead fiber with a stack of the same size class
+	 * is reused.
+	 */
+	cord_stack_stat(cord(), &stat_before, false);
+	fiber = fiber_new_ex("test_pool", fiber_attr, noop_f);
+	fiber_set_joinable(fiber, true);
+	fiber_start(fiber);
+	fiber_join(fiber);
+	cord_stack_stat(cord(), &stat_after, false);
+	ok(stat_after.reused == stat_before.reused + 1 &&
+	   stat_after.created == stat_before.created,
+	   "custom stack is reused");
+
+	/*
+	 * A stack grown above the watermark is trimmed when
+	 * the event loop is idle.
+	 */
+	fiber = fiber_new("test_trim", deep_stack_f);
+	fiber_set_joinable(fiber, true);
+	fiber_start(fiber);
+	fiber_join(fiber);
+	ok(!rlist_empty(&cord()->stack_trim), "stack trim is scheduled");
+	cord_stack_stat(cord(), &stat_before, false);
+	fiber_sleep(0);
+	cord_stack_stat(cord(), &stat_after, false);
+	ok(rlist_empty(&cord()->stack_trim) &&
+	   stat_after.trimmed > stat_before.trimmed,
+	   "stack is trimmed in background");
+
+	/*
+	 * A pooled stack is reused only for a size of the same
+	 * class, so it is never smaller than requested.
+	 */
+	fiber_attr->stack_size = 256 << 10;
+	fiber = fiber_new_ex("test_class", fiber_attr, noop_f);
+	fiber_set_joinable(fiber, true);
+	fiber_start(fiber);
+	fiber_join(fiber);
+	fiber_attr->stack_size = (256 << 10) + 1;
+	fiber = fiber_new_ex("test_class", fiber_attr, noop_f);
+	ok(fiber != NULL &&
+	   fiber->stack_slab->size >= fiber_attr->stack_size,
+	   "reused stack is not smaller than requested");
+	if (fiber != NULL) {
+		fiber_set_joinable(fiber, true);
+		fiber_start(fiber);
+		fiber_join(fiber);
+	}
+
 	fiber_attr_delete(fiber_attr);
 	footer();
 
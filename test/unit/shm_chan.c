@@ -0,0 +1,192 @@
+#include "core/shm_chan.h"
+#include "unit.h"
+#include "trivia/util.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+enum { RING_SIZE = 4096 };
+
+static struct shm_chan server;
+static struct shm_chan client;
+
+static void
+shm_chan_test_connect(void)
+{
+	header();
+	plan(3);
+
+	int sv[2];
+	fail_if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0);
+	is(shm_chan_accept(&server, sv[0], RING_SIZE - 1), 0, "accept");
+	is(shm_chan_connect(&client, sv[1]), 0, "connect");
+	is(client.ring_size, RING_SIZE, "ring size is a power of 2");
+	close(sv[0]);
+	close(sv[1]);
+
+	check_plan();
+	footer();
+}
+
+static void
+shm_chan_test_transfer(void)
+{
+	header();
+	plan(8);
+
+	char buf[RING_SIZE];
+	is(shm_chan_read(&server, buf, sizeof(buf)), -1, "read empty");
+	is(errno, EAGAIN, "EAGAIN");
+
+	/* Make the data wrap around the end of the ring. */
+	char out[RING_SIZE];
+	for (int i = 0; i < RING_SIZE; i++)
+		out[i] = (char)i;
+	struct iovec iov[2] = {
+		{ out, 100 }, { out + 100, RING_SIZE - 200 },
+	};
+	is(shm_chan_writev(&client, iov, 2), RING_SIZE - 100, "write");
+	is(shm_chan_read(&server, buf, sizeof(buf)), RING_SIZE - 100, "read");
+	iov[0].iov_base = out;
+	iov[0].iov_len = RING_SIZE;
+	is(shm_chan_writev(&client, iov, 1), RING_SIZE, "write full ring");
+	is(shm_chan_writev(&client, iov, 1), -1, "write to full ring");
+	is(shm_chan_read(&server, buf, sizeof(buf)), RING_SIZE,
+	   "read full ring");
+	is(memcmp(buf, out, RING_SIZE), 0, "data");
+
+	check_plan();
+	footer();
+}
+
+static void
+shm_chan_test_wait(void)
+{
+	header();
+	plan(6);
+
+	is(shm_chan_prepare_wait(&server, SHM_CHAN_READ | SHM_CHAN_WRITE),
+	   SHM_CHAN_WRITE, "empty ring is not readable");
+	is(shm_chan_wait(&server, SHM_CHAN_READ, 0), 0, "no doorbell");
+	struct iovec iov = { (void *)"ping", 4 };
+	is(shm_chan_writev(&client, &iov, 1), 4, "write");
+	is(shm_chan_wait(&server, SHM_CHAN_READ, 0), SHM_CHAN_READ,
+	   "doorbell");
+	/* The flag is reset, the doorbell is rung once. */
+	is(shm_chan_writev(&client, &iov, 1), 4, "write");
+	is(shm_chan_prepare_wait(&server, SHM_CHAN_READ), SHM_CHAN_READ,
+	   "readable");
+
+	check_plan();
+	footer();
+}
+
+static void
+shm_chan_test_close(void)
+{
+	header();
+	plan(5);
+
+	char buf[16];
+	shm_chan_close(&client);
+	is(shm_chan_read(&server, buf, sizeof(buf)), 8,
+	   "read the data written before close");
+	is(shm_chan_read(&server, buf, sizeof(buf)), 0, "EOF");
+	struct iovec iov = { buf, sizeof(buf) };
+	is(shm_chan_writev(&server, &iov, 1), -1, "write to closed channel");
+	is(errno, EPIPE, "EPIPE");
+	is(shm_chan_prepare_wait(&server, SHM_CHAN_READ), SHM_CHAN_READ,
+	   "closed channel is readable");
+	shm_chan_close(&server);
+
+	check_plan();
+	footer();
+}
+
+/**
+ * Counters and flags in a ring header, see struct shm_ring. The
+ * ring the client writes to goes first in the mapping.
+ */
+enum {
+	RING_HEAD = 0,
+	RING_WRITER_CLOSED = 8,
+	RING_TAIL = 64,
+	RING_HEADER_SIZE = 128,
+};
+
+static void *
+ring_field(struct shm_chan *ch, bool is_up, size_t offset)
+{
+	char *ring = (char *)ch->map;
+	if (!is_up)
+		ring += RING_HEADER_SIZE + ch->ring_size;
+	return ring + offset;
+}
+
+static void
+shm_chan_test_forged(void)
+{
+	header();
+	plan(12);
+
+	int sv[2];
+	fail_if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0);
+	fail_if(shm_chan_accept(&server, sv[0], RING_SIZE) != 0);
+	fail_if(shm_chan_connect(&client, sv[1]) != 0);
+	close(sv[0]);
+	close(sv[1]);
+
+	char buf[4 * RING_SIZE];
+	uint64_t *head = ring_field(&client, true, RING_HEAD);
+	*head = 2 * RING_SIZE;
+	is(shm_chan_read(&server, buf, sizeof(buf)), -1,
+	   "read a ring with the head too far ahead");
+	is(errno, EPROTO, "EPROTO");
+	*head = 0;
+	uint32_t *is_closed = ring_field(&client, true, RING_WRITER_CLOSED);
+	*is_closed = 2;
+	is(shm_chan_read(&server, buf, sizeof(buf)), -1,
+	   "read a ring with a bad closed flag");
+	is(errno, EPROTO, "EPROTO");
+	*is_closed = 0;
+
+	struct iovec iov = { buf, 100 };
+	is(shm_chan_writev(&server, &iov, 1), 100, "write");
+	uint64_t *tail = ring_field(&client, false, RING_TAIL);
+	*tail = 200;
+	is(shm_chan_writev(&server, &iov, 1), -1,
+	   "write to a ring with the tail ahead of the head");
+	is(errno, EPROTO, "EPROTO");
+	is(shm_chan_read(&client, buf, sizeof(buf)), 100, "read");
+	is(shm_chan_writev(&server, &iov, 1), 100, "write");
+	*tail = 0;
+	is(shm_chan_writev(&server, &iov, 1), -1,
+	   "write to a ring with the tail moved back");
+	is(errno, EPROTO, "EPROTO");
+	is(shm_chan_prepare_wait(&server, SHM_CHAN_WRITE), SHM_CHAN_WRITE,
+	   "corrupted ring is ready");
+
+	shm_chan_close(&client);
+	shm_chan_close(&server);
+
+	check_plan();
+	footer();
+}
+
+int
+main(void)
+{
+	header();
+	plan(5);
+
+	shm_chan_test_connect();
+	shm_chan_test_transfer();
+	shm_chan_test_wait();
+	shm_chan_test_close();
+	shm_chan_test_forged();
+
+	footer();
+	return check_plan();
+}
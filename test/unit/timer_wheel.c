@@ -0,0 +1,238 @@
+#include <stdlib.h>
+
+#include "memory.h"
+#include "fiber.h"
+#include "timer_wheel.h"
+#include "unit.h"
+#include "trivia/util.h"
+
+/** Number of timers in the randomized test. */
+enum { RANDOM_TIMER_COUNT = 1000 };
+
+static int
+expired_count(struct rlist *expired)
+{
+	int count = 0;
+	struct timer_wheel_entry *entry;
+	rlist_foreach_entry(entry, expired, link)
+		count++;
+	return count;
+}
+
+static void
+test_basic(void)
+{
+	header();
+	plan(8);
+
+	struct timer_wheel wheel;
+	timer_wheel_create(&wheel, 100);
+	struct timer_wheel_entry a, b, c;
+	timer_wheel_entry_create(&a);
+	timer_wheel_entry_create(&b);
+	timer_wheel_entry_create(&c);
+	timer_wheel_add(&wheel, &a, 110);
+	timer_wheel_add(&wheel, &b, 5000);
+	timer_wheel_add(&wheel, &c, 50);
+	is(timer_wheel_next(&wheel), 101, "past deadline is due next tick");
+
+	RLIST_HEAD(expired);
+	timer_wheel_advance(&wheel, 109, &expired);
+	ok(expired_count(&expired) == 1 &&
+	   rlist_first_entry(&expired, struct timer_wheel_entry, link) == &c,
+	   "past deadline expired");
+	ok(!timer_wheel_entry_is_armed(&c), "expired timer is disarmed");
+
+	rlist_create(&expired);
+	timer_wheel_advance(&wheel, 110, &expired);
+	ok(expired_count(&expired) == 1 &&
+	   rlist_first_entry(&expired, struct timer_wheel_entry, link) == &a,
+	   "timer expired on its deadline");
+
+	timer_wheel_del(&wheel, &b);
+	ok(timer_wheel_is_empty(&wheel), "cancelled timer is removed");
+	is(timer_wheel_next(&wheel), UINT64_MAX, "empty wheel has no next");
+	timer_wheel_del(&wheel, &b);
+	ok(timer_wheel_is_empty(&wheel), "cancelling twice is a no-op");
+
+	rlist_create(&expired);
+	timer_wheel_advance(&wheel, 100000, &expired);
+	is(wheel.now, 100000, "empty wheel time advanced");
+
+	check_plan();
+	footer();
+}
+
+static void
+test_far(void)
+{
+	header();
+	plan(3);
+
+	const uint64_t span =
+		(uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+	struct timer_wheel wheel;
+	timer_wheel_create(&wheel, 12345);
+	struct timer_wheel_entry entry;
+	timer_wheel_entry_create(&entry);
+	uint64_t expire = 12345 + 3 * span + 777;
+	timer_wheel_add(&wheel, &entry, expire);
+
+	RLIST_HEAD(expired);
+	timer_wheel_advance(&wheel, expire - 1, &expired);
+	ok(rlist_empty(&expired), "timer beyond the span is not expired early");
+	ok(timer_wheel_next(&wheel) <= expire, "next is not after deadline");
+	timer_wheel_advance(&wheel, expire, &expired);
+	is(expired_count(&expired), 1, "timer beyond the span expired");
+
+	check_plan();
+	footer();
+}
+
+/**
+ * Arm, cancel and expire random timers, checking every advance
+ * against a brute-force scan.
+ */
+static void
+test_random(void)
+{
+	header();
+	plan(3);
+
+	static struct timer_wheel_entry entries[RANDOM_TIMER_COUNT];
+	static uint64_t deadlines[RANDOM_TIMER_COUNT];
+	struct timer_wheel wheel;
+	uint64_t now = 987654321;
+	timer_wheel_create(&wheel, now);
+	for (int i = 0; i < RANDOM_TIMER_COUNT; i++)
+		timer_wheel_entry_create(&entries[i]);
+
+	int early = 0, missed = 0, late_next = 0;
+	for (int step = 0; step < 100000; step++) {
+		int i = rand() % RANDOM_TIMER_COUNT;
+		struct timer_wheel_entry *entry = &entries[i];
+		switch (rand() % 3) {
+		case 0: {
+			if (timer_wheel_entry_is_armed(entry))
+				break;
+			uint64_t delay;
+			switch (rand() % 3) {
+			case 0:
+				delay = 1 + rand() % 100;
+				break;
+			case 1:
+				delay = 1 + rand() % 100000;
+				break;
+			default:
+				delay = 1 + ((uint64_t)rand() << 16) % (1ULL << 40);
+				break;
+			}
+			deadlines[i] = now + delay;
+			timer_wheel_add(&wheel, entry, deadlines[i]);
+			break;
+		}
+		case 1:
+			timer_wheel_del(&wheel, entry);
+			break;
+		default: {
+			now += rand() % 4 == 0 ?
+			       ((uint64_t)rand() << 8) % (1ULL << 36) :
+			       (uint64_t)(rand() % 200);
+			RLIST_HEAD(expired);
+			timer_wheel_advance(&wheel, now, &expired);
+			struct timer_wheel_entry *e, *tmp;
+			rlist_foreach_entry_safe(e, &expired, link, tmp) {
+				rlist_del_entry(e, link);
+				if (deadlines[e - entries] > now)
+					early++;
+			}
+			uint64_t next = timer_wheel_next(&wheel);
+			for (int j = 0; j < RANDOM_TIMER_COUNT; j++) {
+				if (!timer_wheel_entry_is_armed(&entries[j]))
+					continue;
+				if (deadlines[j] <= now)
+					missed++;
+				else if (deadlines[j] < next)
+					late_next++;
+			}
+			break;
+		}
+		}
+	}
+	is(early, 0, "no timer expired early");
+	is(missed, 0, "no timer missed");
+	is(late_next, 0, "next is never after a deadline");
+
+	check_plan();
+	footer();
+}
+
+static int
+sleeper_f(va_list ap)
+{
+	double delay = va_arg(ap, double);
+	bool *timed_out = va_arg(ap, bool *);
+	*timed_out = fiber_yield_timeout(delay);
+	return 0;
+}
+
+static void
+test_fiber(void)
+{
+	header();
+	plan(5);
+
+	double start = ev_monotonic_now(loop());
+	fiber_sleep(0.02);
+	ok(ev_monotonic_now(loop()) - start >= 0.02, "fiber slept enough");
+
+	bool timed_out = true;
+	struct fiber *f = fiber_new("sleeper", sleeper_f);
+	fiber_set_joinable(f, true);
+	fiber_start(f, 100.0, &timed_out);
+	ok(!timer_wheel_is_empty(&cord()->timer_wheel), "timer armed");
+	fiber_wakeup(f);
+	fiber_join(f);
+	ok(!timed_out, "woken up before timeout");
+	ok(timer_wheel_is_empty(&cord()->timer_wheel), "timer cancelled");
+
+	f = fiber_new("sleeper", sleeper_f);
+	fiber_set_joinable(f, true);
+	fiber_start(f, 0.03, &timed_out);
+	fiber_join(f);
+	ok(timed_out, "timed out");
+
+	check_plan();
+	footer();
+}
+
+static int
+main_f(va_list ap)
+{
+	(void)ap;
+	test_basic();
+	test_far();
+	test_random();
+	test_fiber();
+	ev_break(loop(), EVBREAK_ALL);
+	return 0;
+}
+
+int
+main(void)
+{
+	header();
+	plan(4);
+
+	srand(1);
+	memory_init();
+	fiber_init(fiber_c_invoke);
+	struct fiber *f = fiber_new("main", main_f);
+	fiber_wakeup(f);
+	ev_run(loop(), 0);
+	fiber_free();
+	memory_free();
+
+	footer();
+	return check_plan();
+}